@@ -4,16 +4,19 @@
 #include <iomanip>
 #include <cstdlib>
 #include <cassert>
+#include <vector>
+#include <utility>
 using namespace std;
 
+//the functions that shift, split or merge arrays move the items (with std::move)
+// instead of copying them, so an item that owns heap memory is never deep copied
+// on its way from one slot or array to another. the slots left behind hold
+// moved-from items. entries passed by value are moved into place as well.
+
 //return the larger of the two items
 template <typename T>
 T maximal(const T& a, const T& b);
 
-//swap the two items
-template <typename T>
-void swap(T& a, T& b);
-
 //return index of the largest item in data
 template <typename T>
 int indexOfMaximal(T data[ ], int n);
@@ -26,9 +29,15 @@ void orderedInsert(T data[ ], int& n, T entry);
 template <typename T>
 int firstGE(const T data[ ], int n, const T& entry);
 
+//same as firstGE, by a branchless binary search of the sorted array data
+template <typename T>
+int firstGEBinary(const T data[ ], int n, const T& entry);
+
 //append entry to the right of data
 template <typename T>
 void attachItem(T data[ ], int& n, const T& entry);
+template <typename T>
+void attachItem(T data[ ], int& n, T&& entry);
 
 //insert entry at index i in data
 template <typename T>
@@ -114,17 +123,6 @@ T maximal(const T& a, const T& b)
     return (a > b) ? a : b;
 }
 
-//preconditions: none
-//postconditions: swap the two items
-template <typename T>
-void swap(T& a, T& b)
-{
-    T temp;
-    temp = a;
-    a = b;
-    b = temp;
-}
-
 //preconditions: none
 //postconditions: return index of the largest item in data
 template <typename T>
@@ -156,9 +154,9 @@ void orderedInsert(T data[], int& n, T entry)
 
     //shift all items to the right of insertAt to the right.
     for(int i = n-1; i >= insertAt; i--)
-        data[i+1] = data[i];
+        data[i+1] = std::move(data[i]);
 
-    data[insertAt] = entry;
+    data[insertAt] = std::move(entry);
     ++n;
 }
 
@@ -186,6 +184,29 @@ int firstGE(const T data[], int n, const T& entry)
     return indexOfGE;
 }
 
+//preconditions: data[] is sorted.
+//postconditions: return the index of the first element in data that is not less than entry
+// if no such element exists, returns n.
+// the range [base, base+len] always holds the answer, and each step halves len by
+// moving base with a conditional move instead of a branch.
+template <typename T>
+int firstGEBinary(const T data[], int n, const T& entry)
+{
+    if(n == 0)
+        return 0;
+
+    const T* base = data;
+    int len = n;
+    while(len > 1)
+    {
+        int half = len / 2;
+        base = (base[half] < entry) ? base + half : base;
+        len -= half;
+    }
+
+    return int(base - data) + (*base < entry);
+}
+
 //preconditions: none
 //postconditions: append entry to the right of data
 template <typename T>
@@ -195,6 +216,15 @@ void attachItem(T data[], int& n, const T& entry)
     ++n;
 }
 
+//preconditions: none
+//postconditions: move entry to the right of data
+template <typename T>
+void attachItem(T data[], int& n, T&& entry)
+{
+    data[n] = std::move(entry);
+    ++n;
+}
+
 //preconditons: data[] has a capacity of at least n+1
 //postconditions: the entry is inserted to data at data[i]
 // and everything right and including data[i] is shifted right.
@@ -202,9 +232,9 @@ template <typename T>
 void insertItem(T data[], int i, int& n, T entry)
 {
     for(int j = n-1; j >= i; j--)
-        data[j+1] = data[j];
+        data[j+1] = std::move(data[j]);
 
-    data[i] = entry;
+    data[i] = std::move(entry);
     ++n;
 }
 
@@ -213,7 +243,7 @@ void insertItem(T data[], int i, int& n, T entry)
 template <typename T>
 T detachItem(T data[], int& n)
 {
-    T item = data[n-1];
+    T item = std::move(data[n-1]);
     n--;
     return item;
 }
@@ -224,10 +254,10 @@ T detachItem(T data[], int& n)
 template <typename T>
 T deleteItem(T data[], int i, int& n)
 {
-    T item = data[i];
+    T item = std::move(data[i]);
     //shift
     for(int j = i; j < n-1; j++)
-        data[j] = data[j+1];
+        data[j] = std::move(data[j+1]);
     --n;
     return item;
 }
@@ -240,7 +270,7 @@ template <typename T>
 void mergeArrays(T dest[], int& destSize, T source[], int& sourceSize)
 {
     for(int i = destSize; i < destSize + sourceSize; i++)
-        dest[i] = source[i-destSize];
+        dest[i] = std::move(source[i-destSize]);
 
     destSize += sourceSize;
     sourceSize = 0;
@@ -254,14 +284,18 @@ void mergeArrays(T dest[], int& destSize, T source[], int& sourceSize)
 template <typename T>
 void mergeFront(T dest[ ], int& destSize, T source[ ], int& sourceSize)
 {
+    //nothing to insert, (and shifting by 0 would move each item onto itself)
+    if(sourceSize == 0)
+        return;
+
     //shift all items in data1 over by n2.
     for(int i = destSize-1; i >= 0; i--)
-        dest[i+sourceSize] = dest[i];
+        dest[i+sourceSize] = std::move(dest[i]);
 
     destSize += sourceSize;
 
     for(int i = 0; i < sourceSize; i++)
-        dest[i] = source[i];
+        dest[i] = std::move(source[i]);
 
     sourceSize = 0;
 }
@@ -278,7 +312,7 @@ void split(T data1[], int& n1, T data2[], int& n2, bool includeMid)
         int mid = (n1+1)/2;
 
         for(int i = mid-1; i < n1; i++)
-            data2[i-mid+1] = data1[i];
+            data2[i-mid+1] = std::move(data1[i]);
 
         n2 = n1 - mid+1;
         n1 = mid-1;
@@ -289,7 +323,7 @@ void split(T data1[], int& n1, T data2[], int& n2, bool includeMid)
         int mid = (n1+1)/2;
 
         for(int i = mid; i < n1; i++)
-            data2[i-mid] = data1[i];
+            data2[i-mid] = std::move(data1[i]);
 
         n2 = n1 - mid;
         n1 = mid;
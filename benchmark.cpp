@@ -0,0 +1,979 @@
+/*************************************************************************************************************************
+ * B+Tree benchmark
+ * ***********************************************************************************************************************
+ * Sweeps the MinDegree (node order) of BPlusTree<int> from 1 to 128, and times the following for each order:
+ *    1) insert:  inserting N shuffled integers into an empty tree.
+ *    2) find:    calling find on every one of the N integers, in a different shuffled order.
+ *    3) iterate: walking the whole tree from begin() to end() with the leaf iterator.
+ * The time per operation (in nanoseconds) is reported for each phase.
+ *
+ * Then, compares building a tree of N sorted keys with bulkLoad, against N calls to insert, and std::sort of N keys.
+ *
+ * Then, times range scans of 100 keys started with lower_bound, forwards, and backwards from the key (top-K).
+ *
+ * Then, times upserts (map[key] += 1) into a Map<int, int>, half of them to keys that are already there.
+ *
+ * Then, churns a tree of N keys (removing and reinserting keys at random) and reports the node allocation counters,
+ * to show how many node allocations the node pools serve per request to the system allocator.
+ *
+ * Then, applies sorted batches of updates (inserts, then erases) to a tree of N keys with insertBatch and eraseBatch,
+ * against one insert or remove per key.
+ *
+ * Then, compares taking a snapshot of a tree of N keys by copying a BPlusTree (copyTree, every node) against
+ * a PersistentBPlusTree snapshot (one shared root), and times writes to the tree while the snapshot is held.
+ *
+ * Then, saves a Map<int, int> of N keys to a binary stream and loads it back (a checkpoint and restore), against
+ * rebuilding the map by inserting the N pairs.
+ *
+ * Then, times durable inserts into a DurableMap<int, int> for group commits of 1, 64 and 4096 changes per sync
+ * of the write-ahead log, and reopening (replaying) the log.
+ *
+ * Then, compares starting up from a file of N keys written by MappedBPlusTree (mapping it) against rebuilding a tree
+ * by inserting the N keys, and times find on the mapped tree.
+ *
+ * Then, builds a PagedBPlusTree<int> of N keys in a file, and times random finds and inserts behind buffer pools
+ * of 1/64, 1/8 and all of the tree's pages, reporting the hit rate and the page reads and writes per operation.
+ *
+ * Then, times insert and find of N URL keys (a long shared prefix) in a BPlusTree<string>, whose separators are
+ * truncated to the shortest distinguishing prefix and searched by the inline heads of NodePrefixes, against a string
+ * key type that keeps whole keys as separators and compares them as strings, and against N int keys.
+ *
+ * Then, times random finds in a BPlusTree<int> of N keys one at a time, against multiFind over the same keys
+ * (descents interleaved in groups), and a scan of the leaves. (the build prefetches during descents and scans
+ * unless BPLUSTREE_PREFETCH is 0, see the CMake option of the same name.)
+ *
+ * Then, times batches of 50 and 500 keys (random over the tree, clustered close together, and clustered and sorted)
+ * looked up in a BPlusTree<int> of N keys with find in a loop, multiFind and findMany, and in a Map<int, int> with
+ * getMany.
+ *
+ * Then, reports the bytes of the (cache line aligned) leaves and inner nodes, and the node bytes per key, of trees
+ * of N ints, N Pair<int, int>s and N URL strings, built by inserts in random order and by bulkLoad.
+ *
+ * Then, times appending N values to the value lists of N/2 keys of an MMap<int, int> (a ValueList per key, short
+ * lists kept in the leaf) and scanning them, against the same tree with a std::vector per key, and reports the
+ * lists that needed a heap block per key.
+ *
+ * Last, for node widths from 4 to 256 keys, compares the searches that can be used inside a node:
+ *    firstGE (linear scan), firstGEBinary (branchless binary search), and NodeSearch (what BPlusTree uses).
+ ************************************************************************************************************************/
+#include "bplustree.h"
+#include "map.h"
+#include "persistentbplustree.h"
+#include "mappedbplustree.h"
+#include "durablemap.h"
+#include "pagedbplustree.h"
+#include "multimap.h"
+#include <string>
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <vector>
+using namespace std;
+
+typedef chrono::steady_clock Clock;
+
+//preconditions: none
+//postconditions: returns the nanoseconds elapsed since start, divided by ops.
+double nsPerOp(Clock::time_point start, size_t ops)
+{
+    return chrono::duration<double, nano>(Clock::now() - start).count() / ops;
+}
+
+//preconditions: keys and probes hold the same n distinct integers.
+//postconditions: a BPlusTree<int, MinDegree> will be built from keys,
+// then probed with probes and iterated, printing one line of results.
+template <int MinDegree>
+void benchOrder(const vector<int>& keys, const vector<int>& probes)
+{
+    BPlusTree<int, MinDegree>* tree = new BPlusTree<int, MinDegree>();
+
+    Clock::time_point start = Clock::now();
+    for(size_t i = 0; i < keys.size(); i++)
+        tree->insert(keys[i]);
+    double insertNs = nsPerOp(start, keys.size());
+
+    size_t hits = 0;
+    start = Clock::now();
+    for(size_t i = 0; i < probes.size(); i++)
+        if(tree->find(probes[i]))
+            hits++;
+    double findNs = nsPerOp(start, probes.size());
+
+    long long sum = 0;
+    start = Clock::now();
+    for(typename BPlusTree<int, MinDegree>::Iterator it = tree->begin(); it != tree->end(); ++it)
+        sum += *it;
+    double iterateNs = nsPerOp(start, keys.size());
+
+    //the checksums keep the compiler from discarding the timed loops.
+    if(hits != probes.size() || sum == 0)
+        cout << "checksum mismatch for order " << MinDegree << endl;
+
+    cout << setw(6) << MinDegree
+         << setw(12) << fixed << setprecision(1) << insertNs
+         << setw(12) << findNs
+         << setw(12) << iterateNs << endl;
+
+    delete tree;
+}
+
+//sweep the orders: 1, 2, 4, ... , 128 at compile time.
+template <int MinDegree>
+struct OrderSweep
+{
+    static void run(const vector<int>& keys, const vector<int>& probes)
+    {
+        benchOrder<MinDegree>(keys, probes);
+        OrderSweep<MinDegree * 2>::run(keys, probes);
+    }
+};
+
+template <>
+struct OrderSweep<256>
+{
+    static void run(const vector<int>&, const vector<int>&) {}
+};
+
+//preconditions: none
+//postconditions: prints the ns per key to sort n shuffled keys, to bulk load n sorted keys,
+// and to insert n sorted keys one at a time.
+void benchBulkLoad(int n)
+{
+    vector<int> keys(n);
+    for(int i = 0; i < n; i++)
+        keys[i] = i;
+    vector<int> shuffled(keys);
+    shuffleArray(shuffled.data(), n);
+
+    Clock::time_point start = Clock::now();
+    sort(shuffled.begin(), shuffled.end());
+    double sortNs = nsPerOp(start, n);
+
+    BPlusTree<int> loaded;
+    start = Clock::now();
+    loaded.bulkLoad(keys.begin(), keys.end());
+    double bulkNs = nsPerOp(start, n);
+
+    BPlusTree<int> inserted;
+    start = Clock::now();
+    for(int i = 0; i < n; i++)
+        inserted.insert(keys[i]);
+    double insertNs = nsPerOp(start, n);
+
+    if(loaded.size() != n || inserted.size() != n)
+        cout << "size mismatch in bulk load benchmark" << endl;
+
+    cout << endl << "building BPlusTree<int> from " << n << " sorted keys (ns / key)" << endl
+         << setw(12) << "std::sort" << setw(12) << "bulkLoad" << setw(12) << "insert" << endl
+         << fixed << setprecision(1)
+         << setw(12) << sortNs << setw(12) << bulkNs << setw(12) << insertNs << endl;
+}
+
+//preconditions: none
+//postconditions: prints the ns per scan of the keys in [a, a + WIDTH) of a tree of keys 0 .. n-1,
+// for random a, walking from lower_bound(a) along the leaves, and the ns per scan of
+// the WIDTH keys before a, walking backwards from lower_bound(a).
+void benchRangeScan(int n)
+{
+    const int WIDTH = 100;
+    const int SCANS = 100000;
+
+    vector<int> keys(n);
+    for(int i = 0; i < n; i++)
+        keys[i] = i;
+    BPlusTree<int> tree;
+    tree.bulkLoad(keys.begin(), keys.end());
+
+    long long sum = 0;
+    Clock::time_point start = Clock::now();
+    for(int s = 0; s < SCANS; s++)
+    {
+        int a = rand() % n;
+        for(BPlusTree<int>::Iterator it = tree.lower_bound(a); it != tree.end() && *it < a + WIDTH; ++it)
+            sum += *it;
+    }
+    double scanNs = nsPerOp(start, SCANS);
+
+    start = Clock::now();
+    for(int s = 0; s < SCANS; s++)
+    {
+        int a = rand() % n;
+        BPlusTree<int>::Iterator it = tree.lower_bound(a);
+        for(int k = 0; k < WIDTH && it != tree.begin(); k++)
+            sum += *(--it);
+    }
+    double reverseNs = nsPerOp(start, SCANS);
+
+    cout << endl << "scanning " << WIDTH << " keys from lower_bound in a BPlusTree<int> of " << n << " keys" << endl
+         << setw(12) << "forward" << setw(12) << "backward" << "  (ns / scan)" << endl
+         << fixed << setprecision(1) << setw(12) << scanNs << setw(12) << reverseNs
+         << "  (checksum " << sum << ")" << endl;
+}
+
+//preconditions: none
+//postconditions: prints the ns per upsert of n random keys in [0, n/2) into a Map<int, int>,
+// each of which either inserts the key or updates its value in one descent.
+void benchUpsert(int n)
+{
+    Map<int, int> counts;
+    vector<int> keys(n);
+    for(int i = 0; i < n; i++)
+        keys[i] = rand() % (n / 2 + 1);
+
+    Clock::time_point start = Clock::now();
+    for(int i = 0; i < n; i++)
+        counts[keys[i]] += 1;
+    double upsertNs = nsPerOp(start, n);
+
+    cout << endl << "upserting " << n << " random keys into a Map<int, int> of up to " << n / 2 + 1 << " keys" << endl
+         << setw(12) << "ns / op" << setw(12) << "keys" << endl
+         << fixed << setprecision(1) << setw(12) << upsertNs << setw(12) << counts.size() << endl;
+}
+
+//preconditions: none
+//postconditions: prints the ns per operation of removing and reinserting random keys of a tree of n keys,
+// along with the node allocation counters of the tree, and the ns per key of clearTree.
+void benchChurn(int n)
+{
+    vector<int> keys(n);
+    for(int i = 0; i < n; i++)
+        keys[i] = i;
+    shuffleArray(keys.data(), n);
+
+    BPlusTree<int> tree;
+    for(int i = 0; i < n; i++)
+        tree.insert(keys[i]);
+
+    //remove a random half of the keys, put them back, and repeat.
+    const int ROUNDS = 4;
+    Clock::time_point start = Clock::now();
+    for(int r = 0; r < ROUNDS; r++)
+    {
+        shuffleArray(keys.data(), n);
+        for(int i = 0; i < n / 2; i++)
+            tree.remove(keys[i]);
+        for(int i = 0; i < n / 2; i++)
+            tree.insert(keys[i]);
+    }
+    double churnNs = nsPerOp(start, size_t(ROUNDS) * n);
+    PoolStats stats = tree.allocationStats();
+
+    start = Clock::now();
+    tree.clearTree();
+    double clearNs = nsPerOp(start, n);
+
+    if(!tree.empty())
+        cout << "size mismatch in churn benchmark" << endl;
+
+    cout << endl << "churning BPlusTree<int> of " << n << " keys" << endl
+         << setw(12) << "ns / op" << setw(12) << "node allocs" << setw(12) << "node frees"
+         << setw(12) << "slab allocs" << setw(12) << "slab KiB" << setw(14) << "clear ns/key" << endl
+         << fixed << setprecision(1)
+         << setw(12) << churnNs << setw(12) << stats.allocations << setw(12) << stats.deallocations
+         << setw(12) << stats.slabAllocations << setw(12) << stats.slabBytes / 1024 << setw(14) << clearNs << endl;
+}
+
+//preconditions: none
+//postconditions: prints the time of saving a Map<int, int> of n keys to a stringstream, of loading it
+// into another map, and of inserting the n pairs into a map one at a time, with the bytes saved.
+void benchSaveLoad(int n)
+{
+    vector<int> keys(n);
+    for(int i = 0; i < n; i++)
+        keys[i] = i;
+    shuffleArray(keys.data(), n);
+
+    Clock::time_point start = Clock::now();
+    Map<int, int> map;
+    for(int i = 0; i < n; i++)
+        map.insert(keys[i], i);
+    double insertMs = nsPerOp(start, 1) / 1e6;
+
+    stringstream stream;
+    start = Clock::now();
+    bool saved = map.save(stream);
+    double saveMs = nsPerOp(start, 1) / 1e6;
+
+    Map<int, int> loaded;
+    start = Clock::now();
+    bool ok = saved && loaded.load(stream);
+    double loadMs = nsPerOp(start, 1) / 1e6;
+
+    if(!ok || loaded.size() != n)
+        cout << "size mismatch in save and load benchmark" << endl;
+
+    cout << endl << "checkpointing Map<int, int> of " << n << " keys (" << stream.str().size() / 1024 << " KiB)" << endl
+         << setw(12) << "save ms" << setw(12) << "load ms" << setw(12) << "insert ms" << endl
+         << fixed << setprecision(1)
+         << setw(12) << saveMs << setw(12) << loadMs << setw(12) << insertMs << endl;
+}
+
+//preconditions: none
+//postconditions: for each group size, prints the inserts per second into a DurableMap<int, int> that syncs
+// its log once per group (a group of 1 is limited to 2000 inserts, each waits for the disk), the syncs made,
+// and the ms to reopen the map from the log.
+void benchDurableMap(int n)
+{
+    const string path = "bplustree_benchmark_durable";
+    const size_t groups[] = {1, 64, 4096};
+
+    cout << endl << "durable inserts into DurableMap<int, int> (group commit)" << endl
+         << setw(12) << "group" << setw(12) << "inserts" << setw(14) << "inserts / s"
+         << setw(12) << "syncs" << setw(12) << "reopen ms" << endl;
+    for(size_t g = 0; g < sizeof(groups) / sizeof(groups[0]); g++)
+    {
+        remove((path + ".log").c_str());
+        remove((path + ".checkpoint").c_str());
+        int inserts = (groups[g] == 1) ? min(n, 2000) : n;
+
+        size_t syncs = 0;
+        Clock::time_point start = Clock::now();
+        {
+            DurableMap<int, int> durable(groups[g]);
+            durable.open(path);
+            for(int i = 0; i < inserts; i++)
+                durable.insert(i, i);
+            durable.close();
+            syncs = durable.log().commits();
+        }
+        double seconds = nsPerOp(start, 1) / 1e9;
+
+        start = Clock::now();
+        DurableMap<int, int> reopened;
+        if(!reopened.open(path) || reopened.size() != inserts)
+            cout << "size mismatch in durable map benchmark" << endl;
+        double reopenMs = nsPerOp(start, 1) / 1e6;
+
+        cout << fixed << setprecision(0) << setw(12) << groups[g] << setw(12) << inserts << setw(14) << inserts / seconds
+             << setw(12) << syncs << setprecision(1) << setw(12) << reopenMs << endl;
+    }
+    remove((path + ".log").c_str());
+    remove((path + ".checkpoint").c_str());
+}
+
+//preconditions: none
+//postconditions: prints the time of writing a tree of n keys to a file, of opening (mapping) the file,
+// and of rebuilding the tree by inserting the keys, then the ns per find on the mapped tree and on the tree.
+void benchMappedFile(int n)
+{
+    const char* path = "bplustree_benchmark.bpt";
+    vector<int> keys(n);
+    for(int i = 0; i < n; i++)
+        keys[i] = i;
+    vector<int> probes(keys);
+    shuffleArray(probes.data(), n);
+
+    Clock::time_point start = Clock::now();
+    BPlusTree<int> rebuilt;
+    for(int i = 0; i < n; i++)
+        rebuilt.insert(probes[i]);
+    double rebuildMs = nsPerOp(start, 1) / 1e6;
+
+    start = Clock::now();
+    bool written = MappedBPlusTree<int>::write(path, rebuilt.begin(), rebuilt.end());
+    double writeMs = nsPerOp(start, 1) / 1e6;
+
+    MappedBPlusTree<int> mapped;
+    start = Clock::now();
+    bool opened = written && mapped.open(path);
+    double openMs = nsPerOp(start, 1) / 1e6;
+
+    long long found = 0;
+    start = Clock::now();
+    for(int i = 0; i < n; i++)
+        found += (mapped.find(probes[i]) != nullptr);
+    double mappedFindNs = nsPerOp(start, n);
+    start = Clock::now();
+    for(int i = 0; i < n; i++)
+        found += (rebuilt.find(probes[i]) != nullptr);
+    double treeFindNs = nsPerOp(start, n);
+
+    if(!opened || found != 2LL * n)
+        cout << "size mismatch in mapped file benchmark" << endl;
+
+    cout << endl << "starting up with " << n << " keys: MappedBPlusTree<int> file of " << mapped.pageCount() << " pages" << endl
+         << setw(12) << "write ms" << setw(12) << "open ms" << setw(12) << "rebuild ms"
+         << setw(14) << "mapped find" << setw(12) << "tree find" << endl
+         << fixed << setprecision(3)
+         << setw(12) << writeMs << setw(12) << openMs << setw(12) << rebuildMs
+         << setprecision(1) << setw(14) << mappedFindNs << setw(12) << treeFindNs << endl;
+
+    mapped.close();
+    remove(path);
+}
+
+//preconditions: n > 0
+//postconditions: a PagedBPlusTree<int> of n keys is built in a file, then reopened behind buffer pools of
+// 1/64, 1/8 and all of its pages, and for each, the ns per op, hit rate, and page reads and writes per op
+// of n random finds, then n/4 random inserts, are printed.
+void benchPagedTree(int n)
+{
+    typedef PagedBPlusTree<int> Paged;
+    const char* path = "bplustree_benchmark.paged";
+    remove(path);
+
+    vector<int> keys(n);
+    for(int i = 0; i < n; i++)
+        keys[i] = 2 * i;
+    shuffleArray(keys.data(), n);
+
+    size_t pages = 0;
+    {
+        Paged paged;
+        paged.open(path, size_t(1) << 30);
+        for(int i = 0; i < n; i++)
+            paged.insert(keys[i]);
+        pages = paged.pageCount();
+        paged.close();
+    }
+    shuffleArray(keys.data(), n);
+
+    cout << endl << "PagedBPlusTree<int> of " << n << " keys in " << pages << " pages of 4096 bytes (ns / op, page I/O per op)" << endl
+         << setw(10) << "budget" << setw(8) << "op" << setw(12) << "ns" << setw(12) << "hit rate"
+         << setw(12) << "reads" << setw(12) << "writes" << endl;
+
+    const int fractions[] = {64, 8, 1};
+    for(int f = 0; f < 3; f++)
+    {
+        size_t budget = pages * 4096 / fractions[f];
+        Paged paged;
+        paged.open(path, budget);
+        //warm the pool up, (the root and upper levels stay cached).
+        int item = 0;
+        long long found = 0;
+        for(int i = 0; i < n / 8; i++)
+            found += paged.find(keys[i], item);
+
+        paged.resetBufferStats();
+        Clock::time_point start = Clock::now();
+        for(int i = 0; i < n; i++)
+            found += paged.find(keys[i], item);
+        double findNs = nsPerOp(start, n);
+        BufferStats finds = paged.bufferStats();
+
+        paged.resetBufferStats();
+        int inserts = n / 4;
+        start = Clock::now();
+        for(int i = 0; i < inserts; i++)
+            paged.insert(keys[i] + 1);
+        double insertNs = nsPerOp(start, inserts);
+        BufferStats writes = paged.bufferStats();
+
+        if(found != n + n / 8 || paged.size() != n + inserts)
+            cout << "size mismatch in paged tree benchmark" << endl;
+
+        string label = (fractions[f] == 1) ? "all" : "1/" + to_string(fractions[f]);
+        cout << fixed << setw(10) << label << setw(8) << "find" << setprecision(1) << setw(12) << findNs
+             << setprecision(3) << setw(12) << finds.hitRate()
+             << setw(12) << double(finds.reads) / n << setw(12) << double(finds.writes) / n << endl
+             << setw(10) << label << setw(8) << "insert" << setprecision(1) << setw(12) << insertNs
+             << setprecision(3) << setw(12) << writes.hitRate()
+             << setw(12) << double(writes.reads) / inserts << setw(12) << double(writes.writes) / inserts << endl;
+        paged.close();
+
+        //the next budget starts from the tree without these inserts.
+        Paged restore;
+        restore.open(path);
+        for(int i = 0; i < inserts; i++)
+            restore.remove(keys[i] + 1);
+        restore.close();
+    }
+    remove(path);
+}
+
+//a string key that KeySeparator does not truncate and NodePrefixes does not keep heads for, (its
+// separators are whole keys, searched by comparing strings).
+struct WholeKey : string
+{
+    WholeKey() {}
+    WholeKey(const string& key): string(key) {}
+};
+
+//preconditions: keys and probes hold the same keys.
+//postconditions: returns the ns per key of inserting keys into a BPlusTree<Key> and of finding probes in it.
+template <typename Key, typename Source>
+pair<double, double> timeKeys(const vector<Source>& keys, const vector<Source>& probes)
+{
+    vector<Key> items(keys.begin(), keys.end());
+    vector<Key> lookups(probes.begin(), probes.end());
+    BPlusTree<Key> tree;
+
+    Clock::time_point start = Clock::now();
+    for(size_t i = 0; i < items.size(); i++)
+        tree.insert(items[i]);
+    double insertNs = nsPerOp(start, items.size());
+
+    size_t hits = 0;
+    start = Clock::now();
+    for(size_t i = 0; i < lookups.size(); i++)
+        hits += (tree.find(lookups[i]) != nullptr);
+    double findNs = nsPerOp(start, lookups.size());
+
+    if(hits != lookups.size())
+        cout << "size mismatch in key benchmark" << endl;
+    return make_pair(insertNs, findNs);
+}
+
+//preconditions: n > 0
+//postconditions: prints the ns per key of inserting n shuffled URL keys into a BPlusTree<string>,
+// and of finding them in another shuffled order, for string and WholeKey keys, and the same for ints.
+void benchStringKeys(int n)
+{
+    vector<string> keys(n);
+    for(int i = 0; i < n; i++)
+    {
+        string digits = to_string(i);
+        keys[i] = "https://www.example.com/catalog/products/" + string(8 - digits.size(), '0') + digits + "/details";
+    }
+    vector<string> probes(keys);
+    shuffleArray(keys.data(), n);
+    shuffleArray(probes.data(), n);
+
+    vector<int> numbers(n);
+    for(int i = 0; i < n; i++)
+        numbers[i] = i;
+    vector<int> numberProbes(numbers);
+    shuffleArray(numbers.data(), n);
+    shuffleArray(numberProbes.data(), n);
+
+    pair<double, double> prefixed = timeKeys<string>(keys, probes);
+    pair<double, double> whole = timeKeys<WholeKey>(keys, probes);
+    pair<double, double> integers = timeKeys<int>(numbers, numberProbes);
+
+    cout << endl << "BPlusTree of " << n << " URL keys of " << keys[0].size() << " characters (ns / key)" << endl
+         << setw(12) << "key" << setw(12) << "insert" << setw(12) << "find" << endl
+         << fixed << setprecision(1)
+         << setw(12) << "string" << setw(12) << prefixed.first << setw(12) << prefixed.second << endl
+         << setw(12) << "WholeKey" << setw(12) << whole.first << setw(12) << whole.second << endl
+         << setw(12) << "int" << setw(12) << integers.first << setw(12) << integers.second << endl;
+}
+
+//preconditions: n > 0
+//postconditions: prints the ns per key of finding n random keys (half of them missing) in a BPlusTree<int> of
+// n keys with find, and with multiFind, and the ns per item of scanning the tree with its iterator.
+void benchMultiFind(int n)
+{
+    vector<int> keys(n);
+    for(int i = 0; i < n; i++)
+        keys[i] = 2 * i;
+    vector<int> probes(n);
+    for(int i = 0; i < n; i++)
+        probes[i] = rand() % (2 * n);
+    BPlusTree<int> tree;
+    tree.bulkLoad(keys.begin(), keys.end(), 0.75);
+
+    size_t hits = 0;
+    Clock::time_point start = Clock::now();
+    for(int i = 0; i < n; i++)
+        hits += (tree.findKey(probes[i]) != nullptr);
+    double findNs = nsPerOp(start, n);
+
+    vector<const int*> found(n);
+    start = Clock::now();
+    tree.multiFind(probes.begin(), probes.end(), found.begin());
+    double multiNs = nsPerOp(start, n);
+    size_t multiHits = n - count(found.begin(), found.end(), (const int*)nullptr);
+
+    long long sum = 0;
+    start = Clock::now();
+    for(BPlusTree<int>::Iterator it = tree.begin(); it != tree.end(); ++it)
+        sum += *it;
+    double scanNs = nsPerOp(start, n);
+
+    if(hits != multiHits || sum < 0)
+        cout << "size mismatch in multi find benchmark" << endl;
+    cout << endl << "random finds in BPlusTree<int> of " << n << " keys (ns / key, prefetch "
+         << (BPLUSTREE_PREFETCH ? "on" : "off") << ")" << endl
+         << setw(12) << "find" << setw(12) << "multiFind" << setw(12) << "scan" << endl
+         << fixed << setprecision(1)
+         << setw(12) << findNs << setw(12) << multiNs << setw(12) << scanNs << endl;
+}
+
+//preconditions: n > 0
+//postconditions: prints the ns per key of looking up batches of keys (half of them missing) in a BPlusTree<int>
+// of n keys with find, multiFind and findMany, and in a Map<int, int> of the same keys with getMany. the keys of a
+// batch are random over the whole tree, or clustered within a span of 2% of it, and the clustered batches sorted.
+void benchFindMany(int n)
+{
+    vector<int> keys(n);
+    for(int i = 0; i < n; i++)
+        keys[i] = 2 * i;
+    BPlusTree<int> tree;
+    tree.bulkLoad(keys.begin(), keys.end(), 0.75);
+    Map<int, int> map;
+    for(int i = 0; i < n; i++)
+        map[keys[i]] = i;
+
+    const int LOOKUPS = 2000000;
+    const char* kinds[] = {"random", "clustered", "sorted"};
+    cout << endl << "batch lookups in BPlusTree<int> and Map<int, int> of " << n << " keys (ns / key)" << endl
+         << setw(8) << "batch" << setw(12) << "keys" << setw(12) << "find" << setw(12) << "multiFind"
+         << setw(12) << "findMany" << setw(12) << "getMany" << endl;
+    for(int batch = 50; batch <= 500; batch *= 10)
+        for(int kind = 0; kind < 3; kind++)
+        {
+            int batches = LOOKUPS / batch;
+            int spread = (kind == 0) ? 2 * n : max(2 * n / 50, 1);
+            vector<int> probes(size_t(batches) * batch);
+            for(int b = 0; b < batches; b++)
+            {
+                int base = rand() % (2 * n - spread + 1);
+                for(int i = 0; i < batch; i++)
+                    probes[size_t(b) * batch + i] = base + rand() % spread;
+                if(kind == 2)
+                    sort(probes.begin() + size_t(b) * batch, probes.begin() + size_t(b + 1) * batch);
+            }
+
+            vector<const int*> found(batch);
+            size_t hits[4] = {0, 0, 0, 0};
+            Clock::time_point start = Clock::now();
+            for(size_t i = 0; i < probes.size(); i++)
+                hits[0] += (tree.findKey(probes[i]) != nullptr);
+            double findNs = nsPerOp(start, probes.size());
+
+            start = Clock::now();
+            for(int b = 0; b < batches; b++)
+            {
+                const int* first = &probes[size_t(b) * batch];
+                tree.multiFind(first, first + batch, found.begin());
+                hits[1] += batch - count(found.begin(), found.end(), (const int*)nullptr);
+            }
+            double multiNs = nsPerOp(start, probes.size());
+
+            start = Clock::now();
+            for(int b = 0; b < batches; b++)
+            {
+                tree.findMany(&probes[size_t(b) * batch], batch, found.data());
+                hits[2] += batch - count(found.begin(), found.end(), (const int*)nullptr);
+            }
+            double manyNs = nsPerOp(start, probes.size());
+
+            start = Clock::now();
+            for(int b = 0; b < batches; b++)
+            {
+                map.getMany(&probes[size_t(b) * batch], batch, found.data());
+                hits[3] += batch - count(found.begin(), found.end(), (const int*)nullptr);
+            }
+            double getNs = nsPerOp(start, probes.size());
+
+            if(hits[0] != hits[1] || hits[0] != hits[2] || hits[0] != hits[3])
+                cout << "size mismatch in find many benchmark" << endl;
+            cout << fixed << setprecision(1) << setw(8) << batch << setw(12) << kinds[kind] << setw(12) << findNs
+                 << setw(12) << multiNs << setw(12) << manyNs << setw(12) << getNs << endl;
+        }
+}
+
+//preconditions: sorted holds distinct items, in order.
+//postconditions: prints one row: the bytes of a leaf and of an inner node of a BPlusTree<T>, and the bytes of
+// nodes per item (what its node pools hold) when the tree is built by inserting the items in random order,
+// and by bulkLoad.
+template <typename T>
+void layoutRow(const char* label, const vector<T>& sorted)
+{
+    vector<T> shuffled(sorted);
+    shuffleArray(shuffled.data(), int(shuffled.size()));
+    BPlusTree<T> inserted;
+    for(size_t i = 0; i < shuffled.size(); i++)
+        inserted.insert(shuffled[i]);
+    BPlusTree<T> loaded;
+    loaded.bulkLoad(sorted.begin(), sorted.end());
+
+    cout << setw(16) << label << setw(10) << BPlusTree<T>::leafBytes() << setw(10) << BPlusTree<T>::innerBytes()
+         << setw(12) << double(inserted.allocationStats().slabBytes) / sorted.size()
+         << setw(12) << double(loaded.allocationStats().slabBytes) / sorted.size() << endl;
+}
+
+//preconditions: n > 0
+//postconditions: prints the node sizes and node bytes per key of trees of n ints, Pair<int, int>s
+// and URL strings (the bytes of the strings' characters are not counted).
+void benchNodeLayout(int n)
+{
+    vector<int> numbers(n);
+    vector<Pair<int, int> > pairs(n);
+    vector<string> urls(n);
+    for(int i = 0; i < n; i++)
+    {
+        numbers[i] = i;
+        pairs[i] = Pair<int, int>(i, i);
+        string digits = to_string(i);
+        urls[i] = "https://www.example.com/catalog/products/" + string(8 - digits.size(), '0') + digits + "/details";
+    }
+
+    cout << endl << "node layout of trees of " << n << " items (bytes, nodes are aligned to "
+         << CACHE_LINE_BYTES << " byte cache lines)" << endl
+         << setw(16) << "item" << setw(10) << "leaf" << setw(10) << "inner"
+         << setw(12) << "insert/key" << setw(12) << "bulk/key" << endl
+         << fixed << setprecision(2);
+    layoutRow("int", numbers);
+    layoutRow("Pair<int,int>", pairs);
+    layoutRow("string", urls);
+}
+
+//an MPair that keeps its values in a std::vector, (one heap block per key, once it has a value).
+struct VectorPair
+{
+    int key;
+    vector<int> values;
+
+    VectorPair(int k = 0): key(k) {}
+    friend bool operator ==(const VectorPair& lhs, const VectorPair& rhs) {return lhs.key == rhs.key;}
+    friend bool operator <(const VectorPair& lhs, const VectorPair& rhs) {return lhs.key < rhs.key;}
+    friend bool operator >(const VectorPair& lhs, const VectorPair& rhs) {return lhs.key > rhs.key;}
+    friend bool operator <=(const VectorPair& lhs, const VectorPair& rhs) {return lhs.key <= rhs.key;}
+    friend bool operator >=(const VectorPair& lhs, const VectorPair& rhs) {return lhs.key >= rhs.key;}
+    friend ostream& operator <<(ostream& outs, const VectorPair& printMe) {return outs << printMe.key;}
+};
+
+template <>
+struct KeyOf<VectorPair>
+{
+    typedef int type;
+    static const int& key(const VectorPair& item) {return item.key;}
+};
+
+bool onHeap(const vector<int>& values) {return values.capacity() > 0;}
+bool onHeap(const ValueList<int>& values) {return !values.isInline();}
+
+//preconditions: none
+//postconditions: prints one row: the ns per value of appending values[i] to the list of keys[i] in a
+// BPlusTree<Item> and of scanning every value back, and the lists that are on the heap per key.
+template <typename Item>
+void timeValueLists(const char* label, const vector<int>& keys, const vector<int>& values)
+{
+    BPlusTree<Item> tree(true);
+    Clock::time_point start = Clock::now();
+    for(size_t i = 0; i < keys.size(); i++)
+        tree.insert_or_get(Item(keys[i])).first->values.push_back(values[i]);
+    double insertNs = nsPerOp(start, keys.size());
+
+    long long sum = 0;
+    size_t scanned = 0, heapLists = 0;
+    start = Clock::now();
+    for(typename BPlusTree<Item>::Iterator it = tree.begin(); it != tree.end(); ++it)
+        for(size_t v = 0; v < (*it).values.size(); v++, scanned++)
+            sum += (*it).values[v];
+    double scanNs = nsPerOp(start, scanned);
+    for(typename BPlusTree<Item>::Iterator it = tree.begin(); it != tree.end(); ++it)
+        heapLists += onHeap((*it).values);
+
+    if(scanned != keys.size() || sum < 0)
+        cout << "size mismatch in value list benchmark" << endl;
+    cout << setw(12) << label << setw(12) << insertNs << setw(12) << scanNs
+         << setw(12) << double(heapLists) / tree.size() << setw(12) << sizeof(Item) << endl;
+}
+
+//preconditions: n > 1
+//postconditions: prints the ns per value of appending n values to the lists of n/2 random keys, and of
+// scanning them, with the lists as ValueLists (MPair) and as vectors (VectorPair).
+void benchValueLists(int n)
+{
+    vector<int> keys(n), values(n);
+    for(int i = 0; i < n; i++)
+    {
+        keys[i] = rand() % (n / 2);
+        values[i] = i;
+    }
+
+    cout << endl << n << " values appended to the lists of " << n / 2 << " random keys (ns / value)" << endl
+         << setw(12) << "list" << setw(12) << "insert" << setw(12) << "scan"
+         << setw(12) << "heap/key" << setw(12) << "leaf bytes" << endl
+         << fixed << setprecision(2);
+    timeValueLists<MPair<int, int> >("ValueList", keys, values);
+    timeValueLists<VectorPair>("vector", keys, values);
+}
+
+//preconditions: none
+//postconditions: prints the ns per key of inserting, then erasing, sorted batches of n/10 new keys
+// in a tree of n keys, with insertBatch and eraseBatch, and with one insert or remove per key.
+void benchBatch(int n)
+{
+    const int BATCH = n / 10 + 1;
+    vector<int> keys(n);
+    for(int i = 0; i < n; i++)
+        keys[i] = 2 * i;
+    vector<int> updates(BATCH);
+    for(int i = 0; i < BATCH; i++)
+        updates[i] = 2 * (rand() % n) + 1;
+    sort(updates.begin(), updates.end());
+    updates.erase(unique(updates.begin(), updates.end()), updates.end());
+    int batch = int(updates.size());
+
+    BPlusTree<int> batched, single;
+    batched.bulkLoad(keys.begin(), keys.end());
+    single.bulkLoad(keys.begin(), keys.end());
+
+    Clock::time_point start = Clock::now();
+    batched.insertBatch(updates.begin(), updates.end());
+    double batchInsertNs = nsPerOp(start, batch);
+    start = Clock::now();
+    batched.eraseBatch(updates.begin(), updates.end());
+    double batchEraseNs = nsPerOp(start, batch);
+
+    start = Clock::now();
+    for(int i = 0; i < batch; i++)
+        single.insert(updates[i]);
+    double singleInsertNs = nsPerOp(start, batch);
+    start = Clock::now();
+    for(int i = 0; i < batch; i++)
+        single.remove(updates[i]);
+    double singleEraseNs = nsPerOp(start, batch);
+
+    if(batched.size() != n || single.size() != n || !batched.isValid())
+        cout << "size mismatch in batch benchmark" << endl;
+
+    cout << endl << "sorted batch of " << batch << " keys into BPlusTree<int> of " << n << " keys (ns / key)" << endl
+         << setw(12) << "" << setw(12) << "insert" << setw(12) << "erase" << endl
+         << fixed << setprecision(1)
+         << setw(12) << "batch" << setw(12) << batchInsertNs << setw(12) << batchEraseNs << endl
+         << setw(12) << "per key" << setw(12) << singleInsertNs << setw(12) << singleEraseNs << endl;
+}
+
+//preconditions: none
+//postconditions: prints the time of one snapshot of a tree of n keys, taken by copying a BPlusTree<int>
+// and by PersistentBPlusTree<int>::snapshot, then the ns per insert of n/10 new keys into each tree
+// while a snapshot of it is held (the persistent tree copies the shared nodes on the path of each write),
+// and the number of nodes the persistent tree copied.
+void benchSnapshot(int n)
+{
+    vector<int> keys(n);
+    for(int i = 0; i < n; i++)
+        keys[i] = 2 * i;
+    shuffleArray(keys.data(), n);
+
+    BPlusTree<int> tree;
+    PersistentBPlusTree<int> persistent;
+    for(int i = 0; i < n; i++)
+    {
+        tree.insert(keys[i]);
+        persistent.insert(keys[i]);
+    }
+
+    Clock::time_point start = Clock::now();
+    BPlusTree<int> copy(tree);
+    double copyUs = nsPerOp(start, 1000);
+
+    start = Clock::now();
+    PersistentBPlusTree<int> snapshot = persistent.snapshot();
+    double snapshotUs = nsPerOp(start, 1000);
+
+    start = Clock::now();
+    for(int i = 0; i < n / 10; i++)
+        tree.insert(keys[i] + 1);
+    double treeInsertNs = nsPerOp(start, n / 10);
+
+    start = Clock::now();
+    for(int i = 0; i < n / 10; i++)
+        persistent.insert(keys[i] + 1);
+    double persistentInsertNs = nsPerOp(start, n / 10);
+
+    if(copy.size() != n || snapshot.size() != n || persistent.size() != tree.size())
+        cout << "size mismatch in snapshot benchmark" << endl;
+
+    cout << endl << "snapshots of a tree of " << n << " keys, then " << n / 10 << " inserts while the snapshot is held" << endl
+         << setw(22) << "tree" << setw(14) << "snapshot us" << setw(12) << "insert ns" << setw(14) << "nodes copied" << endl
+         << fixed << setprecision(1)
+         << setw(22) << "BPlusTree (copy)" << setw(14) << copyUs << setw(12) << treeInsertNs << setw(14) << "-" << endl
+         << setw(22) << "PersistentBPlusTree" << setw(14) << snapshotUs << setw(12) << persistentInsertNs
+         << setw(14) << persistent.nodesCopied() << endl;
+}
+
+//preconditions: data[] holds width sorted items, probes[] holds probeCount items.
+//postconditions: returns the ns per call of search over all the probes,
+// adding the results to checksum so that the calls are not optimized away.
+template <typename T, typename Search>
+double timeSearch(const T data[], int width, const vector<T>& probes, Search search, long long& checksum)
+{
+    const int ROUNDS = 20;
+    Clock::time_point start = Clock::now();
+    for(int r = 0; r < ROUNDS; r++)
+        for(size_t i = 0; i < probes.size(); i++)
+            checksum += search(data, width, probes[i]);
+    return nsPerOp(start, probes.size() * ROUNDS);
+}
+
+template <typename T> int linearSearch(const T data[], int n, const T& entry) {return firstGE(data, n, entry);}
+template <typename T> int binarySearch(const T data[], int n, const T& entry) {return firstGEBinary(data, n, entry);}
+template <typename T> int policySearch(const T data[], int n, const T& entry) {return NodeSearch<T>::firstGE(data, n, entry);}
+
+//preconditions: none
+//postconditions: prints the ns per search of a node of int keys, and of string keys,
+// for each search method at each node width.
+void benchNodeSearch()
+{
+    const int MAX_WIDTH = 256;
+    const int PROBES = 10000;
+
+    cout << endl << "search within one node (ns / search)" << endl;
+    cout << setw(6) << "width"
+         << setw(12) << "int linear" << setw(12) << "int binary" << setw(12) << "int policy"
+         << setw(12) << "str linear" << setw(12) << "str binary" << endl;
+
+    long long checksum = 0;
+    for(int width = 4; width <= MAX_WIDTH; width *= 2)
+    {
+        int ints[MAX_WIDTH];
+        string strings[MAX_WIDTH];
+        for(int i = 0; i < width; i++)
+        {
+            ints[i] = 2 * i;
+            strings[i] = "https://example.com/" + to_string(100000 + 2 * i);
+        }
+
+        vector<int> intProbes(PROBES);
+        vector<string> stringProbes(PROBES);
+        for(int i = 0; i < PROBES; i++)
+        {
+            intProbes[i] = rand() % (2 * width + 1);
+            stringProbes[i] = "https://example.com/" + to_string(100000 + intProbes[i]);
+        }
+
+        cout << setw(6) << width << fixed << setprecision(2)
+             << setw(12) << timeSearch(ints, width, intProbes, linearSearch<int>, checksum)
+             << setw(12) << timeSearch(ints, width, intProbes, binarySearch<int>, checksum)
+             << setw(12) << timeSearch(ints, width, intProbes, policySearch<int>, checksum)
+             << setw(12) << timeSearch(strings, width, stringProbes, linearSearch<string>, checksum)
+             << setw(12) << timeSearch(strings, width, stringProbes, binarySearch<string>, checksum)
+             << endl;
+    }
+    cout << "(checksum " << checksum << ")" << endl;
+}
+
+int main(int argc, char* argv[])
+{
+    const int n = (argc > 1) ? atoi(argv[1]) : 1000000;
+    srand(42);
+
+    vector<int> keys(n);
+    for(int i = 0; i < n; i++)
+        keys[i] = i + 1;
+    vector<int> probes(keys);
+    shuffleArray(keys.data(), n);
+    shuffleArray(probes.data(), n);
+
+    cout << "BPlusTree<int, MinDegree> with " << n << " keys (ns / op)" << endl;
+    cout << setw(6) << "order" << setw(12) << "insert" << setw(12) << "find" << setw(12) << "iterate" << endl;
+    OrderSweep<1>::run(keys, probes);
+
+    cout << "default MinDegree for int: " << DefaultMinDegree<int>::value << endl;
+
+    benchBulkLoad(n);
+    benchRangeScan(n);
+    benchUpsert(n);
+    benchChurn(n);
+    benchBatch(n);
+    benchSnapshot(n);
+    benchSaveLoad(n);
+    benchDurableMap(n);
+    benchMappedFile(n);
+    benchPagedTree(n);
+    benchStringKeys(n);
+    benchMultiFind(n);
+    benchFindMany(n);
+    benchNodeLayout(n);
+    benchValueLists(n);
+    benchNodeSearch();
+    return 0;
+}
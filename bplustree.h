@@ -2,22 +2,116 @@
 #define BPLUSTREE_H
 
 #include <iostream>
+#include <string>
+#include <vector>
+#include <utility>
+#include <iterator>
+#include <algorithm>
+#include <cstddef>
 #include "arrayutil.h"
+#include "nodesearch.h"
+#include "nodepool.h"
+#include "serialize.h"
 using namespace std;
 
+//the nodes of a BPlusTree start on a cache line (see Inner and Leaf).
+const size_t CACHE_LINE_BYTES = 64;
+
+//searches and scans prefetch the node they go to next (see prefetchLines), unless this is set to 0.
+#ifndef BPLUSTREE_PREFETCH
+#define BPLUSTREE_PREFETCH 1
+#endif
+
+//preconditions: none
+//postconditions: the cache lines of [bytes, bytes + count) are requested for reading, without waiting
+// for them. only a hint: nothing is done where the compiler has no prefetch, or BPLUSTREE_PREFETCH is 0.
+inline void prefetchLines(const void* bytes, size_t count)
+{
+#if BPLUSTREE_PREFETCH && (defined(__GNUC__) || defined(__clang__))
+    const char* line = static_cast<const char*>(bytes);
+    for(size_t offset = 0; offset < count; offset += CACHE_LINE_BYTES)
+        __builtin_prefetch(line + offset, 0, 3);
+#else
+    (void)bytes;
+    (void)count;
+#endif
+}
+
+//the default MinDegree for a BPlusTree of T is picked so that the data[] of a full
+// node spans about NODE_TARGET_BYTES (a few cache lines), with a minimum degree of 1.
+template <typename T>
+struct DefaultMinDegree
+{
+    static const int NODE_TARGET_BYTES = 256;
+    static const int value = (NODE_TARGET_BYTES / (2 * sizeof(T)) > 1) ? int(NODE_TARGET_BYTES / (2 * sizeof(T))) : 1;
+};
+
+//KeyOf<T> gives the key a T is ordered by. Inner nodes of a BPlusTree store only keys,
+// so types that carry a payload along with their key (Pair, MPair) specialize this
+// to keep their payload out of the routing separators.
 template <typename T>
+struct KeyOf
+{
+    typedef T type;
+    static const T& key(const T& item) {return item;}
+};
+
+//KeySeparator<Key> gives the routing key an inner node keeps between two neighbouring subtrees,
+// from the largest key on the left and the smallest key on the right. Any key s with
+// left < s <= right routes every search the right way, (right itself, if left == right),
+// so a key type that can be shortened specializes this to return the shortest such key.
+template <typename Key>
+struct KeySeparator
+{
+    static Key between(const Key& left, const Key& right) {return right;}
+};
+
+//string separators are truncated to the shortest prefix of right that is still greater than left:
+// right up to (and including) the first character where the two differ. keys with a long shared
+// prefix (paths, URLs) get separators short enough to stay in the string's own buffer.
+template <>
+struct KeySeparator<string>
+{
+    static string between(const string& left, const string& right)
+    {
+        if(!(left < right))
+            return right;
+        size_t shared = 0;
+        size_t shorter = (left.size() < right.size()) ? left.size() : right.size();
+        while(shared < shorter && left[shared] == right[shared])
+            shared++;
+        return right.substr(0, shared + 1);
+    }
+};
+
+//MinDegree: every node other than the root holds at least MinDegree
+// and at most 2*MinDegree data items.
+template <typename T, int MinDegree = DefaultMinDegree<T>::value>
 class BPlusTree
 {
+private:
+    struct Leaf;
+
 public:
+    typedef typename KeyOf<T>::type Key;
+
+    //a bidirectional iterator over the items, in order. end() is a null iterator
+    // that still knows its tree, so that it can be decremented to the last item.
     class Iterator
     {
     public:
         friend class BPlusTree;
 
+        typedef bidirectional_iterator_tag iterator_category;
+        typedef T value_type;
+        typedef ptrdiff_t difference_type;
+        typedef T* pointer;
+        typedef T& reference;
+
         friend bool operator ==(const Iterator& lhs, const Iterator& rhs){return (lhs.node == rhs.node && (lhs.keyPtr == rhs.keyPtr));}
         friend bool operator !=(const Iterator& lhs, const Iterator& rhs){return (lhs.node != rhs.node || (lhs.keyPtr != rhs.keyPtr));}
 
-        Iterator(BPlusTree<T>* _node=nullptr, int _keyPtr = 0):node(_node), keyPtr(_keyPtr) {}
+        Iterator(Leaf* _node=nullptr, int _keyPtr = 0, const BPlusTree* _owner = nullptr):node(_node), keyPtr(_keyPtr), owner(_owner) {}
 
         bool is_null(){return !node;}
 
@@ -29,6 +123,11 @@ public:
             return node->data[keyPtr];
         }
 
+        T* operator ->()
+        {
+            return &this->operator*();
+        }
+
         //preconditions: node != nullptr
         //postconditions: make a copy of this, then,
         // call the prefix increment operator on this and return the copy.
@@ -52,7 +151,41 @@ public:
                 {
                     node = node->nextSubset;
                     keyPtr = 0;
+                    prefetchAhead(node);
+                }
+            }
+            return *this;
+        }
+
+        //preconditions: this is not the first item. if node == nullptr (end), owner != nullptr.
+        //postconditions: make a copy of this, then,
+        // call the prefix decrement operator on this and return the copy.
+        Iterator operator--(int unUsed)
+        {
+            Iterator temp = *this;
+            this->operator--();
+            return temp;
+        }
+
+        //preconditions: this is not the first item. if node == nullptr (end), owner != nullptr.
+        //postconditions: move keyPtr back if it is not at the front of the current leaf,
+        // otherwise, move node back to the previous leaf (from end(), to the last leaf)
+        // and set the current position to the last item within that leaf.
+        Iterator operator--()
+        {
+            if(node != nullptr && keyPtr > 0)
+                keyPtr--;
+            else
+            {
+                if(node != nullptr)
+                    node = node->prevSubset;
+                else
+                {
+                    assert(owner);
+                    node = owner->rightmostLeaf();
                 }
+                assert(node && node->dataCount > 0);
+                keyPtr = node->dataCount - 1;
             }
             return *this;
         }
@@ -72,11 +205,14 @@ public:
         }
 
     private:
-        BPlusTree<T>* node;
+        Leaf* node;
         int keyPtr;
+        const BPlusTree* owner;                    //the tree of this iterator, used to step back from end()
     };
 
-    friend ostream& operator<<(ostream& outs, const BPlusTree<T>& printMe)
+    typedef std::reverse_iterator<Iterator> ReverseIterator;
+
+    friend ostream& operator<<(ostream& outs, const BPlusTree<T, MinDegree>& printMe)
     {
         printMe.printTree(0, 0, outs);
         return outs;
@@ -85,19 +221,64 @@ public:
     BPlusTree(bool dups = false);
 
     //big three:
-    BPlusTree(const BPlusTree<T>& other);
+    BPlusTree(const BPlusTree<T, MinDegree>& other);
     ~BPlusTree();
-    BPlusTree<T>& operator =(const BPlusTree<T>& RHS);
+    BPlusTree<T, MinDegree>& operator =(const BPlusTree<T, MinDegree>& RHS);
 
     bool areDupsOk() const {return dupsOk;}
     bool insert(const T& entry);                //insert entry into the tree
+    bool insert(T&& entry);                     //move entry into the tree
+    pair<Iterator, bool> insert_or_get(const T& entry); //insert entry unless its key is already there, in one descent.
+    pair<Iterator, bool> insert_or_get(T&& entry);
+
+    //construct an item from args and move it into the tree (unless its key is there, and dups are not ok).
+    template <typename... Args>
+    pair<Iterator, bool> emplace(Args&&... args);
+    //insert T(key, arg) unless key is there, in one descent: the item is only made (and arg only
+    // moved from) if it is inserted.
+    template <typename Arg>
+    pair<Iterator, bool> try_emplace(const Key& key, Arg&& arg);
     bool remove(const T& entry);                //remove entry from the tree
     void clearTree();                           //clear this object (delete all nodes etc.)
 
-    bool contains(const T& entry);              //true if entry can be found in the array
-    T& get(const T& entry);                     //return a reference to entry in the tree
-    const T& get(const T &entry) const;
+    //insert (or remove) every item of [first, last) in one walk of the tree, sorting a copy of the
+    // range first if it is not sorted by key. each node is split (or repaired) once per batch.
+    // returns the number of items inserted (or removed).
+    template <typename InputIt>
+    int insertBatch(InputIt first, InputIt last);
+    template <typename InputIt>
+    int eraseBatch(InputIt first, InputIt last);
+
+    //replace the contents of this tree with the sorted range [first, last), building it bottom-up.
+    // each node is filled to fillFactor of its capacity (but never below the minimum).
+    template <typename InputIt>
+    void bulkLoad(InputIt first, InputIt last, double fillFactor = 1.0);
+
+    //write the items to outs in a compact binary form (with Encoder<T>), and read them back. load replaces
+    // the contents of this tree (and whether it allows dups) with what was saved, streaming the items into
+    // bulkLoad. each returns false if the stream fails, (load leaves the tree empty).
+    bool save(ostream& outs) const;
+    bool load(istream& ins, double fillFactor = 1.0);
+
+    bool contains(const T& entry) const;        //true if entry can be found in the array
+    T& get(const T& entry);                     //return a reference to entry in the tree, inserting it if it is not there
+    const T& get(const T &entry) const;         //return a reference to entry, which must be in the tree
     T* find(const T& entry);                    //return a pointer to this key. NULL if not there.
+    const T* find(const T& entry) const;
+    T* findKey(const Key& key);                 //find by key alone, without making a T. NULL if not there.
+    const T* findKey(const Key& key) const;
+
+    //write to results a pointer to the item of each key of [first, last) (a forward range of keys), in order,
+    // nullptr for a key that is not there. the descents of MULTI_FIND_GROUP keys at a time are taken together,
+    // a level at a time, prefetching each next node, so the cache misses of the group overlap.
+    template <typename ForwardIt, typename OutputIt>
+    OutputIt multiFind(ForwardIt first, ForwardIt last, OutputIt results) const;
+    static const int MULTI_FIND_GROUP = 16;
+
+    //set results[i] to a pointer to the item of keys[i] (nullptr if it is not there), for the count keys.
+    // as multiFind, but each group of keys first descends once to the node whose subtree holds its whole
+    // key range, so a batch of nearby (or sorted) keys shares the top of its paths, and often the leaf.
+    void findMany(const Key* keys, size_t count, const T** results) const;
 
     int size() const;                           //count the number of elements in the tree
     bool empty() const;                         //true if the tree is empty
@@ -107,81 +288,209 @@ public:
 
     bool isValid() const;                       //verify that the tree satisfies all B+Tree rules.
 
+    PoolStats allocationStats() const;          //node allocation counters of both node pools
+    static size_t leafBytes() {return sizeof(Leaf);}    //the bytes of one leaf (whole cache lines)
+    static size_t innerBytes() {return sizeof(Inner);}  //the bytes of one inner node (whole cache lines)
+
     Iterator getIteratorAtEntry(const T& entry); //return an iterator to this key. NULL if not there.
+    Iterator lower_bound(const Key& key);        //return an iterator to the first item not less than key.
+    Iterator upper_bound(const Key& key);        //return an iterator to the first item greater than key.
+    pair<Iterator, Iterator> equal_range(const Key& key); //return [lower_bound(key), upper_bound(key)).
     Iterator begin();
     Iterator end();
+    ReverseIterator rbegin() {return ReverseIterator(end());}   //the last item, going backwards
+    ReverseIterator rend() {return ReverseIterator(begin());}
 
 private:
-    static const int MINIMUM = 1;
+    static_assert(MinDegree >= 1, "BPlusTree requires a MinDegree of at least 1");
+
+    static const int MINIMUM = MinDegree;
     static const int MAXIMUM = 2 * MINIMUM;
 
+    static const uint32_t SAVE_MAGIC = 0x53545042;    //"BPTS", read as a little endian integer
+    static const uint32_t SAVE_VERSION = 1;
+
+    //the bookkeeping shared by both kinds of node: the header at the start of each node's first cache line,
+    // followed by its keys, so the counts a search reads first come in on the same line as the first keys.
+    // (what belongs to the whole tree, its size and whether it allows dups, is kept in the tree, not here)
+    struct Node
+    {
+        bool leaf;                                 //true if this node is a Leaf
+        int dataCount;                             //number of data elements
+        int childCount;                            //number of children (always 0 in a leaf)
+
+        Node(bool isLeafNode): leaf(isLeafNode), dataCount(0), childCount(0) {}
+        bool isLeaf() const {return leaf;}
+    };
+
+    //an inner node only routes searches: data[i] is a key greater than every key in subset[i]
+    // and not greater than any key in subset[i+1], never a whole T. (the smallest key of
+    // subset[i+1], or a shorter key from KeySeparator, where a leaf was split.)
+    // its NodePrefixes (nodesearch.h) are refreshed whenever data[] changes.
+    // the keys are contiguous, and the child pointers (read only once a key is picked) follow them.
+    struct alignas(CACHE_LINE_BYTES) Inner : Node, NodePrefixes<Key, MAXIMUM + 1>
+    {
+        Key data[MAXIMUM + 1];                     //holds the routing keys
+        Node* subset[MAXIMUM + 2];                 //subtrees
+
+        Inner(): Node(false) {}
+        void refreshPrefixes() {this->refresh(data, this->dataCount);}
+        bool prefixesAreFresh() const {return this->isFresh(data, this->dataCount);}
+    };
+
+    //a leaf holds the items themselves, and is linked to the leaves on its right and left.
+    struct alignas(CACHE_LINE_BYTES) Leaf : Node
+    {
+        T data[MAXIMUM + 1];                       //holds the items
+        Leaf* nextSubset;
+        Leaf* prevSubset;
+
+        Leaf(): Node(true), nextSubset(nullptr), prevSubset(nullptr) {}
+    };
+
+    //every node of this tree comes from one of its two pools.
+    NodePool<Inner> innerPool;
+    NodePool<Leaf> leafPool;
+
+    //where an item sits in the leaves: leaf->data[index].
+    struct Position
+    {
+        Leaf* leaf;
+        int index;
+    };
+
+    Node* root;                                    //never null, an empty tree is a single empty leaf
     bool dupsOk;                                   //true if duplicate keys may be inserted
-    int dataCount;                                 //number of data elements
-    T data[MAXIMUM + 1];                           //holds the keys
-    int childCount;                                //number of children
-    BPlusTree* subset[MAXIMUM + 2];                //subtrees
-    BPlusTree* nextSubset;
     size_t _size;
 
-    void removeDuplicate(T key);                   //remove the duplicate from the tree whose data[i] is key.
-    T getSmallest();                               //get the smallest value from this subtree.
-
-    void copyTree(const BPlusTree<T>& other,
-                  BPlusTree<T>*& lastLeaf);        //copy other to this.
+    static Inner* asInner(Node* node) {return static_cast<Inner*>(node);}
+    static const Inner* asInner(const Node* node) {return static_cast<const Inner*>(node);}
+    static Leaf* asLeaf(Node* node) {return static_cast<Leaf*>(node);}
+    static const Leaf* asLeaf(const Node* node) {return static_cast<const Leaf*>(node);}
+    static const Key& keyOf(const T& item) {return KeyOf<T>::key(item);}
+
+    static int innerIndex(const Inner* inner, const Key& key); //index of the first routing key in inner that is not less than key
+    static int childIndex(const Inner* inner, const Key& key); //the index of the subtree of inner a search for key continues in
+    static Node* childOf(const Inner* inner, const Key& key);  //that subtree, (prefetched)
+    static int leafIndex(const Leaf* leaf, const Key& key);    //index of the first item in leaf that is not less than key
+    static int leafIndex(const Leaf* leaf, const Key& key, true_type);  //T is its own key
+    static int leafIndex(const Leaf* leaf, const Key& key, false_type); //T carries a payload along with its key
+    Inner* newInner();                             //construct an empty Inner in innerPool
+    Leaf* newLeaf();                               //construct an empty Leaf in leafPool
+    void deleteNode(Node* node);                   //free a single node of either kind
+    void deleteSubtree(Node* node);                //free node and everything below it
+    void releaseTree();                            //free every node of the tree, leaving root dangling
+
+    //the bytes at the start of a node that a search of it reads: the header and the keys (the items, in a leaf).
+    static const size_t INNER_SEARCH_BYTES = sizeof(Node) + sizeof(NodePrefixes<Key, MAXIMUM + 1>) + (MAXIMUM + 1) * sizeof(Key);
+    static const size_t LEAF_SEARCH_BYTES = sizeof(Node) + (MAXIMUM + 1) * sizeof(T);
+    static const size_t SEARCH_BYTES = (INNER_SEARCH_BYTES > LEAF_SEARCH_BYTES) ? INNER_SEARCH_BYTES : LEAF_SEARCH_BYTES;
+    static const int SCAN_PREFETCH_LEAVES = 2;     //how many leaves ahead a scan prefetches
+
+    static void prefetchSearch(const Node* node) {prefetchLines(node, SEARCH_BYTES);}   //the node a descent goes to next
+    static void prefetchAhead(const Leaf* leaf);   //the leaf SCAN_PREFETCH_LEAVES to the right of leaf
+
+    Leaf* findLeaf(const Key& key, int& index) const; //descend to the leaf where key is, or would be.
+    Leaf* findFirstLeaf(const Key& key, bool after, int& index) const; //descend to the first item not less than (or greater than) key.
+    Iterator iteratorAt(Leaf* leaf, int index) const; //an iterator to leaf->data[index], moving to the next leaf past the end.
+
+    static const Key& getSmallest(const Node* node);  //get the smallest key in this subtree.
+    static const Key& getLargest(const Node* node);   //get the largest key in this subtree.
+    static Key separatorOf(const Node* left, const Node* right); //the routing key between neighbouring subtrees
+    Leaf* leftmostLeaf() const;                       //get the first leaf of the tree.
+    Leaf* rightmostLeaf() const;                      //get the last leaf of the tree.
+
+    Node* copyTree(const Node* other,
+                   Leaf*& lastLeaf);               //return a copy of the subtree at other.
+
+    //bulk load functions
+    static int fillTarget(double fillFactor);      //the number of data items per node for fillFactor
+    void balanceLastLeaf(Leaf* previous, Leaf* last); //give last at least MINIMUM items from previous
+    Node* buildInnerLevels(vector<Node*>& level, int target); //build the inner nodes above level, return the root
+
+    //an entry whose item, T(key, arg), is made only when it is converted to T: in its leaf, if inserted.
+    template <typename Arg>
+    struct KeyedEntry
+    {
+        const Key& key;
+        Arg&& arg;
 
-    bool isLeaf() const {return childCount==0;}    //true if this is a leaf node
+        operator T() const {return T(key,std::forward<Arg>(arg));}
+    };
+    template <typename Arg>
+    static const Key& keyOf(const KeyedEntry<Arg>& entry) {return entry.key;}
 
     //insert element functions
-    bool looseInsert(const T& entry);              //allows MAXIMUM+1 data elements in the root
-    void fixExcess(int i);                         //fix excess of data elements in child i
+    //Entry is const T&, T or a KeyedEntry, so that entry is copied, moved or made into its leaf (and only then).
+    template <typename Entry>
+    bool insertEntry(Entry&& entry, bool dups, Position& at); //insert, and set at to the item inserted or found
+    template <typename Entry>
+    bool looseInsert(Node* node, Entry&& entry, bool dups, Position& at); //allows MAXIMUM+1 data elements in node
+    void fixExcess(Inner* node, int i, Position& at); //fix excess of data elements in child i, keeping at on its item
 
     //remove element functions:
-    bool looseRemove(const T& entry);              //allows MINIMUM-1 data elements in the root
-    void fixShortage(int i);                       //fix shortage of data elements in child i
-
-    void rotateLeft(int i);                        //transfer one element LEFT from child i
-    void rotateRight(int i);                       //transfer one element RIGHT from child i
-    void mergeWithNextSubset(int i);               //merge subset i with subset i+1
-    void mergeWithPreviousSubset(int i);
+    bool looseRemove(Node* node, const Key& key);  //allows MINIMUM-1 data elements in node
+    void fixShortage(Inner* node, int i);          //fix shortage of data elements in child i
+
+    //batch functions: [first, last) of batch (or keys) is the sorted run that belongs under node.
+    static bool keyLess(const T& lhs, const T& rhs) {return keyOf(lhs) < keyOf(rhs);}
+    int insertRun(Node* node, vector<T>& batch, size_t first, size_t last, vector<Node*>& extra); //new right siblings go to extra
+    int removeRun(Node* node, const vector<Key>& keys, vector<char>& used, size_t first, size_t last);
+    void splitItems(Leaf* leaf, vector<T>& items, vector<Node*>& extra); //spread items over leaf and new leaves
+    void splitChildren(Inner* inner, vector<Node*>& children, vector<Node*>& extra); //spread children over inner and new inners
+    void repairSubsets(Inner* node);               //drop emptied subsets, then fix every shortage in node's subsets
+    void fixShortSubsets(Inner* node);             //fix the short subsets of node, and the short ones below them
+    static bool hasShortSubset(const Inner* node); //true if a subset of node is short
+    void dropSubset(Inner* node, int i);           //free the emptied subset[i] (unlinking its leaf)
+    static bool isEmptySubtree(const Node* node);  //true if the subtree holds no items
+
+    void rotateLeft(Inner* node, int i);           //transfer one element LEFT from child i+1
+    void rotateRight(Inner* node, int i);          //transfer one element RIGHT from child i-1
+    void mergeWithNextSubset(Inner* node, int i);  //merge subset i with subset i+1
+    void mergeWithPreviousSubset(Inner* node, int i);
+
+    void printTree(const Node* node, int level, int index, ostream& outs) const;
 
     //used by isValid() to verify that data[i] > all of subtree[i], and data[i] < all of subtree[i+1]
-    bool isLargerThanTree(const T &item) const;      //returns true if item is larger than all data items in tree.
-    bool verifyDepth() const;                        //verify that all leaf nodes occur at the same recursive depth, relative to this node.
-    bool verifyRelativePositionsOfDataItems() const; //verify that all data[]s in the tree are sorted, and that subtree[i] < data[i].
-    int maxDepth() const;                            //used by verifyDepth to obtain the depth of a particular subtree.
+    bool isLargerThanTree(const Node* node, const Key& item) const; //returns true if item is not less than any key in the subtree.
+    bool verifyDepth(const Node* node) const;                       //verify that all leaf nodes occur at the same recursive depth, relative to this node.
+    bool verifyOccupancy(const Node* node) const;                   //verify that no node below this one is short, and no inner node has a single subset.
+    bool verifyRelativePositionsOfDataItems(const Node* node) const;//verify that all data[]s in the tree are sorted, and that subtree[i] < data[i].
+    int maxDepth(const Node* node) const;                           //used by verifyDepth to obtain the depth of a particular subtree.
 };
 
 //preconditions: none
 //postconditions: if all conditions for a valid B+Tree are met,
 // return true, otherwise false.
-template<typename T>
-bool BPlusTree<T>::isValid() const
+template<typename T, int MinDegree>
+bool BPlusTree<T, MinDegree>::isValid() const
 {
-    return (verifyDepth() && verifyRelativePositionsOfDataItems());
+    return (verifyDepth(root) && verifyOccupancy(root) && verifyRelativePositionsOfDataItems(root));
 }
 
 //preconditions: none.
 //postcontions: returns true if the depth of the tree is constant, otherwise false.
-template<typename T>
-bool BPlusTree<T>::verifyDepth() const
+template<typename T, int MinDegree>
+bool BPlusTree<T, MinDegree>::verifyDepth(const Node* node) const
 {
     bool depthOk = true;
     int theDepth = 0;
 
-    if(!isLeaf())
+    if(!node->isLeaf())
     {
-        theDepth = subset[0]->maxDepth(); //the max depth of the 0th subtree.
-        for(int i = 1; i < childCount && depthOk; i++)
+        const Inner* inner = asInner(node);
+        theDepth = maxDepth(inner->subset[0]); //the max depth of the 0th subtree.
+        for(int i = 1; i < inner->childCount && depthOk; i++)
         {
             //verify that the max depth of subset[i] is the same as the max depth of subset[0]
-            if(theDepth != subset[i]->maxDepth())
+            if(theDepth != maxDepth(inner->subset[i]))
                 depthOk = false;
         }
 
-        for(int i = 0; i < childCount && depthOk; i++)
+        for(int i = 0; i < inner->childCount && depthOk; i++)
         {
             //call verifyDepth on the ith subset, being sure not to overwrite depthOk if it is false.
-            bool subTreeDepthStatus = subset[i]->verifyDepth();
+            bool subTreeDepthStatus = verifyDepth(inner->subset[i]);
             if(depthOk)
                 depthOk = subTreeDepthStatus;
         }
@@ -190,21 +499,45 @@ bool BPlusTree<T>::verifyDepth() const
     return depthOk;
 }
 
+//preconditions: none.
+//postcontions: returns true if every inner node at or below node has at least two subsets, and every
+// node below node holds at least MINIMUM items, otherwise false. (node itself may be short: the root can be.)
+template<typename T, int MinDegree>
+bool BPlusTree<T, MinDegree>::verifyOccupancy(const Node* node) const
+{
+    static const bool DEBUG = true;
+
+    if(node->isLeaf())
+        return true;
+
+    const Inner* inner = asInner(node);
+    if(DEBUG)
+        assert(inner->childCount >= 2 && !hasShortSubset(inner));
+    else if(inner->childCount < 2 || hasShortSubset(inner))
+        return false;
+
+    bool occupancyOk = true;
+    for(int i = 0; i < inner->childCount && occupancyOk; i++)
+        occupancyOk = verifyOccupancy(inner->subset[i]);
+    return occupancyOk;
+}
+
 //preconditions: none.
 //postcontions: traverse the tree to find all leaf nodes,
 // returning the largest depth that a leaf node was encountered at.
-template<typename T>
-int BPlusTree<T>::maxDepth() const
+template<typename T, int MinDegree>
+int BPlusTree<T, MinDegree>::maxDepth(const Node* node) const
 {
     int theMaxDepth = 1;
 
-    if(isLeaf())
+    if(node->isLeaf())
         return theMaxDepth;
     else
     {
-        for(int i = 0; i < childCount; i++)
+        const Inner* inner = asInner(node);
+        for(int i = 0; i < inner->childCount; i++)
         {
-            int subTreeDepth = subset[i]->maxDepth() + 1;
+            int subTreeDepth = maxDepth(inner->subset[i]) + 1;
 
             if(subTreeDepth > theMaxDepth)
                 theMaxDepth = subTreeDepth;
@@ -214,23 +547,34 @@ int BPlusTree<T>::maxDepth() const
 }
 
 //preconditions: none.
-//postcontions: returns true if item is larger than all data items in tree, otherwise false.
-template<typename T>
-bool BPlusTree<T>::isLargerThanTree(const T &item) const
+//postcontions: returns true if item is not less than any key in the subtree at node, otherwise false.
+template<typename T, int MinDegree>
+bool BPlusTree<T, MinDegree>::isLargerThanTree(const Node* node, const Key &item) const
 {
     bool isLargest = true;
 
-    for(int i = 0; i < dataCount; i++)
-        if(data[i] > item)
-            isLargest = false;
-
-    for(int i = 0; i < childCount && isLargest; i++)
+    if(node->isLeaf())
+    {
+        const Leaf* leaf = asLeaf(node);
+        for(int i = 0; i < leaf->dataCount; i++)
+            if(keyOf(leaf->data[i]) > item)
+                isLargest = false;
+    }
+    else
     {
-        bool returnVal = subset[i]->isLargerThanTree(item);
+        const Inner* inner = asInner(node);
+        for(int i = 0; i < inner->dataCount; i++)
+            if(inner->data[i] > item)
+                isLargest = false;
+
+        for(int i = 0; i < inner->childCount && isLargest; i++)
+        {
+            bool returnVal = isLargerThanTree(inner->subset[i], item);
 
-        //if we have found that a branch returned false, do not overwrite isLargest.
-        if(isLargest)
-            isLargest = returnVal;
+            //if we have found that a branch returned false, do not overwrite isLargest.
+            if(isLargest)
+                isLargest = returnVal;
+        }
     }
 
     return isLargest;
@@ -239,52 +583,69 @@ bool BPlusTree<T>::isLargerThanTree(const T &item) const
 //preconditions: none.
 //postcontions: returns true if all of the following are true:
 // 1) if a node has k data items, it has k+1 subsets (with the exception of leaf nodes)
-// 2) for all non-leaf nodes, data[i] > all items in subtree[i]
-// 3) for all non-leaf nodes, data[i] < all items in subtree[i+1]
+// 2) for all non-leaf nodes, data[i] >= all items in subtree[i]
+// 3) for all non-leaf nodes, data[i] <= the smallest item in subtree[i+1]
 // 4) for any node, data[i] < data[i+1]
 // -- otherwise, returns false.
-template<typename T>
-bool BPlusTree<T>::verifyRelativePositionsOfDataItems() const
+template<typename T, int MinDegree>
+bool BPlusTree<T, MinDegree>::verifyRelativePositionsOfDataItems(const Node* node) const
 {
     static const bool DEBUG = true;
 
     //initially, assume that a tree / subtree is valid.
     bool treeIsValid = true;
 
-    //verify that data[i] < data[i+1]
-    if(DEBUG)
-        assert(arrayIsSorted(data,dataCount));
-    else if(!arrayIsSorted(data,dataCount))
-        treeIsValid = false;
-
-    if(!isLeaf())
+    if(node->isLeaf())
+    {
+        //verify that data[i] < data[i+1]
+        const Leaf* leaf = asLeaf(node);
+        if(DEBUG)
+            assert(arrayIsSorted(leaf->data,leaf->dataCount));
+        else if(!arrayIsSorted(leaf->data,leaf->dataCount))
+            treeIsValid = false;
+    }
+    else
     {
+        const Inner* inner = asInner(node);
+
+        //verify that data[i] < data[i+1]
+        if(DEBUG)
+            assert(arrayIsSorted(inner->data,inner->dataCount));
+        else if(!arrayIsSorted(inner->data,inner->dataCount))
+            treeIsValid = false;
+
+        //verify that the prefixes kept to search data[] are up to date.
+        if(DEBUG)
+            assert(inner->prefixesAreFresh());
+        else if(!inner->prefixesAreFresh())
+            treeIsValid = false;
+
         //verify that a non-leaf with k data items, has k+1 subsets.
         if(DEBUG)
-            assert(dataCount == childCount-1);
-        else if(dataCount != childCount-1)
+            assert(inner->dataCount == inner->childCount-1);
+        else if(inner->dataCount != inner->childCount-1)
             treeIsValid = false;
 
-        //verify that data[i] > all of subset[i], for all data items in this node.
-        // and that data[i] == the smallest item in subset[i+1]
-        for(int i = 0; i < dataCount; i++)
+        //verify that data[i] >= all of subset[i], for all data items in this node.
+        // and that data[i] <= the smallest item in subset[i+1]
+        for(int i = 0; i < inner->dataCount; i++)
         {
             if(DEBUG)
-                assert(subset[i]->isLargerThanTree(data[i]));
-            else if(!subset[i]->isLargerThanTree(data[i]))
+                assert(isLargerThanTree(inner->subset[i],inner->data[i]));
+            else if(!isLargerThanTree(inner->subset[i],inner->data[i]))
                 treeIsValid = false;
 
             if(DEBUG)
-                assert(data[i]==subset[i+1]->getSmallest());
-            else if(!(data[i] == subset[i+1]->getSmallest()))
+                assert(!(getSmallest(inner->subset[i+1]) < inner->data[i]));
+            else if(getSmallest(inner->subset[i+1]) < inner->data[i])
                 treeIsValid = false;
         }
 
         //Call this function all all subtrees recursively,
         //  being sure not to overwrite a false value for treeIsValid.
-        for(int i = 0; i < childCount && treeIsValid; i++)
+        for(int i = 0; i < inner->childCount && treeIsValid; i++)
         {
-            bool returnVal = subset[i]->isValid();
+            bool returnVal = verifyDepth(inner->subset[i]) && verifyRelativePositionsOfDataItems(inner->subset[i]);
             if(treeIsValid)
                 treeIsValid = returnVal;
         }
@@ -294,522 +655,1496 @@ bool BPlusTree<T>::verifyRelativePositionsOfDataItems() const
 
 //preconditions: none
 //postconditions: B+Tree will be initialized to allow duplicates if dups.
-template<typename T>
-BPlusTree<T>::BPlusTree(bool dups)
+template<typename T, int MinDegree>
+BPlusTree<T, MinDegree>::BPlusTree(bool dups)
 {
-    nextSubset = nullptr;
+    root = newLeaf();
     dupsOk = dups;
-    dataCount = 0;
-    childCount = 0;
     _size = 0;
 }
 
 //preconditions: none
 //postconditions: B+Tree will be initialized to allow dups if other allows them,
 // and the tree structure / contents of other will be copied to this tree.
-template<typename T>
-BPlusTree<T>::BPlusTree(const BPlusTree<T> &other)
+template<typename T, int MinDegree>
+BPlusTree<T, MinDegree>::BPlusTree(const BPlusTree<T, MinDegree> &other)
 {
     _size = other._size;
-    nextSubset = nullptr;
     dupsOk = other.dupsOk;
-    BPlusTree<T>* temp = nullptr;
-    copyTree(other,temp);
+    Leaf* temp = nullptr;
+    root = copyTree(other.root,temp);
 }
 
 //preconditions: none
 //postconditions: B+Tree will be initialized to allow dups if RHS allows them,
-//  all dynamic memory of the current tree will be deallocated by clearTree(),
+//  all dynamic memory of the current tree will be deallocated,
 //  and the tree structure / contents of RHS will be copied to this tree.
-template<typename T>
-BPlusTree<T>& BPlusTree<T>::operator =(const BPlusTree<T>& RHS)
+template<typename T, int MinDegree>
+BPlusTree<T, MinDegree>& BPlusTree<T, MinDegree>::operator =(const BPlusTree<T, MinDegree>& RHS)
 {
-    clearTree();
+    if(this != &RHS)
+    {
+        releaseTree();
 
-    BPlusTree<T>* temp = nullptr;
-    _size = RHS._size;
-    nextSubset = nullptr;
-    dupsOk = RHS.dupsOk;
-    copyTree(RHS,temp);
+        Leaf* temp = nullptr;
+        _size = RHS._size;
+        dupsOk = RHS.dupsOk;
+        root = copyTree(RHS.root,temp);
+    }
 
     return *this;
 }
 
 //preconditions: none
-//postconditions: All dynamic memory will be deallocated by clearTree().
-template<typename T>
-BPlusTree<T>::~BPlusTree()
+//postconditions: All dynamic memory will be deallocated.
+template<typename T, int MinDegree>
+BPlusTree<T, MinDegree>::~BPlusTree()
 {
-    clearTree();
+    releaseTree();
 }
 
 //preconditions: none
-//postconditions: All dynamic memory will be freed by traversing the tree from left to right.
-// note that after clearing all children of a node, childCount will be set to 0, so when
-// the parent of this node calls delete, double deletion errors wil be prevented.
-template<typename T>
-void BPlusTree<T>::clearTree()
+//postconditions: All nodes will be freed, leaving this tree as a single empty leaf.
+template<typename T, int MinDegree>
+void BPlusTree<T, MinDegree>::clearTree()
 {
-    if(childCount > 0)
-    {
-        for (int i = 0; i < childCount; i++)
-        {
-            subset[i]->clearTree();
-            delete subset[i];
-        }
-        childCount = 0;
-    }
+    releaseTree();
+    root = newLeaf();
+    _size = 0;
 }
 
 //preconditions: none
-//postconditions: if the key exists in this subtree,
-// and the key is not at a leaf, it will be replaced
-// by the smallest item in subset[index+1] of where it was found.
-template<typename T>
-void BPlusTree<T>::removeDuplicate(T key)
+//postconditions: returns the counters of innerPool and leafPool added together.
+template<typename T, int MinDegree>
+PoolStats BPlusTree<T, MinDegree>::allocationStats() const
 {
-    int index = firstGE(data,dataCount,key);
-    bool found = (index < dataCount && key == data[index]);
-
-    if(found && !isLeaf())
-        data[index] = subset[index+1]->getSmallest();
-    else if(!found && !isLeaf())
-        subset[index]->removeDuplicate(key);
+    PoolStats stats = innerPool.stats();
+    stats += leafPool.stats();
+    return stats;
 }
 
 //preconditions: none
-//postconditions: returns the smallest item in this subtree.
-template<typename T>
-T BPlusTree<T>::getSmallest()
+//postconditions: returns a new, empty Inner node, constructed in a block of innerPool.
+template<typename T, int MinDegree>
+typename BPlusTree<T, MinDegree>::Inner* BPlusTree<T, MinDegree>::newInner()
 {
-    if(!isLeaf())
-        return subset[0]->getSmallest();
-    else
-        return data[0];
+    return new (innerPool.allocate()) Inner;
 }
 
 //preconditions: none
-//postconditions: returns an interator to entry, if it exists in the tree.
-//                otherwise return an iterator to null.
-template<typename T>
-typename BPlusTree<T>::Iterator BPlusTree<T>::getIteratorAtEntry(const T& entry)
+//postconditions: returns a new, empty Leaf node, constructed in a block of leafPool.
+template<typename T, int MinDegree>
+typename BPlusTree<T, MinDegree>::Leaf* BPlusTree<T, MinDegree>::newLeaf()
 {
-    int index = firstGE(data,dataCount,entry);
-    bool found = (index < dataCount && entry == data[index]);
+    return new (leafPool.allocate()) Leaf;
+}
 
-    if(found)
+//preconditions: node was allocated as an Inner if it is not a leaf, otherwise as a Leaf.
+//postconditions: node is destroyed and its block returned to its pool, its children (if any) are not.
+template<typename T, int MinDegree>
+void BPlusTree<T, MinDegree>::deleteNode(Node* node)
+{
+    if(node->isLeaf())
     {
-        if(isLeaf())
-            return BPlusTree<T>::Iterator(this,index);
-        else
-            return subset[index+1]->getIteratorAtEntry(entry);
+        asLeaf(node)->~Leaf();
+        leafPool.deallocate(node);
     }
     else
     {
-        if(isLeaf())
-            return BPlusTree<T>::Iterator();
-        else
-            return subset[index]->getIteratorAtEntry(entry);
+        asInner(node)->~Inner();
+        innerPool.deallocate(node);
     }
 }
 
 //preconditions: none
-//postconditions: returns an interator to the first data item in the leaf nodes.
-template<typename T>
-typename BPlusTree<T>::Iterator BPlusTree<T>::begin()
+//postconditions: every node of the tree is freed and root must be reset by the caller.
+// when neither kind of node has a destructor to run, the slabs are freed without
+// visiting a single node, otherwise the tree is walked to destroy each node first.
+template<typename T, int MinDegree>
+void BPlusTree<T, MinDegree>::releaseTree()
 {
-    if(!this->empty())
-    {
-        BPlusTree<T> * temp = this;
-        while(!temp->isLeaf())
-            temp = temp->subset[0];
+    if(!is_trivially_destructible<Inner>::value || !is_trivially_destructible<Leaf>::value)
+        deleteSubtree(root);
+
+    innerPool.releaseAll();
+    leafPool.releaseAll();
+}
 
-        return BPlusTree<T>::Iterator(temp,0);
+//preconditions: none
+//postconditions: node and every node below it will be freed, from left to right.
+template<typename T, int MinDegree>
+void BPlusTree<T, MinDegree>::deleteSubtree(Node* node)
+{
+    if(!node->isLeaf())
+    {
+        Inner* inner = asInner(node);
+        for (int i = 0; i < inner->childCount; i++)
+            deleteSubtree(inner->subset[i]);
     }
-    else
-        return BPlusTree<T>::Iterator();
+    deleteNode(node);
 }
 
 //preconditions: none
-//postconditions: returns an interator to null.
-template<typename T>
-typename BPlusTree<T>::Iterator BPlusTree<T>::end()
+//postconditions: returns the index of the first routing key in inner that is not less than key,
+// if no such key exists, returns inner->dataCount.
+template<typename T, int MinDegree>
+int BPlusTree<T, MinDegree>::innerIndex(const Inner* inner, const Key& key)
 {
-    return BPlusTree<T>::Iterator();
+    return inner->firstGE(inner->data,inner->dataCount,key);
 }
 
 //preconditions: none
-//postconditions: other will be traversed recursively to copy the data and
-// structure of other tree to this tree.
-template<typename T>
-void BPlusTree<T>::copyTree(const BPlusTree<T>& other, BPlusTree<T>*& lastLeaf)
+//postconditions: returns the index of the first item in leaf whose key is not less than key,
+// if no such item exists, returns leaf->dataCount.
+template<typename T, int MinDegree>
+int BPlusTree<T, MinDegree>::leafIndex(const Leaf* leaf, const Key& key)
 {
-    //copy the data of the root from source to dest.
-    copyArray(data,other.data,dataCount,other.dataCount);
-    childCount = other.childCount;
+    return leafIndex(leaf,key,is_same<T, Key>());
+}
 
-    //if the root is not a leaf:
-    if(!other.isLeaf())
-    {
-        for(int i = 0; i < other.childCount; i++)
-        {
-            subset[i] = new BPlusTree<T>(other.dupsOk);
-            subset[i]->copyTree(*other.subset[i],lastLeaf);
-        }
-    }
-    else
-    {
-        //since the leaf nodes are being instantiated from left to right
-        // lastLeaf will be null for the first leaf, for all subsequent leaves,
-        // it will point to the previous node.
-        if(lastLeaf)
-            lastLeaf->nextSubset = this;
-        lastLeaf = this;
-    }
+//preconditions: T is the same type as Key
+//postconditions: the items are the keys, so search them with the NodeSearch for Key.
+template<typename T, int MinDegree>
+int BPlusTree<T, MinDegree>::leafIndex(const Leaf* leaf, const Key& key, true_type)
+{
+    return NodeSearch<Key>::firstGE(leaf->data,leaf->dataCount,key);
 }
 
 //preconditions: none
-//postconditions: the entry will be inserted into the B+Tree using looseInsert,
-// which when returning, may cause an excess in the root, which will be resolved by:
-// 1) creating a new node, copying all the contents of this root into it,
-// 2) clearing the root node,
-// 3) making the new node this root's only child (subset[0])
-// 4) calling fixExcess on this only subset (subset[0])
-template <typename T>
-bool BPlusTree<T>::insert(const T& entry)
+//postconditions: a branchless binary search (see firstGEBinary) comparing keyOf(data[i]) with key.
+template<typename T, int MinDegree>
+int BPlusTree<T, MinDegree>::leafIndex(const Leaf* leaf, const Key& key, false_type)
 {
-    bool itemInserted = looseInsert(entry);
-    if(itemInserted)
+    if(leaf->dataCount == 0)
+        return 0;
+
+    const T* base = leaf->data;
+    int len = leaf->dataCount;
+    while(len > 1)
     {
-        _size++;
-        if(dataCount == MAXIMUM + 1)
-        {
-            //create a new node, copy all the contents of this root into it,
-            BPlusTree<T> * newNode = new BPlusTree<T>(dupsOk);
-            copyArray(newNode->data, data, newNode->dataCount, dataCount);
-            copyArray(newNode->subset, subset, newNode->childCount, childCount);
+        int half = len / 2;
+        base = (keyOf(base[half]) < key) ? base + half : base;
+        len -= half;
+    }
 
-            dataCount = 0;
-            childCount = 1;
+    return int(base - leaf->data) + (keyOf(*base) < key);
+}
 
-            //make the new node this root's only child (subset[0])
-            subset[0] = newNode;
-            fixExcess(0);
-        }
-    }
-    return itemInserted;
+//preconditions: none
+//postconditions: returns the index of the subtree of inner that holds key (or where it would be inserted).
+// when key equals a routing key data[i], that is subset[i+1], since data[i] is not greater than any key
+// in that subtree. so subset[j] holds the keys from data[j-1] up to (but not including) data[j].
+template<typename T, int MinDegree>
+int BPlusTree<T, MinDegree>::childIndex(const Inner* inner, const Key& key)
+{
+    int i = innerIndex(inner,key);
+    bool found = (i < inner->dataCount && key == inner->data[i]);
+    return found ? i+1 : i;
 }
 
 //preconditions: none
-//postcondition: looseRemove will be called to remove the target from the tree,
-// the tree will be valid when returning, except that the root may have no data
-// and only a single subset - This will be resolved by:
-//  1) create a temporary pointer (shrink_ptr) and point it to this root's only subset
-//  2) copy all the data and subsets of this subset into the root (through shrink_ptr)
-//  3) now, the root contains all the data and poiners of it's old child.
-//  4) simply delete shrink_ptr (blank out child), and the tree has shrunk by one level.
-// Note, the root node of the tree will always be the same, it's the child node we delete
-template<typename T>
-bool BPlusTree<T>::remove(const T& entry)
-{
-    bool itemRemoved = looseRemove(entry);
-    if(itemRemoved)
-    {
-        _size--;
-        if(dataCount <= 1 && childCount == 1)
-        {
-            BPlusTree<T>* shrinkPtr = subset[0];
-            copyArray(data,shrinkPtr->data,dataCount,shrinkPtr->dataCount);
-            copyArray(subset,shrinkPtr->subset,childCount,shrinkPtr->childCount);
-            shrinkPtr->childCount = 0;
-            delete shrinkPtr;
-        }
-    }
-    return itemRemoved;
+//postconditions: returns subset[childIndex(inner, key)], and starts fetching its keys.
+template<typename T, int MinDegree>
+typename BPlusTree<T, MinDegree>::Node* BPlusTree<T, MinDegree>::childOf(const Inner* inner, const Key& key)
+{
+    Node* child = inner->subset[childIndex(inner,key)];
+    prefetchSearch(child);
+    return child;
 }
 
 //preconditions: none
-//postconditions: returns a reference to the entry in the tree.
-// if no such entry exists, the entry will be inserted.
-// otherwise, just return the reference to the existing entry.
-template<class T>
-T &BPlusTree<T>::get(const T &entry)
+//postconditions: the leaf SCAN_PREFETCH_LEAVES to the right of leaf (if there is one) is prefetched, whole.
+// the nextSubset links on the way are in leaves a scan prefetched earlier.
+template<typename T, int MinDegree>
+void BPlusTree<T, MinDegree>::prefetchAhead(const Leaf* leaf)
 {
-    T * temp = find(entry);
-    if(!temp)
-    {
-        insert(entry);
-        temp = find(entry);
-    }
-    return *temp;
+    for(int hop = 0; hop < SCAN_PREFETCH_LEAVES && leaf; hop++)
+        leaf = leaf->nextSubset;
+    if(leaf)
+        prefetchLines(leaf, sizeof(Leaf));
 }
 
 //preconditions: none
-//postconditions: returns a reference to the entry in the tree.
-// if no such entry exists, the entry will be inserted.
-// otherwise, just return the reference to the existing entry.
-template<class T>
-const T& BPlusTree<T>::get(const T &entry) const
+//postconditions: follows the routing keys from the root to the leaf that holds key,
+// (or where key would be inserted) and returns it, with index set to leafIndex(leaf, key).
+template<typename T, int MinDegree>
+typename BPlusTree<T, MinDegree>::Leaf* BPlusTree<T, MinDegree>::findLeaf(const Key& key, int& index) const
 {
-    T * temp = find(entry);
-    assert(temp);
-    return *temp;
+    Node* node = root;
+    while(!node->isLeaf())
+        node = childOf(asInner(node),key);
+
+    Leaf* leaf = asLeaf(node);
+    index = leafIndex(leaf,key);
+    return leaf;
 }
 
 //preconditions: none
-//postconditions: returns true if the entry exists in the tree, otherwise false.
-template<typename T>
-bool BPlusTree<T>::contains(const T &entry)
+//postconditions: descends from the root to the leaf holding the first item with a key not less
+// than key (or greater than key, if after), and returns it with index set to that item's position.
+// unlike findLeaf, the search goes left of a routing key equal to key (unless after is set),
+// since duplicates of key may sit at the end of subset[i] as well as in subset[i+1].
+// if every item of the leaf comes before key, index is the leaf's dataCount, and the
+// item wanted is the first one of the next leaf.
+template<typename T, int MinDegree>
+typename BPlusTree<T, MinDegree>::Leaf* BPlusTree<T, MinDegree>::findFirstLeaf(const Key& key, bool after, int& index) const
 {
-    int index = firstGE(data,dataCount,entry);
-    bool found = (index < dataCount && entry == data[index]);
-    if(found)
-    {
-        if(isLeaf())
-            return true;
-        else
-            return subset[index+1]->contains(entry);
-    }
-    else
+    Node* node = root;
+    while(!node->isLeaf())
     {
-        if(isLeaf())
-            return false;
-        else
-            return subset[index]->contains(entry);
+        Inner* inner = asInner(node);
+        int i = innerIndex(inner,key);
+        if(after)
+            while(i < inner->dataCount && !(key < inner->data[i]))
+                i++;
+        node = inner->subset[i];
+        prefetchSearch(node);
     }
+
+    Leaf* leaf = asLeaf(node);
+    index = leafIndex(leaf,key);
+    if(after)
+        while(index < leaf->dataCount && !(key < keyOf(leaf->data[index])))
+            index++;
+    return leaf;
 }
 
-//preconditions: none
-//postconditions: returns a pointer to the entry in the tree if it exists,
-// otherwise returns nullptr.
-template<typename T>
-T *BPlusTree<T>::find(const T &entry)
+//preconditions: 0 <= index <= leaf->dataCount
+//postconditions: returns an iterator to leaf->data[index], or if index is past the end
+// of leaf, to the first item of the next leaf (a null iterator if there is none).
+template<typename T, int MinDegree>
+typename BPlusTree<T, MinDegree>::Iterator BPlusTree<T, MinDegree>::iteratorAt(Leaf* leaf, int index) const
 {
-    int index = firstGE(data,dataCount,entry);
-    bool found = (index < dataCount && entry == data[index]);
+    assert(index >= 0 && index <= leaf->dataCount);
 
-    if(found)
-    {
-        if(isLeaf())
-            return &data[index];
-        else
-            return subset[index+1]->find(entry);
-    }
+    if(index < leaf->dataCount)
+        return Iterator(leaf,index,this);
+    else if(leaf->nextSubset)
+        return Iterator(leaf->nextSubset,0,this);
     else
-    {
-        if(isLeaf())
-            return nullptr;
-        else
-            return subset[index]->find(entry);
-    }
+        return Iterator(nullptr,0,this);
 }
 
 //preconditions: none
-//postconditions: returns the total number of data items in the tree.
-template<typename T>
-int BPlusTree<T>::size() const
+//postconditions: returns an iterator to the first item whose key is not less than key,
+// or end() if there is none. Only one path from the root is searched, so walking the
+// range from here with the iterator costs O(log n) plus the length of the range.
+template<typename T, int MinDegree>
+typename BPlusTree<T, MinDegree>::Iterator BPlusTree<T, MinDegree>::lower_bound(const Key& key)
 {
-    return _size;
+    int index;
+    Leaf* leaf = findFirstLeaf(key,false,index);
+    return iteratorAt(leaf,index);
 }
 
 //preconditions: none
-//postconditions: returns true if this node
-// has no children or data items, otherwise false.
-template<typename T>
-bool BPlusTree<T>::empty() const
+//postconditions: returns an iterator to the first item whose key is greater than key,
+// or end() if there is none.
+template<typename T, int MinDegree>
+typename BPlusTree<T, MinDegree>::Iterator BPlusTree<T, MinDegree>::upper_bound(const Key& key)
 {
-    if(childCount == 0 && dataCount == 0)
-        return true;
-    else
-        return false;
+    int index;
+    Leaf* leaf = findFirstLeaf(key,true,index);
+    return iteratorAt(leaf,index);
 }
 
 //preconditions: none
-//postconditions: the tree will be printed
-template <typename T>
-void BPlusTree<T>::printTree(int level, int index, ostream& outs) const
+//postconditions: returns the range of items whose key equals key, as the pair
+// (lower_bound(key), upper_bound(key)). the range is empty if key is not in the tree.
+template<typename T, int MinDegree>
+pair<typename BPlusTree<T, MinDegree>::Iterator, typename BPlusTree<T, MinDegree>::Iterator> BPlusTree<T, MinDegree>::equal_range(const Key& key)
 {
-    //1. print the last child (if any)
-    //2. print all the rest of the data and children
-    if(childCount > 0)
-        for(int i = childCount-1; i >= 0; i--)
-            if(subset[i])
-                subset[i]->printTree(level+1,i,outs);
-
-    outs << setw(level*10) << index << " : "; //buffer the list based on the depth.
-    printArray(data,dataCount);
+    return make_pair(lower_bound(key),upper_bound(key));
 }
 
-//preconditions: none
-//postconditions: the entry will be inserted into the tree,
-// if it does not already exist, or if duplicates are allowed.
-// The item will be inserted as follows:
-//  1) find the index of the first item in data[] of this node that is not less than the entry.
-//     if no such entry exists, index will be set to dataCount.
-//  2) check if the entry exists in the tree
-//  3) if the entry was found,
-//     a) if dupsOk, insert it here.
-//     b) else, return false.
-//  4) if this node is a leaf, insert the entry here,
-//     otherwise, call looseInsert on subset[i]
-template <typename T>
-bool BPlusTree<T>::looseInsert(const T& entry)
+//preconditions: the subtree at node is not empty.
+//postconditions: returns the smallest key in this subtree.
+template<typename T, int MinDegree>
+const typename BPlusTree<T, MinDegree>::Key& BPlusTree<T, MinDegree>::getSmallest(const Node* node)
 {
-    bool itemInserted = false;
-    int i = firstGE(data, dataCount, entry);
-    bool found = (i < dataCount && entry == data[i]);
+    while(!node->isLeaf())
+        node = asInner(node)->subset[0];
 
-    if(found)
-    {
-        // if the node is not a leaf, we have not found the data item yet.
-        // howerver, we know it is the leftmost data item in subse[i+1]
-        if(!isLeaf())
-        {
-            itemInserted = subset[i+1]->looseInsert(entry);
-            fixExcess(i+1);
-        }
-        else if(!dupsOk)
-            itemInserted = false;
-    }
-    else
-    {
-        if(isLeaf())
-        {
-            orderedInsert(data,dataCount,entry);
-            itemInserted = true;
-        }
-        else
-            itemInserted = subset[i]->looseInsert(entry);
+    return keyOf(asLeaf(node)->data[0]);
+}
 
-        if(itemInserted)
-            fixExcess(i);
-    }
+//preconditions: the subtree at node is not empty.
+//postconditions: returns the largest key in this subtree.
+template<typename T, int MinDegree>
+const typename BPlusTree<T, MinDegree>::Key& BPlusTree<T, MinDegree>::getLargest(const Node* node)
+{
+    while(!node->isLeaf())
+        node = asInner(node)->subset[node->childCount-1];
 
-    return itemInserted;
+    const Leaf* leaf = asLeaf(node);
+    return keyOf(leaf->data[leaf->dataCount-1]);
 }
 
-//preconditions: subset[i] must have an exces,  index < maximum+1, childCount <= maximum+1
-//postconditions: the excess in subset[i] will be resolved as follows:
-//  1) add a new subset at location i+1 of this node
-//  2) split subset[i] (both the subset array and the data array)
-//  and move half into subset[i+1] (this is the subset we created in step 1.)
-//  3) detach the last data item of subset[i] and bring it and insert it into this node's data[]
-//Note that this last step may cause this node to have too many items. This is OK. This will be
-//dealt with at the higher recursive level. (my parent will fix it!)
-template <typename T>
-void BPlusTree<T>::fixExcess(int i)
+//preconditions: left and right are neighbouring subtrees, neither of them empty.
+//postconditions: returns the key to route between them: KeySeparator's shortest key
+// greater than every key of left, and not greater than any key of right.
+template<typename T, int MinDegree>
+typename BPlusTree<T, MinDegree>::Key BPlusTree<T, MinDegree>::separatorOf(const Node* left, const Node* right)
 {
-    assert(i <= MAXIMUM+1 && childCount <= MAXIMUM +1);
+    return KeySeparator<Key>::between(getLargest(left),getSmallest(right));
+}
 
-    if(i < childCount && subset[i]->dataCount > MAXIMUM)
-    {
-        if(subset[i]->isLeaf())
-        {
-            insertItem(subset,i+1,childCount,new BPlusTree<T>(dupsOk));
-            split(subset[i]->data,subset[i]->dataCount,subset[i+1]->data,subset[i+1]->dataCount,true);
-            split(subset[i]->subset,subset[i]->childCount,subset[i+1]->subset,subset[i+1]->childCount);
-            T temp = subset[i+1]->data[0];
-            orderedInsert(data,dataCount, temp);
+//preconditions: none
+//postconditions: returns the first leaf of the tree, following the first subset down from the root.
+template<typename T, int MinDegree>
+typename BPlusTree<T, MinDegree>::Leaf* BPlusTree<T, MinDegree>::leftmostLeaf() const
+{
+    Node* node = root;
+    while(!node->isLeaf())
+        node = asInner(node)->subset[0];
 
-            //preserve the 'linked list' when inserting a leaf to the right of i
-            BPlusTree<T>* nextFromI = subset[i]->nextSubset;
-            subset[i]->nextSubset = subset[i+1];
-            subset[i+1]->nextSubset = nextFromI;
-        }
-        else
-        {
-            insertItem(subset,i+1,childCount,new BPlusTree<T>(dupsOk));
-            split(subset[i]->data,subset[i]->dataCount,subset[i+1]->data,subset[i+1]->dataCount);
-            split(subset[i]->subset,subset[i]->childCount,subset[i+1]->subset,subset[i+1]->childCount);
-            orderedInsert(data,dataCount, detachItem(subset[i]->data,subset[i]->dataCount));
-        }
-    }
+    return asLeaf(node);
 }
 
 //preconditions: none
-//postconditions: the entry, if it exists, will be removed from the tree.
-// a) leaf && not found target: there is nothing to do
-// b) leaf && found target: just remove the target
-// c) not leaf and not found target: recursive call to loose_remove
-// d) not leaf and found: replace target with largest child of subset[i]
-template <typename T>
-bool BPlusTree<T>::looseRemove(const T& entry)
+//postconditions: returns the last leaf of the tree, following the last subset down from the root.
+template<typename T, int MinDegree>
+typename BPlusTree<T, MinDegree>::Leaf* BPlusTree<T, MinDegree>::rightmostLeaf() const
 {
-    int index = firstGE(data,dataCount,entry);
-    bool found = (index < dataCount && data[index] == entry);
-    bool itemRemoved = false;
+    Node* node = root;
+    while(!node->isLeaf())
+        node = asInner(node)->subset[node->childCount-1];
 
-    if(!isLeaf())
-    {
-        if(found)
-        {
-            itemRemoved = subset[index+1]->looseRemove(entry);
-            if(subset[index+1]->dataCount < MINIMUM)
-                fixShortage(index+1);
-        }
-        else
-        {
-            itemRemoved = subset[index]->looseRemove(entry);
-            if(subset[index]->dataCount < MINIMUM)
-                fixShortage(index);
-        }
-        removeDuplicate(entry);
-    }
-    else
-    {
-        if(found)
+    return asLeaf(node);
+}
+
+//preconditions: none
+//postconditions: returns an interator to entry, if it exists in the tree.
+//                otherwise return an iterator to null.
+template<typename T, int MinDegree>
+typename BPlusTree<T, MinDegree>::Iterator BPlusTree<T, MinDegree>::getIteratorAtEntry(const T& entry)
+{
+    int index;
+    Leaf* leaf = findLeaf(keyOf(entry),index);
+
+    if(index < leaf->dataCount && keyOf(entry) == keyOf(leaf->data[index]))
+        return BPlusTree<T, MinDegree>::Iterator(leaf,index,this);
+    else
+        return BPlusTree<T, MinDegree>::Iterator();
+}
+
+//preconditions: none
+//postconditions: returns an interator to the first data item in the leaf nodes.
+template<typename T, int MinDegree>
+typename BPlusTree<T, MinDegree>::Iterator BPlusTree<T, MinDegree>::begin()
+{
+    if(!this->empty())
+    {
+        return BPlusTree<T, MinDegree>::Iterator(leftmostLeaf(),0,this);
+    }
+    else
+        return end();
+}
+
+//preconditions: none
+//postconditions: returns an interator to null, that can be decremented to the last item.
+template<typename T, int MinDegree>
+typename BPlusTree<T, MinDegree>::Iterator BPlusTree<T, MinDegree>::end()
+{
+    return BPlusTree<T, MinDegree>::Iterator(nullptr,0,this);
+}
+
+//preconditions: none
+//postconditions: other will be traversed recursively to copy the data and
+// structure of the subtree at other, and the copy will be returned.
+template<typename T, int MinDegree>
+typename BPlusTree<T, MinDegree>::Node* BPlusTree<T, MinDegree>::copyTree(const Node* other, Leaf*& lastLeaf)
+{
+    //if the subtree is not a leaf:
+    if(!other->isLeaf())
+    {
+        const Inner* source = asInner(other);
+        Inner* copy = newInner();
+        copyArray(copy->data,source->data,copy->dataCount,source->dataCount);
+        copy->refreshPrefixes();
+
+        for(int i = 0; i < source->childCount; i++)
+            copy->subset[i] = copyTree(source->subset[i],lastLeaf);
+        copy->childCount = source->childCount;
+
+        return copy;
+    }
+    else
+    {
+        Leaf* copy = newLeaf();
+        copyArray(copy->data,asLeaf(other)->data,copy->dataCount,other->dataCount);
+
+        //since the leaf nodes are being instantiated from left to right
+        // lastLeaf will be null for the first leaf, for all subsequent leaves,
+        // it will point to the previous node.
+        if(lastLeaf)
+            lastLeaf->nextSubset = copy;
+        copy->prevSubset = lastLeaf;
+        lastLeaf = copy;
+
+        return copy;
+    }
+}
+
+//preconditions: [first, last) is sorted by key, and each item can be assigned to a T.
+//postconditions: the tree will hold exactly the items in [first, last)
+// (with a repeated key kept only once, unless dups are allowed), built in one pass:
+//  1) the items are appended to a chain of leaves, fillTarget(fillFactor) items per leaf,
+//  2) the last leaf takes items from the one before it if it is short,
+//  3) the inner levels are built bottom-up over the leaves until one root remains.
+template<typename T, int MinDegree>
+template<typename InputIt>
+void BPlusTree<T, MinDegree>::bulkLoad(InputIt first, InputIt last, double fillFactor)
+{
+    const int target = fillTarget(fillFactor);
+
+    releaseTree();
+    _size = 0;
+
+    vector<Node*> level;
+    Leaf* previous = nullptr;
+    Leaf* current = newLeaf();
+    level.push_back(current);
+
+    const T* lastItem = nullptr;
+    for(; first != last; ++first)
+    {
+        T item(*first);
+        if(lastItem)
         {
-            deleteItem(data,index,dataCount);
-            itemRemoved = true;
+            assert(!(keyOf(item) < keyOf(*lastItem)));
+            if(!dupsOk && keyOf(item) == keyOf(*lastItem))
+                continue;
         }
-        else
-            itemRemoved = false;
+
+        if(current->dataCount == target)
+        {
+            previous = current;
+            current = newLeaf();
+            previous->nextSubset = current;
+            current->prevSubset = previous;
+            level.push_back(current);
+        }
+
+        attachItem(current->data,current->dataCount,std::move(item));
+        lastItem = &current->data[current->dataCount-1];
+        _size++;
     }
 
+    if(previous && current->dataCount < MINIMUM)
+    {
+        balanceLastLeaf(previous,current);
+        if(current->dataCount == 0)
+        {
+            deleteNode(current);
+            level.pop_back();
+        }
+    }
+
+    root = buildInnerLevels(level,target);
+}
+
+//preconditions: none
+//postconditions: writes a header (SAVE_MAGIC, SAVE_VERSION, dupsOk and the number of items) to outs,
+// then every item in order, leaf by leaf, with Encoder<T>. returns false if outs failed.
+template<typename T, int MinDegree>
+bool BPlusTree<T, MinDegree>::save(ostream& outs) const
+{
+    Encoder<uint32_t>::write(outs, uint32_t(SAVE_MAGIC));
+    Encoder<uint32_t>::write(outs, uint32_t(SAVE_VERSION));
+    Encoder<uint8_t>::write(outs, uint8_t(dupsOk));
+    Encoder<uint64_t>::write(outs, uint64_t(_size));
+
+    for(const Leaf* leaf = leftmostLeaf(); leaf && outs; leaf = leaf->nextSubset)
+        for(int i = 0; i < leaf->dataCount; i++)
+            Encoder<T>::write(outs, leaf->data[i]);
+
+    return bool(outs);
+}
+
+//preconditions: ins holds what save wrote, (by a tree of the same T).
+//postconditions: the tree holds the items that were saved. the items are decoded one at a time,
+// straight into bulkLoad (no insert, and no copy of the whole stream). returns false, leaving the
+// tree empty, if the header is not a saved tree's, the saved tree's dups setting is not this tree's
+// (a tree keeps its own, so a Map never loads an MMap's duplicate keys), or the stream ends (or fails)
+// before every item is read.
+template<typename T, int MinDegree>
+bool BPlusTree<T, MinDegree>::load(istream& ins, double fillFactor)
+{
+    uint32_t magic = 0, version = 0;
+    uint8_t dups = 0;
+    uint64_t count = 0;
+    bool ok = Encoder<uint32_t>::read(ins, magic) && Encoder<uint32_t>::read(ins, version)
+           && Encoder<uint8_t>::read(ins, dups) && Encoder<uint64_t>::read(ins, count)
+           && magic == SAVE_MAGIC && version == SAVE_VERSION && (dups != 0) == dupsOk;
+    if(!ok)
+    {
+        clearTree();
+        return false;
+    }
+
+    bulkLoad(DecodeIterator<T>(ins, count, ok), DecodeIterator<T>(), fillFactor);
+    if(!ok || uint64_t(_size) != count)
+    {
+        clearTree();
+        return false;
+    }
+    return true;
+}
+
+//preconditions: 0 < fillFactor <= 1
+//postconditions: returns fillFactor of MAXIMUM (rounded), but at least MINIMUM.
+template<typename T, int MinDegree>
+int BPlusTree<T, MinDegree>::fillTarget(double fillFactor)
+{
+    assert(fillFactor > 0 && fillFactor <= 1);
+
+    int target = int(fillFactor * MAXIMUM + 0.5);
+    return (target < MINIMUM) ? MINIMUM : target;
+}
+
+//preconditions: previous is the leaf before last, previous->dataCount >= MINIMUM.
+//postconditions: if both leaves fit in one, all of last is moved to the end of previous
+// (leaving last empty and unlinked), otherwise items are moved from the end of previous
+// to the front of last until last holds half of them.
+template<typename T, int MinDegree>
+void BPlusTree<T, MinDegree>::balanceLastLeaf(Leaf* previous, Leaf* last)
+{
+    int total = previous->dataCount + last->dataCount;
+    if(total <= MAXIMUM)
+    {
+        mergeArrays(previous->data,previous->dataCount,last->data,last->dataCount);
+        previous->nextSubset = last->nextSubset;
+    }
+    else
+    {
+        while(last->dataCount < total / 2)
+            insertItem(last->data,0,last->dataCount,detachItem(previous->data,previous->dataCount));
+    }
+}
+
+//preconditions: level holds the (non-empty) nodes of one level of the tree, from left to right.
+// every node but the first holds at least MINIMUM data items.
+//postconditions: inner nodes with target+1 children each are built over level (the last two
+// are evened out so that neither is short), then the same is done for the level above,
+// until a single node is left. That node is returned as the root.
+template<typename T, int MinDegree>
+typename BPlusTree<T, MinDegree>::Node* BPlusTree<T, MinDegree>::buildInnerLevels(vector<Node*>& level, int target)
+{
+    const int fanout = target + 1;
+
+    while(level.size() > 1)
+    {
+        int children = level.size();
+        int nodes = (children + fanout - 1) / fanout;
+
+        //the number of children each new node gets.
+        vector<int> counts(nodes,fanout);
+        counts.back() = children - (nodes-1)*fanout;
+        if(nodes > 1 && counts.back() < MINIMUM+1)
+        {
+            int total = counts[nodes-2] + counts.back();
+            if(total <= MAXIMUM+1)
+            {
+                counts.pop_back();
+                counts.back() = total;
+            }
+            else
+            {
+                counts[nodes-2] = total - total/2;
+                counts.back() = total/2;
+            }
+        }
+
+        vector<Node*> parents;
+        int next = 0;
+        for(size_t p = 0; p < counts.size(); p++)
+        {
+            Inner* inner = newInner();
+            for(int c = 0; c < counts[p]; c++, next++)
+            {
+                if(c > 0)
+                    attachItem(inner->data,inner->dataCount,separatorOf(level[next-1],level[next]));
+                attachItem(inner->subset,inner->childCount,level[next]);
+            }
+            inner->refreshPrefixes();
+            parents.push_back(inner);
+        }
+        level.swap(parents);
+    }
+
+    return level[0];
+}
+
+//preconditions: none
+//postconditions: the entry will be inserted into the B+Tree, if its key is not
+// there yet or duplicates are allowed. returns true if it was inserted.
+template <typename T, int MinDegree>
+bool BPlusTree<T, MinDegree>::insert(const T& entry)
+{
+    Position at;
+    return insertEntry(entry,dupsOk,at);
+}
+
+//preconditions: none
+//postconditions: same as insert(const T&), but entry is moved into the tree (if it is inserted).
+template <typename T, int MinDegree>
+bool BPlusTree<T, MinDegree>::insert(T&& entry)
+{
+    Position at;
+    return insertEntry(std::move(entry),dupsOk,at);
+}
+
+//preconditions: none
+//postconditions: an item is constructed from args, then inserted like insert(T&&).
+// returns an iterator to the item inserted (or to the item with its key that kept it out),
+// and true if it was inserted.
+template <typename T, int MinDegree>
+template <typename... Args>
+pair<typename BPlusTree<T, MinDegree>::Iterator, bool> BPlusTree<T, MinDegree>::emplace(Args&&... args)
+{
+    Position at;
+    bool itemInserted = insertEntry(T(std::forward<Args>(args)...),dupsOk,at);
+    return make_pair(Iterator(at.leaf,at.index,this),itemInserted);
+}
+
+//preconditions: T can be constructed from key and arg.
+//postconditions: if an item with key is in the tree, returns an iterator to it and false (arg is left
+// as it is), otherwise T(key, arg) is inserted, and an iterator to it is returned with true.
+// like insert_or_get, duplicates are never inserted, and the tree is only descended once either way.
+template <typename T, int MinDegree>
+template <typename Arg>
+pair<typename BPlusTree<T, MinDegree>::Iterator, bool> BPlusTree<T, MinDegree>::try_emplace(const Key& key, Arg&& arg)
+{
+    Position at;
+    KeyedEntry<Arg> entry = {key, std::forward<Arg>(arg)};
+    bool itemInserted = insertEntry(std::move(entry),false,at);
+    return make_pair(Iterator(at.leaf,at.index,this),itemInserted);
+}
+
+//preconditions: none
+//postconditions: if an item with the key of entry is in the tree, returns an iterator to it
+// and false, otherwise entry is inserted, and an iterator to it is returned with true.
+// duplicates are never inserted, and the tree is only descended once either way.
+template <typename T, int MinDegree>
+pair<typename BPlusTree<T, MinDegree>::Iterator, bool> BPlusTree<T, MinDegree>::insert_or_get(const T& entry)
+{
+    Position at;
+    bool itemInserted = insertEntry(entry,false,at);
+    return make_pair(Iterator(at.leaf,at.index,this),itemInserted);
+}
+
+//preconditions: none
+//postconditions: same as insert_or_get(const T&), but entry is moved into the tree (if it is inserted).
+template <typename T, int MinDegree>
+pair<typename BPlusTree<T, MinDegree>::Iterator, bool> BPlusTree<T, MinDegree>::insert_or_get(T&& entry)
+{
+    Position at;
+    bool itemInserted = insertEntry(std::move(entry),false,at);
+    return make_pair(Iterator(at.leaf,at.index,this),itemInserted);
+}
+
+//preconditions: none
+//postconditions: the entry will be inserted into the B+Tree using looseInsert,
+// (a second copy of its key only if dups) with at set to the item inserted,
+// or to the item found in its place. looseInsert may leave an excess in the root,
+// which will be resolved by:
+// 1) creating a new inner node,
+// 2) making the old root the new node's only child (subset[0])
+// 3) calling fixExcess on this only subset (subset[0])
+// 4) making the new node the root.
+template <typename T, int MinDegree>
+template <typename Entry>
+bool BPlusTree<T, MinDegree>::insertEntry(Entry&& entry, bool dups, Position& at)
+{
+    bool itemInserted = looseInsert(root,std::forward<Entry>(entry),dups,at);
+    if(itemInserted)
+    {
+        _size++;
+        if(root->dataCount == MAXIMUM + 1)
+        {
+            Inner* newRoot = newInner();
+            newRoot->subset[0] = root;
+            newRoot->childCount = 1;
+            fixExcess(newRoot,0,at);
+            root = newRoot;
+        }
+    }
+    return itemInserted;
+}
+
+//preconditions: none
+//postcondition: looseRemove will be called to remove the target from the tree,
+// the tree will be valid when returning, except that the root may have no data
+// and only a single subset - This will be resolved by making that subset the root,
+// and deleting the old root, which shrinks the tree by one level.
+template<typename T, int MinDegree>
+bool BPlusTree<T, MinDegree>::remove(const T& entry)
+{
+    //copy the key, since entry may refer to an item that is about to be removed.
+    const Key key = keyOf(entry);
+
+    bool itemRemoved = looseRemove(root,key);
+    if(itemRemoved)
+    {
+        _size--;
+        if(!root->isLeaf() && root->childCount == 1)
+        {
+            Node* shrinkPtr = root;
+            root = asInner(shrinkPtr)->subset[0];
+            deleteNode(shrinkPtr);
+        }
+    }
     return itemRemoved;
 }
 
-//preconditions: subset[i] must have a shortage.
-//postconditions: the shortaged at subset[i] will be resolved by:
-// 1) if: i+1 < childCount && subset[i+1]->dataCount > MINIMUM, then rotateLeft
-// 2) if: i > 0 && i < childCount && subset[i-1]->dataCount > MINIMUM, then rotateRight
-// 3) if i+1 < childCount, then mergeWithNextSubset
-// 4) otherwise, mergeWithPreviousSubset
-template <typename T>
-void BPlusTree<T>::fixShortage(int i)
+//preconditions: the items of [first, last) can be converted to T.
+//postconditions: the items are copied into a batch, sorted (stably) by key unless they already are,
+// then inserted by insertRun in one walk from the root. a key already in the tree (or repeated in
+// the batch) is inserted only if dups are ok, so the first of them is kept. the new right siblings
+// of the root are put under new roots, as many levels as they need. returns the number inserted.
+template <typename T, int MinDegree>
+template <typename InputIt>
+int BPlusTree<T, MinDegree>::insertBatch(InputIt first, InputIt last)
+{
+    vector<T> batch(first,last);
+    if(!is_sorted(batch.begin(),batch.end(),keyLess))
+        stable_sort(batch.begin(),batch.end(),keyLess);
+    if(batch.empty())
+        return 0;
+
+    vector<Node*> extra;
+    int inserted = insertRun(root,batch,0,batch.size(),extra);
+    _size += inserted;
+
+    while(!extra.empty())
+    {
+        vector<Node*> children(1,root);
+        children.insert(children.end(),extra.begin(),extra.end());
+        extra.clear();
+
+        Inner* newRoot = newInner();
+        splitChildren(newRoot,children,extra);
+        root = newRoot;
+    }
+    return inserted;
+}
+
+//preconditions: the items of [first, last) can be converted to T.
+//postconditions: the keys of the items are sorted, then removed by removeRun in one walk from
+// the root, one item per key (as remove would). a root left with a single subset is replaced
+// by it, as many times as needed. returns the number of items removed.
+template <typename T, int MinDegree>
+template <typename InputIt>
+int BPlusTree<T, MinDegree>::eraseBatch(InputIt first, InputIt last)
+{
+    vector<Key> keys;
+    for(; first != last; ++first)
+    {
+        const T& item = *first;
+        keys.push_back(keyOf(item));
+    }
+    if(!is_sorted(keys.begin(),keys.end()))
+        sort(keys.begin(),keys.end());
+    if(keys.empty())
+        return 0;
+
+    vector<char> used(keys.size(),false);
+    int removed = removeRun(root,keys,used,0,keys.size());
+    _size -= removed;
+
+    while(!root->isLeaf() && root->childCount == 1)
+    {
+        Node* shrinkPtr = root;
+        root = asInner(shrinkPtr)->subset[0];
+        deleteNode(shrinkPtr);
+    }
+    return removed;
+}
+
+//preconditions: batch[first, last) is sorted by key, and belongs in the subtree at node.
+//postconditions: the items of the run are moved into the subtree, unless their key is there
+// (and dups are not ok). the nodes that overflow are split once, into as many nodes as they
+// need, and the new nodes to the right of node are appended to extra, in order:
+//  a leaf merges its items with the run, then spreads them over itself and new leaves.
+//  an inner node hands each subset the part of the run routed to it (where a key equal to
+//  data[i] goes to subset[i+1]), gathering the subsets with their new right siblings,
+//  then spreads them over itself and new inner nodes if there are more than MAXIMUM+1.
+// returns the number of items inserted.
+template <typename T, int MinDegree>
+int BPlusTree<T, MinDegree>::insertRun(Node* node, vector<T>& batch, size_t first, size_t last, vector<Node*>& extra)
+{
+    int inserted = 0;
+
+    if(node->isLeaf())
+    {
+        Leaf* leaf = asLeaf(node);
+        vector<T> items;
+        items.reserve(leaf->dataCount + (last - first));
+
+        int i = 0;
+        size_t b = first;
+        while(i < leaf->dataCount || b < last)
+        {
+            if(b == last || (i < leaf->dataCount && keyOf(leaf->data[i]) < keyOf(batch[b])))
+                items.push_back(std::move(leaf->data[i++]));
+            else if(!dupsOk && ((i < leaf->dataCount && keyOf(batch[b]) == keyOf(leaf->data[i]))
+                                || (!items.empty() && keyOf(batch[b]) == keyOf(items.back()))))
+                b++;
+            else
+            {
+                items.push_back(std::move(batch[b++]));
+                inserted++;
+            }
+        }
+
+        splitItems(leaf,items,extra);
+    }
+    else
+    {
+        Inner* inner = asInner(node);
+        vector<Node*> children;
+        children.reserve(MAXIMUM + 2);
+
+        size_t b = first;
+        for(int i = 0; i < inner->childCount; i++)
+        {
+            size_t end = last;
+            if(i < inner->dataCount)
+            {
+                const Key& bound = inner->data[i];
+                end = std::lower_bound(batch.begin() + b, batch.begin() + last, bound,
+                                       [](const T& item, const Key& key) {return keyOf(item) < key;}) - batch.begin();
+            }
+
+            //the new right siblings of subset[i] are appended right after it.
+            children.push_back(inner->subset[i]);
+            if(end > b)
+                inserted += insertRun(inner->subset[i],batch,b,end,children);
+            b = end;
+        }
+
+        if(children.size() > size_t(inner->childCount))
+            splitChildren(inner,children,extra);
+    }
+
+    return inserted;
+}
+
+//preconditions: items is sorted by key.
+//postconditions: the items are moved into leaf if they fit in MAXIMUM, otherwise they are spread
+// evenly over leaf and as few new leaves as will hold them (each gets at least MINIMUM), which
+// are linked in after leaf and appended to extra.
+template <typename T, int MinDegree>
+void BPlusTree<T, MinDegree>::splitItems(Leaf* leaf, vector<T>& items, vector<Node*>& extra)
+{
+    int total = int(items.size());
+    int pieces = (total > MAXIMUM) ? (total + MAXIMUM - 1) / MAXIMUM : 1;
+
+    Leaf* current = leaf;
+    int next = 0;
+    for(int p = 0; p < pieces; p++)
+    {
+        if(p > 0)
+        {
+            Leaf* right = newLeaf();
+            right->nextSubset = current->nextSubset;
+            right->prevSubset = current;
+            if(right->nextSubset)
+                right->nextSubset->prevSubset = right;
+            current->nextSubset = right;
+            extra.push_back(right);
+            current = right;
+        }
+
+        int count = total / pieces + ((p < total % pieces) ? 1 : 0);
+        current->dataCount = 0;
+        for(int c = 0; c < count; c++)
+            attachItem(current->data,current->dataCount,std::move(items[next++]));
+    }
+}
+
+//preconditions: children holds non-empty subtrees of equal depth, in order.
+//postconditions: the children become the subsets of inner if there are at most MAXIMUM+1 of
+// them, otherwise they are spread evenly over inner and as few new inner nodes as will hold
+// them (each gets at least MINIMUM+1), which are appended to extra. the routing keys are the
+// separators of the subsets on either side of them, (the parent gets the separator between
+// two of the nodes from the nodes themselves).
+template <typename T, int MinDegree>
+void BPlusTree<T, MinDegree>::splitChildren(Inner* inner, vector<Node*>& children, vector<Node*>& extra)
+{
+    int total = int(children.size());
+    int pieces = (total + MAXIMUM) / (MAXIMUM + 1);
+
+    int next = 0;
+    for(int p = 0; p < pieces; p++)
+    {
+        Inner* current = inner;
+        if(p > 0)
+        {
+            current = newInner();
+            extra.push_back(current);
+        }
+
+        int count = total / pieces + ((p < total % pieces) ? 1 : 0);
+        current->dataCount = 0;
+        current->childCount = 0;
+        for(int c = 0; c < count; c++, next++)
+        {
+            if(c > 0)
+                attachItem(current->data,current->dataCount,separatorOf(children[next-1],children[next]));
+            attachItem(current->subset,current->childCount,children[next]);
+        }
+        current->refreshPrefixes();
+    }
+}
+
+//preconditions: keys[first, last) is sorted, and routed to the subtree at node. used marks the keys
+// that have removed an item already.
+//postconditions: one item is removed for each unused key of the run that is found, marking the key:
+//  a leaf drops the items that match, in one pass over the leaf and the run.
+//  an inner node hands each subset the part of the run routed to it (as remove would),
+//  then repairs its subsets once, however many of them lost items. when dups are ok, copies
+//  of data[i] may sit at the end of subset[i] as well as in subset[i+1], so the keys equal
+//  to data[i] are handed to both, and the ones subset[i] used up are skipped by subset[i+1].
+// returns the number of items removed.
+template <typename T, int MinDegree>
+int BPlusTree<T, MinDegree>::removeRun(Node* node, const vector<Key>& keys, vector<char>& used, size_t first, size_t last)
 {
-    bool merge = false;
+    int removed = 0;
 
-    if(i+1 < childCount && subset[i+1]->dataCount > MINIMUM)
-        rotateLeft(i);
-    else if(i > 0 && i < childCount && subset[i-1]->dataCount > MINIMUM)
-        rotateRight(i);
-    else if(i+1 < childCount)
+    if(node->isLeaf())
+    {
+        Leaf* leaf = asLeaf(node);
+        int kept = 0;
+        size_t b = first;
+        for(int i = 0; i < leaf->dataCount; i++)
+        {
+            while(b < last && (used[b] || keys[b] < keyOf(leaf->data[i])))
+                b++;
+            if(b < last && keys[b] == keyOf(leaf->data[i]))
+            {
+                used[b++] = true;
+                removed++;
+            }
+            else
+            {
+                if(kept != i)
+                    leaf->data[kept] = std::move(leaf->data[i]);
+                kept++;
+            }
+        }
+        leaf->dataCount = kept;
+    }
+    else
     {
-        merge = true;
-        mergeWithNextSubset(i);
+        Inner* inner = asInner(node);
+        size_t b = first;
+        for(int i = 0; i < inner->childCount; i++)
+        {
+            size_t end = last;
+            size_t next = last;
+            if(i < inner->dataCount)
+            {
+                next = std::lower_bound(keys.begin() + b, keys.begin() + last, inner->data[i]) - keys.begin();
+                end = dupsOk ? std::upper_bound(keys.begin() + next, keys.begin() + last, inner->data[i]) - keys.begin() : next;
+            }
+            if(end > b)
+                removed += removeRun(inner->subset[i],keys,used,b,end);
+            b = next;
+        }
+
+        if(removed > 0)
+            repairSubsets(inner);
     }
+
+    return removed;
+}
+
+//preconditions: the subsets of node are valid, but for their size: any of them may be short, or empty.
+//postconditions: the subsets are put right in three passes:
+// 1) the subsets left without items are freed (all but one, if every subset is empty),
+// 2) every routing key is reset to the separator of the subsets on either side of it,
+// 3) the short subsets are fixed, with fixShortSubsets.
+// node itself may be left short (or with a single subset), for its parent to fix.
+template <typename T, int MinDegree>
+void BPlusTree<T, MinDegree>::repairSubsets(Inner* node)
+{
+    for(int i = node->childCount - 1; i >= 0 && node->childCount > 1; i--)
+        if(isEmptySubtree(node->subset[i]))
+            dropSubset(node,i);
+
+    for(int j = 0; j < node->dataCount; j++)
+        node->data[j] = separatorOf(node->subset[j],node->subset[j+1]);
+    node->refreshPrefixes();
+
+    fixShortSubsets(node);
+}
+
+//preconditions: the subsets of node are valid but for their size, and below them a node is short only
+// under a node left with a single subset (which repairSubsets could not fix: it had no neighbour).
+//postconditions: from left to right, the short subsets of each subset are fixed first, (the same way),
+// then the subset itself with fixShortage if it is short. a fix merges a subset with a neighbour, or
+// rotates one into it, so a subset that had a single subset has more: the node left short under it can
+// be fixed now. the subset the fix leaves on the left is checked again, as its subsets may be short.
+// node itself may be left short (or with a single subset), for its parent to fix.
+template <typename T, int MinDegree>
+void BPlusTree<T, MinDegree>::fixShortSubsets(Inner* node)
+{
+    for(int i = 0; i < node->childCount; )
+    {
+        Node* subset = node->subset[i];
+        if(!subset->isLeaf() && hasShortSubset(asInner(subset)))
+            fixShortSubsets(asInner(subset));
+
+        if(node->childCount > 1 && subset->dataCount < MINIMUM)
+        {
+            fixShortage(node,i);
+            if(i > 0)
+                i--;
+        }
+        else
+            i++;
+    }
+}
+
+//preconditions: none
+//postconditions: true if a subset of node holds fewer than MINIMUM items.
+template <typename T, int MinDegree>
+bool BPlusTree<T, MinDegree>::hasShortSubset(const Inner* node)
+{
+    for(int i = 0; i < node->childCount; i++)
+        if(node->subset[i]->dataCount < MINIMUM)
+            return true;
+    return false;
+}
+
+//preconditions: subset[i] of node holds no items, and node has another subset.
+//postconditions: the leaf of the subtree is unlinked from the leaves, the subtree is freed,
+// and subset[i] is removed from node along with a routing key next to it.
+template <typename T, int MinDegree>
+void BPlusTree<T, MinDegree>::dropSubset(Inner* node, int i)
+{
+    assert(node->childCount > 1);
+
+    Node* subset = node->subset[i];
+    Node* bottom = subset;
+    while(!bottom->isLeaf())
+        bottom = asInner(bottom)->subset[0];
+
+    Leaf* leaf = asLeaf(bottom);
+    if(leaf->prevSubset)
+        leaf->prevSubset->nextSubset = leaf->nextSubset;
+    if(leaf->nextSubset)
+        leaf->nextSubset->prevSubset = leaf->prevSubset;
+
+    deleteSubtree(subset);
+    deleteItem(node->subset,i,node->childCount);
+    deleteItem(node->data,(i > 0) ? i-1 : 0,node->dataCount);
+    node->refreshPrefixes();
+}
+
+//preconditions: node has been repaired by repairSubsets (if it is an inner node).
+//postconditions: returns true if the subtree at node holds no items. (a repaired inner node
+// with no items has a single subset, so only one path down is followed)
+template <typename T, int MinDegree>
+bool BPlusTree<T, MinDegree>::isEmptySubtree(const Node* node)
+{
+    while(!node->isLeaf())
+    {
+        if(node->childCount > 1)
+            return false;
+        node = asInner(node)->subset[0];
+    }
+    return node->dataCount == 0;
+}
+
+//preconditions: none
+//postconditions: returns a reference to the entry in the tree.
+// if no such entry exists, the entry will be inserted.
+// otherwise, just return the reference to the existing entry.
+template<typename T, int MinDegree>
+T &BPlusTree<T, MinDegree>::get(const T &entry)
+{
+    return *insert_or_get(entry).first;
+}
+
+//preconditions: the entry is in the tree.
+//postconditions: returns a reference to the entry in the tree. (the tree is not changed)
+template<typename T, int MinDegree>
+const T& BPlusTree<T, MinDegree>::get(const T &entry) const
+{
+    const T * temp = find(entry);
+    assert(temp);
+    return *temp;
+}
+
+//preconditions: none
+//postconditions: returns true if the entry exists in the tree, otherwise false.
+template<typename T, int MinDegree>
+bool BPlusTree<T, MinDegree>::contains(const T &entry) const
+{
+    return findKey(keyOf(entry)) != nullptr;
+}
+
+//preconditions: none
+//postconditions: returns a pointer to the entry in the tree if it exists,
+// otherwise returns nullptr.
+template<typename T, int MinDegree>
+T *BPlusTree<T, MinDegree>::find(const T &entry)
+{
+    return findKey(keyOf(entry));
+}
+
+template<typename T, int MinDegree>
+const T *BPlusTree<T, MinDegree>::find(const T &entry) const
+{
+    return findKey(keyOf(entry));
+}
+
+//preconditions: none
+//postconditions: returns a pointer to the item with key if there is one, otherwise nullptr.
+// only reads the tree: a miss inserts nothing, and nothing is allocated.
+template<typename T, int MinDegree>
+const T *BPlusTree<T, MinDegree>::findKey(const Key &key) const
+{
+    int index;
+    const Leaf* leaf = findLeaf(key,index);
+
+    if(index < leaf->dataCount && key == keyOf(leaf->data[index]))
+        return &leaf->data[index];
     else
+        return nullptr;
+}
+
+template<typename T, int MinDegree>
+T *BPlusTree<T, MinDegree>::findKey(const Key &key)
+{
+    return const_cast<T*>(static_cast<const BPlusTree*>(this)->findKey(key));
+}
+
+//preconditions: the items of [first, last) are keys.
+//postconditions: for each key, in order, a pointer to its item (nullptr if it is not there) is written to
+// results, and the end of the results is returned. every leaf is at the same depth, so the descents of a
+// group of keys each take one step per level, together: a step prefetches the child it goes to, and the
+// other keys' steps are made while it arrives. (group prefetching: the steps are all the same length,
+// so the descents can go in lockstep, and need no state machine to interleave them.)
+template<typename T, int MinDegree>
+template<typename ForwardIt, typename OutputIt>
+OutputIt BPlusTree<T, MinDegree>::multiFind(ForwardIt first, ForwardIt last, OutputIt results) const
+{
+    ForwardIt keys[MULTI_FIND_GROUP];
+    const Node* nodes[MULTI_FIND_GROUP];
+    while(first != last)
     {
-        merge = true;
-        mergeWithPreviousSubset(i);
+        int group = 0;
+        for(; group < MULTI_FIND_GROUP && first != last; ++first, group++)
+        {
+            keys[group] = first;
+            nodes[group] = root;
+        }
+
+        while(!nodes[0]->isLeaf())
+            for(int g = 0; g < group; g++)
+                nodes[g] = childOf(asInner(nodes[g]),*keys[g]);
+
+        for(int g = 0; g < group; g++, ++results)
+        {
+            const Leaf* leaf = asLeaf(nodes[g]);
+            const Key& key = *keys[g];
+            int index = leafIndex(leaf,key);
+            *results = (index < leaf->dataCount && key == keyOf(leaf->data[index])) ? &leaf->data[index] : nullptr;
+        }
     }
+    return results;
+}
 
-    //there is no guarentee that data[j] == subset[j+1]->data[0] for all 0 <= j < dataCount
-    // after returning a rotate or merge function if subset[] of this node are leaves.
-    if(subset[0]->isLeaf())
+//preconditions: keys and results hold count items.
+//postconditions: results[i] points to the item of keys[i], or is nullptr if it is not there, (the same
+// item findKey(keys[i]) finds). the keys are taken MULTI_FIND_GROUP at a time: a subtree holds a range of
+// keys, so the deepest node whose subtree holds both the smallest and the largest key of a group holds
+// every key of it. the group descends to that node once, (the part of their paths the keys share, which
+// a clustered batch makes most of the path), then as in multiFind, the keys step down from it together,
+// prefetching the child each goes to. a group whose keys all fall in one leaf shares the one visit of it.
+template<typename T, int MinDegree>
+void BPlusTree<T, MinDegree>::findMany(const Key* keys, size_t count, const T** results) const
+{
+    const Node* nodes[MULTI_FIND_GROUP];
+    for(size_t first = 0; first < count; first += MULTI_FIND_GROUP)
     {
-        for(int j = ((i == 0) ? 0 : i-1); j < dataCount; j++)
-            if(!(data[j] == subset[j+1]->data[0]))
-                data[j] = subset[j+1]->data[0];
+        const Key* group = keys + first;
+        int size = int(min(count - first, size_t(MULTI_FIND_GROUP)));
+        const Key* low = group;
+        const Key* high = group;
+        for(int g = 1; g < size; g++)
+            if(group[g] < *low)
+                low = &group[g];
+            else if(*high < group[g])
+                high = &group[g];
+
+        const Node* shared = root;
+        while(!shared->isLeaf())
+        {
+            const Inner* inner = asInner(shared);
+            int j = childIndex(inner,*low);
+            if(j != childIndex(inner,*high))
+                break;
+            shared = inner->subset[j];
+            prefetchSearch(shared);
+        }
+
+        for(int g = 0; g < size; g++)
+            nodes[g] = shared;
+        while(!nodes[0]->isLeaf())
+            for(int g = 0; g < size; g++)
+                nodes[g] = childOf(asInner(nodes[g]),group[g]);
 
-        //for merge, a subset was deleted, after the above shift
-        // the item that needs to be removed from data[] is now at data[dataCount-1].
-        if(merge)
-            deleteItem(data,dataCount-1,dataCount);
+        for(int g = 0; g < size; g++)
+        {
+            const Leaf* leaf = asLeaf(nodes[g]);
+            int index = leafIndex(leaf,group[g]);
+            results[first + g] = (index < leaf->dataCount && group[g] == keyOf(leaf->data[index])) ? &leaf->data[index] : nullptr;
+        }
     }
 }
 
+//preconditions: none
+//postconditions: returns the total number of data items in the tree.
+template<typename T, int MinDegree>
+int BPlusTree<T, MinDegree>::size() const
+{
+    return _size;
+}
+
+//preconditions: none
+//postconditions: returns true if the root
+// has no children or data items, otherwise false.
+template<typename T, int MinDegree>
+bool BPlusTree<T, MinDegree>::empty() const
+{
+    if(root->isLeaf() && root->dataCount == 0)
+        return true;
+    else
+        return false;
+}
+
+//preconditions: none
+//postconditions: the tree will be printed
+template <typename T, int MinDegree>
+void BPlusTree<T, MinDegree>::printTree(int level, int index, ostream& outs) const
+{
+    printTree(root,level,index,outs);
+}
+
+//preconditions: none
+//postconditions: the subtree at node will be printed
+template <typename T, int MinDegree>
+void BPlusTree<T, MinDegree>::printTree(const Node* node, int level, int index, ostream& outs) const
+{
+    //1. print the last child (if any)
+    //2. print all the rest of the data and children
+    if(node->isLeaf())
+    {
+        outs << setw(level*10) << index << " : "; //buffer the list based on the depth.
+        printArray(asLeaf(node)->data,node->dataCount);
+    }
+    else
+    {
+        const Inner* inner = asInner(node);
+        for(int i = inner->childCount-1; i >= 0; i--)
+            printTree(inner->subset[i],level+1,i,outs);
+
+        outs << setw(level*10) << index << " : ";
+        printArray(inner->data,inner->dataCount);
+    }
+}
+
+//preconditions: none
+//postconditions: the entry will be inserted into the subtree at node,
+// if it does not already exist, or if dups is set. at is set to the item
+// inserted, or to the existing item that kept the entry out.
+// The item will be inserted as follows:
+//  1) find the index of the first item in data[] of this node that is not less than the entry.
+//     if no such entry exists, index will be set to dataCount.
+//  2) check if the entry exists in the tree
+//  3) if this node is a leaf,
+//     a) if the entry was found and dups is not set, return false.
+//     b) otherwise, insert it here.
+//  4) if this node is not a leaf, call looseInsert on the subset the entry belongs in,
+//     (subset[i+1] if the entry was found, since data[i] is the smallest item in it)
+//     and fix an excess in that subset.
+template <typename T, int MinDegree>
+template <typename Entry>
+bool BPlusTree<T, MinDegree>::looseInsert(Node* node, Entry&& entry, bool dups, Position& at)
+{
+    bool itemInserted = false;
+    const Key& key = keyOf(entry);
+
+    if(node->isLeaf())
+    {
+        Leaf* leaf = asLeaf(node);
+        int i = leafIndex(leaf,key);
+        bool found = (i < leaf->dataCount && key == keyOf(leaf->data[i]));
+
+        if(!found || dups)
+        {
+            insertItem<T>(leaf->data,i,leaf->dataCount,std::forward<Entry>(entry));
+            itemInserted = true;
+        }
+        at.leaf = leaf;
+        at.index = i;
+    }
+    else
+    {
+        Inner* inner = asInner(node);
+        int i = innerIndex(inner,key);
+        bool found = (i < inner->dataCount && key == inner->data[i]);
+
+        // if the node is not a leaf, we have not found the data item yet.
+        // howerver, we know it is the leftmost data item in subset[i+1]
+        if(found)
+            i++;
+
+        itemInserted = looseInsert(inner->subset[i],std::forward<Entry>(entry),dups,at);
+        if(itemInserted)
+            fixExcess(inner,i,at);
+    }
+
+    return itemInserted;
+}
+
+//preconditions: subset[i] of node may have an excess, i < childCount, childCount <= maximum+1
+//postconditions: the excess in subset[i] will be resolved as follows:
+//  1) add a new subset at location i+1 of this node
+//  2) split subset[i] (both the subset array and the data array)
+//  and move half into subset[i+1] (this is the subset we created in step 1.)
+//  3) for a leaf, insert the separator of the two leaves (see KeySeparator) into this node's data[],
+//     otherwise, detach the last data item of subset[i] and insert it into this node's data[]
+//Note that this last step may cause this node to have too many items. This is OK. This will be
+//dealt with at the higher recursive level. (my parent will fix it!)
+//if the leaf of at is split, and its item moved to the new leaf, at will follow it.
+template <typename T, int MinDegree>
+void BPlusTree<T, MinDegree>::fixExcess(Inner* node, int i, Position& at)
+{
+    assert(i < node->childCount && node->childCount <= MAXIMUM+1);
+
+    if(node->subset[i]->dataCount > MAXIMUM)
+    {
+        if(node->subset[i]->isLeaf())
+        {
+            Leaf* left = asLeaf(node->subset[i]);
+            Leaf* right = newLeaf();
+            split(left->data,left->dataCount,right->data,right->dataCount,true);
+            insertItem(node->subset,i+1,node->childCount,static_cast<Node*>(right));
+            insertItem(node->data,i,node->dataCount,
+                       KeySeparator<Key>::between(keyOf(left->data[left->dataCount-1]),keyOf(right->data[0])));
+
+            //preserve the 'linked list' when inserting a leaf to the right of i
+            right->nextSubset = left->nextSubset;
+            right->prevSubset = left;
+            if(right->nextSubset)
+                right->nextSubset->prevSubset = right;
+            left->nextSubset = right;
+
+            if(at.leaf == left && at.index >= left->dataCount)
+            {
+                at.leaf = right;
+                at.index -= left->dataCount;
+            }
+        }
+        else
+        {
+            Inner* left = asInner(node->subset[i]);
+            Inner* right = newInner();
+            split(left->data,left->dataCount,right->data,right->dataCount);
+            split(left->subset,left->childCount,right->subset,right->childCount);
+            insertItem(node->subset,i+1,node->childCount,static_cast<Node*>(right));
+            insertItem(node->data,i,node->dataCount,detachItem(left->data,left->dataCount));
+            left->refreshPrefixes();
+            right->refreshPrefixes();
+        }
+        node->refreshPrefixes();
+    }
+}
+
+//preconditions: none
+//postconditions: the key, if it exists, will be removed from the subtree at node.
+// a) leaf && not found target: there is nothing to do
+// b) leaf && found target: just remove the target
+// c) not leaf: recursive call to looseRemove on the subset the key belongs in,
+//    if the key was a routing key, replace it with the new smallest key of that subset,
+//    then fix a shortage in that subset.
+template <typename T, int MinDegree>
+bool BPlusTree<T, MinDegree>::looseRemove(Node* node, const Key& key)
+{
+    bool itemRemoved = false;
+
+    if(!node->isLeaf())
+    {
+        Inner* inner = asInner(node);
+        int index = innerIndex(inner,key);
+        bool found = (index < inner->dataCount && inner->data[index] == key);
+
+        if(found)
+            index++;
+
+        itemRemoved = looseRemove(inner->subset[index],key);
+
+        //data[index-1] was the key removed from subset[index]. with dups, more of it may be left at
+        // the end of subset[index-1], so it is raised to the new smallest key of subset[index] to route
+        // the next search for key there. (an emptied leaf is resynced by fixShortage)
+        if(found && itemRemoved && !(inner->subset[index]->isLeaf() && inner->subset[index]->dataCount == 0))
+        {
+            inner->data[index-1] = getSmallest(inner->subset[index]);
+            inner->refreshPrefixes();
+        }
+
+        if(inner->subset[index]->dataCount < MINIMUM)
+            fixShortage(inner,index);
+    }
+    else
+    {
+        Leaf* leaf = asLeaf(node);
+        int index = leafIndex(leaf,key);
+
+        if(index < leaf->dataCount && keyOf(leaf->data[index]) == key)
+        {
+            deleteItem(leaf->data,index,leaf->dataCount);
+            itemRemoved = true;
+        }
+    }
+
+    return itemRemoved;
+}
+
+//preconditions: subset[i] of node must have a shortage.
+//postconditions: the shortaged at subset[i] will be resolved by:
+// 1) if: i+1 < childCount && subset[i+1]->dataCount > MINIMUM, then rotateLeft
+// 2) if: i > 0 && subset[i-1]->dataCount > MINIMUM, then rotateRight
+// 3) if i+1 < childCount, then mergeWithNextSubset
+// 4) otherwise, mergeWithPreviousSubset
+template <typename T, int MinDegree>
+void BPlusTree<T, MinDegree>::fixShortage(Inner* node, int i)
+{
+    if(i+1 < node->childCount && node->subset[i+1]->dataCount > MINIMUM)
+        rotateLeft(node,i);
+    else if(i > 0 && node->subset[i-1]->dataCount > MINIMUM)
+        rotateRight(node,i);
+    else if(i+1 < node->childCount)
+        mergeWithNextSubset(node,i);
+    else
+        mergeWithPreviousSubset(node,i);
+
+    //when the subsets are leaves, the items that moved (or the item that was removed)
+    // may have moved the bounds of the subsets on either side of data[i-1] and data[i].
+    if(node->subset[0]->isLeaf())
+    {
+        for(int j = ((i == 0) ? 0 : i-1); j <= i && j < node->dataCount; j++)
+            node->data[j] = separatorOf(node->subset[j],node->subset[j+1]);
+    }
+    node->refreshPrefixes();
+}
+
 //preconditions: (i + 1 < childCount)
 //postconditions: The shortage in subset[i] will be resolved by the following:
 //              A) non-leaf case:
@@ -818,80 +2153,104 @@ void BPlusTree<T>::fixShortage(int i)
 //                3) delete subset[i]
 //              B) leaf-case:
 //                1) transfer subset[i+1]->data[] to the end of subset[i]->data[]
-//                2) bypass and delete subset[i+1] by making subset[i]->next point to subset[i+1]->next
-//                   then delete subset[i+1] from subset and deallocate it.
-template <typename T>
-void BPlusTree<T>::mergeWithNextSubset(int i)
+//                2) bypass subset[i+1] by making subset[i]->next point to subset[i+1]->next,
+//                   and point the prev of the leaf after it back at subset[i]
+//                3) remove data[i], then delete subset[i+1] from subset and deallocate it.
+template <typename T, int MinDegree>
+void BPlusTree<T, MinDegree>::mergeWithNextSubset(Inner* node, int i)
 {
-    assert(childCount > i+1);
+    assert(node->childCount > i+1);
 
-    if(subset[i]->isLeaf())
+    if(node->subset[i]->isLeaf())
     {
-        mergeArrays(subset[i]->data,subset[i]->dataCount,subset[i+1]->data,subset[i+1]->dataCount);
-        subset[i]->nextSubset = subset[i+1]->nextSubset;
-        delete deleteItem(subset,i+1,childCount);
+        Leaf* left = asLeaf(node->subset[i]);
+        Leaf* right = asLeaf(node->subset[i+1]);
+        mergeArrays(left->data,left->dataCount,right->data,right->dataCount);
+        left->nextSubset = right->nextSubset;
+        if(left->nextSubset)
+            left->nextSubset->prevSubset = left;
+        deleteItem(node->data,i,node->dataCount);
+        deleteNode(deleteItem(node->subset,i+1,node->childCount));
     }
     else
     {
-        insertItem(subset[i+1]->data,0,subset[i+1]->dataCount,deleteItem(data,i,dataCount));
-        mergeFront(subset[i+1]->data,subset[i+1]->dataCount,subset[i]->data,subset[i]->dataCount);
-        mergeFront(subset[i+1]->subset,subset[i+1]->childCount,subset[i]->subset,subset[i]->childCount);
-        delete deleteItem(subset,i,childCount);
+        Inner* left = asInner(node->subset[i]);
+        Inner* right = asInner(node->subset[i+1]);
+        insertItem(right->data,0,right->dataCount,deleteItem(node->data,i,node->dataCount));
+        mergeFront(right->data,right->dataCount,left->data,left->dataCount);
+        mergeFront(right->subset,right->childCount,left->subset,left->childCount);
+        right->refreshPrefixes();
+        deleteNode(deleteItem(node->subset,i,node->childCount));
     }
 }
 
 //preconditions: (i > 0)
 //postconditions: The shortage in subset[i] will be resolved by the following:
 //              A) non-leaf case:
-//                1) transfer all data and subsets from subset[i] to end of subset[i-1]
+//                1) transfer data[i-1] to the end of subset[i-1]->data
 //                2) transfer all data and subsets from subset[i] to end of subset[i-1]
 //                3) delete subset[i]
 //              B) leaf-case:
 //                1) transfer subset[i]->data[] to the end of subset[i-1]->data[]
-//                2) bypass and delete subset[i-1] by making subset[i-1]->next point to subset[i]->next
-//                   then delete subset[i] from subset and deallocate it.
-template <typename T>
-void BPlusTree<T>::mergeWithPreviousSubset(int i)
+//                2) bypass subset[i] by making subset[i-1]->next point to subset[i]->next,
+//                   and point the prev of the leaf after it back at subset[i-1]
+//                3) remove data[i-1], then delete subset[i] from subset and deallocate it.
+template <typename T, int MinDegree>
+void BPlusTree<T, MinDegree>::mergeWithPreviousSubset(Inner* node, int i)
 {
     assert(i > 0);
 
-    if(subset[i]->isLeaf())
+    if(node->subset[i]->isLeaf())
     {
-        mergeArrays(subset[i-1]->data,subset[i-1]->dataCount,subset[i]->data,subset[i]->dataCount);
-        subset[i-1]->nextSubset = subset[i]->nextSubset;
-        delete deleteItem(subset,i,childCount);
+        Leaf* left = asLeaf(node->subset[i-1]);
+        Leaf* right = asLeaf(node->subset[i]);
+        mergeArrays(left->data,left->dataCount,right->data,right->dataCount);
+        left->nextSubset = right->nextSubset;
+        if(left->nextSubset)
+            left->nextSubset->prevSubset = left;
+        deleteItem(node->data,i-1,node->dataCount);
+        deleteNode(deleteItem(node->subset,i,node->childCount));
     }
     else
     {
-        attachItem(subset[i-1]->data,subset[i-1]->dataCount,deleteItem(data,i-1,dataCount));
-        mergeArrays(subset[i-1]->data,subset[i-1]->dataCount,subset[i]->data,subset[i]->dataCount);
-        mergeArrays(subset[i-1]->subset,subset[i-1]->childCount,subset[i]->subset,subset[i]->childCount);
-        delete deleteItem(subset,i,childCount);
+        Inner* left = asInner(node->subset[i-1]);
+        Inner* right = asInner(node->subset[i]);
+        attachItem(left->data,left->dataCount,deleteItem(node->data,i-1,node->dataCount));
+        mergeArrays(left->data,left->dataCount,right->data,right->dataCount);
+        mergeArrays(left->subset,left->childCount,right->subset,right->childCount);
+        left->refreshPrefixes();
+        deleteNode(deleteItem(node->subset,i,node->childCount));
     }
 }
 
 //preconditions: (dataCount > i) && (subset[i]->dataCount < MAXIMUM+1) && (subset[i+1]->dataCount > MINIMUM)
 //postconditions: The shortage in subset[i] will be resolved by the following:
 //              A) non-leaf case:
-//                1) transfer data[i+1] to end of subset[i]->data
+//                1) transfer data[i] to end of subset[i]->data
 //                2) transfer first item from subset[i+1]->data to data[i].
-//                3) If subset[i+1] has children, transfer subset[i+1]->subset[0] child to end of subset[i]->subset
+//                3) transfer subset[i+1]->subset[0] child to end of subset[i]->subset
 //              B) leaf case:
 //                1) transfer the first item in subset[i+1]->data to the end of subset[i]->data
-template <typename T>
-void BPlusTree<T>::rotateLeft(int i)
+template <typename T, int MinDegree>
+void BPlusTree<T, MinDegree>::rotateLeft(Inner* node, int i)
 {
-    assert((dataCount > i) && (subset[i]->dataCount < MAXIMUM+1) && (subset[i+1]->dataCount > MINIMUM));
+    assert((node->dataCount > i) && (node->subset[i]->dataCount < MAXIMUM+1) && (node->subset[i+1]->dataCount > MINIMUM));
 
-    if(subset[i]->isLeaf())
-        attachItem(subset[i]->data,subset[i]->dataCount, deleteItem(subset[i+1]->data,0,subset[i+1]->dataCount));
+    if(node->subset[i]->isLeaf())
+    {
+        Leaf* left = asLeaf(node->subset[i]);
+        Leaf* right = asLeaf(node->subset[i+1]);
+        attachItem(left->data,left->dataCount,deleteItem(right->data,0,right->dataCount));
+    }
     else
     {
-        attachItem(subset[i]->data,subset[i]->dataCount,deleteItem(data,i,dataCount));
-        insertItem(data,i,dataCount,deleteItem(subset[i+1]->data,0,subset[i+1]->dataCount));
-
-        if(subset[i+1]->childCount > 0)
-            attachItem(subset[i]->subset,subset[i]->childCount,deleteItem(subset[i+1]->subset,0,subset[i+1]->childCount));
+        Inner* left = asInner(node->subset[i]);
+        Inner* right = asInner(node->subset[i+1]);
+        attachItem(left->data,left->dataCount,deleteItem(node->data,i,node->dataCount));
+        insertItem(node->data,i,node->dataCount,deleteItem(right->data,0,right->dataCount));
+        attachItem(left->subset,left->childCount,deleteItem(right->subset,0,right->childCount));
+        left->refreshPrefixes();
+        right->refreshPrefixes();
     }
 }
 
@@ -900,22 +2259,29 @@ void BPlusTree<T>::rotateLeft(int i)
 //              A) non-leaf case:
 //                1) transfer data[i-1] to front of subset[i]->data
 //                2) transfer final item from subset[i-1]->data to data[i-1].
-//                3) If subset[i-1] has children, transfer final child to front of subset[i]->subset
+//                3) transfer final child of subset[i-1] to front of subset[i]->subset
 //              B) leaf case:
 //                1) transfer the last item in subset[i-1]->data to the front of subset[i]->data
-template <typename T>
-void BPlusTree<T>::rotateRight(int i)
+template <typename T, int MinDegree>
+void BPlusTree<T, MinDegree>::rotateRight(Inner* node, int i)
 {
-    assert((i > 0) && (subset[i]->dataCount < MAXIMUM+1) && (subset[i-1]->dataCount > MINIMUM));
+    assert((i > 0) && (node->subset[i]->dataCount < MAXIMUM+1) && (node->subset[i-1]->dataCount > MINIMUM));
 
-    if(subset[i]->isLeaf())
-        insertItem(subset[i]->data,0,subset[i]->dataCount,detachItem(subset[i-1]->data,subset[i-1]->dataCount));
+    if(node->subset[i]->isLeaf())
+    {
+        Leaf* left = asLeaf(node->subset[i-1]);
+        Leaf* right = asLeaf(node->subset[i]);
+        insertItem(right->data,0,right->dataCount,detachItem(left->data,left->dataCount));
+    }
     else
     {
-        insertItem(subset[i]->data,0,subset[i]->dataCount, deleteItem(data,i-1,dataCount));
-        insertItem(data,i-1,dataCount, detachItem(subset[i-1]->data,subset[i-1]->dataCount));
-        if(subset[i-1]->childCount > 0)
-            insertItem(subset[i]->subset,0,subset[i]->childCount,detachItem(subset[i-1]->subset,subset[i-1]->childCount));
+        Inner* left = asInner(node->subset[i-1]);
+        Inner* right = asInner(node->subset[i]);
+        insertItem(right->data,0,right->dataCount, deleteItem(node->data,i-1,node->dataCount));
+        insertItem(node->data,i-1,node->dataCount, detachItem(left->data,left->dataCount));
+        insertItem(right->subset,0,right->childCount,detachItem(left->subset,left->childCount));
+        left->refreshPrefixes();
+        right->refreshPrefixes();
     }
 }
 
@@ -0,0 +1,304 @@
+#ifndef BUFFERPOOL_H
+#define BUFFERPOOL_H
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <memory>
+#include <unordered_map>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <cassert>
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+using namespace std;
+
+//the counters of a BufferPool.
+struct BufferStats
+{
+    size_t hits;                                   //pins of a page that was in a frame
+    size_t misses;                                 //pins of a page that was not (read, or new)
+    size_t reads;                                  //pages read from the file
+    size_t writes;                                 //dirty pages written back to the file
+
+    BufferStats(): hits(0), misses(0), reads(0), writes(0) {}
+    double hitRate() const {return (hits + misses) ? double(hits) / double(hits + misses) : 1.0;}
+};
+
+//BufferPool keeps the pages of a file in a fixed number of frames (its byte budget divided by the
+// page size). A page is pinned while it is used, and can only be evicted when no one pins it.
+// When a page that is not in a frame is pinned, a frame is chosen by CLOCK: the hand sweeps the
+// frames, skipping the pinned ones and giving the recently used ones (their reference bit set)
+// a second chance by clearing the bit, and takes the first frame that was not used since the last
+// sweep. A dirty page is written back to the file before its frame is reused (and on flush). If it
+// cannot be written, it keeps its frame (still dirty, so that flush tries again and fails).
+// When no frame can be taken (all are pinned, or hold pages that cannot be written), a frame is added:
+// the pool grows past its budget rather than fail a pin, and keeps the frames it added until close.
+// Pages are numbered from 0, page id is at offset id * pageSize of the file.
+// Not thread safe.
+class BufferPool
+{
+public:
+    BufferPool(): fd(-1), pageSize(0), pages(0), hand(0) {}
+    ~BufferPool() {close();}
+
+    //open (or create) the file at path, with frames for budgetBytes of pages (at least one).
+    bool open(const string& path, size_t budgetBytes, size_t pageSize);
+    bool close();                                  //flush, and close the file
+    bool isOpen() const {return fd >= 0;}
+
+    char* pin(uint64_t id);                        //the bytes of page id, pinned until unpin(id)
+    char* pinNew(uint64_t id);                     //pin page id, zeroed instead of read (a new page)
+    void unpin(uint64_t id, bool dirty);           //unpin id, which was written if dirty
+
+    bool flush();                                  //write every dirty page back, and sync the file
+    uint64_t pageCount() const {return pages;}     //one past the highest page id in the file (or pinned new)
+    size_t frameCount() const {return frames.size();}      //the frames of the budget, and any added since
+    size_t pageBytes() const {return pageSize;}
+
+    const BufferStats& stats() const {return counters;}
+    void resetStats() {counters = BufferStats();}
+
+private:
+    struct Frame
+    {
+        uint64_t id;
+        int pins;
+        bool used;                                 //the frame holds a page
+        bool dirty;
+        bool referenced;                           //CLOCK's second chance bit
+
+        Frame(): id(0), pins(0), used(false), dirty(false), referenced(false) {}
+    };
+
+    int fd;
+    size_t pageSize;
+    uint64_t pages;
+    vector<unique_ptr<char[]> > memory;            //the frames' bytes, (each apart, so adding a frame moves none)
+    vector<Frame> frames;
+    unordered_map<uint64_t, size_t> table;         //page id -> frame
+    size_t hand;
+    BufferStats counters;
+
+    char* frameBytes(size_t f) {return memory[f].get();}
+    char* pinPage(uint64_t id, bool fresh);
+    size_t victim();                               //choose a frame for a page by CLOCK, writing back its page
+    size_t addFrame();
+    bool writeBack(size_t f);                      //write frame f's page to the file
+
+    BufferPool(const BufferPool&);
+    BufferPool& operator =(const BufferPool&);
+};
+
+//PageGuard pins a page for its lifetime, (and unpins it as dirty if markDirty was called).
+class PageGuard
+{
+public:
+    PageGuard(BufferPool& _pool, uint64_t _id, bool fresh = false):
+        pool(_pool), pageId(_id), bytes(fresh ? _pool.pinNew(_id) : _pool.pin(_id)), dirty(fresh) {}
+    ~PageGuard() {pool.unpin(pageId, dirty);}
+
+    template <typename Page>
+    Page* as() {return reinterpret_cast<Page*>(bytes);}
+    void markDirty() {dirty = true;}
+    uint64_t id() const {return pageId;}
+
+private:
+    BufferPool& pool;
+    uint64_t pageId;
+    char* bytes;
+    bool dirty;
+
+    PageGuard(const PageGuard&);
+    PageGuard& operator =(const PageGuard&);
+};
+
+//preconditions: the pool is not open, pageSize > 0.
+//postconditions: the file at path is opened (created if it is not there), and the frames allocated.
+// returns false if the file cannot be opened.
+inline bool BufferPool::open(const string& path, size_t budgetBytes, size_t _pageSize)
+{
+    assert(!isOpen() && _pageSize > 0);
+    fd = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+    if(fd < 0)
+        return false;
+
+    struct stat info;
+    if(fstat(fd, &info) != 0)
+    {
+        ::close(fd);
+        fd = -1;
+        return false;
+    }
+
+    pageSize = _pageSize;
+    pages = uint64_t(info.st_size) / pageSize;
+    size_t count = budgetBytes / pageSize;
+    memory.clear();
+    frames.clear();
+    table.clear();
+    while(frames.size() < count || frames.empty())
+        addFrame();
+    hand = 0;
+    counters = BufferStats();
+    return true;
+}
+
+//preconditions: no page is pinned.
+//postconditions: the dirty pages are written back, and the file is closed. returns false if a write failed.
+inline bool BufferPool::close()
+{
+    if(!isOpen())
+        return true;
+    bool ok = flush();
+    ::close(fd);
+    fd = -1;
+    memory.clear();
+    frames.clear();
+    table.clear();
+    return ok;
+}
+
+inline char* BufferPool::pin(uint64_t id)
+{
+    return pinPage(id, false);
+}
+
+inline char* BufferPool::pinNew(uint64_t id)
+{
+    return pinPage(id, true);
+}
+
+//preconditions: the pool is open.
+//postconditions: page id is in a frame (read from the file, or zeroed if fresh or past the end of
+// the file), its pin count and reference bit are set, and its bytes are returned.
+inline char* BufferPool::pinPage(uint64_t id, bool fresh)
+{
+    unordered_map<uint64_t, size_t>::iterator found = table.find(id);
+    if(found != table.end())
+    {
+        Frame& frame = frames[found->second];
+        frame.pins++;
+        frame.referenced = true;
+        counters.hits++;
+        char* bytes = frameBytes(found->second);
+        if(fresh)
+        {
+            memset(bytes, 0, pageSize);
+            frame.dirty = true;
+        }
+        return bytes;
+    }
+
+    counters.misses++;
+    size_t f = victim();
+    Frame& frame = frames[f];
+    if(frame.used)
+        table.erase(frame.id);
+
+    char* bytes = frameBytes(f);
+    size_t filled = 0;
+    if(!fresh && id < pages)
+    {
+        ssize_t n = pread(fd, bytes, pageSize, off_t(id * pageSize));
+        filled = (n > 0) ? size_t(n) : 0;
+        counters.reads++;
+    }
+    memset(bytes + filled, 0, pageSize - filled);
+
+    frame.id = id;
+    frame.pins = 1;
+    frame.used = true;
+    frame.dirty = fresh;
+    frame.referenced = true;
+    table[id] = f;
+    if(id >= pages)
+        pages = id + 1;
+    return bytes;
+}
+
+//preconditions: page id is pinned.
+//postconditions: its pin count drops by one, and if dirty, it will be written back before it is evicted.
+inline void BufferPool::unpin(uint64_t id, bool dirty)
+{
+    unordered_map<uint64_t, size_t>::iterator found = table.find(id);
+    assert(found != table.end() && frames[found->second].pins > 0);
+    Frame& frame = frames[found->second];
+    frame.pins--;
+    if(dirty)
+        frame.dirty = true;
+}
+
+//preconditions: the pool is open.
+//postconditions: returns the first unused frame, or else the first frame the hand reaches that is
+// not pinned and was not referenced since the hand last passed it (clearing the bits it passes),
+// and whose page is clean, or was written back. (a page that cannot be written is passed over.)
+// if two sweeps find no such frame, a new frame is returned.
+inline size_t BufferPool::victim()
+{
+    for(size_t sweeps = 0; sweeps <= 2 * frames.size(); sweeps++)
+    {
+        Frame& frame = frames[hand];
+        size_t f = hand;
+        hand = (hand + 1) % frames.size();
+
+        if(!frame.used)
+            return f;
+        if(frame.pins > 0)
+            continue;
+        if(frame.referenced)
+            frame.referenced = false;
+        else if(!frame.dirty || writeBack(f))
+            return f;
+    }
+    return addFrame();
+}
+
+//preconditions: pageSize > 0
+//postconditions: an unused frame of zeroed bytes is added to the pool, and its index returned.
+inline size_t BufferPool::addFrame()
+{
+    memory.push_back(unique_ptr<char[]>(new char[pageSize]()));
+    frames.push_back(Frame());
+    return frames.size() - 1;
+}
+
+//preconditions: frame f holds a page.
+//postconditions: the page is written to its place in the file, and is clean.
+inline bool BufferPool::writeBack(size_t f)
+{
+    Frame& frame = frames[f];
+    const char* bytes = frameBytes(f);
+    size_t written = 0;
+    while(written < pageSize)
+    {
+        ssize_t n = pwrite(fd, bytes + written, pageSize - written, off_t(frame.id * pageSize + written));
+        if(n < 0 && errno == EINTR)
+            continue;
+        if(n <= 0)
+            return false;
+        written += size_t(n);
+    }
+    frame.dirty = false;
+    counters.writes++;
+    return true;
+}
+
+//preconditions: none
+//postconditions: every dirty page is written back, and the file is synced. returns false if a write
+// failed, (the page stays dirty, to be written by the next flush).
+inline bool BufferPool::flush()
+{
+    if(!isOpen())
+        return true;
+    bool ok = true;
+    for(size_t f = 0; f < frames.size(); f++)
+        if(frames[f].used && frames[f].dirty)
+            ok = writeBack(f) && ok;
+    return (fdatasync(fd) == 0) && ok;
+}
+
+#endif // BUFFERPOOL_H
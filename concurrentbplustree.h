@@ -0,0 +1,1131 @@
+#ifndef CONCURRENTBPLUSTREE_H
+#define CONCURRENTBPLUSTREE_H
+
+#include <atomic>
+#include <vector>
+#include <type_traits>
+#include <cstdint>
+#include "bplustree.h"
+#include "versionlock.h"
+#include "epoch.h"
+using namespace std;
+
+//ConcurrentBPlusTree is a B+Tree of unique keys that any number of threads may use at once.
+// Every node carries a VersionLock.
+//  readers: descend with optimistic lock coupling, they lock nothing, and restart from the
+//           root if a node they passed through changed under them. when T or its Key are not
+//           trivially copyable, a torn read is not harmless, so they hold each node shared
+//           (and its parent only until the child is held) instead.
+//  writers: descend the same way, and lock only the leaf, if the leaf can take the change
+//           without splitting, merging or changing a routing key. otherwise they start over
+//           and crab down: every node on the path is locked, and the nodes above a child that
+//           is safe (that cannot pass a split or merge up) are released, so that fixExcess and
+//           fixShortage run on nodes this writer holds, and on siblings it locks under them.
+// A node unlinked by a merge (or the old root) may still be read by an optimistic reader,
+// so it is not freed at once: every operation runs inside an epoch (see EpochManager), and the
+// node is retired, and freed once every thread that could have reached it has left.
+// Items are copied out (find, scan) instead of handed out by reference or by iterator,
+// since another thread may move or remove the item right after the leaf is released.
+template <typename T, int MinDegree = DefaultMinDegree<T>::value>
+class ConcurrentBPlusTree
+{
+public:
+    typedef typename KeyOf<T>::type Key;
+
+    //true if readers descend optimistically, false if they hold the nodes shared. holding a node shared is an
+    // atomic write to its lock word, so with string keys (or any T or Key that is not trivially copyable)
+    // readers write to the cache line of every node they pass, and do not scale like optimistic readers.
+    // an optimistic copy of such a key is not safe: a writer may free the buffer of a string (which is
+    // not retired through the epochs) while a reader follows its pointer.
+    static const bool OPTIMISTIC_READS = is_trivially_copyable<T>::value && is_trivially_copyable<Key>::value;
+
+    ConcurrentBPlusTree();
+    ~ConcurrentBPlusTree();
+
+    bool insert(const T& entry);                //insert entry, unless its key is already there
+
+    //insert entry unless its key is already there, then call update on the item with the key,
+    // while its leaf is locked. returns true if entry was inserted.
+    template <typename Fn>
+    bool upsert(const T& entry, Fn update);
+    bool remove(const T& entry);                //remove the item with the key of entry
+
+    bool find(const T& entry, T& item) const;   //copy the item with the key of entry into item, false if not there
+    bool contains(const T& entry) const;        //true if an item with the key of entry is in the tree
+
+    //call visit on copies of the items with keys not less than the key of from,
+    // in order, up to maxItems of them. returns the number of items visited.
+    template <typename Fn>
+    int scan(const T& from, int maxItems, Fn visit) const;
+
+    int size() const;                           //count the number of elements in the tree
+    bool empty() const;                         //true if the tree is empty
+    size_t retiredNodes() const;                //the number of unlinked nodes waiting to be freed
+    size_t reclaim();                           //free the retired nodes that no thread can reach, return how many
+
+    bool isValid() const;                       //verify the B+Tree rules, while no other thread uses the tree
+
+private:
+    static_assert(MinDegree >= 1, "ConcurrentBPlusTree requires a MinDegree of at least 1");
+
+    static const int MINIMUM = MinDegree;
+    static const int MAXIMUM = 2 * MINIMUM;
+    static const int MAX_HEIGHT = 64;              //a tree of MinDegree 1 this tall would hold 2^63 items
+
+    struct Node
+    {
+        mutable VersionLock lock;
+        bool leaf;                                 //true if this node is a Leaf
+        bool obsolete;                             //set by the writer that unlinks the node, while it holds it
+        int dataCount;                             //number of data elements
+        int childCount;                            //number of children (always 0 in a leaf)
+
+        Node(bool isLeafNode): leaf(isLeafNode), obsolete(false), dataCount(0), childCount(0) {}
+        bool isLeaf() const {return leaf;}
+    };
+
+    //the subsets past childCount may be read by an optimistic reader before it
+    // restarts, so they start out null, and are cleared when they are vacated (see clearVacated),
+    // so that they never point at a node that was retired before the reader entered.
+    struct Inner : Node
+    {
+        Key data[MAXIMUM + 1];                     //holds the routing keys
+        Node* subset[MAXIMUM + 2];                 //subtrees
+
+        Inner(): Node(false)
+        {
+            for(int i = 0; i < MAXIMUM + 2; i++)
+                subset[i] = nullptr;
+        }
+    };
+
+    struct Leaf : Node
+    {
+        T data[MAXIMUM + 1];                       //holds the items
+
+        Leaf(): Node(true) {}
+    };
+
+    //the nodes a writer holds while it crabs down: the inner nodes of the path it still
+    // holds (top first) with the subset it took, and whether the key was the routing key
+    // in front of it, then every node it has locked (the path and the siblings), in order.
+    struct Path
+    {
+        Inner* inner[MAX_HEIGHT];
+        int index[MAX_HEIGHT];
+        bool found[MAX_HEIGHT];
+        int depth;
+
+        Node* locked[3 * MAX_HEIGHT];
+        int lockedCount;
+        bool rootLocked;                           //true while rootLock is held
+    };
+
+    //for insert(), which leaves the item as it found it.
+    struct KeepItem
+    {
+        void operator()(T&) const {}
+    };
+
+    //the smallest routing key to the right of a leaf's subtree (the first key of the next leaf), if any.
+    struct Fence
+    {
+        bool exists;
+        Key key;
+    };
+
+    atomic<Node*> root;                            //never null, an empty tree is a single empty leaf
+    mutable VersionLock rootLock;                  //guards the root pointer
+    atomic<size_t> _size;
+
+    mutable EpochManager epochs;                   //holds the retired nodes until they can be freed
+
+    static Inner* asInner(Node* node) {return static_cast<Inner*>(node);}
+    static const Inner* asInner(const Node* node) {return static_cast<const Inner*>(node);}
+    static Leaf* asLeaf(Node* node) {return static_cast<Leaf*>(node);}
+    static const Leaf* asLeaf(const Node* node) {return static_cast<const Leaf*>(node);}
+    static const Key& keyOf(const T& item) {return KeyOf<T>::key(item);}
+
+    static int innerIndex(const Inner* inner, const Key& key); //index of the first routing key in inner that is not less than key
+    static int childIndex(const Inner* inner, const Key& key); //the subset of inner that key belongs in
+    static int leafIndex(const Leaf* leaf, const Key& key);    //index of the first item in leaf that is not less than key
+    static int leafIndex(const Leaf* leaf, const Key& key, true_type);
+    static int leafIndex(const Leaf* leaf, const Key& key, false_type);
+    static const Key& getSmallest(const Node* node);           //get the smallest key in this subtree.
+
+    static void deleteNode(Node* node);            //free a single node of either kind
+    static void deleteSubtree(Node* node);         //free node and everything below it
+    static void freeRetired(void* node) {deleteNode(static_cast<Node*>(node));} //the Deleter of retired nodes
+    static void clearVacated(Inner* inner);        //null the subsets past childCount that still point at nodes
+
+    //readers
+    bool lookup(const Key& key, T* item) const;    //find key, copying its item into item (if not null)
+    bool optimisticLookup(const Key& key, T* item, bool& found) const; //false if the reader must restart
+    bool sharedLookup(const Key& key, T* item) const;
+    bool optimisticDescend(const Key& key, const Node*& node, uint64_t& version, bool& isRoot, Fence* fence = nullptr) const;
+    const Leaf* sharedDescend(const Key& key, Fence* fence) const; //the leaf of key, held shared
+    int copyFrom(const Leaf* leaf, const Key& key, T items[]) const; //copy the items not less than key
+
+    //writers
+    Leaf* lockLeaf(const Key& key, bool& isRoot);  //the leaf of key, locked exclusively, without locking the path
+    Leaf* crabDown(const Key& key, Path& path, bool inserting); //the leaf of key, locking the path as needed
+    static bool isSafe(const Node* node, bool inserting, bool isRoot); //true if node will not pass a change up
+    void lockSibling(Path& path, Node* node);      //lock a sibling for fixShortage, releasing it with the path
+    void releaseAncestors(Path& path);             //release everything but the node locked last
+    void releasePath(Path& path, bool modified);   //release every node of path, retiring the unlinked ones
+
+    template <typename Fn>
+    bool crabInsert(const T& entry, Fn& update);   //insert with the path locked
+    bool crabRemove(const Key& key);               //remove with the path locked
+
+    static void fixExcess(Inner* node, int i);     //fix excess of data elements in child i
+    void fixShortage(Inner* node, int i, Path& path); //fix shortage of data elements in child i
+
+    static void rotateLeft(Inner* node, int i);    //transfer one element LEFT from child i+1
+    static void rotateRight(Inner* node, int i);   //transfer one element RIGHT from child i-1
+    static void mergeWithNextSubset(Inner* node, int i); //merge subset i with subset i+1
+    static void mergeWithPreviousSubset(Inner* node, int i);
+
+    bool verifyNode(const Node* node, int depth, int& leafDepth,
+                    const Key* low, const Key* high, size_t& items) const; //used by isValid
+
+    //the tree is shared by its threads, it cannot be copied.
+    ConcurrentBPlusTree(const ConcurrentBPlusTree&);
+    ConcurrentBPlusTree& operator =(const ConcurrentBPlusTree&);
+};
+
+//preconditions: none
+//postconditions: an empty tree, made of a single empty leaf.
+template <typename T, int MinDegree>
+ConcurrentBPlusTree<T, MinDegree>::ConcurrentBPlusTree(): root(new Leaf), _size(0)
+{
+}
+
+//preconditions: no other thread uses the tree.
+//postconditions: every node of the tree is freed, (the retired nodes are freed by epochs).
+template <typename T, int MinDegree>
+ConcurrentBPlusTree<T, MinDegree>::~ConcurrentBPlusTree()
+{
+    deleteSubtree(root.load());
+}
+
+//preconditions: none
+//postconditions: same as upsert(entry), leaving the item that was there as it is.
+template <typename T, int MinDegree>
+bool ConcurrentBPlusTree<T, MinDegree>::insert(const T& entry)
+{
+    return upsert(entry,KeepItem());
+}
+
+//preconditions: update can be called on a T&, and does not change the key of the item.
+//postconditions: if the key of entry is not in the tree, entry is inserted. then update is
+// called on the item with the key, while its leaf is locked. returns true if entry was inserted.
+// the leaf is locked alone when it has room for entry, otherwise the path is crabbed.
+template <typename T, int MinDegree>
+template <typename Fn>
+bool ConcurrentBPlusTree<T, MinDegree>::upsert(const T& entry, Fn update)
+{
+    EpochManager::Guard guard(epochs);
+    const Key& key = keyOf(entry);
+    bool isRoot;
+    Leaf* leaf = lockLeaf(key,isRoot);
+    int i = leafIndex(leaf,key);
+
+    if(i < leaf->dataCount && keyOf(leaf->data[i]) == key)
+    {
+        update(leaf->data[i]);
+        leaf->lock.unlock();
+        return false;
+    }
+
+    if(leaf->dataCount < MAXIMUM)
+    {
+        insertItem(leaf->data,i,leaf->dataCount,entry);
+        update(leaf->data[i]);
+        _size++;
+        leaf->lock.unlock();
+        return true;
+    }
+
+    //the leaf would split, so start over, holding the nodes that the split may reach.
+    leaf->lock.unlockUnchanged();
+    return crabInsert(entry,update);
+}
+
+//preconditions: none
+//postconditions: the item with the key of entry, if there is one, is removed,
+// and true returned. the leaf is locked alone when the removal leaves it with
+// at least MINIMUM items and its first item (which may be a routing key) in place,
+// otherwise the path is crabbed.
+template <typename T, int MinDegree>
+bool ConcurrentBPlusTree<T, MinDegree>::remove(const T& entry)
+{
+    //copy the key, since entry may refer to an item that is about to be removed.
+    const Key key = keyOf(entry);
+
+    EpochManager::Guard guard(epochs);
+    bool isRoot;
+    Leaf* leaf = lockLeaf(key,isRoot);
+    int i = leafIndex(leaf,key);
+
+    if(i == leaf->dataCount || !(keyOf(leaf->data[i]) == key))
+    {
+        leaf->lock.unlockUnchanged();
+        return false;
+    }
+
+    if(isRoot || (i > 0 && leaf->dataCount > MINIMUM))
+    {
+        deleteItem(leaf->data,i,leaf->dataCount);
+        _size--;
+        leaf->lock.unlock();
+        return true;
+    }
+
+    leaf->lock.unlockUnchanged();
+    return crabRemove(key);
+}
+
+//preconditions: none
+//postconditions: if the key of entry is in the tree, its item is copied into item, and true is returned.
+template <typename T, int MinDegree>
+bool ConcurrentBPlusTree<T, MinDegree>::find(const T& entry, T& item) const
+{
+    return lookup(keyOf(entry),&item);
+}
+
+//preconditions: none
+//postconditions: returns true if the key of entry is in the tree.
+template <typename T, int MinDegree>
+bool ConcurrentBPlusTree<T, MinDegree>::contains(const T& entry) const
+{
+    return lookup(keyOf(entry),nullptr);
+}
+
+//preconditions: none
+//postconditions: the number of items in the tree, as of some moment during the call.
+template <typename T, int MinDegree>
+int ConcurrentBPlusTree<T, MinDegree>::size() const
+{
+    return int(_size.load());
+}
+
+//preconditions: none
+//postconditions: returns true if the tree held no items, at some moment during the call.
+template <typename T, int MinDegree>
+bool ConcurrentBPlusTree<T, MinDegree>::empty() const
+{
+    return _size.load() == 0;
+}
+
+//preconditions: none
+//postconditions: the number of nodes unlinked from the tree, that are not freed yet.
+template <typename T, int MinDegree>
+size_t ConcurrentBPlusTree<T, MinDegree>::retiredNodes() const
+{
+    return epochs.pending();
+}
+
+//preconditions: none
+//postconditions: the epoch is moved on if every thread in the tree has seen it, and the retired
+// nodes no thread can reach any more are freed. (writers also do this as they retire nodes)
+template <typename T, int MinDegree>
+size_t ConcurrentBPlusTree<T, MinDegree>::reclaim()
+{
+    return epochs.reclaim();
+}
+
+//preconditions: no other thread uses the tree.
+//postconditions: returns true if every leaf is at the same depth, every node but the root
+// holds MINIMUM to MAXIMUM items, the keys are in order, each routing key data[i] is the
+// smallest key in subset[i+1], and the number of items is size().
+template <typename T, int MinDegree>
+bool ConcurrentBPlusTree<T, MinDegree>::isValid() const
+{
+    int leafDepth = -1;
+    size_t items = 0;
+    return verifyNode(root.load(),0,leafDepth,nullptr,nullptr,items) && items == _size.load();
+}
+
+//preconditions: low and high are null, or bound the keys of this subtree: low <= key < high.
+//postconditions: returns true if the subtree at node satisfies the rules listed in isValid.
+template <typename T, int MinDegree>
+bool ConcurrentBPlusTree<T, MinDegree>::verifyNode(const Node* node, int depth, int& leafDepth,
+                                                   const Key* low, const Key* high, size_t& items) const
+{
+    if(node->obsolete || node->dataCount > MAXIMUM)
+        return false;
+    if(node != root.load() && node->dataCount < MINIMUM)
+        return false;
+
+    if(node->isLeaf())
+    {
+        const Leaf* leaf = asLeaf(node);
+        if(leafDepth == -1)
+            leafDepth = depth;
+        if(depth != leafDepth)
+            return false;
+
+        for(int i = 0; i < leaf->dataCount; i++)
+        {
+            const Key& key = keyOf(leaf->data[i]);
+            if((i > 0 && !(keyOf(leaf->data[i-1]) < key)) || (low && key < *low) || (high && !(key < *high)))
+                return false;
+        }
+        if(low && leaf->dataCount > 0 && !(keyOf(leaf->data[0]) == *low))
+            return false;
+
+        items += leaf->dataCount;
+        return true;
+    }
+
+    const Inner* inner = asInner(node);
+    if(inner->childCount != inner->dataCount + 1)
+        return false;
+
+    for(int i = 0; i < inner->childCount; i++)
+    {
+        const Key* subsetLow = (i == 0) ? low : &inner->data[i-1];
+        const Key* subsetHigh = (i == inner->dataCount) ? high : &inner->data[i];
+        if(!verifyNode(inner->subset[i],depth+1,leafDepth,subsetLow,subsetHigh,items))
+            return false;
+        if(i > 0 && !(getSmallest(inner->subset[i]) == inner->data[i-1]))
+            return false;
+    }
+    return true;
+}
+
+//preconditions: none
+//postconditions: returns the index of the first routing key in inner that is not less than key.
+template <typename T, int MinDegree>
+int ConcurrentBPlusTree<T, MinDegree>::innerIndex(const Inner* inner, const Key& key)
+{
+    return NodeSearch<Key>::firstGE(inner->data,inner->dataCount,key);
+}
+
+//preconditions: none
+//postconditions: returns the index of the subset of inner that key belongs in,
+// which is subset[i+1] when key equals data[i], since data[i] is the smallest key there.
+template <typename T, int MinDegree>
+int ConcurrentBPlusTree<T, MinDegree>::childIndex(const Inner* inner, const Key& key)
+{
+    int i = innerIndex(inner,key);
+    if(i < inner->dataCount && key == inner->data[i])
+        i++;
+    return i;
+}
+
+//preconditions: none
+//postconditions: returns the index of the first item in leaf whose key is not less than key,
+// if no such item exists, returns leaf->dataCount.
+template <typename T, int MinDegree>
+int ConcurrentBPlusTree<T, MinDegree>::leafIndex(const Leaf* leaf, const Key& key)
+{
+    return leafIndex(leaf,key,is_same<T, Key>());
+}
+
+//preconditions: T is the same type as Key
+//postconditions: the items are the keys, so search them with the NodeSearch for Key.
+template <typename T, int MinDegree>
+int ConcurrentBPlusTree<T, MinDegree>::leafIndex(const Leaf* leaf, const Key& key, true_type)
+{
+    return NodeSearch<Key>::firstGE(leaf->data,leaf->dataCount,key);
+}
+
+//preconditions: none
+//postconditions: a branchless binary search (see firstGEBinary) comparing keyOf(data[i]) with key.
+template <typename T, int MinDegree>
+int ConcurrentBPlusTree<T, MinDegree>::leafIndex(const Leaf* leaf, const Key& key, false_type)
+{
+    if(leaf->dataCount == 0)
+        return 0;
+
+    const T* base = leaf->data;
+    int len = leaf->dataCount;
+    while(len > 1)
+    {
+        int half = len / 2;
+        base = (keyOf(base[half]) < key) ? base + half : base;
+        len -= half;
+    }
+
+    return int(base - leaf->data) + (keyOf(*base) < key);
+}
+
+//preconditions: the leftmost path of node is held by this thread (or no other thread uses the tree).
+//postconditions: returns the key of the first item in the leftmost leaf of node.
+template <typename T, int MinDegree>
+const typename ConcurrentBPlusTree<T, MinDegree>::Key& ConcurrentBPlusTree<T, MinDegree>::getSmallest(const Node* node)
+{
+    while(!node->isLeaf())
+        node = asInner(node)->subset[0];
+
+    assert(node->dataCount > 0);
+    return keyOf(asLeaf(node)->data[0]);
+}
+
+//preconditions: node is not null, and not reachable by any other thread.
+//postconditions: the node is destroyed and freed.
+template <typename T, int MinDegree>
+void ConcurrentBPlusTree<T, MinDegree>::deleteNode(Node* node)
+{
+    if(node->isLeaf())
+        delete asLeaf(node);
+    else
+        delete asInner(node);
+}
+
+//preconditions: node is not null, and not reachable by any other thread.
+//postconditions: node and all of its descendants are freed.
+template <typename T, int MinDegree>
+void ConcurrentBPlusTree<T, MinDegree>::deleteSubtree(Node* node)
+{
+    if(!node->isLeaf())
+    {
+        Inner* inner = asInner(node);
+        for(int i = 0; i < inner->childCount; i++)
+            deleteSubtree(inner->subset[i]);
+    }
+    deleteNode(node);
+}
+
+//preconditions: inner is held by this thread.
+//postconditions: the subsets of inner past childCount are null. (they are contiguous,
+// since the subsets are only ever shifted, split off or merged away from the right)
+template <typename T, int MinDegree>
+void ConcurrentBPlusTree<T, MinDegree>::clearVacated(Inner* inner)
+{
+    for(int i = inner->childCount; i < MAXIMUM + 2 && inner->subset[i]; i++)
+        inner->subset[i] = nullptr;
+}
+
+//preconditions: none
+//postconditions: returns true if key is in the tree, and copies its item into item,
+// if item is not null. restarts an optimistic lookup until it validates.
+template <typename T, int MinDegree>
+bool ConcurrentBPlusTree<T, MinDegree>::lookup(const Key& key, T* item) const
+{
+    EpochManager::Guard guard(epochs);
+    if(!OPTIMISTIC_READS)
+        return sharedLookup(key,item);
+
+    bool found = false;
+    int spins = 0;
+    while(!optimisticLookup(key,item,found))
+        VersionLock::backoff(spins);
+    return found;
+}
+
+//preconditions: T and Key are trivially copyable.
+//postconditions: returns false if a node changed during the search (and nothing
+// that was read can be trusted), otherwise sets found, and copies the item if found.
+template <typename T, int MinDegree>
+bool ConcurrentBPlusTree<T, MinDegree>::optimisticLookup(const Key& key, T* item, bool& found) const
+{
+    const Node* node;
+    uint64_t version;
+    bool isRoot;
+    if(!optimisticDescend(key,node,version,isRoot))
+        return false;
+
+    const Leaf* leaf = asLeaf(node);
+    int i = leafIndex(leaf,key);
+    found = (i < leaf->dataCount && keyOf(leaf->data[i]) == key);
+    if(found && item)
+        *item = leaf->data[i];
+
+    return leaf->lock.validate(version);
+}
+
+//preconditions: none
+//postconditions: descends to the leaf of key holding each node shared, and the parent only until
+// the child is held. returns true if key is in the tree, copying its item into item (if not null).
+template <typename T, int MinDegree>
+bool ConcurrentBPlusTree<T, MinDegree>::sharedLookup(const Key& key, T* item) const
+{
+    const Leaf* leaf = sharedDescend(key,nullptr);
+    int i = leafIndex(leaf,key);
+    bool found = (i < leaf->dataCount && keyOf(leaf->data[i]) == key);
+    if(found && item)
+        *item = leaf->data[i];
+
+    leaf->lock.unlockShared();
+    return found;
+}
+
+//preconditions: none
+//postconditions: visit is called on copies of the items with keys not less than the key of from,
+// in order, up to maxItems of them, and the number visited is returned. the items of one leaf are
+// copied out at a time (optimistically, or with the leaf held shared), then visited with nothing held,
+// and the scan goes on from the fence of the leaf, the key the next leaf starts at. so each leaf is
+// a consistent snapshot, but the scan as a whole is not: it sees every item that stays in the tree
+// while it runs, and may or may not see the items inserted or removed while it runs.
+template <typename T, int MinDegree>
+template <typename Fn>
+int ConcurrentBPlusTree<T, MinDegree>::scan(const T& from, int maxItems, Fn visit) const
+{
+    EpochManager::Guard guard(epochs);
+    Key key = keyOf(from);
+    T items[MAXIMUM + 1];
+    int visited = 0;
+
+    while(visited < maxItems)
+    {
+        Fence fence;
+        int count;
+        if(OPTIMISTIC_READS)
+        {
+            int spins = 0;
+            for(;;)
+            {
+                const Node* node;
+                uint64_t version;
+                bool isRoot;
+                if(optimisticDescend(key,node,version,isRoot,&fence))
+                {
+                    count = copyFrom(asLeaf(node),key,items);
+                    if(node->lock.validate(version))
+                        break;
+                }
+                VersionLock::backoff(spins);
+            }
+        }
+        else
+        {
+            const Leaf* leaf = sharedDescend(key,&fence);
+            count = copyFrom(leaf,key,items);
+            leaf->lock.unlockShared();
+        }
+
+        for(int i = 0; i < count && visited < maxItems; i++, visited++)
+            visit(items[i]);
+
+        if(!fence.exists)
+            break;
+        key = fence.key;
+    }
+    return visited;
+}
+
+//preconditions: leaf is held shared, or read optimistically (and validated after).
+//postconditions: the items of leaf with keys not less than key are copied into items, in order,
+// and their number is returned. (a torn dataCount is clamped, the copy is discarded anyway)
+template <typename T, int MinDegree>
+int ConcurrentBPlusTree<T, MinDegree>::copyFrom(const Leaf* leaf, const Key& key, T items[]) const
+{
+    int count = leaf->dataCount;
+    if(count < 0 || count > MAXIMUM + 1)
+        return 0;
+
+    int n = 0;
+    for(int i = leafIndex(leaf,key); i < count; i++)
+        items[n++] = leaf->data[i];
+    return n;
+}
+
+//preconditions: none
+//postconditions: descends to the leaf of key holding each node shared, and the parent only until
+// the child is held, and returns the leaf, held shared. if fence is not null, it is set to the
+// fence of the leaf: the routing key right of the subset taken in the lowest node that has one.
+template <typename T, int MinDegree>
+const typename ConcurrentBPlusTree<T, MinDegree>::Leaf* ConcurrentBPlusTree<T, MinDegree>::sharedDescend(const Key& key, Fence* fence) const
+{
+    if(fence)
+        fence->exists = false;
+
+    rootLock.lockShared();
+    const Node* node = root.load(memory_order_acquire);
+    node->lock.lockShared();
+    rootLock.unlockShared();
+
+    while(!node->isLeaf())
+    {
+        const Inner* inner = asInner(node);
+        int i = childIndex(inner,key);
+        if(fence && i < inner->dataCount)
+        {
+            fence->exists = true;
+            fence->key = inner->data[i];
+        }
+
+        const Node* child = inner->subset[i];
+        child->lock.lockShared();
+        node->lock.unlockShared();
+        node = child;
+    }
+    return asLeaf(node);
+}
+
+//preconditions: T and Key are trivially copyable.
+//postconditions: returns false if the descent must restart. otherwise node is the leaf of key,
+// version is its version (the leaf still has to be validated after it is read), and isRoot
+// is true if the leaf was the root. each child's version is read before its parent is
+// validated, so a child that a writer unlinked or split away is never trusted.
+// if fence is not null, it is set as in sharedDescend.
+template <typename T, int MinDegree>
+bool ConcurrentBPlusTree<T, MinDegree>::optimisticDescend(const Key& key, const Node*& node, uint64_t& version, bool& isRoot, Fence* fence) const
+{
+    if(fence)
+        fence->exists = false;
+
+    uint64_t rootVersion;
+    if(!rootLock.readVersion(rootVersion))
+        return false;
+
+    node = root.load(memory_order_acquire);
+    if(!node->lock.readVersion(version) || !rootLock.validate(rootVersion))
+        return false;
+
+    isRoot = true;
+    while(!node->isLeaf())
+    {
+        const Inner* inner = asInner(node);
+        int i = childIndex(inner,key);
+        if(fence && i < inner->dataCount)
+        {
+            fence->exists = true;
+            fence->key = inner->data[i];
+        }
+
+        const Node* child = inner->subset[i];
+        uint64_t childVersion;
+        if(!child || !inner->lock.validate(version))
+            return false;
+        if(!child->lock.readVersion(childVersion) || !inner->lock.validate(version))
+            return false;
+
+        node = child;
+        version = childVersion;
+        isRoot = false;
+    }
+    return true;
+}
+
+//preconditions: none
+//postconditions: returns the leaf that key belongs in, locked exclusively by this thread,
+// with isRoot set if it is the root. the nodes above it are read optimistically (or held
+// shared, and released on the way down), so a writer does not block the readers above its leaf.
+template <typename T, int MinDegree>
+typename ConcurrentBPlusTree<T, MinDegree>::Leaf* ConcurrentBPlusTree<T, MinDegree>::lockLeaf(const Key& key, bool& isRoot)
+{
+    if(OPTIMISTIC_READS)
+    {
+        int spins = 0;
+        for(;;)
+        {
+            const Node* node;
+            uint64_t version;
+            if(optimisticDescend(key,node,version,isRoot) && node->lock.tryUpgrade(version))
+                return asLeaf(const_cast<Node*>(node));
+            VersionLock::backoff(spins);
+        }
+    }
+
+    rootLock.lockShared();
+    Node* node = root.load(memory_order_acquire);
+    isRoot = node->isLeaf();
+    if(isRoot)
+        node->lock.lock();
+    else
+        node->lock.lockShared();
+    rootLock.unlockShared();
+
+    while(!node->isLeaf())
+    {
+        Node* child = asInner(node)->subset[childIndex(asInner(node),key)];
+        if(child->isLeaf())
+            child->lock.lock();
+        else
+            child->lock.lockShared();
+        node->lock.unlockShared();
+        node = child;
+    }
+    return asLeaf(node);
+}
+
+//preconditions: node is held by this thread.
+//postconditions: returns true if a change below node cannot reach the nodes above it:
+// inserting, node has room for one more item. removing, node can lose one, (the root
+// until it is left with a single subset, which takes the root pointer with it).
+template <typename T, int MinDegree>
+bool ConcurrentBPlusTree<T, MinDegree>::isSafe(const Node* node, bool inserting, bool isRoot)
+{
+    if(inserting)
+        return node->dataCount < MAXIMUM;
+    if(isRoot)
+        return node->isLeaf() || node->dataCount > 1;
+    return node->dataCount > MINIMUM;
+}
+
+//preconditions: this thread holds no node of the tree.
+//postconditions: returns the leaf of key, locked exclusively, after crabbing down from the root:
+// each node is locked before its parent is released, and when the node just locked is safe,
+// everything above it is released. removing, a node whose routing key equals key (the key
+// will have to be replaced by the next smallest key) is held to the end, with everything below it.
+template <typename T, int MinDegree>
+typename ConcurrentBPlusTree<T, MinDegree>::Leaf* ConcurrentBPlusTree<T, MinDegree>::crabDown(const Key& key, Path& path, bool inserting)
+{
+    path.depth = 0;
+    path.lockedCount = 0;
+
+    rootLock.lock();
+    path.rootLocked = true;
+    Node* node = root.load(memory_order_relaxed);
+    node->lock.lock();
+    path.locked[path.lockedCount++] = node;
+    if(isSafe(node,inserting,true))
+        releaseAncestors(path);
+
+    bool pinned = false;
+    while(!node->isLeaf())
+    {
+        Inner* inner = asInner(node);
+        int i = innerIndex(inner,key);
+        bool found = (i < inner->dataCount && key == inner->data[i]);
+        if(found)
+            i++;
+
+        assert(path.depth < MAX_HEIGHT);
+        path.inner[path.depth] = inner;
+        path.index[path.depth] = i;
+        path.found[path.depth] = found;
+        path.depth++;
+        if(found && !inserting)
+            pinned = true;
+
+        node = inner->subset[i];
+        node->lock.lock();
+        path.locked[path.lockedCount++] = node;
+        if(!pinned && isSafe(node,inserting,false))
+            releaseAncestors(path);
+    }
+    return asLeaf(node);
+}
+
+//preconditions: node is a sibling of a node of path, under a parent of path.
+//postconditions: node is locked exclusively, and will be released with path.
+template <typename T, int MinDegree>
+void ConcurrentBPlusTree<T, MinDegree>::lockSibling(Path& path, Node* node)
+{
+    assert(path.lockedCount < 3 * MAX_HEIGHT);
+    node->lock.lock();
+    path.locked[path.lockedCount++] = node;
+}
+
+//preconditions: none of the nodes of path was modified.
+//postconditions: every node of path except the last one locked is released, with rootLock.
+template <typename T, int MinDegree>
+void ConcurrentBPlusTree<T, MinDegree>::releaseAncestors(Path& path)
+{
+    if(path.rootLocked)
+    {
+        rootLock.unlockUnchanged();
+        path.rootLocked = false;
+    }
+
+    for(int i = 0; i < path.lockedCount - 1; i++)
+        path.locked[i]->lock.unlockUnchanged();
+
+    path.locked[0] = path.locked[path.lockedCount - 1];
+    path.lockedCount = 1;
+    path.depth = 0;
+}
+
+//preconditions: none
+//postconditions: every node of path is released (the version of each moves on if modified),
+// and the nodes that were unlinked are unlocked as obsolete and retired.
+template <typename T, int MinDegree>
+void ConcurrentBPlusTree<T, MinDegree>::releasePath(Path& path, bool modified)
+{
+    for(int i = 0; i < path.lockedCount; i++)
+    {
+        Node* node = path.locked[i];
+        if(node->obsolete)
+        {
+            node->lock.unlockObsolete();
+            epochs.retire(node,&freeRetired);
+        }
+        else if(modified)
+            node->lock.unlock();
+        else
+            node->lock.unlockUnchanged();
+    }
+
+    if(path.rootLocked)
+    {
+        if(modified)
+            rootLock.unlock();
+        else
+            rootLock.unlockUnchanged();
+    }
+    path.lockedCount = 0;
+    path.depth = 0;
+    path.rootLocked = false;
+}
+
+//preconditions: this thread holds no node of the tree.
+//postconditions: same as upsert(entry, update), with the path crabbed, then the excess fixed
+// from the leaf up through the nodes held (the topmost one has room, unless it is the root,
+// which is split under a new root, as in BPlusTree::insertEntry).
+template <typename T, int MinDegree>
+template <typename Fn>
+bool ConcurrentBPlusTree<T, MinDegree>::crabInsert(const T& entry, Fn& update)
+{
+    const Key& key = keyOf(entry);
+    Path path;
+    Leaf* leaf = crabDown(key,path,true);
+    int i = leafIndex(leaf,key);
+
+    if(i < leaf->dataCount && keyOf(leaf->data[i]) == key)
+    {
+        update(leaf->data[i]);
+        releasePath(path,true);
+        return false;
+    }
+
+    insertItem(leaf->data,i,leaf->dataCount,entry);
+    update(leaf->data[i]);
+    _size++;
+
+    for(int level = path.depth - 1; level >= 0; level--)
+        fixExcess(path.inner[level],path.index[level]);
+
+    if(path.rootLocked)
+    {
+        Node* oldRoot = root.load(memory_order_relaxed);
+        if(oldRoot->dataCount == MAXIMUM + 1)
+        {
+            Inner* newRoot = new Inner;
+            newRoot->subset[0] = oldRoot;
+            newRoot->childCount = 1;
+            fixExcess(newRoot,0);
+            root.store(newRoot,memory_order_release);
+        }
+    }
+
+    releasePath(path,true);
+    return true;
+}
+
+//preconditions: this thread holds no node of the tree.
+//postconditions: same as remove(key), with the path crabbed, then the shortage fixed from the
+// leaf up through the nodes held, as in BPlusTree::looseRemove, and the root shrunk if it is
+// left with a single subset.
+template <typename T, int MinDegree>
+bool ConcurrentBPlusTree<T, MinDegree>::crabRemove(const Key& key)
+{
+    Path path;
+    Leaf* leaf = crabDown(key,path,false);
+    int i = leafIndex(leaf,key);
+
+    if(i == leaf->dataCount || !(keyOf(leaf->data[i]) == key))
+    {
+        releasePath(path,false);
+        return false;
+    }
+
+    deleteItem(leaf->data,i,leaf->dataCount);
+    _size--;
+
+    for(int level = path.depth - 1; level >= 0; level--)
+    {
+        Inner* inner = path.inner[level];
+        int index = path.index[level];
+        Node* subset = inner->subset[index];
+
+        //data[index-1] was the smallest key of subset[index], refresh it before
+        // a rotate or merge can move it. (an emptied leaf is resynced by fixShortage)
+        if(path.found[level] && !(subset->isLeaf() && subset->dataCount == 0))
+            inner->data[index-1] = getSmallest(subset);
+
+        if(subset->dataCount < MINIMUM)
+            fixShortage(inner,index,path);
+    }
+
+    if(path.rootLocked)
+    {
+        Node* oldRoot = root.load(memory_order_relaxed);
+        if(!oldRoot->isLeaf() && oldRoot->childCount == 1)
+        {
+            root.store(asInner(oldRoot)->subset[0],memory_order_release);
+            oldRoot->obsolete = true;
+        }
+    }
+
+    releasePath(path,true);
+    return true;
+}
+
+//preconditions: node and subset[i] are held by this thread, i < childCount, childCount <= maximum+1
+//postconditions: same as BPlusTree::fixExcess: a subset[i] with too many items is split in
+// two, and the new right half inserted as subset[i+1]. the new node is not reachable
+// until node is released, so it is not locked.
+template <typename T, int MinDegree>
+void ConcurrentBPlusTree<T, MinDegree>::fixExcess(Inner* node, int i)
+{
+    assert(i < node->childCount && node->childCount <= MAXIMUM+1);
+
+    if(node->subset[i]->dataCount > MAXIMUM)
+    {
+        if(node->subset[i]->isLeaf())
+        {
+            Leaf* left = asLeaf(node->subset[i]);
+            Leaf* right = new Leaf;
+            split(left->data,left->dataCount,right->data,right->dataCount,true);
+            insertItem(node->subset,i+1,node->childCount,static_cast<Node*>(right));
+            insertItem(node->data,i,node->dataCount,keyOf(right->data[0]));
+        }
+        else
+        {
+            Inner* left = asInner(node->subset[i]);
+            Inner* right = new Inner;
+            split(left->data,left->dataCount,right->data,right->dataCount);
+            split(left->subset,left->childCount,right->subset,right->childCount);
+            clearVacated(left);
+            insertItem(node->subset,i+1,node->childCount,static_cast<Node*>(right));
+            insertItem(node->data,i,node->dataCount,detachItem(left->data,left->dataCount));
+        }
+    }
+}
+
+//preconditions: node and subset[i] are held by this thread, and subset[i] has a shortage.
+//postconditions: same as BPlusTree::fixShortage, after locking the siblings it looks at:
+// subset[i+1] first, then subset[i-1] if subset[i+1] cannot lend an item. the siblings
+// are released with the path, so the leftmost path below node stays held.
+template <typename T, int MinDegree>
+void ConcurrentBPlusTree<T, MinDegree>::fixShortage(Inner* node, int i, Path& path)
+{
+    bool hasNext = (i+1 < node->childCount);
+    if(hasNext)
+        lockSibling(path,node->subset[i+1]);
+
+    if(hasNext && node->subset[i+1]->dataCount > MINIMUM)
+        rotateLeft(node,i);
+    else
+    {
+        if(i > 0)
+            lockSibling(path,node->subset[i-1]);
+
+        if(i > 0 && node->subset[i-1]->dataCount > MINIMUM)
+            rotateRight(node,i);
+        else if(hasNext)
+            mergeWithNextSubset(node,i);
+        else
+            mergeWithPreviousSubset(node,i);
+    }
+
+    //when the subsets are leaves, the items that moved (or the item that was removed)
+    // may have changed the smallest key of the subsets on either side of data[i-1] and data[i].
+    if(node->subset[0]->isLeaf())
+    {
+        for(int j = ((i == 0) ? 0 : i-1); j <= i && j < node->dataCount; j++)
+            if(!(node->data[j] == keyOf(asLeaf(node->subset[j+1])->data[0])))
+                node->data[j] = keyOf(asLeaf(node->subset[j+1])->data[0]);
+    }
+}
+
+//preconditions: (i + 1 < childCount), subset[i] and subset[i+1] are held by this thread.
+//postconditions: same as BPlusTree::mergeWithNextSubset, the subset that is emptied
+// is marked obsolete instead of being freed.
+template <typename T, int MinDegree>
+void ConcurrentBPlusTree<T, MinDegree>::mergeWithNextSubset(Inner* node, int i)
+{
+    assert(node->childCount > i+1);
+
+    if(node->subset[i]->isLeaf())
+    {
+        Leaf* left = asLeaf(node->subset[i]);
+        Leaf* right = asLeaf(node->subset[i+1]);
+        mergeArrays(left->data,left->dataCount,right->data,right->dataCount);
+        deleteItem(node->data,i,node->dataCount);
+        deleteItem(node->subset,i+1,node->childCount)->obsolete = true;
+    }
+    else
+    {
+        Inner* left = asInner(node->subset[i]);
+        Inner* right = asInner(node->subset[i+1]);
+        insertItem(right->data,0,right->dataCount,deleteItem(node->data,i,node->dataCount));
+        mergeFront(right->data,right->dataCount,left->data,left->dataCount);
+        mergeFront(right->subset,right->childCount,left->subset,left->childCount);
+        deleteItem(node->subset,i,node->childCount)->obsolete = true;
+    }
+    clearVacated(node);
+}
+
+//preconditions: (i > 0), subset[i-1] and subset[i] are held by this thread.
+//postconditions: same as BPlusTree::mergeWithPreviousSubset, the subset that is emptied
+// is marked obsolete instead of being freed.
+template <typename T, int MinDegree>
+void ConcurrentBPlusTree<T, MinDegree>::mergeWithPreviousSubset(Inner* node, int i)
+{
+    assert(i > 0);
+
+    if(node->subset[i]->isLeaf())
+    {
+        Leaf* left = asLeaf(node->subset[i-1]);
+        Leaf* right = asLeaf(node->subset[i]);
+        mergeArrays(left->data,left->dataCount,right->data,right->dataCount);
+        deleteItem(node->data,i-1,node->dataCount);
+        deleteItem(node->subset,i,node->childCount)->obsolete = true;
+    }
+    else
+    {
+        Inner* left = asInner(node->subset[i-1]);
+        Inner* right = asInner(node->subset[i]);
+        attachItem(left->data,left->dataCount,deleteItem(node->data,i-1,node->dataCount));
+        mergeArrays(left->data,left->dataCount,right->data,right->dataCount);
+        mergeArrays(left->subset,left->childCount,right->subset,right->childCount);
+        deleteItem(node->subset,i,node->childCount)->obsolete = true;
+    }
+    clearVacated(node);
+}
+
+//preconditions: (dataCount > i), subset[i] and subset[i+1] are held by this thread.
+//postconditions: same as BPlusTree::rotateLeft.
+template <typename T, int MinDegree>
+void ConcurrentBPlusTree<T, MinDegree>::rotateLeft(Inner* node, int i)
+{
+    assert((node->dataCount > i) && (node->subset[i]->dataCount < MAXIMUM+1) && (node->subset[i+1]->dataCount > MINIMUM));
+
+    if(node->subset[i]->isLeaf())
+    {
+        Leaf* left = asLeaf(node->subset[i]);
+        Leaf* right = asLeaf(node->subset[i+1]);
+        attachItem(left->data,left->dataCount,deleteItem(right->data,0,right->dataCount));
+    }
+    else
+    {
+        Inner* left = asInner(node->subset[i]);
+        Inner* right = asInner(node->subset[i+1]);
+        attachItem(left->data,left->dataCount,deleteItem(node->data,i,node->dataCount));
+        insertItem(node->data,i,node->dataCount,deleteItem(right->data,0,right->dataCount));
+        attachItem(left->subset,left->childCount,deleteItem(right->subset,0,right->childCount));
+        clearVacated(right);
+    }
+}
+
+//preconditions: (i > 0), subset[i-1] and subset[i] are held by this thread.
+//postconditions: same as BPlusTree::rotateRight.
+template <typename T, int MinDegree>
+void ConcurrentBPlusTree<T, MinDegree>::rotateRight(Inner* node, int i)
+{
+    assert((i > 0) && (node->subset[i]->dataCount < MAXIMUM+1) && (node->subset[i-1]->dataCount > MINIMUM));
+
+    if(node->subset[i]->isLeaf())
+    {
+        Leaf* left = asLeaf(node->subset[i-1]);
+        Leaf* right = asLeaf(node->subset[i]);
+        insertItem(right->data,0,right->dataCount,detachItem(left->data,left->dataCount));
+    }
+    else
+    {
+        Inner* left = asInner(node->subset[i-1]);
+        Inner* right = asInner(node->subset[i]);
+        insertItem(right->data,0,right->dataCount, deleteItem(node->data,i-1,node->dataCount));
+        insertItem(node->data,i-1,node->dataCount, detachItem(left->data,left->dataCount));
+        insertItem(right->subset,0,right->childCount,detachItem(left->subset,left->childCount));
+        clearVacated(left);
+    }
+}
+
+#endif // CONCURRENTBPLUSTREE_H
@@ -0,0 +1,132 @@
+#ifndef CONCURRENTMAP_H
+#define CONCURRENTMAP_H
+#include "map.h"
+#include "concurrentbplustree.h"
+using namespace std;
+
+//a Map that any number of threads may use at once, on a ConcurrentBPlusTree of Pairs.
+// values are copied out (get) or changed in place (upsert) while their leaf is held,
+// since a reference into the tree would not survive another thread's insert or erase.
+//MinDegree is passed through to the underlying ConcurrentBPlusTree.
+template <typename K, typename V, int MinDegree = DefaultMinDegree<Pair<K,V> >::value>
+class ConcurrentMap
+{
+public:
+    ConcurrentMap() {}
+
+    //  Capacity
+    int size() const {return _map.size();}
+    bool empty() const {return _map.empty();}
+
+    //  Element Access
+    bool get(const K& key, V& value) const;
+
+    //  Modifiers
+    bool insert(const K& k, const V& v);
+    bool insert_or_assign(const K& k, const V& v);
+    template <typename Fn>
+    bool upsert(const K& k, Fn update);
+    bool erase(const K& key);
+
+    //  Operations:
+    bool contains(const K& key) const;
+    template <typename Fn>
+    int scan(const K& from, int maxPairs, Fn visit) const; //visit(key, value) in order, from the key from
+    bool isValid() const {return _map.isValid();}
+    size_t reclaim() {return _map.reclaim();}  //free the nodes no thread can reach any more
+    size_t retiredNodes() const {return _map.retiredNodes();}
+
+private:
+    ConcurrentBPlusTree<Pair<K,V>, MinDegree> _map;
+};
+
+//preconditions: none
+//postconditions: if the key is in the map, its value is copied into value,
+// and true is returned, otherwise value is left as it is, and false is returned.
+template<typename K, typename V, int MinDegree>
+bool ConcurrentMap<K,V,MinDegree>::get(const K& key, V& value) const
+{
+    Pair<K,V> item;
+    if(!_map.find(Pair<K,V>(key),item))
+        return false;
+
+    value = item._value;
+    return true;
+}
+
+//preconditions: none
+//postconditions: if the key is not in the map yet, the pair (k, v) is inserted
+// and true is returned. otherwise the map is left as it is, and false is returned.
+template<typename K, typename V, int MinDegree>
+bool ConcurrentMap<K,V,MinDegree>::insert(const K& k, const V& v)
+{
+    return _map.insert(Pair<K,V>(k,v));
+}
+
+//preconditions: none
+//postconditions: the pair (k, v) is inserted, or the value of k is set to v if k was there.
+// returns true if the pair was inserted.
+template<typename K, typename V, int MinDegree>
+bool ConcurrentMap<K,V,MinDegree>::insert_or_assign(const K& k, const V& v)
+{
+    struct Assign
+    {
+        const V& value;
+        void operator()(Pair<K,V>& item) const {item._value = value;}
+    };
+    Assign assign = {v};
+    return _map.upsert(Pair<K,V>(k,v),assign);
+}
+
+//preconditions: update can be called on a V&.
+//postconditions: a pair with a default constructed value is inserted if k is not there,
+// then update is called on the value of k, while no other thread can reach it
+// (the concurrent counterpart of update(map[k])). returns true if the pair was inserted.
+template<typename K, typename V, int MinDegree>
+template<typename Fn>
+bool ConcurrentMap<K,V,MinDegree>::upsert(const K& k, Fn update)
+{
+    struct UpdateValue
+    {
+        Fn& update;
+        void operator()(Pair<K,V>& item) const {update(item._value);}
+    };
+    UpdateValue updateValue = {update};
+    return _map.upsert(Pair<K,V>(k,V()),updateValue);
+}
+
+//preconditions: none
+//postconditions: removes the pair with the recieved key from the map,
+// returning true if the pair was removed, otherwise false.
+template<typename K, typename V, int MinDegree>
+bool ConcurrentMap<K,V,MinDegree>::erase(const K& key)
+{
+    return _map.remove(Pair<K,V>(key,V()));
+}
+
+//preconditions: none
+//postconditions: returns true if the key is in the map, otherwise false.
+template<typename K, typename V, int MinDegree>
+bool ConcurrentMap<K,V,MinDegree>::contains(const K& key) const
+{
+    return _map.contains(Pair<K,V>(key,V()));
+}
+
+//preconditions: visit can be called with a const K& and a const V&.
+//postconditions: visit is called on copies of the pairs with keys not less than from, in order,
+// up to maxPairs of them, and the number visited is returned. (see ConcurrentBPlusTree::scan
+// for what a scan that runs alongside writers sees)
+template<typename K, typename V, int MinDegree>
+template<typename Fn>
+int ConcurrentMap<K,V,MinDegree>::scan(const K& from, int maxPairs, Fn visit) const
+{
+    struct VisitPair
+    {
+        Fn& visit;
+        void operator()(const Pair<K,V>& item) const {visit(item._key,item._value);}
+    };
+    VisitPair visitPair = {visit};
+    return _map.scan(Pair<K,V>(from,V()),maxPairs,visitPair);
+}
+
+#endif // CONCURRENTMAP_H
@@ -0,0 +1,94 @@
+#ifndef CONCURRENTMULTIMAP_H
+#define CONCURRENTMULTIMAP_H
+#include "multimap.h"
+#include "concurrentbplustree.h"
+using namespace std;
+
+//an MMap that any number of threads may use at once, on a ConcurrentBPlusTree of MPairs.
+// a value is appended to its key's list while the leaf that holds the list is locked,
+// and the list is copied out (get) instead of handed out by reference.
+//MinDegree is passed through to the underlying ConcurrentBPlusTree.
+template <typename K, typename V, int MinDegree = DefaultMinDegree<MPair<K,V> >::value>
+class ConcurrentMMap
+{
+public:
+    ConcurrentMMap() {}
+
+    //  Capacity
+    int size() const {return _mmap.size();}
+    bool empty() const {return _mmap.empty();}
+
+    //  Element Access
+    bool get(const K& key, vector<V>& values) const;
+
+    //  Modifiers
+    bool insert(const K& k, const V& v);
+    bool erase(const K& key);
+
+    //  Operations:
+    bool contains(const K& key) const;
+    int count(const K& key) const;
+    bool isValid() const {return _mmap.isValid();}
+
+private:
+    ConcurrentBPlusTree<MPair<K,V>, MinDegree> _mmap;
+};
+
+//preconditions: none
+//postconditions: if the key is in the map, its values are copied into values,
+// and true is returned, otherwise values is left as it is, and false is returned.
+template<typename K, typename V, int MinDegree>
+bool ConcurrentMMap<K,V,MinDegree>::get(const K& key, vector<V>& values) const
+{
+    MPair<K,V> item;
+    if(!_mmap.find(MPair<K,V>(key),item))
+        return false;
+
+    values.assign(make_move_iterator(item.values.begin()), make_move_iterator(item.values.end()));
+    return true;
+}
+
+//preconditions: none
+//postconditions: an empty list is inserted for k if k is not there, then v is
+// appended to the list of k, in the same descent.
+template<typename K, typename V, int MinDegree>
+bool ConcurrentMMap<K,V,MinDegree>::insert(const K& k, const V& v)
+{
+    struct Append
+    {
+        const V& value;
+        void operator()(MPair<K,V>& item) const {item.values.push_back(value);}
+    };
+    Append append = {v};
+    _mmap.upsert(MPair<K,V>(k),append);
+    return true;
+}
+
+//preconditions: none
+//postconditions: removes the Mpair with the recieved key from the map,
+// returning true if the pair was removed, otherwise false.
+template<typename K, typename V, int MinDegree>
+bool ConcurrentMMap<K,V,MinDegree>::erase(const K& key)
+{
+    return _mmap.remove(MPair<K,V>(key));
+}
+
+//preconditions: none
+//postconditions: returns true if the key exists in the map, otherwise false.
+template<typename K, typename V, int MinDegree>
+bool ConcurrentMMap<K,V,MinDegree>::contains(const K& key) const
+{
+    return _mmap.contains(MPair<K,V>(key));
+}
+
+//preconditions: none
+//postconditions: returns the number of values of the key (0 if it is not there).
+template<typename K, typename V, int MinDegree>
+int ConcurrentMMap<K,V,MinDegree>::count(const K& key) const
+{
+    vector<V> values;
+    get(key,values);
+    return int(values.size());
+}
+
+#endif // CONCURRENTMULTIMAP_H
@@ -0,0 +1,269 @@
+#ifndef DURABLEMAP_H
+#define DURABLEMAP_H
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include "map.h"
+#include "multimap.h"
+#include "wal.h"
+using namespace std;
+
+//DurableMap is a Map whose changes survive a crash: each insert, erase and assign is appended to a
+// WriteAheadLog (see wal.h) before it is applied, and open() rebuilds the map from the last checkpoint
+// and the log. syncEvery sets the group commit: how many changes share one sync of the log, (1 makes
+// each change durable before it returns, a larger group trades the last changes of a crash for speed,
+// and 0 syncs only on commit, checkpoint and close). checkpoint() saves the whole map and empties the log.
+// A change whose record cannot be written (or committed, when it ends a group) returns false and
+// leaves the map as it was.
+// The map itself is read through map(). It can only be changed through DurableMap, so every change
+// is logged. (an assignment through Map::operator[] could not be.)
+template <typename K, typename V, int MinDegree = DefaultMinDegree<Pair<K,V> >::value>
+class DurableMap
+{
+public:
+    explicit DurableMap(size_t syncEvery = 1): _log(syncEvery) {}
+
+    bool open(const string& path);                 //recover the map from path, and log the changes to it
+    void close() {_log.close();}                   //commit, and close the log
+    bool isOpen() const {return _log.isOpen();}
+
+    //  Modifiers: each returns what Map's does, and is logged only if it changes the map.
+    // they return false, without changing the map, if the record cannot be logged.
+    bool insert(const K& k, const V& v);
+    bool erase(const K& key);
+    bool assign(const K& key, const V& value);     //map[key] = value
+
+    bool commit() {return _log.commit();}          //sync the changes made so far
+    bool checkpoint();                             //save the map, and empty the log
+
+    //  Element Access
+    bool find(const K& key, V& value) const;       //copy the value of key to value, false if it is not there
+    int size() const {return _map.size();}
+    bool empty() const {return _map.empty();}
+    const Map<K,V,MinDegree>& map() const {return _map;}
+    const WriteAheadLog& log() const {return _log;}
+
+private:
+    enum Op {INSERT = 1, ERASE = 2, ASSIGN = 3};
+
+    Map<K,V,MinDegree> _map;
+    WriteAheadLog _log;
+
+    bool apply(uint8_t op, istream& payload);      //apply one record of the log to the map
+};
+
+//preconditions: the map is not open.
+//postconditions: the map is cleared, then loaded from the checkpoint at path and the records of its
+// log are applied. returns false if the files cannot be read or written.
+template<typename K, typename V, int MinDegree>
+bool DurableMap<K,V,MinDegree>::open(const string& path)
+{
+    _map.clear();
+    return _log.open(path,
+                     [this](istream& ins) {return _map.load(ins);},
+                     [this](uint8_t op, istream& payload) {return apply(op, payload);});
+}
+
+//preconditions: payload holds the payload of a record of op.
+//postconditions: the change the record logged is made to the map again.
+template<typename K, typename V, int MinDegree>
+bool DurableMap<K,V,MinDegree>::apply(uint8_t op, istream& payload)
+{
+    K key;
+    V value;
+    if(!Encoder<K>::read(payload, key))
+        return false;
+    if(op == ERASE)
+    {
+        _map.erase(key);
+        return true;
+    }
+    if(!Encoder<V>::read(payload, value))
+        return false;
+
+    if(op == INSERT)
+        _map.insert(key, std::move(value));
+    else if(op == ASSIGN)
+        _map[key] = std::move(value);
+    else
+        return false;
+    return true;
+}
+
+//preconditions: the map is open.
+//postconditions: unless k is there, the insert of the pair (k, v) is logged, and then made.
+template<typename K, typename V, int MinDegree>
+bool DurableMap<K,V,MinDegree>::insert(const K& k, const V& v)
+{
+    if(_map.contains(k))
+        return false;
+    bool logged = _log.append(INSERT, [&](ostream& outs)
+    {
+        Encoder<K>::write(outs, k);
+        Encoder<V>::write(outs, v);
+    });
+    return logged && _map.insert(k, v);
+}
+
+//preconditions: the map is open.
+//postconditions: if there is a pair with key, its erase is logged, and then made.
+template<typename K, typename V, int MinDegree>
+bool DurableMap<K,V,MinDegree>::erase(const K& key)
+{
+    if(!_map.contains(key))
+        return false;
+    bool logged = _log.append(ERASE, [&](ostream& outs) {Encoder<K>::write(outs, key);});
+    return logged && _map.erase(key);
+}
+
+//preconditions: the map is open.
+//postconditions: the assign is logged, and then the value of key is value (the pair is inserted
+// if it was not there).
+template<typename K, typename V, int MinDegree>
+bool DurableMap<K,V,MinDegree>::assign(const K& key, const V& value)
+{
+    bool logged = _log.append(ASSIGN, [&](ostream& outs)
+    {
+        Encoder<K>::write(outs, key);
+        Encoder<V>::write(outs, value);
+    });
+    if(!logged)
+        return false;
+    _map[key] = value;
+    return true;
+}
+
+//preconditions: the map is open.
+//postconditions: the map is saved to a new checkpoint, and the log starts over.
+template<typename K, typename V, int MinDegree>
+bool DurableMap<K,V,MinDegree>::checkpoint()
+{
+    return _log.checkpoint([this](ostream& outs) {return _map.save(outs);});
+}
+
+//preconditions: none
+//postconditions: if key is in the map, its value is copied to value and true is returned.
+template<typename K, typename V, int MinDegree>
+bool DurableMap<K,V,MinDegree>::find(const K& key, V& value) const
+{
+    const V* found = _map.find(key);
+    if(!found)
+        return false;
+    value = *found;
+    return true;
+}
+
+//DurableMMap is the same, for an MMap: each insert (of a value for a key) and erase (of a key,
+// with all of its values) is logged before it is applied, and fails if it cannot be.
+template <typename K, typename V, int MinDegree = DefaultMinDegree<MPair<K,V> >::value>
+class DurableMMap
+{
+public:
+    explicit DurableMMap(size_t syncEvery = 1): _log(syncEvery) {}
+
+    bool open(const string& path);                 //recover the multimap from path, and log the changes to it
+    void close() {_log.close();}                   //commit, and close the log
+    bool isOpen() const {return _log.isOpen();}
+
+    //  Modifiers
+    bool insert(const K& k, const V& v);
+    bool erase(const K& key);
+
+    bool commit() {return _log.commit();}          //sync the changes made so far
+    bool checkpoint();                             //save the multimap, and empty the log
+
+    //  Element Access
+    bool find(const K& key, vector<V>& values) const;  //copy the values of key to values, false if it is not there
+    int size() const {return _mmap.size();}
+    bool empty() const {return _mmap.empty();}
+    const MMap<K,V,MinDegree>& mmap() const {return _mmap;}
+    const WriteAheadLog& log() const {return _log;}
+
+private:
+    enum Op {INSERT = 1, ERASE = 2};
+
+    MMap<K,V,MinDegree> _mmap;
+    WriteAheadLog _log;
+
+    bool apply(uint8_t op, istream& payload);      //apply one record of the log to the multimap
+};
+
+//preconditions: the multimap is not open.
+//postconditions: the multimap is cleared, then loaded from the checkpoint at path and the records of
+// its log are applied. returns false if the files cannot be read or written.
+template<typename K, typename V, int MinDegree>
+bool DurableMMap<K,V,MinDegree>::open(const string& path)
+{
+    _mmap.clear();
+    return _log.open(path,
+                     [this](istream& ins) {return _mmap.load(ins);},
+                     [this](uint8_t op, istream& payload) {return apply(op, payload);});
+}
+
+//preconditions: payload holds the payload of a record of op.
+//postconditions: the change the record logged is made to the multimap again.
+template<typename K, typename V, int MinDegree>
+bool DurableMMap<K,V,MinDegree>::apply(uint8_t op, istream& payload)
+{
+    K key;
+    V value;
+    if(!Encoder<K>::read(payload, key))
+        return false;
+    if(op == ERASE)
+    {
+        _mmap.erase(key);
+        return true;
+    }
+    if(op != INSERT || !Encoder<V>::read(payload, value))
+        return false;
+
+    _mmap.insert(key, std::move(value));
+    return true;
+}
+
+//preconditions: the multimap is open.
+//postconditions: the insert is logged, and then v is appended to the values of k.
+template<typename K, typename V, int MinDegree>
+bool DurableMMap<K,V,MinDegree>::insert(const K& k, const V& v)
+{
+    bool logged = _log.append(INSERT, [&](ostream& outs)
+    {
+        Encoder<K>::write(outs, k);
+        Encoder<V>::write(outs, v);
+    });
+    return logged && _mmap.insert(k, v);
+}
+
+//preconditions: the multimap is open.
+//postconditions: if key is there, the erase is logged, and then key and its values are removed.
+template<typename K, typename V, int MinDegree>
+bool DurableMMap<K,V,MinDegree>::erase(const K& key)
+{
+    if(!_mmap.contains(key))
+        return false;
+    bool logged = _log.append(ERASE, [&](ostream& outs) {Encoder<K>::write(outs, key);});
+    return logged && _mmap.erase(key);
+}
+
+//preconditions: the multimap is open.
+//postconditions: the multimap is saved to a new checkpoint, and the log starts over.
+template<typename K, typename V, int MinDegree>
+bool DurableMMap<K,V,MinDegree>::checkpoint()
+{
+    return _log.checkpoint([this](ostream& outs) {return _mmap.save(outs);});
+}
+
+//preconditions: none
+//postconditions: if key is in the multimap, its values are copied to values and true is returned.
+template<typename K, typename V, int MinDegree>
+bool DurableMMap<K,V,MinDegree>::find(const K& key, vector<V>& values) const
+{
+    const ValueList<V>* found = _mmap.find(key);
+    if(!found)
+        return false;
+    values.assign(found->begin(), found->end());
+    return true;
+}
+
+#endif // DURABLEMAP_H
@@ -0,0 +1,280 @@
+#ifndef EPOCH_H
+#define EPOCH_H
+#include <atomic>
+#include <mutex>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <cassert>
+using namespace std;
+
+//EpochManager defers freeing the objects unlinked from a concurrent structure until no thread
+// can still be reading them. A thread is inside the structure while it holds a Guard, and
+// publishes the global epoch it entered in, in a slot of its own (a cache line no other thread
+// writes), so entering costs no atomic write to a shared cache line.
+// An object is retired with the epoch current when it was unlinked. The global epoch only moves
+// on once every thread inside has entered in the current epoch, so when it has moved on twice
+// since the retirement, every thread inside entered after the object was unlinked, and it is freed.
+// Threads beyond the first MAX_THREADS share one more slot, through a mutex: it holds the epoch
+// the first of them that is inside entered in, until none of them is. (holding an older epoch than
+// a thread entered in only keeps objects longer.)
+class EpochManager
+{
+public:
+    typedef void (*Deleter)(void*);
+
+    static const int MAX_THREADS = 256;            //threads with a slot of their own, the rest share one
+
+    //a thread is inside the structure for the life of its Guards. Guards may nest.
+    class Guard
+    {
+    public:
+        explicit Guard(EpochManager& epochs): manager(epochs) {manager.enter();}
+        ~Guard() {manager.exit();}
+
+    private:
+        EpochManager& manager;
+
+        Guard(const Guard&);
+        Guard& operator =(const Guard&);
+    };
+
+    EpochManager();
+    ~EpochManager();                               //free every object still retired
+
+    void enter();                                  //this thread is inside, until the matching exit()
+    void exit();
+    void retire(void* object, Deleter deleter);    //free object with deleter once no thread can reach it
+    size_t reclaim();                              //move the epoch on if possible, and free what can be freed
+    size_t pending() const;                        //the number of retired objects not freed yet
+
+private:
+    static const uint64_t QUIESCENT = 0;           //the epoch of a thread that is not inside
+    static const size_t RECLAIM_EVERY = 64;        //retirements between two calls to reclaim
+
+    //the slot of one thread, padded so that the slots of two threads never share the line they write.
+    struct Slot
+    {
+        atomic<uint64_t> epoch;                    //the epoch this thread entered in, or QUIESCENT
+        int depth;                                 //the number of Guards of this thread, only it reads this
+        char padding[64 - sizeof(atomic<uint64_t>) - sizeof(int)];
+
+        Slot(): epoch(QUIESCENT), depth(0) {}
+    };
+
+    struct Retired
+    {
+        void* object;
+        Deleter deleter;
+        uint64_t epoch;                            //the global epoch when object was retired
+    };
+
+    static const int SHARED_SLOT = MAX_THREADS;    //the index of the slot the threads beyond MAX_THREADS share
+
+    atomic<uint64_t> globalEpoch;
+    Slot slots[MAX_THREADS + 1];                   //its depth counts the Guards of every thread sharing it
+    mutex sharedLock;                              //held to enter or exit through the shared slot
+
+    mutable mutex retireMutex;
+    vector<Retired> retired;
+    size_t retiredSinceReclaim;
+
+    size_t reclaimLocked();                        //reclaim(), with retireMutex held
+
+    //every thread is given the index of a slot for as long as it runs, the same in every EpochManager.
+    struct IndexTable
+    {
+        mutex lock;
+        vector<bool> used;
+        atomic<int> highWater;                     //one past the highest index handed out
+
+        IndexTable(): highWater(0) {}
+    };
+
+    static IndexTable& indexTable();
+    static int threadIndex();
+    static int acquireIndex();                     //hand out the lowest free index, (SHARED_SLOT if there is none)
+    static void releaseIndex(int index);           //take an index back
+
+    EpochManager(const EpochManager&);
+    EpochManager& operator =(const EpochManager&);
+};
+
+inline EpochManager::EpochManager(): globalEpoch(1), retiredSinceReclaim(0)
+{
+}
+
+//preconditions: no thread is inside.
+//postconditions: every retired object is freed.
+inline EpochManager::~EpochManager()
+{
+    for(size_t i = 0; i < retired.size(); i++)
+        retired[i].deleter(retired[i].object);
+}
+
+//preconditions: none
+//postconditions: this thread's slot holds the global epoch, and the global epoch was still that
+// epoch after the slot was written (so a reclaim that did not see the slot cannot have moved past it).
+// a nested enter only counts the depth.
+inline void EpochManager::enter()
+{
+    int index = threadIndex();
+    unique_lock<mutex> shared;
+    if(index == SHARED_SLOT)
+        shared = unique_lock<mutex>(sharedLock);
+
+    Slot& slot = slots[index];
+    if(slot.depth++ > 0)
+        return;
+
+    uint64_t epoch = globalEpoch.load();
+    for(;;)
+    {
+        slot.epoch.store(epoch, memory_order_relaxed);
+        atomic_thread_fence(memory_order_seq_cst);
+        uint64_t now = globalEpoch.load();
+        if(now == epoch)
+            break;
+        epoch = now;
+    }
+}
+
+//preconditions: this thread called enter()
+//postconditions: when the outermost Guard exits, this thread's slot is QUIESCENT again.
+inline void EpochManager::exit()
+{
+    int index = threadIndex();
+    unique_lock<mutex> shared;
+    if(index == SHARED_SLOT)
+        shared = unique_lock<mutex>(sharedLock);
+
+    Slot& slot = slots[index];
+    assert(slot.depth > 0);
+    if(--slot.depth == 0)
+        slot.epoch.store(QUIESCENT, memory_order_release);
+}
+
+//preconditions: object has been unlinked, so that no thread that enters from now on can reach it.
+//postconditions: object is added to the retired list with the current epoch,
+// and every RECLAIM_EVERY retirements, the list is reclaimed.
+inline void EpochManager::retire(void* object, Deleter deleter)
+{
+    lock_guard<mutex> guard(retireMutex);
+    Retired entry = {object, deleter, globalEpoch.load()};
+    retired.push_back(entry);
+
+    if(++retiredSinceReclaim >= RECLAIM_EVERY)
+        reclaimLocked();
+}
+
+//preconditions: none
+//postconditions: same as reclaimLocked. returns the number of objects freed.
+inline size_t EpochManager::reclaim()
+{
+    lock_guard<mutex> guard(retireMutex);
+    return reclaimLocked();
+}
+
+//preconditions: retireMutex is held.
+//postconditions: if every thread inside entered in the current epoch, the epoch moves on. then every
+// object retired two or more epochs ago is freed. returns the number of objects freed.
+inline size_t EpochManager::reclaimLocked()
+{
+    retiredSinceReclaim = 0;
+
+    uint64_t epoch = globalEpoch.load();
+    bool allCurrent = true;
+    int threads = indexTable().highWater.load();
+    for(int i = 0; i < threads && allCurrent; i++)
+    {
+        uint64_t seen = slots[i].epoch.load();
+        if(seen != QUIESCENT && seen != epoch)
+            allCurrent = false;
+    }
+    uint64_t shared = slots[SHARED_SLOT].epoch.load();
+    if(shared != QUIESCENT && shared != epoch)
+        allCurrent = false;
+    if(allCurrent)
+        globalEpoch.compare_exchange_strong(epoch, epoch + 1);
+
+    uint64_t now = globalEpoch.load();
+    size_t kept = 0;
+    for(size_t i = 0; i < retired.size(); i++)
+    {
+        if(retired[i].epoch + 2 <= now)
+            retired[i].deleter(retired[i].object);
+        else
+            retired[kept++] = retired[i];
+    }
+
+    size_t freed = retired.size() - kept;
+    retired.resize(kept);
+    return freed;
+}
+
+//preconditions: none
+//postconditions: the number of retired objects that are not freed yet.
+inline size_t EpochManager::pending() const
+{
+    lock_guard<mutex> guard(retireMutex);
+    return retired.size();
+}
+
+//preconditions: none
+//postconditions: returns the table of slot indices, shared by every EpochManager.
+inline EpochManager::IndexTable& EpochManager::indexTable()
+{
+    static IndexTable table;
+    return table;
+}
+
+//preconditions: none
+//postconditions: returns this thread's slot index, acquired on its first call,
+// and given back when the thread ends.
+inline int EpochManager::threadIndex()
+{
+    struct Registration
+    {
+        int index;
+        Registration(): index(acquireIndex()) {}
+        ~Registration() {releaseIndex(index);}
+    };
+    static thread_local Registration registration;
+    return registration.index;
+}
+
+//preconditions: none
+//postconditions: returns the lowest index not in use, marking it used. if MAX_THREADS indices are
+// in use, returns SHARED_SLOT, (which any number of threads may hold).
+inline int EpochManager::acquireIndex()
+{
+    IndexTable& table = indexTable();
+    lock_guard<mutex> guard(table.lock);
+
+    size_t i = 0;
+    while(i < table.used.size() && table.used[i])
+        i++;
+    if(i == size_t(MAX_THREADS))
+        return SHARED_SLOT;
+
+    if(i == table.used.size())
+        table.used.push_back(true);
+    else
+        table.used[i] = true;
+    if(int(i) + 1 > table.highWater.load())
+        table.highWater.store(int(i) + 1);
+    return int(i);
+}
+
+//preconditions: index was acquired by a thread that is ending, (outside of every EpochManager).
+//postconditions: index can be handed out again.
+inline void EpochManager::releaseIndex(int index)
+{
+    if(index == SHARED_SLOT)
+        return;
+    IndexTable& table = indexTable();
+    lock_guard<mutex> guard(table.lock);
+    table.used[index] = false;
+}
+
+#endif // EPOCH_H
@@ -21,21 +21,126 @@
 #include "bplustree.h"
 #include "map.h"
 #include "multimap.h"
+#include "concurrentmap.h"
+#include "concurrentmultimap.h"
+#include "persistentbplustree.h"
+#include "mappedbplustree.h"
+#include "durablemap.h"
+#include "pagedbplustree.h"
+#include <algorithm>
+#include <cstdio>
+#include <csignal>
+#include <cstring>
+#include <fstream>
 #include <iostream>
 #include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <sys/resource.h>
 using namespace std;
 
+//a value that owns heap memory, and counts every allocation it makes.
+// copies allocate, moves do not, so any deep copy made by the tree shows up in allocations.
+struct Tracked
+{
+    static int allocations;
+    int* payload;
+
+    Tracked(): payload(nullptr) {}
+    explicit Tracked(int value): payload(new int(value)) {allocations++;}
+    Tracked(const Tracked& other): payload(nullptr) {*this = other;}
+    Tracked(Tracked&& other) noexcept: payload(other.payload) {other.payload = nullptr;}
+    ~Tracked() {delete payload;}
+
+    Tracked& operator =(const Tracked& other)
+    {
+        if(this != &other)
+        {
+            delete payload;
+            payload = nullptr;
+            if(other.payload)
+            {
+                payload = new int(*other.payload);
+                allocations++;
+            }
+        }
+        return *this;
+    }
+
+    Tracked& operator =(Tracked&& other) noexcept
+    {
+        if(this != &other)
+        {
+            delete payload;
+            payload = other.payload;
+            other.payload = nullptr;
+        }
+        return *this;
+    }
+};
+int Tracked::allocations = 0;
+
+template <int MinDegree>
 bool testBTreeAuto(int how_many, bool report);
+template <int MinDegree>
 void testBTreeAuto(int tree_size, int how_many, bool report);
 void testIterator();
+void testBTreeDupsAuto(int n, int iterations);
+void testBulkLoad(int maxItems);
+void testNodePool(int n, int rounds);
+void testRangeScan(int n, int iterations);
+void testInsertOrGet(int n, int iterations);
+void testBatch(int n, int iterations);
+void testNoDeepCopies(int n);
+void testConcurrentMap(int threads, int n);
+void testConcurrentScan(int threads, int n);
+void testPersistentSnapshots(int n, int rounds);
+void testMappedFile(int n);
+void testSaveLoad(int n);
+void removeDurableFiles(const string& path);
+void testDurableMap(int n);
+void testPagedTree(int n);
+void testStringKeys(int n, int iterations);
+template <typename List>
+bool valueListRounds(int rounds, typename List::value_type (*makeValue)(int));
+void testValueLists(int n, int rounds);
+void testLookups(int n);
+template <int MinDegree>
+bool multiFindRounds(int n);
+void testMultiFind(int n, int iterations);
+template <int MinDegree>
+bool findManyRounds(int n, bool dups);
+void testFindMany(int n, int iterations);
 void autoMapTest(int n, int iterations);
 void autoMMapTest(int n, int iterations);
 
 int main()
 {
-    testBTreeAuto(1000,100,true);
-    testBTreeAuto(1000,100,false);
+    testBTreeAuto<DefaultMinDegree<int>::value>(1000,100,true);
+    testBTreeAuto<DefaultMinDegree<int>::value>(1000,100,false);
+    testBTreeAuto<1>(1000,100,false);
+    testBTreeAuto<3>(1000,100,false);
     testIterator();
+    testBTreeDupsAuto(1000,100);
+    testBulkLoad(500);
+    testNodePool(2000,5);
+    testRangeScan(500,50);
+    testInsertOrGet(500,50);
+    testBatch(500,50);
+    testNoDeepCopies(2000);
+    testConcurrentMap(4,2000);
+    testConcurrentScan(4,2000);
+    testPersistentSnapshots(1000,50);
+    testMappedFile(2000);
+    testSaveLoad(2000);
+    testDurableMap(2000);
+    testPagedTree(3000);
+    testStringKeys(500,20);
+    testValueLists(2000,200);
+    testLookups(2000);
+    testMultiFind(2000,20);
+    testFindMany(2000,20);
     autoMMapTest(1000,100);
     autoMapTest(1000,100);
 
@@ -73,6 +178,16 @@ void testIterator()
     cout<<"{"<<*(it++)<<"}"<<endl;
     cout<<"{"<<*it<<"}"<<endl;
 
+    cout<<"test -- operator: "<<endl;
+    it = bpt.end();
+    cout<<"{"<<*(--it)<<"}"<<endl;
+    cout<<"{"<<*(--it)<<"}"<<endl;
+
+    cout<<"------------------------------------------------------------"<<endl;
+    for(BPlusTree<int>::ReverseIterator rit = bpt.rbegin(); rit != bpt.rend(); ++rit)
+        cout<<"["<<*rit<<"] <-";
+    cout<<endl;
+
     for(int k = 0; k < 125; k++)
     {
         for (int i = k; i<125; i++)
@@ -88,6 +203,7 @@ void testIterator()
 
 //preconditions: howMany < MAX
 //postconditions: this function will call testBTreeAuto(int,bool) to test the BTree class.
+template <int MinDegree>
 void testBTreeAuto(int treeSize, int howMany, bool report)
 {
     bool verified = true;
@@ -100,7 +216,7 @@ void testBTreeAuto(int treeSize, int howMany, bool report)
             cout<<"*********************************************************"<<endl;
         }
 
-        if(!testBTreeAuto(treeSize, report))
+        if(!testBTreeAuto<MinDegree>(treeSize, report))
         {
             cout<<"T E S T :   ["<<i<<"]    F A I L E D ! ! !"<<endl;
             verified = false;
@@ -110,7 +226,7 @@ void testBTreeAuto(int treeSize, int howMany, bool report)
 
     cout<<"**************************************************************************"<<endl;
     cout<<"**************************************************************************"<<endl;
-    cout<<"             E N D     T E S T: "<<howMany<<" tests of "<<treeSize<<" items: ";
+    cout<<"             E N D     T E S T: "<<howMany<<" tests of "<<treeSize<<" items (MinDegree "<<MinDegree<<"): ";
     cout<<(verified?"VERIFIED": "VERIFICATION FAILED")<<endl;
     cout<<"**************************************************************************"<<endl;
     cout<<"**************************************************************************"<<endl;
@@ -122,11 +238,12 @@ void testBTreeAuto(int treeSize, int howMany, bool report)
 // shuffling the array of items, then deleting each one of them,
 // after each item is inserted or removed, the verify function is called
 // to ensure that all conditions required for a B+tree are met.
+template <int MinDegree>
 bool testBTreeAuto(int howMany, bool report)
 {
     const int MAX = 10000;
     assert(howMany < MAX);
-    BPlusTree<int> bt;
+    BPlusTree<int, MinDegree> bt;
     int a[MAX];
     int original[MAX];
     int deletedList[MAX];
@@ -171,13 +288,13 @@ bool testBTreeAuto(int howMany, bool report)
             cout<<"========================================================"<<endl;
         }
 
-        BPlusTree<int>::Iterator it = bt.begin();
+        typename BPlusTree<int, MinDegree>::Iterator it = bt.begin();
         bool validIterator = true;
         int count = 0;
 
         while(it != bt.end() && validIterator)
         {
-            BPlusTree<int>::Iterator current = it;
+            typename BPlusTree<int, MinDegree>::Iterator current = it;
             ++it;
 
             if(!it.is_null() && *it <= *current)
@@ -202,6 +319,2065 @@ bool testBTreeAuto(int howMany, bool report)
     return true;
 }
 
+//preconditions: none
+//postconditions: a B+Tree that allows duplicates will be tested by inserting and removing
+// many random items from a small range, so that runs of equal keys span several leaves.
+// After each insertion or removal the tree is verified with isValid(), and the number of
+// copies of each key found by the iterator is compared against the expected count.
+void testBTreeDupsAuto(int n, int iterations)
+{
+    cout << string(50,'=') << endl
+         << "Starting duplicate key auto test with: items = " << n << ", over iterations = " << iterations
+         << endl << string(50,'=') << endl;
+
+    const int RANGE = 20;
+    bool isValid = true;
+    for(int j = 0; j < iterations && isValid; j++)
+    {
+        BPlusTree<int, 2> bt(true);
+        int counts[RANGE] = {0};
+        int size = 0;
+
+        for(int i = 0; i < n && isValid; i++)
+        {
+            int key = rand() % RANGE;
+            if(rand() % 2)
+            {
+                bt.insert(key);
+                counts[key]++;
+                size++;
+            }
+            else if(bt.remove(key) != (counts[key] > 0))
+            {
+                isValid = false;
+                cout << "Error, remove returned the wrong result for key: " << key << endl;
+            }
+            else if(counts[key] > 0)
+            {
+                counts[key]--;
+                size--;
+            }
+
+            if(!bt.isValid() || bt.size() != size)
+            {
+                isValid = false;
+                cout << "Error, tree with duplicates is invalid after key: " << key << endl;
+            }
+        }
+
+        int found[RANGE] = {0};
+        for(BPlusTree<int, 2>::Iterator it = bt.begin(); it != bt.end(); ++it)
+            found[*it]++;
+
+        //walking backwards must visit the same items, in descending order.
+        int foundBackwards[RANGE] = {0};
+        int last = RANGE;
+        for(BPlusTree<int, 2>::ReverseIterator rit = bt.rbegin(); rit != bt.rend(); ++rit)
+        {
+            foundBackwards[*rit]++;
+            if(*rit > last)
+                isValid = false;
+            last = *rit;
+        }
+
+        for(int k = 0; k < RANGE; k++)
+        {
+            if(found[k] != counts[k] || foundBackwards[k] != counts[k])
+            {
+                isValid = false;
+                cout << "Error, expected " << counts[k] << " copies of " << k << " but found " << found[k]
+                     << " (" << foundBackwards[k] << " backwards)" << endl;
+            }
+        }
+    }
+
+    cout << string(50,'=') << endl
+         << (isValid ? "Duplicate Key Test Passed." : "Duplicate Key Test Failed!")
+         << endl << string(50,'=') << endl;
+}
+
+//preconditions: none
+//postconditions: B+Trees will be bulk loaded from sorted arrays of every size up to maxItems,
+// at several fill factors. Each tree is verified with isValid(), its items are checked with
+// the iterator, and then half of them are removed and the tree is verified again.
+void testBulkLoad(int maxItems)
+{
+    cout << string(50,'=') << endl
+         << "Starting bulk load test with: sizes up to " << maxItems
+         << endl << string(50,'=') << endl;
+
+    const double FILL_FACTORS[] = {0.1, 0.5, 0.75, 1.0};
+    bool isValid = true;
+    int * a = new int[maxItems];
+    for(int i = 0; i < maxItems; i++)
+        a[i] = 2 * i;
+
+    for(int n = 0; n <= maxItems && isValid; n++)
+    {
+        for(int f = 0; f < 4 && isValid; f++)
+        {
+            BPlusTree<int, 3> bt;
+            bt.insert(-1);
+            bt.bulkLoad(a, a + n, FILL_FACTORS[f]);
+
+            int count = 0;
+            for(BPlusTree<int, 3>::Iterator it = bt.begin(); it != bt.end(); ++it, ++count)
+                if(count >= n || *it != a[count])
+                    isValid = false;
+
+            if(!isValid || count != n || bt.size() != n || !bt.isValid())
+            {
+                isValid = false;
+                cout << "Error, bulk loading " << n << " items at fill factor " << FILL_FACTORS[f] << " failed." << endl;
+            }
+
+            for(int i = 0; i < n && isValid; i += 2)
+            {
+                if(!bt.remove(a[i]) || !bt.isValid())
+                {
+                    isValid = false;
+                    cout << "Error, removing " << a[i] << " from a bulk loaded tree of " << n << " items failed." << endl;
+                }
+            }
+        }
+    }
+    delete [] a;
+
+    cout << string(50,'=') << endl
+         << (isValid ? "Bulk Load Test Passed." : "Bulk Load Test Failed!")
+         << endl << string(50,'=') << endl;
+}
+
+//preconditions: none
+//postconditions: a B+Tree will be filled with n shuffled integers and emptied again, rounds times.
+// after the first round, the freed nodes must be reused without requesting any more slabs,
+// every node must be returned once the tree is empty, and clearTree must release all slabs.
+// every leaf must start on a cache line, so the first items of the full leaves of a bulk loaded tree
+// sit at the same offset in a line.
+void testNodePool(int n, int rounds)
+{
+    cout << string(50,'=') << endl
+         << "Starting node pool test with: " << n << " items, " << rounds << " rounds"
+         << endl << string(50,'=') << endl;
+
+    bool isValid = true;
+    int * a = new int[n];
+    for(int i = 0; i < n; i++)
+        a[i] = i;
+
+    BPlusTree<int, 2> bt;
+    size_t slabsAfterFirstRound = 0;
+    for(int r = 0; r < rounds && isValid; r++)
+    {
+        shuffleArray(a,n);
+        for(int i = 0; i < n; i++)
+            bt.insert(a[i]);
+        shuffleArray(a,n);
+        for(int i = 0; i < n; i++)
+            bt.remove(a[i]);
+
+        PoolStats stats = bt.allocationStats();
+        if(r == 0)
+            slabsAfterFirstRound = stats.slabAllocations;
+
+        //only the empty root leaf is left.
+        if(!bt.empty() || !bt.isValid() || stats.liveBlocks() != 1 || stats.slabAllocations != slabsAfterFirstRound)
+        {
+            isValid = false;
+            cout << "Error, round " << r << " left " << stats.liveBlocks() << " live nodes in "
+                 << stats.slabAllocations << " slabs." << endl;
+        }
+    }
+
+    for(int i = 0; i < n; i++)
+        bt.insert(a[i]);
+    if(BPlusTree<int, 2>::leafBytes() % CACHE_LINE_BYTES != 0 || BPlusTree<int, 2>::innerBytes() % CACHE_LINE_BYTES != 0)
+        isValid = false;
+    vector<int> sorted(a, a + n);
+    sort(sorted.begin(), sorted.end());
+    BPlusTree<int, 2> full;
+    full.bulkLoad(sorted.begin(), sorted.end());   //4 items to a leaf, (but the last two leaves may be shorter)
+    uintptr_t offset = uintptr_t(&*full.begin()) % CACHE_LINE_BYTES;
+    for(BPlusTree<int, 2>::Iterator it = full.begin(); it != full.end() && *it < n - 8 && isValid; it++)
+        if(*it % 4 == 0 && uintptr_t(&*it) % CACHE_LINE_BYTES != offset)
+        {
+            isValid = false;
+            cout << "Error, the leaf of " << *it << " does not start on a cache line." << endl;
+        }
+    size_t allocations = bt.allocationStats().allocations;
+    bt.clearTree();
+    PoolStats cleared = bt.allocationStats();
+    if(cleared.liveBlocks() != 1 || cleared.allocations != allocations + 1 || !bt.empty() || !bt.isValid())
+    {
+        isValid = false;
+        cout << "Error, clearTree left " << cleared.liveBlocks() << " live nodes." << endl;
+    }
+    cout << bt.allocationStats().allocations << " node allocations served by "
+         << bt.allocationStats().slabAllocations << " slab allocations." << endl;
+    delete [] a;
+
+    cout << string(50,'=') << endl
+         << (isValid ? "Node Pool Test Passed." : "Node Pool Test Failed!")
+         << endl << string(50,'=') << endl;
+}
+
+//preconditions: none
+//postconditions: B+Trees with duplicates will be filled with n random even keys, then for every key k
+// (and the odd keys between them) lower_bound, upper_bound and equal_range are checked against the
+// expected counts, and every range [a, b) is counted by walking from lower_bound(a) to lower_bound(b).
+// Then the range functions of Map and MMap are checked on maps of the even keys.
+void testRangeScan(int n, int iterations)
+{
+    cout << string(50,'=') << endl
+         << "Starting range scan test with: items = " << n << ", over iterations = " << iterations
+         << endl << string(50,'=') << endl;
+
+    const int RANGE = 40;
+    bool isValid = true;
+    for(int j = 0; j < iterations && isValid; j++)
+    {
+        BPlusTree<int, 2> bt(true);
+        int counts[RANGE + 1] = {0};
+        for(int i = 0; i < n; i++)
+        {
+            int key = 2 * (rand() % (RANGE / 2));
+            bt.insert(key);
+            counts[key]++;
+        }
+
+        //below[k] is the number of items less than k.
+        int below[RANGE + 2] = {0};
+        for(int k = 0; k <= RANGE; k++)
+            below[k + 1] = below[k] + counts[k];
+
+        for(int k = 0; k <= RANGE && isValid; k++)
+        {
+            BPlusTree<int, 2>::Iterator lower = bt.lower_bound(k);
+            BPlusTree<int, 2>::Iterator upper = bt.upper_bound(k);
+            pair<BPlusTree<int, 2>::Iterator, BPlusTree<int, 2>::Iterator> range = bt.equal_range(k);
+
+            int equal = 0;
+            for(BPlusTree<int, 2>::Iterator it = range.first; it != range.second; ++it)
+                if(*it == k)
+                    equal++;
+
+            if(range.first != lower || range.second != upper || equal != counts[k]
+               || (below[k] < n && (lower.is_null() || *lower < k))
+               || (below[k + 1] < n && (upper.is_null() || *upper <= k))
+               || (below[k + 1] == n && !upper.is_null()))
+            {
+                isValid = false;
+                cout << "Error, the bounds of " << k << " are wrong." << endl;
+            }
+
+            for(int b = k; b <= RANGE && isValid; b += 7)
+            {
+                int inRange = 0;
+                for(BPlusTree<int, 2>::Iterator it = lower; it != bt.lower_bound(b); ++it)
+                    inRange++;
+                if(inRange != below[b] - below[k])
+                {
+                    isValid = false;
+                    cout << "Error, expected " << below[b] - below[k] << " items in [" << k << ", " << b
+                         << ") but found " << inRange << endl;
+                }
+            }
+        }
+    }
+
+    Map<int,int> map;
+    MMap<int,int> mmap;
+    for(int k = 0; k < RANGE; k += 2)
+    {
+        map[k] = k * 10;
+        mmap[k] += k;
+        mmap[k] += k + 1;
+    }
+    for(int k = 0; k < RANGE - 1 && isValid; k++)
+    {
+        int next = (k % 2) ? k + 1 : k;
+        Map<int,int>::Iterator mapIt = map.lower_bound(k);
+        MMap<int,int>::Iterator mmapIt = mmap.upper_bound(k);
+        if(mapIt == map.end() || mapIt.key() != next || *mapIt != next * 10
+           || (k + 2 < RANGE - 1 && (mmapIt == mmap.end() || mmapIt.key() != k + 1 + (k % 2 == 0))))
+        {
+            isValid = false;
+            cout << "Error, the map bounds of " << k << " are wrong." << endl;
+        }
+
+        pair<MMap<int,int>::Iterator, MMap<int,int>::Iterator> values = mmap.equal_range(k);
+        int valueCount = 0;
+        for(MMap<int,int>::Iterator it = values.first; it != values.second; ++it)
+            valueCount++;
+        if(valueCount != ((k % 2) ? 0 : 2))
+        {
+            isValid = false;
+            cout << "Error, expected " << ((k % 2) ? 0 : 2) << " values of " << k << " but found " << valueCount << endl;
+        }
+    }
+
+    //the maps walked backwards, from their last key down.
+    int expectedKey = RANGE - 2;
+    for(Map<int,int>::ReverseIterator rit = map.rbegin(); rit != map.rend(); ++rit, expectedKey -= 2)
+        if(*rit != expectedKey * 10)
+            isValid = false;
+    int expectedValue = RANGE - 1;      //the values of k are k and k+1
+    for(MMap<int,int>::ReverseIterator rit = mmap.rbegin(); rit != mmap.rend(); ++rit)
+    {
+        if(*rit != expectedValue)
+            isValid = false;
+        expectedValue--;
+    }
+    if(expectedKey != -2 || expectedValue != -1)
+    {
+        isValid = false;
+        cout << "Error, the maps walked backwards stopped early." << endl;
+    }
+
+    cout << string(50,'=') << endl
+         << (isValid ? "Range Scan Test Passed." : "Range Scan Test Failed!")
+         << endl << string(50,'=') << endl;
+}
+
+//preconditions: none
+//postconditions: n random keys (some repeated) will be passed to insert_or_get on small B+Trees,
+// checking that each call returns an iterator to the key, and that it inserts only new keys.
+// Then Map::insert and try_emplace are checked to keep the first value of a key,
+// even when that value is default constructed, and try_emplace and insert not to move from a value they do not insert.
+void testInsertOrGet(int n, int iterations)
+{
+    cout << string(50,'=') << endl
+         << "Starting insert or get test with: items = " << n << ", over iterations = " << iterations
+         << endl << string(50,'=') << endl;
+
+    bool isValid = true;
+    for(int j = 0; j < iterations && isValid; j++)
+    {
+        BPlusTree<int, 1> bt;
+        vector<bool> present(n, false);
+        int size = 0;
+        for(int i = 0; i < n && isValid; i++)
+        {
+            int key = rand() % n;
+            pair<BPlusTree<int, 1>::Iterator, bool> result = bt.insert_or_get(key);
+            if(result.second)
+                size++;
+
+            if(result.first.is_null() || *result.first != key || result.second == present[key]
+               || bt.size() != size || !bt.isValid())
+            {
+                isValid = false;
+                cout << "Error, insert_or_get returned the wrong result for key: " << key << endl;
+            }
+            present[key] = true;
+        }
+    }
+
+    Map<int,int> map;
+    if(!map.insert(1,0) || map.insert(1,5) || map[1] != 0)
+    {
+        isValid = false;
+        cout << "Error, Map::insert replaced a default constructed value." << endl;
+    }
+    pair<Map<int,int>::Iterator, bool> emplaced = map.try_emplace(2,7);
+    pair<Map<int,int>::Iterator, bool> existing = map.try_emplace(2,8);
+    if(!emplaced.second || existing.second || *existing.first != 7 || emplaced.first != existing.first)
+    {
+        isValid = false;
+        cout << "Error, Map::try_emplace returned the wrong result." << endl;
+    }
+    Map<int,string> names;
+    string first = "first", second = "second", third = "third";
+    if(!names.try_emplace(1,std::move(first)).second || names.try_emplace(1,std::move(second)).second
+       || names.insert(1,std::move(third)) || names[1] != "first" || second != "second" || third != "third")
+    {
+        isValid = false;
+        cout << "Error, Map::try_emplace or insert moved from a value it did not insert." << endl;
+    }
+
+    cout << string(50,'=') << endl
+         << (isValid ? "Insert Or Get Test Passed." : "Insert Or Get Test Failed!")
+         << endl << string(50,'=') << endl;
+}
+
+//preconditions: n > 0
+//postconditions: 20 batches of up to n random keys in [0, n) are inserted into (or erased from) a tree,
+// returning false as soon as a batch inserts or removes the wrong number of items, or leaves the tree
+// with the wrong size, the wrong items (forwards or backwards, so the leaf links are checked), or invalid.
+template <int MinDegree>
+bool batchRounds(int n, bool dups)
+{
+    BPlusTree<int, MinDegree> bt(dups);
+    vector<int> counts(n, 0);
+    int size = 0;
+
+    for(int round = 0; round < 20; round++)
+    {
+        vector<int> batch;
+        int batchSize = rand() % n;
+        for(int i = 0; i < batchSize; i++)
+            batch.push_back(rand() % n);
+
+        int expected = 0;
+        if(round % 3 != 2)
+        {
+            for(size_t i = 0; i < batch.size(); i++)
+                if(dups || counts[batch[i]] == 0)
+                {
+                    counts[batch[i]]++;
+                    expected++;
+                }
+            if(bt.insertBatch(batch.begin(), batch.end()) != expected)
+                return false;
+            size += expected;
+        }
+        else
+        {
+            for(size_t i = 0; i < batch.size(); i++)
+                if(counts[batch[i]] > 0)
+                {
+                    counts[batch[i]]--;
+                    expected++;
+                }
+            if(bt.eraseBatch(batch.begin(), batch.end()) != expected)
+                return false;
+            size -= expected;
+        }
+
+        vector<int> items;
+        for(int key = 0; key < n; key++)
+            items.insert(items.end(), counts[key], key);
+        vector<int> forwards(bt.begin(), bt.end());
+        vector<int> backwards(bt.rbegin(), bt.rend());
+        reverse(backwards.begin(), backwards.end());
+        if(bt.size() != size || forwards != items || backwards != items || !bt.isValid())
+            return false;
+    }
+    return true;
+}
+
+//preconditions: n > 0
+//postconditions: the keys [0, n) are inserted into a tree one at a time (so it is deep), then about nine
+// in ten of a range of them are erased in one batch, which empties whole subtrees. returns false if the
+// tree is left invalid, or if removing the keys that survived, one at a time, leaves it invalid or wrong.
+template <int MinDegree>
+bool rangeEraseRounds(int n, int from, int to)
+{
+    BPlusTree<int, MinDegree> bt;
+    for(int key = 0; key < n; key++)
+        bt.insert(key);
+
+    vector<int> batch, survivors;
+    for(int key = from; key < to; key++)
+        (key % 10 == 3 ? survivors : batch).push_back(key);
+    if(bt.eraseBatch(batch.begin(), batch.end()) != int(batch.size()) || !bt.isValid())
+        return false;
+
+    for(size_t i = 0; i < survivors.size(); i++)
+        if(!bt.remove(survivors[i]) || !bt.isValid())
+            return false;
+    return bt.size() == n - (to - from) && !bt.contains(from + 3) && bt.contains(to);
+}
+
+//preconditions: n > 0
+//postconditions: batches of random keys (some repeated, unsorted) will be passed to insertBatch and
+// eraseBatch on B+Trees of MinDegree 1 and 3, with and without dups, with batchRounds.
+// A range of a deep tree is erased in a batch, then the rest of it one key at a time, with rangeEraseRounds.
+// Then Map::insertBatch is checked to keep the values already there, and the first of a repeated key,
+// and Map::insert(k, v) with a key and value of the same type to insert that one pair.
+void testBatch(int n, int iterations)
+{
+    cout << string(50,'=') << endl
+         << "Starting batch test with: items = " << n << ", over iterations = " << iterations
+         << endl << string(50,'=') << endl;
+
+    bool isValid = true;
+    for(int j = 0; j < iterations && isValid; j++)
+    {
+        bool dups = (j % 2 == 1);
+        if(!batchRounds<1>(n, dups) || !batchRounds<3>(n, dups))
+        {
+            isValid = false;
+            cout << "Error, a batch left the wrong items in a tree (dups = " << dups << ")." << endl;
+        }
+    }
+    int deep = 4 * n;
+    if(!rangeEraseRounds<1>(deep, deep / 20, deep - deep / 20) || !rangeEraseRounds<3>(deep, deep / 20, deep - deep / 20)
+       || !rangeEraseRounds<1>(deep, 0, deep / 2) || !rangeEraseRounds<3>(deep, deep / 3, deep - 1))
+    {
+        isValid = false;
+        cout << "Error, a batch erase left a tree that single removes could not fix." << endl;
+    }
+
+    Map<string, int> map;
+    map.insert("b", 1);
+    vector<pair<string, int> > pairs;
+    pairs.push_back(make_pair("c", 3));
+    pairs.push_back(make_pair("a", 1));
+    pairs.push_back(make_pair("b", 2));
+    pairs.push_back(make_pair("c", 4));
+    vector<string> gone(1, "a");
+    if(map.insertBatch(pairs.begin(), pairs.end()) != 2 || map["a"] != 1 || map["b"] != 1 || map["c"] != 3
+       || map.eraseBatch(gone.begin(), gone.end()) != 1 || map.size() != 2 || !map.isValid())
+    {
+        isValid = false;
+        cout << "Error, Map::insertBatch replaced a value." << endl;
+    }
+
+    Map<int, long> numbers;
+    Map<string, string> words;
+    if(!numbers.insert(1, 2) || !numbers.contains(1) || numbers[1] != 2 || numbers.size() != 1
+       || !words.insert("k", "v") || words["k"] != "v" || words.size() != 1)
+    {
+        isValid = false;
+        cout << "Error, Map::insert(k, v) did not insert the pair (k, v)." << endl;
+    }
+
+    cout << string(50,'=') << endl
+         << (isValid ? "Batch Test Passed." : "Batch Test Failed!")
+         << endl << string(50,'=') << endl;
+}
+
+//preconditions: none
+//postconditions: n Tracked values will be moved into a Map and an MMap of MinDegree 1 (so that
+// nearly every insert and erase splits, merges or rotates nodes), in shuffled order, then read
+// back and erased in another shuffled order. The only allocations allowed are the n made by
+// the test itself for each container: the trees must move values around, never copy them.
+// Then string keys (which a move empties) are inserted and erased at random in a Map of MinDegree 1,
+// which must stay valid and keep its keys.
+void testNoDeepCopies(int n)
+{
+    cout << string(50,'=') << endl
+         << "Starting no deep copies test with: items = " << n
+         << endl << string(50,'=') << endl;
+
+    bool isValid = true;
+    int * keys = new int[n];
+    for(int i = 0; i < n; i++)
+        keys[i] = i;
+
+    Tracked::allocations = 0;
+    Map<int, Tracked, 1> map;
+    shuffleArray(keys,n);
+    for(int i = 0; i < n; i++)
+        map.insert(keys[i], Tracked(keys[i]));
+    for(int i = 0; i < n; i++)
+        if(!map[i].payload || *map[i].payload != i)
+            isValid = false;
+    shuffleArray(keys,n);
+    for(int i = 0; i < n; i++)
+        map.erase(keys[i]);
+
+    if(!isValid || !map.empty() || Tracked::allocations != n)
+    {
+        isValid = false;
+        cout << "Error, Map made " << Tracked::allocations - n << " deep copies." << endl;
+    }
+
+    Tracked::allocations = 0;
+    MMap<int, Tracked, 1> mmap;
+    shuffleArray(keys,n);
+    for(int i = 0; i < n; i++)
+        mmap.insert(keys[i] / 2, Tracked(keys[i]));
+    for(int i = 0; i < n / 2; i++)
+        if(mmap[i].size() != 2 || *mmap[i][0].payload / 2 != i || *mmap[i][1].payload / 2 != i)
+            isValid = false;
+    shuffleArray(keys,n);
+    for(int i = 0; i < n; i++)
+        mmap.erase(keys[i] / 2);
+
+    if(!isValid || !mmap.empty() || Tracked::allocations != n)
+    {
+        isValid = false;
+        cout << "Error, MMap made " << Tracked::allocations - n << " deep copies." << endl;
+    }
+    delete [] keys;
+
+    //moving a string empties it, so an item moved onto itself (a shift by 0 in mergeFront)
+    // loses its key: random inserts and erases at MinDegree 1 merge inner nodes all the time.
+    Map<string, int, 1> strings;
+    vector<int> counts(n, 0);
+    for(int i = 0; i < 4 * n && isValid; i++)
+    {
+        int key = rand() % n;
+        if(rand() % 2)
+        {
+            strings.insert(to_string(key), key);
+            counts[key] = 1;
+        }
+        else if(counts[key])
+        {
+            strings.erase(to_string(key));
+            counts[key] = 0;
+        }
+        if(strings.contains(to_string(key)) != (counts[key] == 1) || (i % 16 == 0 && !strings.isValid()))
+        {
+            isValid = false;
+            cout << "Error, a Map of string keys lost a key when its nodes merged." << endl;
+        }
+    }
+
+    cout << string(50,'=') << endl
+         << (isValid ? "No Deep Copies Test Passed." : "No Deep Copies Test Failed!")
+         << endl << string(50,'=') << endl;
+}
+
+//preconditions: threads > 0
+//postconditions: threads will insert, find and erase their own n keys in a ConcurrentMap of ints
+// (optimistic readers) at once, then upsert the same n string keys in a ConcurrentMap
+// (shared readers), and append to the same keys of a ConcurrentMMap. MinDegree 1 makes
+// nearly every change split, merge or rotate. The results are checked after the threads join.
+void testConcurrentMap(int threads, int n)
+{
+    cout << string(50,'=') << endl
+         << "Starting concurrent map test with: threads = " << threads << ", items = " << n
+         << endl << string(50,'=') << endl;
+
+    ConcurrentMap<int, int, 1> map;
+    ConcurrentMap<string, int, 1> counters;
+    ConcurrentMMap<string, int, 2> mmap;
+    vector<int> errors(threads, 0);
+    vector<thread> workers;
+
+    for(int t = 0; t < threads; t++)
+        workers.push_back(thread([&, t]()
+        {
+            //thread t owns the keys k with k % threads == t.
+            for(int i = 0; i < n; i++)
+            {
+                int key = i * threads + t;
+                int value = 0;
+                if(!map.insert(key, -key) || map.insert(key, key))
+                    errors[t]++;
+                if(!map.get(key, value) || value != -key)
+                    errors[t]++;
+                map.insert_or_assign(key, key);
+            }
+            for(int i = 0; i < n; i += 2)
+                if(!map.erase(i * threads + t) || map.contains(i * threads + t))
+                    errors[t]++;
+
+            for(int i = 0; i < n; i++)
+            {
+                counters.upsert(to_string(i), [](int& count) {count++;});
+                mmap.insert(to_string(i % 100), t);
+            }
+        }));
+
+    for(int t = 0; t < threads; t++)
+        workers[t].join();
+
+    bool isValid = map.isValid() && counters.isValid() && mmap.isValid();
+    for(int t = 0; t < threads; t++)
+        if(errors[t] != 0)
+            isValid = false;
+
+    if(map.size() != threads * (n / 2))
+        isValid = false;
+    for(int key = 0; key < threads * n && isValid; key++)
+    {
+        int value = -1;
+        bool erased = (key / threads) % 2 == 0;
+        if(map.get(key, value) == erased || (!erased && value != key))
+        {
+            isValid = false;
+            cout << "Error, the ConcurrentMap lost key: " << key << endl;
+        }
+    }
+
+    for(int i = 0; i < n && isValid; i++)
+    {
+        int count = 0;
+        if(!counters.get(to_string(i), count) || count != threads)
+        {
+            isValid = false;
+            cout << "Error, ConcurrentMap::upsert lost an update of key: " << i << endl;
+        }
+    }
+
+    int values = 0;
+    for(int i = 0; i < 100; i++)
+        values += mmap.count(to_string(i));
+    if(values != threads * n)
+    {
+        isValid = false;
+        cout << "Error, the ConcurrentMMap holds " << values << " values." << endl;
+    }
+
+    cout << string(50,'=') << endl
+         << (isValid ? "Concurrent Map Test Passed." : "Concurrent Map Test Failed!")
+         << endl << string(50,'=') << endl;
+}
+
+//preconditions: threads > 1
+//postconditions: the even keys 0, 2, ... 2(n-1) stay in a ConcurrentMap of MinDegree 1, while half
+// of the threads insert and erase the odd keys (splitting and merging leaves under the scans, and
+// retiring them), and the other half scan from random keys. every scan must visit its keys in
+// ascending order, with their values, and every even key from its start to the last key it visited.
+// once the threads join, reclaim() must free every retired node. last, MAX_THREADS + 16 threads
+// change a ConcurrentMap at once, the last of them through the EpochManager's shared slot.
+void testConcurrentScan(int threads, int n)
+{
+    cout << string(50,'=') << endl
+         << "Starting concurrent scan test with: threads = " << threads << ", items = " << n
+         << endl << string(50,'=') << endl;
+
+    ConcurrentMap<int, int, 1> map;
+    for(int key = 0; key < 2 * n; key += 2)
+        map.insert(key, key);
+
+    vector<int> errors(threads, 0);
+    vector<thread> workers;
+    for(int t = 0; t < threads; t++)
+        workers.push_back(thread([&, t]()
+        {
+            mt19937 rng(t);
+            uniform_int_distribution<int> pickKey(0, 2 * n - 1);
+            //each writer inserts and erases its own odd keys, so that no other writer can make it fail.
+            const int writers = (threads + 1) / 2;
+            uniform_int_distribution<int> pickLane(0, (n - 1 - t / 2) / writers);
+            for(int round = 0; round < n; round++)
+            {
+                if(t % 2 == 0)
+                {
+                    int odd = 2 * (pickLane(rng) * writers + t / 2) + 1;
+                    if(!map.insert(odd, odd) || !map.erase(odd))
+                        errors[t]++;
+                }
+                else
+                {
+                    int from = pickKey(rng);
+                    int expected = from + (from % 2);   //the first even key not less than from
+                    int last = from - 1;
+                    map.scan(from, 20, [&](const int& key, const int& value)
+                    {
+                        if(key <= last || value != key || (key % 2 == 0 && key != expected))
+                            errors[t]++;
+                        if(key % 2 == 0)
+                            expected = key + 2;
+                        last = key;
+                    });
+                }
+            }
+        }));
+
+    for(int t = 0; t < threads; t++)
+        workers[t].join();
+
+    bool isValid = map.isValid() && map.size() == n;
+    for(int t = 0; t < threads; t++)
+        if(errors[t] != 0)
+        {
+            isValid = false;
+            cout << "Error, thread " << t << " saw " << errors[t] << " errors." << endl;
+        }
+
+    //with no thread inside, each reclaim moves the epoch on, so the second frees everything.
+    map.reclaim();
+    map.reclaim();
+    if(map.retiredNodes() != 0)
+    {
+        isValid = false;
+        cout << "Error, " << map.retiredNodes() << " retired nodes were not freed." << endl;
+    }
+
+    int visited = 0;
+    map.scan(0, 2 * n, [&](const int& key, const int&)
+    {
+        if(key != 2 * visited)
+            isValid = false;
+        visited++;
+    });
+    if(visited != n)
+        isValid = false;
+
+    //more threads than EpochManager::MAX_THREADS are alive at once, so the last of them share a slot.
+    const int crowd = EpochManager::MAX_THREADS + 16;
+    ConcurrentMap<int, int, 1> crowded;
+    atomic<int> started(0);
+    vector<int> crowdErrors(crowd, 0);
+    vector<thread> crowdWorkers;
+    for(int t = 0; t < crowd; t++)
+        crowdWorkers.push_back(thread([&, t]()
+        {
+            if(!crowded.insert(t, t))
+                crowdErrors[t]++;
+            started++;
+            while(started.load() < crowd)
+                this_thread::yield();
+            for(int i = 1; i < 20; i++)
+            {
+                int key = i * crowd + t, value = -1;
+                if(!crowded.insert(key, key) || !crowded.get(key, value) || value != key
+                   || (i % 2 == 0 && !crowded.erase(key)))
+                    crowdErrors[t]++;
+            }
+        }));
+    for(int t = 0; t < crowd; t++)
+        crowdWorkers[t].join();
+    crowded.reclaim();
+    crowded.reclaim();
+    if(count(crowdErrors.begin(), crowdErrors.end(), 0) != crowd || crowded.size() != crowd * 11
+       || !crowded.isValid() || crowded.retiredNodes() != 0)
+    {
+        isValid = false;
+        cout << "Error, a ConcurrentMap was wrong with more threads than EpochManager::MAX_THREADS." << endl;
+    }
+
+    cout << string(50,'=') << endl
+         << (isValid ? "Concurrent Scan Test Passed." : "Concurrent Scan Test Failed!")
+         << endl << string(50,'=') << endl;
+}
+
+//preconditions: n > 0
+//postconditions: a PersistentBPlusTree of MinDegree 1 is snapshot every round, then changed by n/10 random
+// inserts and removes. every snapshot must still hold the items it was taken with (forwards and backwards)
+// after all the rounds, and the first write after a snapshot must copy no more than the path it touches
+// (and a sibling per level). the snapshots are then dropped in random order, and the tree checked again.
+// last, a tree with dups is snapshot, and emptied, leaving the snapshot as it was.
+void testPersistentSnapshots(int n, int rounds)
+{
+    cout << string(50,'=') << endl
+         << "Starting persistent snapshot test with: items = " << n << ", rounds = " << rounds
+         << endl << string(50,'=') << endl;
+
+    bool isValid = true;
+    mt19937 rng(7);
+    uniform_int_distribution<int> pickKey(0, 2 * n - 1);
+
+    PersistentBPlusTree<int, 1> tree;
+    vector<bool> present(2 * n, false);
+    vector<PersistentBPlusTree<int, 1> > snapshots;
+    vector<vector<int> > expected;
+
+    for(int round = 0; round < rounds && isValid; round++)
+    {
+        snapshots.push_back(tree.snapshot());
+        expected.push_back(vector<int>());
+        for(int key = 0; key < 2 * n; key++)
+            if(present[key])
+                expected.back().push_back(key);
+
+        for(int op = 0; op < n / 10; op++)
+        {
+            int key = pickKey(rng);
+            size_t copied = tree.nodesCopied();
+            if(present[key] ? !tree.remove(key) : !tree.insert(key))
+                isValid = false;
+            present[key] = !present[key];
+
+            //a tree of MinDegree 1 with s items is at most log2(s)+1 levels tall.
+            int height = 1;
+            for(int items = tree.size() + 1; items > 1; items /= 2)
+                height++;
+            if(op == 0 && tree.nodesCopied() - copied > size_t(2 * height))
+            {
+                isValid = false;
+                cout << "Error, a write after a snapshot copied " << tree.nodesCopied() - copied << " nodes." << endl;
+            }
+        }
+        if(!tree.isValid())
+            isValid = false;
+    }
+
+    for(size_t i = 0; i < snapshots.size() && isValid; i++)
+    {
+        vector<int> forwards(snapshots[i].begin(), snapshots[i].end());
+        vector<int> backwards;
+        for(PersistentBPlusTree<int, 1>::Iterator it = snapshots[i].end(); it != snapshots[i].begin(); )
+            backwards.insert(backwards.begin(), *--it);
+
+        if(!snapshots[i].isValid() || forwards != expected[i] || backwards != expected[i]
+           || snapshots[i].size() != int(expected[i].size()))
+        {
+            isValid = false;
+            cout << "Error, snapshot " << i << " changed after it was taken." << endl;
+        }
+    }
+
+    shuffleArray(&snapshots[0], int(snapshots.size()));
+    while(!snapshots.empty())
+        snapshots.pop_back();
+
+    for(int key = 0; key < 2 * n && isValid; key++)
+    {
+        PersistentBPlusTree<int, 1>::Iterator it = tree.lower_bound(key);
+        if(tree.contains(key) != present[key] || (present[key] && (it == tree.end() || *it != key)))
+            isValid = false;
+    }
+    if(!tree.isValid())
+        isValid = false;
+
+    PersistentBPlusTree<string, 2> dups(true);
+    for(int i = 0; i < n; i++)
+        dups.insert(to_string(i % 100));
+    PersistentBPlusTree<string, 2> before = dups;
+    for(int i = 0; i < n; i++)
+        dups.remove(to_string(i % 100));
+    if(!dups.empty() || !dups.isValid() || before.size() != n || !before.isValid())
+        isValid = false;
+    PersistentBPlusTree<string, 2>::Iterator it = before.lower_bound("42");
+    for(int i = 0; i < n / 100 && isValid; i++, ++it)
+        if(it == before.end() || *it != "42")
+            isValid = false;
+
+    cout << string(50,'=') << endl
+         << (isValid ? "Persistent Snapshot Test Passed." : "Persistent Snapshot Test Failed!")
+         << endl << string(50,'=') << endl;
+}
+
+//preconditions: n > 0
+//postconditions: B+Trees of random keys (unique, and with dups) will be written to files of small pages
+// (so they are several levels tall), mapped back with MappedBPlusTree, and checked against the tree:
+// the size, isValid(), find and lower_bound/upper_bound of every key (and of keys that are not there),
+// and the items forwards and backwards. Pairs are checked the same way, an empty tree is written and
+// opened, and a file is checked to be refused when opened as a tree of another type. Last, a file whose
+// header claims more pages than it holds is refused, and a file whose page links point past its end is
+// searched and iterated without reading outside of the mapping.
+void testMappedFile(int n)
+{
+    cout << string(50,'=') << endl
+         << "Starting mapped file test with: items = " << n
+         << endl << string(50,'=') << endl;
+
+    const char* path = "bplustree_mapped_test.bpt";
+    bool isValid = true;
+    mt19937 rng(15);
+    uniform_int_distribution<int> pickKey(0, 2 * n - 1);
+
+    for(int dups = 0; dups < 2 && isValid; dups++)
+    {
+        BPlusTree<int> tree(dups != 0);
+        for(int i = 0; i < n; i++)
+            tree.insert(pickKey(rng));
+        vector<int> expected(tree.begin(), tree.end());
+
+        MappedBPlusTree<int, 128> mapped;
+        if(!MappedBPlusTree<int, 128>::write(path, tree.begin(), tree.end(), dups != 0) || !mapped.open(path))
+        {
+            cout << "Error, the tree file could not be written or opened." << endl;
+            isValid = false;
+            break;
+        }
+
+        vector<int> forwards(mapped.begin(), mapped.end());
+        vector<int> backwards(mapped.rbegin(), mapped.rend());
+        reverse(backwards.begin(), backwards.end());
+        if(!mapped.isValid() || mapped.size() != tree.size() || mapped.height() < 3
+           || forwards != expected || backwards != expected || mapped.areDupsOk() != (dups != 0))
+            isValid = false;
+
+        for(int key = -1; key <= 2 * n && isValid; key++)
+        {
+            const int* found = mapped.find(key);
+            vector<int>::iterator low = std::lower_bound(expected.begin(), expected.end(), key);
+            vector<int>::iterator high = std::upper_bound(expected.begin(), expected.end(), key);
+            MappedBPlusTree<int, 128>::Iterator lowIt = mapped.lower_bound(key);
+            MappedBPlusTree<int, 128>::Iterator highIt = mapped.upper_bound(key);
+            if((found != nullptr) != (low != high) || (found && *found != key)
+               || mapped.contains(key) != tree.contains(key)
+               || (low == expected.end()) != (lowIt == mapped.end()) || (lowIt != mapped.end() && *lowIt != *low)
+               || (high == expected.end()) != (highIt == mapped.end()) || (highIt != mapped.end() && *highIt != *high))
+            {
+                cout << "Error, the mapped tree does not find " << key << " where the tree does." << endl;
+                isValid = false;
+            }
+        }
+        if(isValid && dups)
+        {
+            //every copy of a key is reached from lower_bound, across leaves.
+            int key = expected[expected.size() / 2];
+            MappedBPlusTree<int, 128>::Iterator it = mapped.lower_bound(key);
+            int copies = 0;
+            for(; it != mapped.end() && *it == key; ++it)
+                copies++;
+            if(copies != int(std::upper_bound(expected.begin(), expected.end(), key) - std::lower_bound(expected.begin(), expected.end(), key)))
+                isValid = false;
+        }
+    }
+
+    //pairs are ordered (and found) by their key.
+    vector<Pair<int, int> > pairs;
+    for(int i = 0; i < n; i++)
+        pairs.push_back(Pair<int, int>(3 * i, i));
+    MappedBPlusTree<Pair<int, int>, 256> mappedPairs;
+    if(!MappedBPlusTree<Pair<int, int>, 256>::write(path, pairs.begin(), pairs.end()) || !mappedPairs.open(path)
+       || !mappedPairs.isValid() || mappedPairs.size() != n)
+        isValid = false;
+    for(int i = 0; i < 3 * n && isValid; i++)
+    {
+        const Pair<int, int>* pair = mappedPairs.find(i);
+        if((pair != nullptr) != (i % 3 == 0) || (pair && pair->_value != i / 3))
+            isValid = false;
+    }
+    mappedPairs.close();
+
+    //an empty tree, and a file of ints opened as a tree of long longs (or with other pages).
+    vector<int> none;
+    MappedBPlusTree<int, 128> empty;
+    if(!MappedBPlusTree<int, 128>::write(path, none.begin(), none.end()) || !empty.open(path)
+       || !empty.empty() || !empty.isValid() || empty.begin() != empty.end() || empty.find(1))
+        isValid = false;
+    MappedBPlusTree<long long, 128> wrongItems;
+    MappedBPlusTree<int, 256> wrongPages;
+    if(wrongItems.open(path) || wrongPages.open(path) || wrongItems.isOpen() || empty.open("no_such_file.bpt"))
+        isValid = false;
+
+    vector<int> keys;
+    for(int i = 0; i < n; i++)
+        keys.push_back(i);
+    MappedBPlusTree<int, 128>::write(path, keys.begin(), keys.end());
+    vector<char> file;
+    {
+        ifstream ins(path, ios::binary);
+        file.assign(istreambuf_iterator<char>(ins), istreambuf_iterator<char>());
+    }
+    const uint64_t farAway = uint64_t(1) << 40;
+
+    //a corrupt header: its page count times the page size wraps around to 0, and its root is far away.
+    // (the page count is at offset 32 of the header, the root page at 48)
+    {
+        vector<char> header = file;
+        const uint64_t wrapping = uint64_t(1) << 57;
+        memcpy(&header[32], &wrapping, 8);
+        memcpy(&header[48], &farAway, 8);
+        ofstream outs(path, ios::binary | ios::trunc);
+        outs.write(header.data(), header.size());
+    }
+    MappedBPlusTree<int, 128> wrapped;
+    if(wrapped.open(path) || wrapped.isOpen())
+    {
+        cout << "Error, a tree file whose header claims more pages than it holds was opened." << endl;
+        isValid = false;
+    }
+
+    //a corrupt file: the children of its inner pages and the links of its leaves point past the file.
+    // (a page starts with its kind and count, 4 bytes each, then the next and prev links, then the children)
+    for(size_t offset = 128; offset + 128 <= file.size(); offset += 128)
+    {
+        uint32_t kind, count;
+        memcpy(&kind, &file[offset], 4);
+        memcpy(&count, &file[offset + 4], 4);
+        memcpy(&file[offset + 8], &farAway, 8);
+        for(uint32_t i = 0; kind == 2 && i <= count && 24 + 8 * (i + 1) <= 128; i++)
+            memcpy(&file[offset + 24 + 8 * i], &farAway, 8);
+    }
+    {
+        ofstream outs(path, ios::binary | ios::trunc);
+        outs.write(file.data(), file.size());
+    }
+    MappedBPlusTree<int, 128> corrupt;
+    if(!corrupt.open(path) || corrupt.isValid() || corrupt.find(n / 2) || corrupt.lower_bound(0) != corrupt.end()
+       || distance(corrupt.begin(), corrupt.end()) > n)
+    {
+        cout << "Error, a corrupt tree file was not refused or read outside of its pages." << endl;
+        isValid = false;
+    }
+    corrupt.close();
+
+    remove(path);
+
+    cout << string(50,'=') << endl
+         << (isValid ? "Mapped File Test Passed." : "Mapped File Test Failed!")
+         << endl << string(50,'=') << endl;
+}
+
+//preconditions: n > 0
+//postconditions: BPlusTrees (with and without dups), Maps and an MMap of random items will be saved to a
+// stringstream and loaded into other containers (that held other items), which are checked to hold the
+// same items, in order, and to be valid. A tree must refuse a stream saved with the other dups setting,
+// (a Map refuses an MMap). Then a stream cut short, a stream that is not a saved tree, and streams with
+// a corrupt string or list length are checked to fail to load, leaving the container empty.
+void testSaveLoad(int n)
+{
+    cout << string(50,'=') << endl
+         << "Starting save and load test with: items = " << n
+         << endl << string(50,'=') << endl;
+
+    bool isValid = true;
+    mt19937 rng(16);
+    uniform_int_distribution<int> pickKey(0, n - 1);
+
+    for(int dups = 0; dups < 2; dups++)
+    {
+        BPlusTree<int> tree(dups != 0);
+        for(int i = 0; i < n; i++)
+            tree.insert(pickKey(rng));
+        BPlusTree<int, 2> loaded(dups != 0);
+        loaded.insert(-1);
+        BPlusTree<int> other(dups == 0);
+        other.insert(-1);
+
+        stringstream stream;
+        if(!tree.save(stream) || !loaded.load(stream) || loaded.areDupsOk() != tree.areDupsOk()
+           || loaded.size() != tree.size() || !loaded.isValid()
+           || vector<int>(loaded.begin(), loaded.end()) != vector<int>(tree.begin(), tree.end()))
+        {
+            cout << "Error, the tree " << (dups ? "with" : "without") << " dups was not loaded as it was saved." << endl;
+            isValid = false;
+        }
+        stream.clear();
+        stream.seekg(0);
+        if(other.load(stream) || !other.empty() || other.areDupsOk() == tree.areDupsOk())
+        {
+            cout << "Error, a tree " << (dups ? "without" : "with") << " dups loaded a tree that was saved "
+                 << (dups ? "with" : "without") << " them." << endl;
+            isValid = false;
+        }
+    }
+
+    Map<string, int> words;
+    Map<int, int> squares;
+    for(int i = 0; i < n; i++)
+    {
+        words[to_string(pickKey(rng)) + string(i % 20, 'x')] = i;
+        squares[i] = i * i;
+    }
+    Map<string, int> loadedWords;
+    Map<int, int> loadedSquares;
+    loadedWords["stale"] = 1;
+    stringstream wordStream, squareStream;
+    if(!words.save(wordStream) || !loadedWords.load(wordStream, 0.5) || !loadedWords.isValid()
+       || loadedWords.size() != words.size()
+       || (loadedWords.lower_bound("stale") != loadedWords.end() && loadedWords.lower_bound("stale").key() == "stale")
+       || !squares.save(squareStream) || !loadedSquares.load(squareStream) || loadedSquares.size() != n)
+        isValid = false;
+    for(Map<string, int>::Iterator it = words.begin(); it != words.end() && isValid; ++it)
+        if(loadedWords.at(it.key()) != *it)
+            isValid = false;
+    for(int i = 0; i < n && isValid; i++)
+        if(loadedSquares[i] != i * i)
+            isValid = false;
+
+    MMap<int, string> lists;
+    for(int i = 0; i < n; i++)
+        lists.insert(pickKey(rng) % (n / 10 + 1), to_string(i));
+    MMap<int, string> loadedLists;
+    stringstream listStream;
+    if(!lists.save(listStream) || !loadedLists.load(listStream) || !loadedLists.isValid()
+       || loadedLists.size() != lists.size()
+       || vector<string>(loadedLists.begin(), loadedLists.end()) != vector<string>(lists.begin(), lists.end()))
+        isValid = false;
+
+    //an MMap's tree allows dups, a Map's does not: a Map must not load an MMap.
+    MMap<int, int> single;
+    for(int i = 0; i < 10; i++)
+        single.insert(i, i);
+    stringstream singleStream;
+    Map<int, int> notAMap;
+    notAMap[1] = 1;
+    if(!single.save(singleStream) || notAMap.load(singleStream) || !notAMap.empty())
+    {
+        cout << "Error, a Map loaded a saved MMap." << endl;
+        isValid = false;
+    }
+
+    //every prefix of a saved stream is too short to load.
+    string saved = squareStream.str();
+    for(size_t cut = 0; cut < saved.size() && isValid; cut += 1 + saved.size() / 50)
+    {
+        istringstream truncated(saved.substr(0, cut));
+        Map<int, int> partial;
+        partial[1] = 1;
+        if(partial.load(truncated) || !partial.empty() || !partial.isValid())
+        {
+            cout << "Error, a stream cut after " << cut << " bytes was loaded." << endl;
+            isValid = false;
+        }
+    }
+    istringstream garbage("this is not a saved tree");
+    BPlusTree<int> refused;
+    if(refused.load(garbage) || !refused.empty())
+        isValid = false;
+
+    //a corrupt length, (of a string, a vector and a value list), fails the load instead of allocating it.
+    // the first item follows the header: the magic and version (4 bytes each), dups (1) and the count (8).
+    const size_t firstItem = 4 + 4 + 1 + 8;
+    uint64_t huge = uint64_t(1) << 62;
+    string corrupt = wordStream.str();
+    memcpy(&corrupt[firstItem], &huge, 8);
+    istringstream corruptWords(corrupt);
+    Map<string, int> refusedWords;
+
+    Map<int, vector<int> > vectors;
+    vectors[1] = vector<int>(3, 1);
+    stringstream vectorStream;
+    vectors.save(vectorStream);
+    string corruptVector = vectorStream.str();
+    memcpy(&corruptVector[firstItem + sizeof(int)], &huge, 8);
+    istringstream corruptVectors(corruptVector);
+    Map<int, vector<int> > refusedVectors;
+
+    string corruptList = listStream.str();
+    memcpy(&corruptList[firstItem + sizeof(int)], &huge, 8);
+    istringstream corruptLists(corruptList);
+    MMap<int, string> refusedLists;
+    if(refusedWords.load(corruptWords) || !refusedWords.empty() || refusedVectors.load(corruptVectors)
+       || !refusedVectors.empty() || refusedLists.load(corruptLists) || !refusedLists.empty())
+    {
+        cout << "Error, a stream with a corrupt length was loaded." << endl;
+        isValid = false;
+    }
+
+    cout << string(50,'=') << endl
+         << (isValid ? "Save Load Test Passed." : "Save Load Test Failed!")
+         << endl << string(50,'=') << endl;
+}
+
+//preconditions: none
+//postconditions: the files of the durable map at path are removed.
+void removeDurableFiles(const string& path)
+{
+    remove((path + ".log").c_str());
+    remove((path + ".checkpoint").c_str());
+}
+
+//preconditions: n > 0
+//postconditions: random inserts, erases and assigns will be made to a DurableMap<int, string> (grouping
+// 64 changes per sync) and to a plain Map, with a checkpoint part of the way through. The durable map is
+// reopened after each phase and checked to hold what the Map holds:
+//  1) after it is closed, (the changes since the checkpoint are replayed from the log),
+//  2) after bytes of garbage, and then a record cut short, are appended to its log (a write a crash
+//     interrupted): the whole records are still replayed, and the log is truncated after them,
+//  3) after another checkpoint, when the log left by the crash is dropped.
+//  4) after the log could not be written for a while (the file size limit is lowered below it): the
+//     changes made then must fail and leave the map as it was, and a commit must fail and keep its
+//     records pending until the log can be written again.
+// Last, a DurableMMap is checked the same way.
+void testDurableMap(int n)
+{
+    cout << string(50,'=') << endl
+         << "Starting durable map test with: items = " << n
+         << endl << string(50,'=') << endl;
+
+    const string path = "bplustree_durable_test";
+    removeDurableFiles(path);
+
+    bool isValid = true;
+    mt19937 rng(17);
+    uniform_int_distribution<int> pickKey(0, n - 1);
+    uniform_int_distribution<int> pickOp(0, 2);
+    Map<int, string> expected;
+
+    //the reopened map must hold exactly the pairs of expected.
+    auto matches = [&](DurableMap<int, string>& durable)
+    {
+        vector<string> values(expected.begin(), expected.end());
+        int i = 0;
+        bool same = durable.size() == expected.size();
+        for(Map<int, string>::Iterator it = expected.begin(); it != expected.end() && same; ++it, i++)
+        {
+            string value;
+            same = durable.find(it.key(), value) && value == values[i];
+        }
+        return same;
+    };
+
+    {
+        DurableMap<int, string> durable(64);
+        if(!durable.open(path))
+            isValid = false;
+        for(int i = 0; i < 2 * n && isValid; i++)
+        {
+            int key = pickKey(rng);
+            string value = to_string(i);
+            int op = pickOp(rng);
+            if(op == 0 && durable.insert(key, value) != expected.insert(key, value))
+                isValid = false;
+            else if(op == 1 && durable.erase(key) != expected.erase(key))
+                isValid = false;
+            else if(op == 2)
+            {
+                if(!durable.assign(key, value))
+                    isValid = false;
+                expected[key] = value;
+            }
+            if(i == n && !durable.checkpoint())
+                isValid = false;
+        }
+        if(durable.log().commits() < size_t(n / 64))
+            isValid = false;
+    }
+
+    DurableMap<int, string> reopened;
+    if(!reopened.open(path) || !matches(reopened) || reopened.map().size() != expected.size())
+    {
+        cout << "Error, the durable map was not recovered from its checkpoint and log." << endl;
+        isValid = false;
+    }
+    reopened.insert(-1, "logged");
+    expected.insert(-1, "logged");
+    reopened.close();
+
+    //a crash in the middle of a write leaves part of a record at the end of the log.
+    {
+        ofstream log((path + ".log").c_str(), ios::binary | ios::app);
+        uint32_t length = 40, sum = 7;
+        log.write(reinterpret_cast<const char*>(&length), sizeof(length));
+        log.write(reinterpret_cast<const char*>(&sum), sizeof(sum));
+        log.write("cut short", 9);
+    }
+    DurableMap<int, string> recovered;
+    size_t logBytes = 0;
+    if(!recovered.open(path) || !matches(recovered))
+    {
+        cout << "Error, the durable map was not recovered from a log with a torn record." << endl;
+        isValid = false;
+    }
+    logBytes = recovered.log().logBytes();
+    recovered.erase(-1);
+    expected.erase(-1);
+    if(!recovered.checkpoint() || recovered.log().logBytes() >= logBytes)
+        isValid = false;
+    recovered.close();
+
+    DurableMap<int, string> checkpointed;
+    if(!checkpointed.open(path) || !matches(checkpointed))
+        isValid = false;
+    checkpointed.close();
+
+    //a full disk: writes past the file size limit fail (with EFBIG, once SIGXFSZ is ignored). the limit
+    // is the size of the log file, and a few bytes more, so that a record is cut short, then cut off.
+    // (it is raised again before anything is printed, which would fail too.)
+    rlimit limits, full;
+    getrlimit(RLIMIT_FSIZE, &limits);
+    full = limits;
+    auto fillDisk = [&](size_t logFileBytes)
+    {
+        full.rlim_cur = rlim_t(logFileBytes + 4);
+        return setrlimit(RLIMIT_FSIZE, &full) == 0;
+    };
+    auto emptyDisk = [&]() {return setrlimit(RLIMIT_FSIZE, &limits) == 0;};
+    signal(SIGXFSZ, SIG_IGN);
+    {
+        DurableMap<int, string> unwritable(1);
+        int key = expected.begin().key();
+        bool refused = unwritable.open(path) && fillDisk(unwritable.log().logBytes())
+                    && !unwritable.insert(-2, "lost") && !unwritable.erase(key) && !unwritable.assign(key, "lost");
+        emptyDisk();
+        if(!refused || unwritable.log().pendingRecords() != 0 || !matches(unwritable))
+        {
+            cout << "Error, the durable map was changed by changes that could not be logged." << endl;
+            isValid = false;
+        }
+    }
+    {
+        //a group that cannot be committed stays pending, and is committed once the log can be written.
+        DurableMap<int, string> grouped(0);
+        bool kept = grouped.open(path) && fillDisk(grouped.log().logBytes())
+                 && grouped.insert(-3, "grouped") && grouped.insert(-4, "grouped")
+                 && !grouped.commit() && grouped.log().pendingRecords() == 2;
+        emptyDisk();
+        if(!kept || !grouped.commit() || grouped.log().pendingRecords() != 0)
+        {
+            cout << "Error, a group commit that failed did not keep its records." << endl;
+            isValid = false;
+        }
+        expected.insert(-3, "grouped");
+        expected.insert(-4, "grouped");
+        grouped.insert(-5, "logged");
+        expected.insert(-5, "logged");
+    }
+    signal(SIGXFSZ, SIG_DFL);
+    DurableMap<int, string> rewritten;
+    if(!rewritten.open(path) || !matches(rewritten))
+    {
+        cout << "Error, the durable map was not recovered after its log could not be written." << endl;
+        isValid = false;
+    }
+    rewritten.close();
+    removeDurableFiles(path);
+
+    //the multimap: a value is appended on each insert.
+    {
+        DurableMMap<int, int> lists(0);
+        if(!lists.open(path))
+            isValid = false;
+        for(int i = 0; i < n; i++)
+            lists.insert(i % 50, i);
+        lists.erase(7);
+        lists.checkpoint();
+        lists.insert(7, -7);
+        lists.insert(8, -8);
+    }
+    DurableMMap<int, int> lists;
+    vector<int> values;
+    if(!lists.open(path) || lists.size() != 50 || !lists.find(7, values) || values != vector<int>(1, -7)
+       || !lists.find(8, values) || int(values.size()) != n / 50 + 1 || values.back() != -8)
+        isValid = false;
+    lists.close();
+    removeDurableFiles(path);
+
+    cout << string(50,'=') << endl
+         << (isValid ? "Durable Map Test Passed." : "Durable Map Test Failed!")
+         << endl << string(50,'=') << endl;
+}
+
+//preconditions: n > 0
+//postconditions: random inserts and removes will be made to a PagedBPlusTree<int> of small pages (256 bytes)
+// behind a buffer pool of only a few frames, so that pages are evicted and read back all the time, and to a
+// BPlusTree<int>. After every few changes the paged tree is checked with isValid() and against the tree:
+// find, contains and lower_bound of random keys, and the items forwards and backwards.
+// Then the paged tree is closed, reopened from its file, and checked again, with more changes made to it.
+// Then a file is checked to be refused when opened as a tree of another type.
+// Last, a BufferPool is checked to add a frame when all of its frames are pinned, and to keep a dirty
+// page that cannot be written back (the file size limit is lowered) in its frame, until a flush can write it.
+void testPagedTree(int n)
+{
+    cout << string(50,'=') << endl
+         << "Starting paged tree test with: items = " << n
+         << endl << string(50,'=') << endl;
+
+    typedef PagedBPlusTree<int, 256> Paged;
+    const char* path = "bplustree_paged_test.bpt";
+    remove(path);
+
+    bool isValid = true;
+    mt19937 rng(23);
+    uniform_int_distribution<int> pickKey(0, 2 * n);
+    BPlusTree<int> expected;
+
+    //the paged tree must hold exactly the items of expected.
+    auto matches = [&](const Paged& paged)
+    {
+        bool same = paged.isValid() && paged.size() == expected.size()
+                 && equal(expected.begin(), expected.end(), paged.begin());
+        vector<int> backwards;
+        for(Paged::Iterator it = paged.end(); it != paged.begin(); )
+            backwards.push_back(*--it);
+        same = same && backwards.size() == size_t(expected.size()) && equal(backwards.rbegin(), backwards.rend(), expected.begin());
+        for(int i = 0; i < 50 && same; i++)
+        {
+            int key = pickKey(rng), item = 0;
+            BPlusTree<int>::Iterator it = expected.lower_bound(key);
+            Paged::Iterator found = paged.lower_bound(key);
+            same = (it == expected.end()) ? found == paged.end() : (found != paged.end() && *found == *it);
+            same = same && paged.find(key, item) == expected.contains(key) && paged.contains(key) == expected.contains(key);
+        }
+        return same;
+    };
+
+    auto change = [&](Paged& paged, int count)
+    {
+        for(int i = 0; i < count && isValid; i++)
+        {
+            int key = pickKey(rng);
+            bool inserting = (i % 3 != 2);
+            if(inserting && paged.insert(key) != expected.insert(key))
+                isValid = false;
+            else if(!inserting && paged.remove(key) != expected.remove(key))
+                isValid = false;
+            if(i % 200 == 0 && !matches(paged))
+                isValid = false;
+        }
+    };
+
+    {
+        Paged paged;
+        if(!paged.open(path, 4 * 256) || paged.bufferFrames() != 4 || !paged.empty() || paged.begin() != paged.end()
+           || !paged.isValid())
+            isValid = false;
+        change(paged, 3 * n);
+        if(paged.height() < 3 || paged.bufferStats().reads == 0 || paged.bufferStats().writes == 0)
+        {
+            cout << "Error, the paged tree did not page its nodes through the buffer pool." << endl;
+            isValid = false;
+        }
+
+        //removing most items merges pages, which are reused by the inserts that follow.
+        vector<int> items(expected.begin(), expected.end());
+        for(size_t i = 0; i < items.size() * 9 / 10; i++)
+            if(!paged.remove(items[i]) || !expected.remove(items[i]))
+                isValid = false;
+        if(!matches(paged))
+            isValid = false;
+        size_t pages = paged.pageCount();
+        change(paged, n / 2);
+        if(paged.pageCount() != pages)
+        {
+            cout << "Error, the paged tree did not reuse its free pages." << endl;
+            isValid = false;
+        }
+        change(paged, 2 * n);
+        if(!paged.close())
+            isValid = false;
+    }
+
+    {
+        Paged reopened;
+        if(!reopened.open(path, 8 * 256) || !matches(reopened))
+        {
+            cout << "Error, the paged tree was not the same after it was reopened." << endl;
+            isValid = false;
+        }
+        change(reopened, n);
+        if(!matches(reopened))
+            isValid = false;
+    }
+
+    {
+        Paged reopened;
+        PagedBPlusTree<long long, 256> other;
+        if(!reopened.open(path) || !matches(reopened) || other.open(path) || other.isOpen())
+            isValid = false;
+    }
+    remove(path);
+
+    {
+        BufferPool pool;
+        char* pinned[3];
+        bool ok = pool.open(path, 2 * 256, 256) && pool.frameCount() == 2;
+        for(int i = 0; i < 3 && ok; i++)
+        {
+            pinned[i] = pool.pinNew(i);
+            memset(pinned[i], 'a' + i, 256);
+        }
+        ok = ok && pool.frameCount() == 3 && pinned[0][255] == 'a' && pinned[1][255] == 'b' && pinned[2][255] == 'c';
+        for(int i = 0; i < 3; i++)
+            pool.unpin(i, true);
+        if(!ok || !pool.flush())
+        {
+            cout << "Error, the buffer pool did not add a frame when all of them were pinned." << endl;
+            isValid = false;
+        }
+
+        //page 1 is changed, and cannot be written back (past the first page) when pages 3 to 6 are pinned after it.
+        rlimit limits, full;
+        getrlimit(RLIMIT_FSIZE, &limits);
+        full = limits;
+        full.rlim_cur = 256;
+        signal(SIGXFSZ, SIG_IGN);
+        pool.pin(1)[0] = 'B';
+        pool.unpin(1, true);
+        bool kept = setrlimit(RLIMIT_FSIZE, &full) == 0;
+        for(uint64_t id = 3; id < 7; id++)
+            pool.unpin(id, pool.pinNew(id) != nullptr);
+        size_t reads = pool.stats().reads;
+        kept = kept && pool.pin(1)[0] == 'B' && pool.stats().reads == reads && !pool.flush();
+        pool.unpin(1, false);
+        setrlimit(RLIMIT_FSIZE, &limits);
+        signal(SIGXFSZ, SIG_DFL);
+        if(!kept || !pool.close())
+        {
+            cout << "Error, the buffer pool lost a dirty page it could not write back." << endl;
+            isValid = false;
+        }
+        ifstream file(path, ios::binary);
+        string bytes((istreambuf_iterator<char>(file)), istreambuf_iterator<char>());
+        if(bytes.size() != 7 * 256 || bytes[0] != 'a' || bytes[256] != 'B' || bytes[257] != 'b' || bytes[512] != 'c')
+            isValid = false;
+    }
+    remove(path);
+
+    cout << string(50,'=') << endl
+         << (isValid ? "Paged Tree Test Passed." : "Paged Tree Test Failed!")
+         << endl << string(50,'=') << endl;
+}
+
+//preconditions: none
+//postconditions: returns a key like a URL: a long prefix shared by every key, then key (zero padded,
+// so that the keys sort as the numbers do), and a suffix for some of them.
+string urlKey(int key)
+{
+    string digits = to_string(key);
+    string url = "https://www.example.com/catalog/products/" + string(6 - digits.size(), '0') + digits;
+    return (key % 3 == 0) ? url + "/reviews" : url;
+}
+
+//preconditions: n > 0
+//postconditions: URL keys of random numbers in [0, n) are inserted into (and removed from) a
+// BPlusTree<string> one at a time, then in batches, then bulk loaded, returning false as soon as the
+// tree holds the wrong items (forwards or backwards), is invalid, or finds or lower_bound of a key
+// (or of a prefix of a key, which is what a separator is truncated to) disagree with the items.
+template <int MinDegree>
+bool stringKeyRounds(int n, bool dups)
+{
+    BPlusTree<string, MinDegree> bt(dups);
+    vector<int> counts(n, 0);
+    int size = 0;
+
+    auto matches = [&]()
+    {
+        vector<string> items;
+        for(int key = 0; key < n; key++)
+            items.insert(items.end(), counts[key], urlKey(key));
+        vector<string> forwards(bt.begin(), bt.end());
+        vector<string> backwards(bt.rbegin(), bt.rend());
+        reverse(backwards.begin(), backwards.end());
+        if(bt.size() != size || forwards != items || backwards != items || !bt.isValid())
+            return false;
+
+        for(int i = 0; i < 20; i++)
+        {
+            int key = rand() % n;
+            string probe = urlKey(key);
+            if((bt.find(probe) != nullptr) != (counts[key] > 0))
+                return false;
+            probe.resize(probe.size() - rand() % 10);
+            typename BPlusTree<string, MinDegree>::Iterator it = bt.lower_bound(probe);
+            vector<string>::iterator first = std::lower_bound(items.begin(), items.end(), probe);
+            if((it == bt.end()) != (first == items.end()) || (first != items.end() && *it != *first))
+                return false;
+        }
+        return true;
+    };
+
+    for(int i = 0; i < 2 * n; i++)
+    {
+        int key = rand() % n;
+        if(i % 3 != 2)
+        {
+            bool inserted = dups || counts[key] == 0;
+            if(bt.insert(urlKey(key)) != inserted)
+                return false;
+            counts[key] += inserted;
+            size += inserted;
+        }
+        else
+        {
+            bool removed = counts[key] > 0;
+            if(bt.remove(urlKey(key)) != removed)
+                return false;
+            counts[key] -= removed;
+            size -= removed;
+        }
+        if(i % 50 == 0 && !matches())
+            return false;
+    }
+
+    for(int round = 0; round < 6; round++)
+    {
+        vector<string> batch;
+        int expected = 0;
+        for(int i = rand() % n; i > 0; i--)
+        {
+            int key = rand() % n;
+            batch.push_back(urlKey(key));
+            bool changed = (round % 2 == 0) ? (dups || counts[key] == 0) : counts[key] > 0;
+            if(changed)
+            {
+                counts[key] += (round % 2 == 0) ? 1 : -1;
+                expected++;
+            }
+        }
+        int changed = (round % 2 == 0) ? bt.insertBatch(batch.begin(), batch.end()) : bt.eraseBatch(batch.begin(), batch.end());
+        size += (round % 2 == 0) ? expected : -expected;
+        if(changed != expected || !matches())
+            return false;
+    }
+
+    vector<string> items(bt.begin(), bt.end());
+    bt.bulkLoad(items.begin(), items.end(), 0.7);
+    return matches();
+}
+
+//preconditions: n > 0
+//postconditions: the separators of string keys will be checked to be the shortest prefix of the key on
+// the right that is greater than the key on the left, and the search of NodePrefixes to agree with firstGE
+// on random sorted keys that share a prefix, then URL keys (that share a long prefix) will be
+// inserted, removed, batched and bulk loaded with stringKeyRounds, on B+Trees of MinDegree 1, 3 and the
+// default, with and without dups. Last, a Map<string, int> of URL keys is saved and loaded back.
+void testStringKeys(int n, int iterations)
+{
+    cout << string(50,'=') << endl
+         << "Starting string key test with: items = " << n << ", over iterations = " << iterations
+         << endl << string(50,'=') << endl;
+
+    bool isValid = true;
+    if(KeySeparator<string>::between("https://a.com/x/apple", "https://a.com/x/banana") != "https://a.com/x/b"
+       || KeySeparator<string>::between("abc", "abcd") != "abcd" || KeySeparator<string>::between("abc", "abd") != "abd"
+       || KeySeparator<string>::between("ab", "ab") != "ab" || KeySeparator<string>::between("", "zz") != "z"
+       || KeySeparator<int>::between(3, 7) != 7)
+    {
+        isValid = false;
+        cout << "Error, KeySeparator did not give the shortest separator." << endl;
+    }
+
+    //the heads of NodePrefixes must order keys as the strings do: keys that share a prefix of
+    // any length, keys shorter than the prefix or than a head, and keys holding zero bytes.
+    const string pieces[] = {"", "a", "ab", "abc", string("ab\0", 3), "abd", "https://x/", "https://x/y", "zz"};
+    for(int round = 0; round < 2000 && isValid; round++)
+    {
+        vector<string> data(1 + rand() % 16);
+        string shared = pieces[rand() % 9];
+        for(size_t i = 0; i < data.size(); i++)
+            data[i] = shared + pieces[rand() % 9] + pieces[rand() % 9];
+        sort(data.begin(), data.end());
+        NodePrefixes<string, 16> prefixes;
+        prefixes.refresh(data.data(), int(data.size()));
+        string key = ((rand() % 2) ? shared : "") + pieces[rand() % 9] + pieces[rand() % 9];
+        if(prefixes.firstGE(data.data(), int(data.size()), key) != firstGE(data.data(), int(data.size()), key))
+        {
+            isValid = false;
+            cout << "Error, NodePrefixes did not find the first key not less than " << key << endl;
+        }
+    }
+
+    for(int j = 0; j < iterations && isValid; j++)
+    {
+        bool dups = (j % 2 == 1);
+        if(!stringKeyRounds<1>(n, dups) || !stringKeyRounds<3>(n, dups)
+           || !stringKeyRounds<DefaultMinDegree<string>::value>(n, dups))
+        {
+            isValid = false;
+            cout << "Error, a tree of string keys held the wrong items (dups = " << dups << ")." << endl;
+        }
+    }
+
+    Map<string, int> map;
+    for(int i = 0; i < n; i++)
+        map[urlKey(rand() % (4 * n))] = i;
+    stringstream stream;
+    Map<string, int> loaded;
+    if(!map.save(stream) || !loaded.load(stream) || loaded.size() != map.size() || !loaded.isValid()
+       || !equal(map.begin(), map.end(), loaded.begin()))
+    {
+        isValid = false;
+        cout << "Error, a Map of string keys was not loaded back." << endl;
+    }
+
+    cout << string(50,'=') << endl
+         << (isValid ? "String Key Test Passed." : "String Key Test Failed!")
+         << endl << string(50,'=') << endl;
+}
+
+//preconditions: none
+//postconditions: random push_back, pop_back, clear, copies and moves will be made to a List (a ValueList)
+// and to a vector of the values makeValue gives, checking after each that they hold the same values,
+// and that the list keeps its values inline until it first holds more than fit inline.
+template <typename List>
+bool valueListRounds(int rounds, typename List::value_type (*makeValue)(int))
+{
+    typedef typename List::value_type V;
+    const size_t INLINE = List().capacity();
+    List list;
+    vector<V> expected;
+    size_t largest = 0;
+    for(int round = 0; round < rounds; round++)
+    {
+        int op = rand() % 10;
+        if(op == 0 && !list.empty())
+        {
+            //appending one of its own values must work while the list moves to a larger block.
+            size_t i = rand() % list.size();
+            expected.push_back(expected[i]);
+            list.push_back(list[i]);
+        }
+        else if(op < 5)
+        {
+            V value = makeValue(rand());
+            list.push_back(value);
+            expected.push_back(value);
+        }
+        else if(op < 8 && !list.empty())
+        {
+            list.pop_back();
+            expected.pop_back();
+        }
+        else if(op == 8)
+        {
+            List copied(list);
+            List moved(std::move(copied));
+            list = List();
+            list = std::move(moved);
+            if(!copied.empty() || !moved.empty())
+                return false;
+        }
+        else if(rand() % 20 == 0)
+        {
+            list.clear();
+            expected.clear();
+        }
+        largest = max(largest, expected.size());
+        if(list != expected || !(expected == list) || list.size() != expected.size()
+           || (largest <= INLINE && !list.isInline()))
+            return false;
+    }
+    return true;
+}
+
+int smallValue(int i) {return i % 1000;}
+string longValue(int i) {return "value number " + to_string(i) + " of a list, too long for a short string";}
+
+//preconditions: n > 0
+//postconditions: ValueLists of ints (several inline values) and of long strings (one inline value)
+// will be checked against vectors (see valueListRounds). Then an MMap<int, Tracked> of MinDegree 1,
+// whose keys have one to three values (inline), will be built and torn down by inserts and erases in
+// shuffled order: no list may leave its leaf for the heap, and no value may be copied.
+// Last, an MMap is saved and loaded back as a Map<int, vector<int> >: the value lists are saved as vectors.
+void testValueLists(int n, int rounds)
+{
+    cout << string(50,'=') << endl
+         << "Starting value list test with: items = " << n << ", over rounds = " << rounds
+         << endl << string(50,'=') << endl;
+
+    bool isValid = true;
+    for(int j = 0; j < rounds && isValid; j++)
+        if(!valueListRounds<ValueList<int> >(n / 10, smallValue) || !valueListRounds<ValueList<string> >(n / 10, longValue)
+           || !valueListRounds<ValueList<int, 1> >(n / 10, smallValue))
+        {
+            isValid = false;
+            cout << "Error, a ValueList did not hold the values of its vector." << endl;
+        }
+
+    if(ValueList<Tracked>().capacity() < 2)
+        isValid = false;
+    int * keys = new int[n];
+    for(int i = 0; i < n; i++)
+        keys[i] = i;
+    shuffleArray(keys,n);
+    Tracked::allocations = 0;
+    MMap<int, Tracked, 1> mmap;
+    for(int i = 0; i < n; i++)
+        mmap.insert(keys[i] / 2, Tracked(keys[i]));
+    for(int i = 0; i < n / 2 && isValid; i++)
+        if(mmap[i].size() != 2 || !mmap[i].isInline())
+        {
+            isValid = false;
+            cout << "Error, the two values of key " << i << " were not kept in its leaf." << endl;
+        }
+    shuffleArray(keys,n);
+    for(int i = 0; i < n; i++)
+        mmap.erase(keys[i] / 2);
+    if(!mmap.empty() || Tracked::allocations != n)
+    {
+        isValid = false;
+        cout << "Error, the MMap made " << Tracked::allocations - n << " deep copies." << endl;
+    }
+    delete [] keys;
+
+    MMap<int, int> lists;
+    for(int i = 0; i < n; i++)
+        lists.insert(rand() % (n / 8 + 1), i);
+    //a list is saved as a vector is: the MMap's tree (which allows dups) loads into a tree of vector pairs.
+    stringstream stream;
+    BPlusTree<Pair<int, vector<int> > > loaded(true);
+    if(!lists.save(stream) || !loaded.load(stream) || loaded.size() != lists.size())
+        isValid = false;
+    for(BPlusTree<Pair<int, vector<int> > >::Iterator it = loaded.begin(); it != loaded.end() && isValid; ++it)
+        if(lists[(*it)._key] != (*it)._value)
+            isValid = false;
+
+    cout << string(50,'=') << endl
+         << (isValid ? "Value List Test Passed." : "Value List Test Failed!")
+         << endl << string(50,'=') << endl;
+}
+
+//preconditions: n > 0
+//postconditions: a BPlusTree, a Map and an MMap of the even keys below 2n will be probed for every key
+// below 2n through const references, with find, findKey, contains, count, at and the const operator[]:
+// each must find exactly the even keys, and none may change the containers (no pair is inserted,
+// no node is allocated) for the odd keys it misses.
+void testLookups(int n)
+{
+    cout << string(50,'=') << endl
+         << "Starting lookup test with: items = " << n
+         << endl << string(50,'=') << endl;
+
+    bool isValid = true;
+    BPlusTree<int> tree;
+    Map<int, string> map;
+    MMap<int, int> mmap;
+    for(int i = 0; i < 2 * n; i += 2)
+    {
+        tree.insert(i);
+        map[i] = to_string(i);
+        mmap.insert(i, i);
+        mmap.insert(i, -i);
+    }
+
+    const BPlusTree<int>& constTree = tree;
+    const Map<int, string>& constMap = map;
+    const MMap<int, int>& constMMap = mmap;
+    PoolStats before = tree.allocationStats();
+    for(int key = 0; key < 2 * n && isValid; key++)
+    {
+        bool present = (key % 2 == 0);
+        const int* item = constTree.find(key);
+        const string* value = constMap.find(key);
+        const ValueList<int>* values = constMMap.find(key);
+        if(constTree.contains(key) != present || (item != nullptr) != present || (item && *item != key)
+           || (constTree.findKey(key) != nullptr) != present || (present && constTree.get(key) != key)
+           || constMap.contains(key) != present || constMap.count(key) != int(present)
+           || (value != nullptr) != present || (present && (*value != to_string(key) || constMap.at(key) != *value))
+           || constMMap.contains(key) != present || constMMap.count(key) != 2 * int(present)
+           || (values != nullptr) != present || constMMap[key].size() != 2 * size_t(present)
+           || (present && (constMMap[key][0] != key || constMMap[key][1] != -key)))
+        {
+            isValid = false;
+            cout << "Error, a lookup of " << key << " gave the wrong answer." << endl;
+        }
+    }
+
+    PoolStats after = tree.allocationStats();
+    if(tree.size() != n || map.size() != n || mmap.size() != n || after.allocations != before.allocations
+       || !tree.isValid() || !map.isValid() || !mmap.isValid())
+    {
+        isValid = false;
+        cout << "Error, a lookup of a missing key changed a container." << endl;
+    }
+
+    //the lookups of a non-const map must not insert either.
+    if(map.find(1) || map.count(3) || mmap.find(5) || mmap.count(7) || map.size() != n || mmap.size() != n)
+        isValid = false;
+    *map.find(0) = "zero";
+    mmap.find(0)->push_back(1);
+    if(map.at(0) != "zero" || mmap.count(0) != 3)
+        isValid = false;
+
+    cout << string(50,'=') << endl
+         << (isValid ? "Lookup Test Passed." : "Lookup Test Failed!")
+         << endl << string(50,'=') << endl;
+}
+
+//preconditions: n > 0
+//postconditions: a BPlusTree<int, MinDegree> and a BPlusTree<Pair<int, int>, MinDegree> of n random even keys
+// will be probed with multiFind for n random keys (about half of them missing, some repeated, and a
+// number of keys that is not a multiple of the group), and each result checked against findKey.
+// then the tree is scanned forwards (the scan prefetches leaves ahead) and checked to be in order.
+template <int MinDegree>
+bool multiFindRounds(int n)
+{
+    BPlusTree<int, MinDegree> tree;
+    BPlusTree<Pair<int, int>, MinDegree> pairs;
+    for(int i = 0; i < n; i++)
+    {
+        int key = 2 * (rand() % (2 * n));
+        tree.insert(key);
+        pairs.insert(Pair<int, int>(key, -key));
+    }
+
+    vector<int> probes(n + rand() % 20);
+    for(size_t i = 0; i < probes.size(); i++)
+        probes[i] = rand() % (4 * n + 2) - 1;
+    vector<const int*> found;
+    vector<const Pair<int, int>*> foundPairs(probes.size());
+    tree.multiFind(probes.begin(), probes.end(), back_inserter(found));
+    if(pairs.multiFind(probes.begin(), probes.end(), foundPairs.begin()) != foundPairs.end()
+       || found.size() != probes.size())
+        return false;
+    for(size_t i = 0; i < probes.size(); i++)
+        if(found[i] != tree.findKey(probes[i]) || foundPairs[i] != pairs.findKey(probes[i])
+           || (foundPairs[i] && foundPairs[i]->_value != -probes[i]))
+            return false;
+
+    vector<int> scanned(tree.begin(), tree.end());
+    return int(scanned.size()) == tree.size() && is_sorted(scanned.begin(), scanned.end());
+}
+
+//preconditions: n > 0
+//postconditions: multiFind is checked against findKey (see multiFindRounds), for several MinDegrees.
+// An empty range and an empty tree are checked too.
+void testMultiFind(int n, int iterations)
+{
+    cout << string(50,'=') << endl
+         << "Starting multi find test with: items = " << n << ", over iterations = " << iterations
+         << endl << string(50,'=') << endl;
+
+    bool isValid = true;
+    for(int j = 0; j < iterations && isValid; j++)
+        if(!multiFindRounds<1>(n) || !multiFindRounds<3>(n) || !multiFindRounds<DefaultMinDegree<int>::value>(n))
+        {
+            isValid = false;
+            cout << "Error, multiFind did not find what findKey found." << endl;
+        }
+
+    BPlusTree<string> empty;
+    vector<string> keys(3, "missing");
+    vector<const string*> found(3, &keys[0]);
+    empty.multiFind(keys.begin(), keys.begin(), found.begin());
+    empty.multiFind(keys.begin(), keys.end(), found.begin());
+    if(found[0] || found[1] || found[2])
+        isValid = false;
+
+    cout << string(50,'=') << endl
+         << (isValid ? "Multi Find Test Passed." : "Multi Find Test Failed!")
+         << endl << string(50,'=') << endl;
+}
+
+//preconditions: n > 0
+//postconditions: a BPlusTree<int, MinDegree> of n random even keys (with or without dups) and a Map of
+// the same keys will be probed with findMany and getMany for batches of random keys (about half of them
+// missing), of keys clustered close together, sorted, and of one key repeated, of lengths that are not
+// a multiple of the group, and each result checked against findKey and find.
+template <int MinDegree>
+bool findManyRounds(int n, bool dups)
+{
+    BPlusTree<int, MinDegree> tree(dups);
+    Map<int, int, MinDegree> map;
+    for(int i = 0; i < n; i++)
+    {
+        int key = 2 * (rand() % (2 * n));
+        tree.insert(key);
+        map[key] = -key;
+    }
+
+    for(int batch = 0; batch < 4; batch++)
+    {
+        vector<int> keys(1 + rand() % 100);
+        int base = rand() % (4 * n);
+        for(size_t i = 0; i < keys.size(); i++)
+            if(batch == 0)
+                keys[i] = rand() % (4 * n + 2) - 1;
+            else if(batch == 3)
+                keys[i] = base;
+            else
+                keys[i] = base + rand() % 40;
+        if(batch == 2)
+            sort(keys.begin(), keys.end());
+
+        vector<const int*> found(keys.size());
+        vector<const int*> values(keys.size());
+        tree.findMany(keys.data(), keys.size(), found.data());
+        map.getMany(keys.data(), keys.size(), values.data());
+        for(size_t i = 0; i < keys.size(); i++)
+            if(found[i] != tree.findKey(keys[i]) || values[i] != map.find(keys[i])
+               || (values[i] && *values[i] != -keys[i]))
+                return false;
+    }
+    return true;
+}
+
+//preconditions: n > 0
+//postconditions: findMany and getMany are checked against findKey and find (see findManyRounds), for
+// several MinDegrees, with and without dups. An empty batch and an empty tree are checked too.
+void testFindMany(int n, int iterations)
+{
+    cout << string(50,'=') << endl
+         << "Starting find many test with: items = " << n << ", over iterations = " << iterations
+         << endl << string(50,'=') << endl;
+
+    bool isValid = true;
+    for(int j = 0; j < iterations && isValid; j++)
+    {
+        bool dups = (j % 2 == 1);
+        if(!findManyRounds<1>(n, dups) || !findManyRounds<3>(n, dups) || !findManyRounds<DefaultMinDegree<int>::value>(n, dups))
+        {
+            isValid = false;
+            cout << "Error, findMany did not find what findKey found." << endl;
+        }
+    }
+
+    BPlusTree<string> empty;
+    Map<string, int> emptyMap;
+    vector<string> keys(3, "missing");
+    vector<const string*> found(3, &keys[0]);
+    int untouched = 0;
+    vector<const int*> values(3, &untouched);
+    empty.findMany(keys.data(), 0, found.data());
+    emptyMap.getMany(keys.data(), 0, values.data());
+    if(found[0] != &keys[0] || values[0] != &untouched)
+        isValid = false;
+    empty.findMany(keys.data(), keys.size(), found.data());
+    emptyMap.getMany(keys.data(), keys.size(), values.data());
+    if(found[0] || found[1] || found[2] || values[0] || values[1] || values[2])
+        isValid = false;
+
+    cout << string(50,'=') << endl
+         << (isValid ? "Find Many Test Passed." : "Find Many Test Failed!")
+         << endl << string(50,'=') << endl;
+}
+
 //preconditions: none
 //postconditions: the MMap will be tested by inserting many random multi-pairs to the MMap,
 // searching for them with operator[], and removing them, also the count will be verified for each MPair in the MMap.
@@ -1,6 +1,10 @@
 #ifndef MAP_H
 #define MAP_H
 #include <iostream>
+#include <vector>
+#include <utility>
+#include <algorithm>
+#include <iterator>
 #include "bplustree.h"
 using namespace std;
 
@@ -11,6 +15,9 @@ struct Pair
     V _value;
 
     Pair(const K& k=K(), const V& v=V()): _key(k), _value(v) {}
+    Pair(const K& k, V&& v): _key(k), _value(std::move(v)) {}
+    Pair(const std::pair<K, V>& p): _key(p.first), _value(p.second) {}
+    Pair(std::pair<K, V>&& p): _key(std::move(p.first)), _value(std::move(p.second)) {}
 
     friend std::ostream& operator <<(std::ostream& outs, const Pair<K, V>& printMe)
     {
@@ -26,7 +33,32 @@ struct Pair
     friend bool operator >= (const Pair<K, V>& lhs, const Pair<K, V>& rhs) { return (lhs._key >= rhs._key); }
 };
 
+//a Pair is ordered by its key, so only the key is stored in the inner nodes of the tree.
 template <typename K, typename V>
+struct KeyOf<Pair<K, V> >
+{
+    typedef K type;
+    static const K& key(const Pair<K, V>& item) {return item._key;}
+};
+
+//a Pair is saved as its key, then its value. (a trivially copyable Pair is saved as its bytes.)
+template <typename K, typename V>
+struct Encoder<Pair<K, V>, typename enable_if<!is_trivially_copyable<Pair<K, V> >::value>::type>
+{
+    static void write(ostream& outs, const Pair<K, V>& item)
+    {
+        Encoder<K>::write(outs, item._key);
+        Encoder<V>::write(outs, item._value);
+    }
+
+    static bool read(istream& ins, Pair<K, V>& item)
+    {
+        return Encoder<K>::read(ins, item._key) && Encoder<V>::read(ins, item._value);
+    }
+};
+
+//MinDegree is passed through to the underlying BPlusTree.
+template <typename K, typename V, int MinDegree = DefaultMinDegree<Pair<K,V> >::value>
 class Map
 {
 public:
@@ -35,8 +67,14 @@ public:
     public:
         friend class Map;
 
+        typedef bidirectional_iterator_tag iterator_category;
+        typedef V value_type;
+        typedef ptrdiff_t difference_type;
+        typedef V* pointer;
+        typedef V& reference;
+
         // Constructor
-        Iterator(typename BPlusTree<Pair<K,V> >::Iterator _it) : _treeIt(_it) {}
+        Iterator(typename BPlusTree<Pair<K,V>, MinDegree>::Iterator _it) : _treeIt(_it) {}
 
         //preconditions: _treeIt must not be null
         //postconditions: increment _treeIt and return *this.
@@ -58,6 +96,24 @@ public:
             return temp;
         }
 
+        //preconditions: this is not begin()
+        //postconditions: decrement _treeIt and return *this.
+        Iterator operator --()
+        {
+            --_treeIt;
+            return *this;
+        }
+
+        //preconditions: this is not begin()
+        //postconditions: make a copy of this, call the prefix
+        // decrement operator on this, then return the copy.
+        Iterator operator --(int unused)
+        {
+            Iterator temp = *this;
+            this->operator--();
+            return temp;
+        }
+
         //preconditions: _treeIt must not be null
         //postconditions: return the value of the pair that the
         // iterator is currently pointing to.
@@ -66,6 +122,14 @@ public:
             return (*_treeIt)._value;
         }
 
+        //preconditions: _treeIt must not be null
+        //postconditions: return the key of the pair that the
+        // iterator is currently pointing to.
+        const K& key()
+        {
+            return (*_treeIt)._key;
+        }
+
         friend bool operator ==(const Iterator& lhs, const Iterator& rhs)
         {
             return(lhs._treeIt == rhs._treeIt);
@@ -77,58 +141,113 @@ public:
         }
 
     private:
-        typename BPlusTree<Pair<K,V> >::Iterator _treeIt;
+        typename BPlusTree<Pair<K,V>, MinDegree>::Iterator _treeIt;
     };
 
+    typedef std::reverse_iterator<Iterator> ReverseIterator;
+
 
-    //  Constructor
+    //  Constructors
     Map(): _map(false) {}
 
+    //build the map from the range [first, last) of Pairs or std::pairs, sorting a copy
+    // first if the range is not sorted by key. When a key repeats, its first value is kept.
+    template <typename ForwardIt>
+    Map(ForwardIt first, ForwardIt last, double fillFactor = 1.0);
+
     //  Capacity
     int size() const;
     bool empty() const;
 
     //  Element Access
-    V& operator[](const K& key);
-    V& at(const K& key);
+    V& operator[](const K& key);                 //the value of key, inserted (default constructed) if it is not there
+    V& at(const K& key);                         //the value of key, which must be in the map
     const V& at(const K& key) const;
+    V* find(const K& key);                       //the value of key, nullptr if it is not there
+    const V* find(const K& key) const;
+    void getMany(const K* keys, size_t count, const V** values) const;  //values[i] = find(keys[i]), looked up as a batch
 
     //  Modifiers
     bool insert(const K& k, const V& v);
+    bool insert(const K& k, V&& v);
+    pair<Iterator, bool> try_emplace(const K& k, const V& v = V());
+    pair<Iterator, bool> try_emplace(const K& k, V&& v);
+    template <typename InputIt>
+    int insertBatch(InputIt first, InputIt last); //insert the Pairs (or std::pairs) of a range in one walk
     bool erase(const K& key);
+    template <typename InputIt>
+    int eraseBatch(InputIt first, InputIt last); //erase the keys of a range in one walk
     void clear();
-    V& get(const K& key);
+    V& get(const K& key);                        //same as operator[]
 
-    //  Operations:
+    //  Operations: (contains, count, find and at never insert, so a miss does not change the map)
     bool contains(const Pair<K, V>& target) const;
+    bool contains(const K& key) const;
+    int count(const K& key) const;               //1 if key is in the map, otherwise 0
     bool isValid(){return _map.isValid();}
 
-    friend ostream& operator<<(ostream& outs, const Map<K, V>& printMe)
+    //  Serialization: the pairs in binary (see BPlusTree::save and load), load replaces the contents.
+    bool save(ostream& outs) const {return _map.save(outs);}
+    bool load(istream& ins, double fillFactor = 1.0) {return _map.load(ins, fillFactor);}
+
+    friend ostream& operator<<(ostream& outs, const Map<K,V,MinDegree>& printMe)
     {
         outs<<printMe._map<<endl;
         return outs;
     }
 
     //  Iterator functions
-    Iterator begin(){return Map<K,V>::Iterator(_map.begin());}
-    Iterator end(){return Map<K,V>::Iterator(_map.end());}
+    Iterator begin(){return Map<K,V,MinDegree>::Iterator(_map.begin());}
+    Iterator end(){return Map<K,V,MinDegree>::Iterator(_map.end());}
+    ReverseIterator rbegin(){return ReverseIterator(end());}
+    ReverseIterator rend(){return ReverseIterator(begin());}
+
+    //  Range functions: the pairs with keys in [a, b) are [lower_bound(a), lower_bound(b))
+    Iterator lower_bound(const K& key){return Map<K,V,MinDegree>::Iterator(_map.lower_bound(key));}
+    Iterator upper_bound(const K& key){return Map<K,V,MinDegree>::Iterator(_map.upper_bound(key));}
+    pair<Iterator, Iterator> equal_range(const K& key){return make_pair(lower_bound(key), upper_bound(key));}
 
 private:
-    BPlusTree<Pair<K, V> > _map;
+    BPlusTree<Pair<K,V>, MinDegree> _map;
 };
 
+//preconditions: the items of [first, last) can be converted to Pair<K, V>.
+//postconditions: the tree is bulk loaded from the range, or from a
+// stably sorted copy of it if the range is not sorted by key.
+template<typename K, typename V, int MinDegree>
+template<typename ForwardIt>
+Map<K,V,MinDegree>::Map(ForwardIt first, ForwardIt last, double fillFactor): _map(false)
+{
+    typedef typename iterator_traits<ForwardIt>::value_type Item;
+    struct ByKey
+    {
+        bool operator()(const Item& lhs, const Item& rhs) const {return keyOfItem(lhs) < keyOfItem(rhs);}
+        static const K& keyOfItem(const Pair<K, V>& item) {return item._key;}
+        static const K& keyOfItem(const std::pair<K, V>& item) {return item.first;}
+    };
+
+    if(is_sorted(first, last, ByKey()))
+        _map.bulkLoad(first, last, fillFactor);
+    else
+    {
+        vector<Item> sorted(first, last);
+        stable_sort(sorted.begin(), sorted.end(), ByKey());
+        _map.bulkLoad(make_move_iterator(sorted.begin()), make_move_iterator(sorted.end()), fillFactor);
+    }
+}
+
 //preconditions: none
 //postconditions: return the size of the BTree (i.e., the map)
-template <typename K, typename V>
-int Map<K,V>::size() const
+template<typename K, typename V, int MinDegree>
+int Map<K,V,MinDegree>::size() const
 {
     return _map.size();
 }
 
 //preconditions: none
 //postconditions: if the BTree is empty, return true, otherwise false.
-template <typename K, typename V>
-bool Map<K,V>::empty() const
+template<typename K, typename V, int MinDegree>
+bool Map<K,V,MinDegree>::empty() const
 {
     return (_map.size() == 0);
 }
@@ -137,64 +256,124 @@ bool Map<K,V>::empty() const
 //postconditions: returns the value of the pair with the recieved key.
 // if no such pair already exists a pair with a default constructed value
 // will be inserted, and a reference to it will be returned.
-template<typename K, typename V>
-V& Map<K,V>::operator[](const K &key)
+template<typename K, typename V, int MinDegree>
+V& Map<K,V,MinDegree>::operator[](const K &key)
 {
     return _map.get(Pair<K,V>(key,V()))._value;
 }
 
-//preconditions: none
+//preconditions: the key is in the map.
+//postconditions: returns the value of the pair with the recieved key. (the map is not changed)
+template<typename K, typename V, int MinDegree>
+V& Map<K,V,MinDegree>::at(const K& key)
+{
+    V* value = find(key);
+    assert(value);
+    return *value;
+}
+
+//preconditions: the key is in the map.
 //postconditions: returns the value of the pair with the recieved key.
-// if no such pair already exists a pair with a default constructed value
-// will be inserted, and a reference to it will be returned.
-template<typename K, typename V>
-V& Map<K,V>::at(const K& key)
+template<typename K, typename V, int MinDegree>
+const V& Map<K,V,MinDegree>::at(const K& key) const
 {
-    return _map.get(Pair<K,V>(key,V()))._value;
+    const V* value = find(key);
+    assert(value);
+    return *value;
 }
 
 //preconditions: none
-//postconditions: returns the value of the pair with the recieved key.
-// if no such pair already exists a pair with a default constructed value
-// will be inserted, and a reference to it will be returned.
-template<typename K, typename V>
-const V& Map<K,V>::at(const K& key) const
+//postconditions: returns a pointer to the value of the pair with the recieved key,
+// or nullptr if there is none. (the map is not changed, and no pair is made for the search)
+template<typename K, typename V, int MinDegree>
+V* Map<K,V,MinDegree>::find(const K& key)
 {
-    return _map.get(Pair<K,V>(key,V()))._value;
+    Pair<K,V>* found = _map.findKey(key);
+    return found ? &found->_value : nullptr;
+}
+
+template<typename K, typename V, int MinDegree>
+const V* Map<K,V,MinDegree>::find(const K& key) const
+{
+    const Pair<K,V>* found = _map.findKey(key);
+    return found ? &found->_value : nullptr;
 }
 
 //preconditions: none
-//postconditions: if duplicates are allowed in the BTree, or the value
-// associated with the recieved key is still default constructed
-// (indicating that get could not find an existing pair, so it inserted a new one)
-// then reassign the value the recieved value (v), and return true.
-// otherwise, return false.
-template<typename K, typename V>
-bool Map<K,V>::insert(const K &k, const V &v)
-{
-    V *temp = &this->operator[](k);
-    if(_map.areDupsOk() || *temp == V())
-    {
-        *temp = v;
-        return true;
-    }
-    else
-        return false;
+//postconditions: if the key is not in the map yet, the pair (k, v) is inserted
+// and true is returned. otherwise the map is left as it is, and false is returned.
+template<typename K, typename V, int MinDegree>
+bool Map<K,V,MinDegree>::insert(const K &k, const V &v)
+{
+    return _map.try_emplace(k,v).second;
+}
+
+//preconditions: none
+//postconditions: same as insert(const K&, const V&), but v is moved into the map.
+// (the pair is only made, moving v, if it is inserted: v is left as it is if k was there)
+template<typename K, typename V, int MinDegree>
+bool Map<K,V,MinDegree>::insert(const K &k, V &&v)
+{
+    return _map.try_emplace(k,std::move(v)).second;
+}
+
+//preconditions: none
+//postconditions: if the key is not in the map yet, the pair (k, v) is inserted, and an
+// iterator to it is returned with true. otherwise an iterator to the existing pair is
+// returned with false. the tree is descended only once either way, and the pair is only
+// made (copying v) if it is inserted.
+template<typename K, typename V, int MinDegree>
+pair<typename Map<K,V,MinDegree>::Iterator, bool> Map<K,V,MinDegree>::try_emplace(const K &k, const V &v)
+{
+    pair<typename BPlusTree<Pair<K,V>, MinDegree>::Iterator, bool> result = _map.try_emplace(k,v);
+    return make_pair(Iterator(result.first), result.second);
+}
+
+//preconditions: none
+//postconditions: same as try_emplace(const K&, const V&), but v is moved into the map.
+// like std::map::try_emplace, v is left as it is if k was there: the pair is only made
+// (moving v) in the leaf it is inserted into, in the same descent.
+template<typename K, typename V, int MinDegree>
+pair<typename Map<K,V,MinDegree>::Iterator, bool> Map<K,V,MinDegree>::try_emplace(const K &k, V &&v)
+{
+    pair<typename BPlusTree<Pair<K,V>, MinDegree>::Iterator, bool> result = _map.try_emplace(k,std::move(v));
+    return make_pair(Iterator(result.first), result.second);
+}
+
+//preconditions: the items of [first, last) can be converted to Pair<K, V>.
+//postconditions: the pairs whose keys are not in the map yet are inserted with
+// BPlusTree::insertBatch (when a key repeats in the range, its first value is kept).
+// returns the number of pairs inserted.
+template<typename K, typename V, int MinDegree>
+template<typename InputIt>
+int Map<K,V,MinDegree>::insertBatch(InputIt first, InputIt last)
+{
+    return _map.insertBatch(first, last);
+}
+
+//preconditions: the items of [first, last) are keys.
+//postconditions: the pairs with the keys of the range are removed with
+// BPlusTree::eraseBatch, and the number of pairs removed is returned.
+template<typename K, typename V, int MinDegree>
+template<typename InputIt>
+int Map<K,V,MinDegree>::eraseBatch(InputIt first, InputIt last)
+{
+    return _map.eraseBatch(first, last);
 }
 
 //preconditions: none
 //postconditions: removes the pair with the recieved key from the map,
 // returning true if the pair was removed, otherwise false.
-template<typename K, typename V>
-bool Map<K,V>::erase(const K &key)
+template<typename K, typename V, int MinDegree>
+bool Map<K,V,MinDegree>::erase(const K &key)
 {
     return _map.remove(Pair<K,V>(key,V()));
 }
 
 //preconditions: none
 //postconditions: calls clear on the BTree, erasing all items from it.
-template<typename K, typename V>
-void Map<K,V>::clear()
+template<typename K, typename V, int MinDegree>
+void Map<K,V,MinDegree>::clear()
 {
     _map.clearTree();
 }
@@ -203,18 +382,51 @@ void Map<K,V>::clear()
 //postconditions: returns the value of the pair with the recieved key.
 // if no such pair already exists a pair with a default constructed value
 // will be inserted, and a reference to it will be returned.
-template<typename K, typename V>
-V& Map<K,V>::get(const K &key)
+template<typename K, typename V, int MinDegree>
+V& Map<K,V,MinDegree>::get(const K &key)
 {
     return _map.get(Pair<K,V>(key,V()))._value;
 }
 
 //preconditions: none
 //postconditions: returns true if the target exists in the Map, otherwise false.
-template<typename K, typename V>
-bool Map<K,V>::contains(const Pair<K, V> &target) const
+template<typename K, typename V, int MinDegree>
+bool Map<K,V,MinDegree>::contains(const Pair<K, V> &target) const
 {
     return _map.contains(target);
 }
 
+//preconditions: keys and values hold count items.
+//postconditions: values[i] points to the value of keys[i], or is nullptr if it is not there.
+// the keys are looked up with BPlusTree::findMany, a group of them at a time. (the map is not changed)
+template<typename K, typename V, int MinDegree>
+void Map<K,V,MinDegree>::getMany(const K* keys, size_t count, const V** values) const
+{
+    const int GROUP = BPlusTree<Pair<K,V>, MinDegree>::MULTI_FIND_GROUP;
+    const Pair<K,V>* pairs[GROUP];
+    for(size_t first = 0; first < count; first += GROUP)
+    {
+        size_t size = min(count - first, size_t(GROUP));
+        _map.findMany(keys + first, size, pairs);
+        for(size_t i = 0; i < size; i++)
+            values[first + i] = pairs[i] ? &pairs[i]->_value : nullptr;
+    }
+}
+
+//preconditions: none
+//postconditions: returns true if a pair with the key exists in the Map, otherwise false.
+template<typename K, typename V, int MinDegree>
+bool Map<K,V,MinDegree>::contains(const K &key) const
+{
+    return _map.findKey(key) != nullptr;
+}
+
+//preconditions: none
+//postconditions: returns the number of pairs with the key, (1 or 0).
+template<typename K, typename V, int MinDegree>
+int Map<K,V,MinDegree>::count(const K &key) const
+{
+    return contains(key) ? 1 : 0;
+}
+
 #endif // MAP_H
@@ -0,0 +1,622 @@
+#ifndef MAPPEDBPLUSTREE_H
+#define MAPPEDBPLUSTREE_H
+
+#include <iostream>
+#include <iterator>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <type_traits>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "bplustree.h"
+using namespace std;
+
+//MappedBPlusTree is a read-only B+Tree stored in a file of fixed size pages, that is opened by
+// mapping the file into memory: nothing is read or rebuilt, find and iteration work on the pages
+// of the mapping in place, and the operating system pages them in as they are touched.
+// A page refers to another by its page id (its offset in the file is id * PageSize), never by a
+// pointer, so the file means the same wherever it is mapped. The file is laid out as:
+//    page 0:          the FileHeader (what the file holds, and where the root and leaves are).
+//    pages 1..L:      the leaves, in order. each holds as many items as fit, and the page ids of
+//                     the leaves on its right and left (0, the header page, for none).
+//    pages L+1..end:  the inner levels, bottom-up, the root last. an inner page holds the page ids
+//                     of its children, and keys[i]: the smallest key of children[i+1].
+// The items (and keys) are stored as their bytes, so T and Key must be trivially copyable, and a
+// file can only be opened by a build with the same item size, key size, page size and byte order.
+// write() builds a file from a sorted range, (a BPlusTree's begin() and end(), for one).
+template <typename T, int PageSize = 4096>
+class MappedBPlusTree
+{
+public:
+    typedef typename KeyOf<T>::type Key;
+
+private:
+    static_assert(is_trivially_copyable<T>::value, "MappedBPlusTree stores the bytes of its items: T must be trivially copyable");
+    static_assert(is_trivially_copyable<Key>::value, "MappedBPlusTree stores the bytes of its keys: Key must be trivially copyable");
+
+    static const uint64_t MAGIC = 0x3130454552545042ULL;   //"BPTREE01", read as a little endian integer
+    static const uint32_t VERSION = 1;
+    static const uint32_t LEAF = 1;
+    static const uint32_t INNER = 2;
+
+    //page 0 of the file.
+    struct FileHeader
+    {
+        uint64_t magic;
+        uint32_t version;
+        uint32_t pageSize;
+        uint32_t itemSize;
+        uint32_t keySize;
+        uint32_t dupsOk;
+        uint32_t height;                           //the number of levels, 1 for a root that is a leaf
+        uint64_t pageCount;
+        uint64_t itemCount;
+        uint64_t rootPage;                         //0 when the file holds no items
+        uint64_t firstLeaf;
+        uint64_t lastLeaf;
+    };
+
+    //the start of every leaf and inner page.
+    struct PageHeader
+    {
+        uint32_t kind;                             //LEAF or INNER
+        uint32_t count;                            //items in a leaf, keys in an inner page
+        uint64_t next;                             //the leaf on the right, 0 if none (0 in an inner page)
+        uint64_t prev;                             //the leaf on the left, 0 if none (0 in an inner page)
+    };
+
+    static const int LEAF_CAPACITY = int((PageSize - sizeof(PageHeader)) / sizeof(T));
+    static const int INNER_CAPACITY = int((PageSize - sizeof(PageHeader) - sizeof(uint64_t)) / (sizeof(Key) + sizeof(uint64_t)));
+
+    struct LeafPage
+    {
+        PageHeader header;
+        T items[LEAF_CAPACITY];
+    };
+
+    struct InnerPage
+    {
+        PageHeader header;
+        uint64_t children[INNER_CAPACITY + 1];
+        Key keys[INNER_CAPACITY];
+    };
+
+    static_assert(LEAF_CAPACITY >= 2 && INNER_CAPACITY >= 2, "a page must hold at least two items and two keys");
+    static_assert(sizeof(FileHeader) <= PageSize && sizeof(LeafPage) <= PageSize && sizeof(InnerPage) <= PageSize,
+                  "every page must fit in PageSize bytes");
+
+public:
+    //a bidirectional iterator over the items, in order, reading the leaves of the mapping in place.
+    // end() is a null iterator that still knows its tree, so that it can be decremented to the last item.
+    // iterators are valid until the tree is closed.
+    class Iterator
+    {
+    public:
+        friend class MappedBPlusTree;
+
+        typedef bidirectional_iterator_tag iterator_category;
+        typedef T value_type;
+        typedef ptrdiff_t difference_type;
+        typedef const T* pointer;
+        typedef const T& reference;
+
+        friend bool operator ==(const Iterator& lhs, const Iterator& rhs){return (lhs.leaf == rhs.leaf && lhs.keyPtr == rhs.keyPtr);}
+        friend bool operator !=(const Iterator& lhs, const Iterator& rhs){return !(lhs == rhs);}
+
+        Iterator(const LeafPage* _leaf = nullptr, int _keyPtr = 0, const MappedBPlusTree* _owner = nullptr):
+            leaf(_leaf), keyPtr(_keyPtr), owner(_owner) {}
+
+        bool is_null() const {return !leaf;}
+
+        //preconditions: leaf != nullptr, keyPtr < leaf->header.count
+        //postconditions: return items[keyPtr] of leaf.
+        const T& operator *() const
+        {
+            assert(leaf && keyPtr < int(leaf->header.count));
+            return leaf->items[keyPtr];
+        }
+
+        const T* operator ->() const
+        {
+            return &this->operator*();
+        }
+
+        Iterator operator++(int unUsed)
+        {
+            Iterator temp = *this;
+            this->operator++();
+            return temp;
+        }
+
+        //preconditions: leaf != nullptr
+        //postconditions: advance keyPtr if there are more items in the current leaf,
+        // otherwise, move to the first item of the next leaf (or to end).
+        Iterator& operator++()
+        {
+            if(leaf != nullptr)
+            {
+                if(keyPtr+1 < int(leaf->header.count))
+                    keyPtr++;
+                else
+                {
+                    leaf = owner->leafPage(leaf->header.next);
+                    keyPtr = 0;
+                }
+            }
+            return *this;
+        }
+
+        Iterator operator--(int unUsed)
+        {
+            Iterator temp = *this;
+            this->operator--();
+            return temp;
+        }
+
+        //preconditions: this is not the first item.
+        //postconditions: move keyPtr back if it is not at the front of the current leaf,
+        // otherwise, move back to the last item of the previous leaf (from end(), the last leaf).
+        // (if a corrupt file links to a page that is not a leaf, the iterator becomes end())
+        Iterator& operator--()
+        {
+            if(leaf != nullptr && keyPtr > 0)
+                keyPtr--;
+            else
+            {
+                assert(owner);
+                leaf = owner->leafPage(leaf ? leaf->header.prev : owner->header()->lastLeaf);
+                keyPtr = leaf ? int(leaf->header.count) - 1 : 0;
+            }
+            return *this;
+        }
+
+    private:
+        const LeafPage* leaf;
+        int keyPtr;
+        const MappedBPlusTree* owner;
+    };
+
+    typedef std::reverse_iterator<Iterator> ReverseIterator;
+
+    MappedBPlusTree(): base(nullptr), bytes(0) {}
+    ~MappedBPlusTree() {close();}
+
+    //write the sorted range [first, last) to a new file at path (replacing any file there),
+    // keeping only the first item of a repeated key unless dupsOk. returns false if the file
+    // cannot be written.
+    template <typename InputIt>
+    static bool write(const char* path, InputIt first, InputIt last, bool dupsOk = false);
+
+    bool open(const char* path);                   //map the file at path, false if it is not a valid tree file
+    void close();                                  //unmap the file (invalidates every iterator)
+    bool isOpen() const {return base != nullptr;}
+
+    bool areDupsOk() const {return header()->dupsOk != 0;}
+    int size() const {return isOpen() ? int(header()->itemCount) : 0;}
+    bool empty() const {return size() == 0;}
+    int height() const {return isOpen() ? int(header()->height) : 0;}
+    size_t pageCount() const {return isOpen() ? size_t(header()->pageCount) : 0;}
+
+    const T* find(const Key& key) const;           //return a pointer to the item with key in the mapping, NULL if not there.
+    bool contains(const Key& key) const {return find(key) != nullptr;}
+
+    Iterator lower_bound(const Key& key) const;    //return an iterator to the first item not less than key.
+    Iterator upper_bound(const Key& key) const;    //return an iterator to the first item greater than key.
+    Iterator begin() const;
+    Iterator end() const {return Iterator(nullptr, 0, this);}
+    ReverseIterator rbegin() const {return ReverseIterator(end());}
+    ReverseIterator rend() const {return ReverseIterator(begin());}
+
+    bool isValid() const;                          //verify that the pages satisfy all B+Tree rules.
+
+private:
+    const char* base;                              //the mapping, nullptr when closed
+    size_t bytes;                                  //the length of the mapping
+
+    static const Key& keyOf(const T& item) {return KeyOf<T>::key(item);}
+
+    const FileHeader* header() const {return reinterpret_cast<const FileHeader*>(base);}
+    const PageHeader* page(uint64_t id) const {return reinterpret_cast<const PageHeader*>(base + id * PageSize);}
+
+    //the page ids read from the file are checked before they are followed: a page id out of the file,
+    // a page of the other kind, or a count past the page's capacity gives nullptr (for a leaf, the end).
+    const LeafPage* leafPage(uint64_t id) const;
+    const InnerPage* innerPage(uint64_t id) const;
+
+    const LeafPage* findLeaf(const Key& key, int& index) const;
+    static int leafIndex(const LeafPage* leaf, const Key& key);
+    bool verifyPage(uint64_t id, int depth, const Key* low, const Key* high, size_t& items) const;
+
+    static bool writePage(FILE* file, const void* pageBytes);
+
+    MappedBPlusTree(const MappedBPlusTree&);
+    MappedBPlusTree& operator =(const MappedBPlusTree&);
+};
+
+//preconditions: [first, last) is sorted by key.
+//postconditions: the file at path holds the items of [first, last) in the format described above,
+// built in one pass, the way BPlusTree::bulkLoad builds a tree:
+//  1) the items are written to full leaves, (a leaf is held back until the next one starts, so that
+//     the last leaf is written knowing it has no next),
+//  2) each inner level is written over the level below, until one root page remains,
+//  3) the header is written last, in page 0.
+// returns false if the file could not be opened or written.
+template <typename T, int PageSize>
+template <typename InputIt>
+bool MappedBPlusTree<T, PageSize>::write(const char* path, InputIt first, InputIt last, bool dupsOk)
+{
+    FILE* file = fopen(path, "wb");
+    if(!file)
+        return false;
+
+    vector<char> buffer(PageSize, 0);
+    bool ok = writePage(file, buffer.data());     //page 0, rewritten at the end
+
+    //the page ids and smallest keys of the current level.
+    vector<uint64_t> ids;
+    vector<Key> lowKeys;
+    uint64_t nextId = 1;
+    uint64_t items = 0;
+
+    vector<char> leafBuffer(PageSize, 0);
+    LeafPage* leaf = reinterpret_cast<LeafPage*>(leafBuffer.data());
+    bool pending = false;                          //leaf holds items that are not written yet
+    const T* lastItem = nullptr;
+
+    for(; first != last && ok; ++first)
+    {
+        T item(*first);
+        if(lastItem)
+        {
+            assert(!(keyOf(item) < keyOf(*lastItem)));
+            if(!dupsOk && keyOf(item) == keyOf(*lastItem))
+                continue;
+        }
+
+        if(pending && int(leaf->header.count) == LEAF_CAPACITY)
+        {
+            leaf->header.next = nextId + 1;
+            ok = writePage(file, leaf);
+            pending = false;
+            nextId++;
+        }
+        if(!pending)
+        {
+            memset(leafBuffer.data(), 0, PageSize);
+            leaf->header.kind = LEAF;
+            leaf->header.prev = ids.empty() ? 0 : ids.back();
+            ids.push_back(nextId);
+            lowKeys.push_back(keyOf(item));
+            pending = true;
+        }
+
+        leaf->items[leaf->header.count++] = item;
+        lastItem = &leaf->items[leaf->header.count-1];
+        items++;
+    }
+    if(pending && ok)
+    {
+        ok = writePage(file, leaf);
+        nextId++;
+    }
+
+    FileHeader fileHeader;
+    memset(&fileHeader, 0, sizeof(fileHeader));
+    fileHeader.firstLeaf = ids.empty() ? 0 : ids.front();
+    fileHeader.lastLeaf = ids.empty() ? 0 : ids.back();
+    fileHeader.height = ids.empty() ? 0 : 1;
+
+    //the inner levels: each page takes up to INNER_CAPACITY+1 children, and the last two pages of
+    // a level share their children evenly, so that no inner page has fewer than two children.
+    while(ids.size() > 1 && ok)
+    {
+        vector<uint64_t> parentIds;
+        vector<Key> parentLowKeys;
+        const size_t fanout = INNER_CAPACITY + 1;
+        size_t children = ids.size();
+        size_t pages = (children + fanout - 1) / fanout;
+
+        size_t start = 0;
+        for(size_t p = 0; p < pages && ok; p++)
+        {
+            size_t count = fanout;
+            if(p == pages - 1)
+                count = children - start;
+            else if(p == pages - 2 && children - start - fanout < 2)
+                count = (children - start) / 2;
+
+            memset(buffer.data(), 0, PageSize);
+            InnerPage* inner = reinterpret_cast<InnerPage*>(buffer.data());
+            inner->header.kind = INNER;
+            inner->header.count = uint32_t(count - 1);
+            for(size_t c = 0; c < count; c++)
+            {
+                inner->children[c] = ids[start + c];
+                if(c > 0)
+                    inner->keys[c-1] = lowKeys[start + c];
+            }
+            ok = writePage(file, inner);
+            parentIds.push_back(nextId++);
+            parentLowKeys.push_back(lowKeys[start]);
+            start += count;
+        }
+
+        ids.swap(parentIds);
+        lowKeys.swap(parentLowKeys);
+        fileHeader.height++;
+    }
+
+    fileHeader.magic = MAGIC;
+    fileHeader.version = VERSION;
+    fileHeader.pageSize = PageSize;
+    fileHeader.itemSize = sizeof(T);
+    fileHeader.keySize = sizeof(Key);
+    fileHeader.dupsOk = dupsOk;
+    fileHeader.pageCount = nextId;
+    fileHeader.itemCount = items;
+    fileHeader.rootPage = ids.empty() ? 0 : ids.front();
+
+    memset(buffer.data(), 0, PageSize);
+    memcpy(buffer.data(), &fileHeader, sizeof(fileHeader));
+    ok = ok && fseek(file, 0, SEEK_SET) == 0 && writePage(file, buffer.data());
+
+    return (fclose(file) == 0) && ok;
+}
+
+//preconditions: pageBytes points at PageSize bytes.
+//postconditions: the page is appended to file. returns false on a write error.
+template <typename T, int PageSize>
+bool MappedBPlusTree<T, PageSize>::writePage(FILE* file, const void* pageBytes)
+{
+    return fwrite(pageBytes, 1, PageSize, file) == size_t(PageSize);
+}
+
+//preconditions: none
+//postconditions: closes any file mapped before, then maps the file at path read only. returns
+// false (leaving the tree closed) if the file cannot be mapped, or its header does not describe
+// a tree of this T, Key and PageSize that fits in the file.
+template <typename T, int PageSize>
+bool MappedBPlusTree<T, PageSize>::open(const char* path)
+{
+    close();
+
+    int fd = ::open(path, O_RDONLY);
+    if(fd < 0)
+        return false;
+
+    struct stat info;
+    if(fstat(fd, &info) != 0 || info.st_size < PageSize)
+    {
+        ::close(fd);
+        return false;
+    }
+
+    void* mapping = mmap(nullptr, size_t(info.st_size), PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);                                   //the mapping keeps the file open
+    if(mapping == MAP_FAILED)
+        return false;
+
+    base = static_cast<const char*>(mapping);
+    bytes = size_t(info.st_size);
+
+    const FileHeader* h = header();
+    bool ok = h->magic == MAGIC && h->version == VERSION && h->pageSize == uint32_t(PageSize)
+           && h->itemSize == sizeof(T) && h->keySize == sizeof(Key)
+           && h->pageCount <= bytes / PageSize && h->rootPage < h->pageCount
+           && h->firstLeaf < h->pageCount && h->lastLeaf < h->pageCount
+           && (h->rootPage == 0 || (h->height >= 1 && h->height <= h->pageCount));
+    if(!ok)
+        close();
+    return ok;
+}
+
+//preconditions: the tree is open.
+//postconditions: returns leaf page id, or nullptr if id is 0 (no leaf), or not a (non empty) leaf page of the file.
+template <typename T, int PageSize>
+const typename MappedBPlusTree<T, PageSize>::LeafPage* MappedBPlusTree<T, PageSize>::leafPage(uint64_t id) const
+{
+    if(id == 0 || id >= header()->pageCount)
+        return nullptr;
+    const PageHeader* p = page(id);
+    bool ok = p->kind == LEAF && p->count >= 1 && p->count <= uint32_t(LEAF_CAPACITY);
+    return ok ? reinterpret_cast<const LeafPage*>(p) : nullptr;
+}
+
+//preconditions: the tree is open.
+//postconditions: returns inner page id, or nullptr if id is not an inner page of the file.
+template <typename T, int PageSize>
+const typename MappedBPlusTree<T, PageSize>::InnerPage* MappedBPlusTree<T, PageSize>::innerPage(uint64_t id) const
+{
+    if(id == 0 || id >= header()->pageCount)
+        return nullptr;
+    const PageHeader* p = page(id);
+    bool ok = p->kind == INNER && p->count <= uint32_t(INNER_CAPACITY);
+    return ok ? reinterpret_cast<const InnerPage*>(p) : nullptr;
+}
+
+//preconditions: none
+//postconditions: the mapping (if any) is removed.
+template <typename T, int PageSize>
+void MappedBPlusTree<T, PageSize>::close()
+{
+    if(base)
+        munmap(const_cast<char*>(base), bytes);
+    base = nullptr;
+    bytes = 0;
+}
+
+//preconditions: none
+//postconditions: returns the index of the first item in leaf whose key is not less than key,
+// if no such item exists, returns its count. (a branchless binary search, see firstGEBinary)
+template <typename T, int PageSize>
+int MappedBPlusTree<T, PageSize>::leafIndex(const LeafPage* leaf, const Key& key)
+{
+    int count = int(leaf->header.count);
+    if(count == 0)
+        return 0;
+
+    const T* items = leaf->items;
+    const T* cursor = items;
+    int len = count;
+    while(len > 1)
+    {
+        int half = len / 2;
+        cursor = (keyOf(cursor[half]) < key) ? cursor + half : cursor;
+        len -= half;
+    }
+
+    return int(cursor - items) + (keyOf(*cursor) < key);
+}
+
+//preconditions: the tree is open and not empty.
+//postconditions: follows the keys from the root page to the leaf where key is (or would be), and
+// returns it with index set to leafIndex(leaf, key). as in BPlusTree, a key equal to keys[i] goes to
+// children[i+1]. with dups, copies of keys[i] may also end children[i], so the search goes there.
+// returns nullptr if the path leaves the file's pages, or is longer than the height, (a corrupt file).
+template <typename T, int PageSize>
+const typename MappedBPlusTree<T, PageSize>::LeafPage* MappedBPlusTree<T, PageSize>::findLeaf(const Key& key, int& index) const
+{
+    bool dups = areDupsOk();
+    uint64_t id = header()->rootPage;
+    for(uint32_t depth = 1; depth < header()->height; depth++)
+    {
+        const InnerPage* inner = innerPage(id);
+        if(!inner)
+            return nullptr;
+        int i = NodeSearch<Key>::firstGE(inner->keys, int(inner->header.count), key);
+        bool found = (i < int(inner->header.count) && key == inner->keys[i]);
+        id = inner->children[(found && !dups) ? i+1 : i];
+    }
+
+    const LeafPage* leaf = leafPage(id);
+    if(leaf)
+        index = leafIndex(leaf, key);
+    return leaf;
+}
+
+//preconditions: none
+//postconditions: returns a pointer into the mapping, to the (first) item with key, or nullptr.
+template <typename T, int PageSize>
+const T* MappedBPlusTree<T, PageSize>::find(const Key& key) const
+{
+    Iterator it = lower_bound(key);
+    if(it.is_null() || !(keyOf(*it) == key))
+        return nullptr;
+    return &*it;
+}
+
+//preconditions: none
+//postconditions: returns an iterator to the first item whose key is not less than key, or end().
+template <typename T, int PageSize>
+typename MappedBPlusTree<T, PageSize>::Iterator MappedBPlusTree<T, PageSize>::lower_bound(const Key& key) const
+{
+    if(empty())
+        return end();
+
+    int index = 0;
+    const LeafPage* leaf = findLeaf(key, index);
+    if(!leaf)
+        return end();
+    if(index == int(leaf->header.count))
+        return Iterator(leafPage(leaf->header.next), 0, this);
+    return Iterator(leaf, index, this);
+}
+
+//preconditions: none
+//postconditions: returns an iterator to the first item whose key is greater than key, or end().
+template <typename T, int PageSize>
+typename MappedBPlusTree<T, PageSize>::Iterator MappedBPlusTree<T, PageSize>::upper_bound(const Key& key) const
+{
+    Iterator it = lower_bound(key);
+    while(!it.is_null() && !(key < keyOf(*it)))
+        ++it;
+    return it;
+}
+
+//preconditions: none
+//postconditions: returns an iterator to the first item, or end() if the tree is empty.
+template <typename T, int PageSize>
+typename MappedBPlusTree<T, PageSize>::Iterator MappedBPlusTree<T, PageSize>::begin() const
+{
+    return empty() ? end() : Iterator(leafPage(header()->firstLeaf), 0, this);
+}
+
+//preconditions: none
+//postconditions: returns true if the tree is closed or empty, or if, starting at the root page:
+// every page id is inside the file, every page holds keys (or items) in order, between the keys
+// its parent bounds it with, inner pages hold at least one key, every leaf is at the same depth and
+// not empty, the leaf chain runs (both ways) from firstLeaf to lastLeaf, and the items add up to size().
+template <typename T, int PageSize>
+bool MappedBPlusTree<T, PageSize>::isValid() const
+{
+    if(!isOpen() || header()->rootPage == 0)
+        return !isOpen() || header()->itemCount == 0;
+
+    size_t items = 0;
+    if(!verifyPage(header()->rootPage, 1, nullptr, nullptr, items) || items != header()->itemCount)
+        return false;
+
+    //walk the chain forwards, checking each back link, and count the items again.
+    size_t chained = 0;
+    uint64_t previous = 0;
+    for(uint64_t id = header()->firstLeaf; id != 0; id = leafPage(id)->header.next)
+    {
+        if(!leafPage(id) || leafPage(id)->header.prev != previous)
+            return false;
+        chained += leafPage(id)->header.count;
+        previous = id;
+    }
+    return previous == header()->lastLeaf && chained == items;
+}
+
+//preconditions: low and high (when not null) bound the keys the page may hold: low <= key < high,
+// (key <= high with dups).
+//postconditions: returns true if the subtree of page id satisfies the rules described in isValid,
+// adding its items to items.
+template <typename T, int PageSize>
+bool MappedBPlusTree<T, PageSize>::verifyPage(uint64_t id, int depth, const Key* low, const Key* high, size_t& items) const
+{
+    if(id == 0 || id >= header()->pageCount)
+        return false;
+
+    bool dups = areDupsOk();
+    const PageHeader* p = page(id);
+    if(p->kind == LEAF)
+    {
+        const LeafPage* leaf = leafPage(id);
+        if(!leaf || depth != int(header()->height) || leaf->header.count == 0)
+            return false;
+        for(int i = 0; i < int(leaf->header.count); i++)
+        {
+            const Key& key = keyOf(leaf->items[i]);
+            if(i > 0 && (dups ? key < keyOf(leaf->items[i-1]) : !(keyOf(leaf->items[i-1]) < key)))
+                return false;
+            if((low && key < *low) || (high && (dups ? *high < key : !(key < *high))))
+                return false;
+        }
+        items += leaf->header.count;
+        return true;
+    }
+
+    const InnerPage* inner = innerPage(id);
+    if(!inner || depth >= int(header()->height) || inner->header.count < 1)
+        return false;
+    int count = int(inner->header.count);
+    for(int i = 0; i <= count; i++)
+    {
+        if(i < count && i > 0 && (dups ? inner->keys[i] < inner->keys[i-1] : !(inner->keys[i-1] < inner->keys[i])))
+            return false;
+        const Key* childLow = (i == 0) ? low : &inner->keys[i-1];
+        const Key* childHigh = (i == count) ? high : &inner->keys[i];
+        if(!verifyPage(inner->children[i], depth + 1, childLow, childHigh, items))
+            return false;
+    }
+    return true;
+}
+
+#endif // MAPPEDBPLUSTREE_H
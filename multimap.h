@@ -1,31 +1,40 @@
 #ifndef MULTIMAP_H
 #define MULTIMAP_H
 #include "bplustree.h"
+#include "valuelist.h"
 #include <vector>
+#include <utility>
+#include <algorithm>
+#include <iterator>
 using namespace std;
 
+//the values of a key are kept in a ValueList, so the short lists (most of them) are stored in the
+// leaf itself, and moving an MPair between leaf slots never copies (or allocates for) its values.
 template <typename K, typename V>
 struct MPair
 {
     K key;
-    vector<V> values;
+    ValueList<V> values;
 
     //Constructors
     MPair(const K& k=K())
     {
         key = k;
-        values;
     }
     MPair(const K& k, const V& v)
     {
         key = k;
-        values;
         values.push_back(v);
     }
     MPair(const K& k, const vector<V>& vlist)
     {
         key = k;
-        values(vlist);
+        values.assign(vlist.begin(), vlist.end());
+    }
+    MPair(const K& k, vector<V>&& vlist)
+    {
+        key = k;
+        values.assign(make_move_iterator(vlist.begin()), make_move_iterator(vlist.end()));
     }
 
     //--------------------------------------------------------------------------------
@@ -44,7 +53,33 @@ struct MPair
     friend bool operator >= (const MPair<K, V>& lhs, const MPair<K, V>& rhs) { return (lhs.key >= rhs.key); }
 };
 
+//an MPair is ordered by its key, so only the key (and never the value list)
+// is stored in the inner nodes of the tree.
 template <typename K, typename V>
+struct KeyOf<MPair<K, V> >
+{
+    typedef K type;
+    static const K& key(const MPair<K, V>& item) {return item.key;}
+};
+
+//an MPair is saved as its key, then its value list (in the format of a vector).
+template <typename K, typename V>
+struct Encoder<MPair<K, V> >
+{
+    static void write(ostream& outs, const MPair<K, V>& item)
+    {
+        Encoder<K>::write(outs, item.key);
+        Encoder<ValueList<V> >::write(outs, item.values);
+    }
+
+    static bool read(istream& ins, MPair<K, V>& item)
+    {
+        return Encoder<K>::read(ins, item.key) && Encoder<ValueList<V> >::read(ins, item.values);
+    }
+};
+
+//MinDegree is passed through to the underlying BPlusTree.
+template <typename K, typename V, int MinDegree = DefaultMinDegree<MPair<K,V> >::value>
 class MMap
 {
 public:
@@ -53,9 +88,15 @@ public:
     public:
         friend class MMap;
 
+        typedef bidirectional_iterator_tag iterator_category;
+        typedef V value_type;
+        typedef ptrdiff_t difference_type;
+        typedef V* pointer;
+        typedef V& reference;
+
         //preconditions: none
         //postconditions: constructors an iterator starting at _it
-        Iterator(typename BPlusTree<MPair<K,V> >::Iterator _it)
+        Iterator(typename BPlusTree<MPair<K,V>, MinDegree>::Iterator _it): _valueIt(), _values(nullptr)
         {
             _treeIt = _it;
 
@@ -93,17 +134,49 @@ public:
                 if(_valueIt == _values->end())
                 {
                     _treeIt++;
-                    //if we are not at the end of the _treeIt, update _valueIt.
+                    //if we are not at the end of the _treeIt, update _valueIt,
+                    // otherwise reset it, so that this iterator equals end().
                     if(_treeIt != nullptr)
                     {
                         _values = &((*_treeIt).values);
                         _valueIt = _values->begin();
                     }
+                    else
+                    {
+                        _values = nullptr;
+                        _valueIt = typename ValueList<V>::iterator();
+                    }
                 }
             }
             return *this;
         }
 
+        //preconditions: this is not begin()
+        //postconditions: make a copy of this iterator,
+        // call the prefix decrement operator on this and return the copy.
+        Iterator operator --(int unused)
+        {
+            Iterator temp = *this;
+            this->operator--();
+            return temp;
+        }
+
+        //preconditions: this is not begin()
+        //postconditions: _treeIt will be decremented if _valueIt is at the front of the current vector
+        //  (or this is end()), and _valueIt moved to the last item of the previous vector.
+        //  otherwise, decrement _valueIt to step back to the previous item within the current vector.
+        Iterator operator --()
+        {
+            if(_treeIt.is_null() || _valueIt == _values->begin())
+            {
+                --_treeIt;
+                _values = &((*_treeIt).values);
+                _valueIt = _values->end();
+            }
+            --_valueIt;
+            return *this;
+        }
+
         //preconditions: _valueIt must not be null
         //postconditions: dereference and return the item of the
         // vector that _valueIt is pointing to.
@@ -112,6 +185,13 @@ public:
             return *_valueIt;
         }
 
+        //preconditions: _treeIt must not be null
+        //postconditions: return the key of the values that _valueIt is in.
+        const K& key()
+        {
+            return (*_treeIt).key;
+        }
+
         friend bool operator ==(const Iterator& lhs, const Iterator& rhs)
         {
             return(lhs._treeIt == rhs._treeIt && lhs._valueIt == rhs._valueIt);
@@ -123,143 +203,240 @@ public:
         }
 
     private:
-        typename BPlusTree<MPair<K,V> >::Iterator _treeIt;
-        typename std::vector<V>::iterator _valueIt;
-        typename std::vector<V> *_values;
+        typename BPlusTree<MPair<K,V>, MinDegree>::Iterator _treeIt;
+        typename ValueList<V>::iterator _valueIt;
+        ValueList<V> *_values;
     };
 
+    typedef std::reverse_iterator<Iterator> ReverseIterator;
+
 public:
     MMap() : _mmap(true){}
 
+    //build the multimap from the range [first, last) of (key, value) std::pairs, sorting a
+    // copy first if the range is not sorted by key. The values of a key keep their order.
+    template <typename ForwardIt>
+    MMap(ForwardIt first, ForwardIt last, double fillFactor = 1.0);
+
     //  Capacity
     int size() const;
     bool empty() const;
 
     //  Element Access
-    const vector<V>& operator[](const K& key) const;
-    vector<V>& operator[](K key);
+    const ValueList<V>& operator[](const K& key) const;    //an empty list if key is not there (nothing is inserted)
+    ValueList<V>& operator[](K key);                       //the list of key, inserted (empty) if it is not there
+    ValueList<V>* find(const K& key);                      //the list of key, nullptr if it is not there
+    const ValueList<V>* find(const K& key) const;
 
     //  Modifiers
     bool insert(const K& k, const V& v);
+    bool insert(const K& k, V&& v);
     bool erase(const K& key);
     void clear();
 
-    //  Operations:
+    //  Operations: (contains, count, find and the const operator[] never insert)
     bool contains(const K& key) const;
-    vector<V> &get(const K& key);
-    int count(const K& key);
+    ValueList<V> &get(const K& key);                       //same as operator[]
+    int count(const K& key) const;                         //the number of values of key, 0 if it is not there
     bool isValid();
 
-    friend ostream& operator<<(ostream& outs, const MMap<K, V>& print_me)
+    //  Serialization: the keys and their value lists in binary (see BPlusTree::save and load),
+    // load replaces the contents.
+    bool save(ostream& outs) const {return _mmap.save(outs);}
+    bool load(istream& ins, double fillFactor = 1.0) {return _mmap.load(ins, fillFactor);}
+
+    friend ostream& operator<<(ostream& outs, const MMap<K,V,MinDegree>& print_me)
     {
         outs<<print_me._mmap<<endl;
         return outs;
     }
 
     // Iterators
-    Iterator begin() { return MMap<K,V>::Iterator(_mmap.begin()); }
-    Iterator end() { return MMap<K,V>::Iterator(_mmap.end()); }
+    Iterator begin() { return MMap<K,V,MinDegree>::Iterator(_mmap.begin()); }
+    Iterator end() { return MMap<K,V,MinDegree>::Iterator(_mmap.end()); }
+    ReverseIterator rbegin() { return ReverseIterator(end()); }
+    ReverseIterator rend() { return ReverseIterator(begin()); }
+
+    // Range functions: the values of the keys in [a, b) are [lower_bound(a), lower_bound(b))
+    Iterator lower_bound(const K& key) { return MMap<K,V,MinDegree>::Iterator(_mmap.lower_bound(key)); }
+    Iterator upper_bound(const K& key) { return MMap<K,V,MinDegree>::Iterator(_mmap.upper_bound(key)); }
+    pair<Iterator, Iterator> equal_range(const K& key) { return make_pair(lower_bound(key), upper_bound(key)); }
 
 private:
-    BPlusTree<MPair<K,V> > _mmap;
+    BPlusTree<MPair<K,V>, MinDegree> _mmap;
+
+    //append the values of the sorted range [first, last) to groups, one MPair per key.
+    template <typename ForwardIt>
+    static void groupByKey(ForwardIt first, ForwardIt last, vector<MPair<K,V> >& groups);
 };
 
+//preconditions: the items of [first, last) have a key (first) and a value (second).
+//postconditions: the items are grouped into one MPair per key, in key order,
+// and the tree is bulk loaded from the groups.
+template<typename K, typename V, int MinDegree>
+template<typename ForwardIt>
+MMap<K,V,MinDegree>::MMap(ForwardIt first, ForwardIt last, double fillFactor) : _mmap(true)
+{
+    typedef typename iterator_traits<ForwardIt>::value_type Item;
+    struct ByKey
+    {
+        bool operator()(const Item& lhs, const Item& rhs) const {return lhs.first < rhs.first;}
+    };
+
+    vector<MPair<K,V> > groups;
+    if(is_sorted(first, last, ByKey()))
+        groupByKey(first, last, groups);
+    else
+    {
+        vector<Item> sorted(first, last);
+        stable_sort(sorted.begin(), sorted.end(), ByKey());
+        groupByKey(make_move_iterator(sorted.begin()), make_move_iterator(sorted.end()), groups);
+    }
+
+    _mmap.bulkLoad(make_move_iterator(groups.begin()), make_move_iterator(groups.end()), fillFactor);
+}
+
+//preconditions: [first, last) is sorted by key.
+//postconditions: each run of items with equal keys is appended to groups
+// as one MPair holding the values of the run, in order. the values are
+// moved out of the range if ForwardIt is a move_iterator.
+template<typename K, typename V, int MinDegree>
+template<typename ForwardIt>
+void MMap<K,V,MinDegree>::groupByKey(ForwardIt first, ForwardIt last, vector<MPair<K,V> >& groups)
+{
+    for(; first != last; ++first)
+    {
+        if(groups.empty() || !(groups.back().key == (*first).first))
+            groups.push_back(MPair<K,V>((*first).first));
+        groups.back().values.push_back((*first).second);
+    }
+}
+
 //preconditions: none
 //postconditions: returns the total number of keys in the MMap.
-template<typename K, typename V>
-int MMap<K,V>::size() const
+template<typename K, typename V, int MinDegree>
+int MMap<K,V,MinDegree>::size() const
 {
     return _mmap.size();
 }
 
 //preconditions: none
 //postconditions: returns true if the B+Tree is empty, otherwise false.
-template<typename K, typename V>
-bool MMap<K,V>::empty() const
+template<typename K, typename V, int MinDegree>
+bool MMap<K,V,MinDegree>::empty() const
 {
     return (_mmap.size() == 0);
 }
 
 //preconditions: none
-//postconditions: the vector of the associated key will be
+//postconditions: the value list of the associated key will be
 // returned from the B+Tree, if no MPair with the recieved key
-// already exists, an Mpair containing an empty vector will be inserted.
-template<typename K, typename V>
-const vector<V>& MMap<K,V>::operator[](const K &key) const
+// exists, an empty list is returned, and the multimap is not changed.
+template<typename K, typename V, int MinDegree>
+const ValueList<V>& MMap<K,V,MinDegree>::operator[](const K &key) const
 {
-    return _mmap.get(MPair<K,V>(key)).values;
+    static const ValueList<V> none;
+    const ValueList<V>* values = find(key);
+    return values ? *values : none;
 }
 
 //preconditions: none
-//postconditions: the vector of the associated key will be
+//postconditions: the value list of the associated key will be
 // returned from the B+Tree, if no MPair with the recieved key
-// already exists, an Mpair containing an empty vector will be inserted.
-template<typename K, typename V>
-vector<V>& MMap<K,V>::operator[](K key)
+// already exists, an Mpair containing an empty value list will be inserted.
+template<typename K, typename V, int MinDegree>
+ValueList<V>& MMap<K,V,MinDegree>::operator[](K key)
 {
     return _mmap.get(MPair<K,V>(key)).values;
 }
 
 //preconditions: none
-//postconditions: obtain the vector of values associated with the recieved key,
-// if it already exists, otherwise it will be created now.
-// Then, call push_back to insert the new value (v) to the vector.
-template<typename K, typename V>
-bool MMap<K,V>::insert(const K &k, const V &v)
+//postconditions: returns a pointer to the value list of the recieved key, or nullptr
+// if the key is not there. (the multimap is not changed, and no MPair is made for the search)
+template<typename K, typename V, int MinDegree>
+ValueList<V>* MMap<K,V,MinDegree>::find(const K& key)
+{
+    MPair<K,V>* found = _mmap.findKey(key);
+    return found ? &found->values : nullptr;
+}
+
+template<typename K, typename V, int MinDegree>
+const ValueList<V>* MMap<K,V,MinDegree>::find(const K& key) const
+{
+    const MPair<K,V>* found = _mmap.findKey(key);
+    return found ? &found->values : nullptr;
+}
+
+//preconditions: none
+//postconditions: obtain the value list associated with the recieved key,
+// if it already exists, otherwise it will be created now (in the same descent).
+// Then, call push_back to insert the new value (v) to the list.
+template<typename K, typename V, int MinDegree>
+bool MMap<K,V,MinDegree>::insert(const K &k, const V &v)
+{
+    _mmap.insert_or_get(MPair<K,V>(k)).first->values.push_back(v);
+    return true;
+}
+
+//preconditions: none
+//postconditions: same as insert(const K&, const V&), but v is moved to the end of the list.
+template<typename K, typename V, int MinDegree>
+bool MMap<K,V,MinDegree>::insert(const K &k, V &&v)
 {
-    vector<V> * temp = &this->operator[](k);
-    temp->push_back(v);
+    _mmap.insert_or_get(MPair<K,V>(k)).first->values.push_back(std::move(v));
     return true;
 }
 
 //preconditions: none
 //postconditions: removes the Mpair with the recieved key from the map,
 // returning true if the pair was removed, otherwise false.
-template<typename K, typename V>
-bool MMap<K,V>::erase(const K &key)
+template<typename K, typename V, int MinDegree>
+bool MMap<K,V,MinDegree>::erase(const K &key)
 {
     return _mmap.remove(MPair<K,V>(key));
 }
 
 //preconditions: none
 //postconditions: calls clear on the B+Tree, erasing all items from it.
-template<typename K, typename V>
-void MMap<K,V>::clear()
+template<typename K, typename V, int MinDegree>
+void MMap<K,V,MinDegree>::clear()
 {
     _mmap.clearTree();
 }
 
 //preconditions: none
 //postconditions: returns true if the target key exists in the Map, otherwise false.
-template<typename K, typename V>
-bool MMap<K,V>::contains(const K& key) const
+template<typename K, typename V, int MinDegree>
+bool MMap<K,V,MinDegree>::contains(const K& key) const
 {
-    return _mmap.contains(MPair<K,V>(key));
+    return _mmap.findKey(key) != nullptr;
 }
 
 //preconditions: none
-//postconditions: the vector of the associated key will be
+//postconditions: the value list of the associated key will be
 // returned from the B+Tree, if no MPair with the recieved key
-// already exists, an Mpair containing an empty vector will be inserted.
-template<typename K, typename V>
-vector<V>& MMap<K,V>::get(const K& key)
+// already exists, an Mpair containing an empty value list will be inserted.
+template<typename K, typename V, int MinDegree>
+ValueList<V>& MMap<K,V,MinDegree>::get(const K& key)
 {
     return _mmap.get(MPair<K,V>(key)).values;
 }
 
 //preconditions: none
-//postconditions: returns the size of the vector associated with the key
-template<typename K, typename V>
-int MMap<K,V>::count(const K& key)
+//postconditions: returns the size of the value list associated with the key,
+// (0 if the key is not there, which is not inserted).
+template<typename K, typename V, int MinDegree>
+int MMap<K,V,MinDegree>::count(const K& key) const
 {
-    return _mmap.get(MPair<K,V>(key)).values.size();
+    const ValueList<V>* values = find(key);
+    return values ? int(values->size()) : 0;
 }
 
 //preconditions: none
 //postconditions: returns true if all the conditions
 // required for a valid B+Tree are met, otherwise false.
-template<typename K, typename V>
-bool MMap<K,V>::isValid()
+template<typename K, typename V, int MinDegree>
+bool MMap<K,V,MinDegree>::isValid()
 {
     return _mmap.isValid();
 }
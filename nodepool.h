@@ -0,0 +1,142 @@
+#ifndef NODEPOOL_H
+#define NODEPOOL_H
+#include <cstddef>
+#include <cstdint>
+#include <cassert>
+#include <new>
+#include <vector>
+using namespace std;
+
+//counters kept by a NodePool, so the effect of pooling can be measured.
+struct PoolStats
+{
+    size_t allocations;      //blocks handed out by allocate()
+    size_t deallocations;    //blocks returned by deallocate()
+    size_t slabAllocations;  //slabs requested from the system allocator
+    size_t slabBytes;        //bytes currently held in slabs
+
+    PoolStats(): allocations(0), deallocations(0), slabAllocations(0), slabBytes(0) {}
+
+    size_t liveBlocks() const {return allocations - deallocations;}
+
+    PoolStats& operator +=(const PoolStats& other)
+    {
+        allocations += other.allocations;
+        deallocations += other.deallocations;
+        slabAllocations += other.slabAllocations;
+        slabBytes += other.slabBytes;
+        return *this;
+    }
+};
+
+//NodePool hands out uninitialized blocks big enough for one Node, carved out of slabs.
+// A freed block goes on a free list and is handed out again before a new one is carved.
+// Slabs start small (so an empty tree stays small) and double up to MAX_SLAB_BLOCKS blocks.
+// The blocks are only memory: constructing and destroying the Node is up to the caller.
+// Each block is aligned for a Node, even one aligned past what operator new guarantees (a node
+// aligned to a cache line): such a slab is allocated with room to round its first block up.
+template <typename Node>
+class NodePool
+{
+public:
+    NodePool(): freeList(nullptr), nextBlock(nullptr), blocksLeft(0), nextSlabBlocks(MIN_SLAB_BLOCKS) {}
+    ~NodePool() {releaseAll();}
+
+    void* allocate();                   //return a block for one Node
+    void deallocate(void* block);       //return a block to the free list
+    void releaseAll();                  //free every slab at once, all blocks become invalid
+
+    const PoolStats& stats() const {return _stats;}
+
+private:
+    //a free block holds the link to the next free block.
+    union Block
+    {
+        Block* next;
+        alignas(Node) char storage[sizeof(Node)];
+    };
+
+    //the bytes a slab is allocated with beyond its blocks, to align them.
+    static const size_t SLAB_PADDING = (alignof(Block) > alignof(max_align_t)) ? alignof(Block) - 1 : 0;
+    static const size_t MIN_SLAB_BLOCKS = 4;
+    static const size_t MAX_SLAB_BLOCKS = (64 * 1024 / sizeof(Block) > MIN_SLAB_BLOCKS) ? 64 * 1024 / sizeof(Block) : MIN_SLAB_BLOCKS;
+
+    Block* freeList;                    //blocks that were freed and can be reused
+    Block* nextBlock;                   //the next never used block of the newest slab
+    size_t blocksLeft;                  //never used blocks left in the newest slab
+    size_t nextSlabBlocks;              //the number of blocks in the next slab
+    vector<void*> slabs;                //as allocated, (before aligning the first block)
+    PoolStats _stats;
+
+    //the pool owns its slabs, so it cannot be copied.
+    NodePool(const NodePool&);
+    NodePool& operator =(const NodePool&);
+};
+
+//preconditions: none
+//postconditions: returns a block from the free list if there is one, otherwise the
+// next unused block of the newest slab, allocating a new slab if that one is used up.
+template <typename Node>
+void* NodePool<Node>::allocate()
+{
+    Block* block;
+    if(freeList)
+    {
+        block = freeList;
+        freeList = freeList->next;
+    }
+    else
+    {
+        if(blocksLeft == 0)
+        {
+            size_t bytes = nextSlabBlocks * sizeof(Block) + SLAB_PADDING;
+            void* slab = ::operator new(bytes);
+            slabs.push_back(slab);
+            uintptr_t first = (reinterpret_cast<uintptr_t>(slab) + SLAB_PADDING) & ~uintptr_t(alignof(Block) - 1);
+            nextBlock = reinterpret_cast<Block*>(first);
+            blocksLeft = nextSlabBlocks;
+
+            _stats.slabAllocations++;
+            _stats.slabBytes += bytes;
+            if(nextSlabBlocks < MAX_SLAB_BLOCKS)
+                nextSlabBlocks = (2 * nextSlabBlocks < MAX_SLAB_BLOCKS) ? 2 * nextSlabBlocks : MAX_SLAB_BLOCKS;
+        }
+        block = nextBlock++;
+        blocksLeft--;
+    }
+
+    _stats.allocations++;
+    return block;
+}
+
+//preconditions: block came from allocate() on this pool, and its Node has been destroyed.
+//postconditions: block is pushed on the free list.
+template <typename Node>
+void NodePool<Node>::deallocate(void* block)
+{
+    assert(block);
+    Block* freed = static_cast<Block*>(block);
+    freed->next = freeList;
+    freeList = freed;
+    _stats.deallocations++;
+}
+
+//preconditions: any Node that needs its destructor run has been destroyed.
+//postconditions: every slab is freed in one pass over the slab list (not the blocks),
+// every live block counts as deallocated, and the pool starts over with small slabs.
+template <typename Node>
+void NodePool<Node>::releaseAll()
+{
+    for(size_t i = 0; i < slabs.size(); i++)
+        ::operator delete(slabs[i]);
+
+    slabs.clear();
+    freeList = nullptr;
+    nextBlock = nullptr;
+    blocksLeft = 0;
+    nextSlabBlocks = MIN_SLAB_BLOCKS;
+    _stats.deallocations = _stats.allocations;
+    _stats.slabBytes = 0;
+}
+
+#endif // NODEPOOL_H
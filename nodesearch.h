@@ -0,0 +1,315 @@
+#ifndef NODESEARCH_H
+#define NODESEARCH_H
+#include <string>
+#include <type_traits>
+#include <cstdint>
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
+#include "arrayutil.h"
+using namespace std;
+
+//NodeSearch<T>::firstGE(data, n, entry) returns the same index as firstGE in arrayutil.h:
+// the index of the first element of the sorted array data that is not less than entry,
+// or n if there is no such element. The method used depends on T:
+//  - 32 and 64 bit integers, float and double: count the elements that are less than entry,
+//    8 (AVX2) or 4 (SSE) at a time, falling back to a branch free scalar loop.
+//    wide nodes are first narrowed to one cache line by binary search steps.
+//  - any other T: a branchless binary search (firstGEBinary).
+template <typename T, typename Enable = void>
+struct NodeSearch
+{
+    static int firstGE(const T data[], int n, const T& entry)
+    {
+        return firstGEBinary(data, n, entry);
+    }
+};
+
+//compare and count, used for the arithmetic types.
+// the primary template is the scalar fallback, the specializations below
+// vectorize the loop when the target supports it.
+template <typename T,
+          int Size = sizeof(T),
+          bool Floating = is_floating_point<T>::value,
+          bool Signed = is_signed<T>::value>
+struct CountLess
+{
+    static int count(const T data[], int n, const T& entry)
+    {
+        int less = 0;
+        for(int i = 0; i < n; i++)
+            less += (data[i] < entry);
+        return less;
+    }
+};
+
+#if defined(__SSE2__)
+//add up the four 32 bit lanes of counts.
+inline int sumLanes(__m128i counts)
+{
+    counts = _mm_add_epi32(counts, _mm_shuffle_epi32(counts, _MM_SHUFFLE(1, 0, 3, 2)));
+    counts = _mm_add_epi32(counts, _mm_shuffle_epi32(counts, _MM_SHUFFLE(2, 3, 0, 1)));
+    return _mm_cvtsi128_si32(counts);
+}
+
+//add up the two 64 bit lanes of counts.
+inline int sumLanes64(__m128i counts)
+{
+    counts = _mm_add_epi64(counts, _mm_shuffle_epi32(counts, _MM_SHUFFLE(1, 0, 3, 2)));
+    return _mm_cvtsi128_si32(counts);
+}
+
+//32 bit integers. unsigned values are biased by the sign bit
+// so that the signed compare orders them correctly.
+template <typename T, bool Signed>
+struct CountLess<T, 4, false, Signed>
+{
+    static int count(const T data[], int n, const T& entry)
+    {
+        const int32_t bias = Signed ? 0 : INT32_MIN;
+        int less = 0;
+        int i = 0;
+#if defined(__AVX2__)
+        const __m256i key8 = _mm256_set1_epi32(int32_t(entry) ^ bias);
+        const __m256i bias8 = _mm256_set1_epi32(bias);
+        __m256i counts8 = _mm256_setzero_si256();
+        for(; i + 8 <= n; i += 8)
+        {
+            __m256i items = _mm256_xor_si256(_mm256_loadu_si256((const __m256i*)(data + i)), bias8);
+            counts8 = _mm256_sub_epi32(counts8, _mm256_cmpgt_epi32(key8, items));
+        }
+        less += sumLanes(_mm_add_epi32(_mm256_castsi256_si128(counts8), _mm256_extracti128_si256(counts8, 1)));
+#endif
+        const __m128i key4 = _mm_set1_epi32(int32_t(entry) ^ bias);
+        const __m128i bias4 = _mm_set1_epi32(bias);
+        __m128i counts4 = _mm_setzero_si128();
+        for(; i + 4 <= n; i += 4)
+        {
+            __m128i items = _mm_xor_si128(_mm_loadu_si128((const __m128i*)(data + i)), bias4);
+            counts4 = _mm_sub_epi32(counts4, _mm_cmpgt_epi32(key4, items));
+        }
+        less += sumLanes(counts4);
+        for(; i < n; i++)
+            less += (data[i] < entry);
+        return less;
+    }
+};
+
+//32 bit floats.
+template <typename T>
+struct CountLess<T, 4, true, true>
+{
+    static int count(const T data[], int n, const T& entry)
+    {
+        int less = 0;
+        int i = 0;
+#if defined(__AVX2__)
+        const __m256 key8 = _mm256_set1_ps(entry);
+        __m256i counts8 = _mm256_setzero_si256();
+        for(; i + 8 <= n; i += 8)
+            counts8 = _mm256_sub_epi32(counts8, _mm256_castps_si256(_mm256_cmp_ps(_mm256_loadu_ps(data + i), key8, _CMP_LT_OQ)));
+        less += sumLanes(_mm_add_epi32(_mm256_castsi256_si128(counts8), _mm256_extracti128_si256(counts8, 1)));
+#endif
+        const __m128 key4 = _mm_set1_ps(entry);
+        __m128i counts4 = _mm_setzero_si128();
+        for(; i + 4 <= n; i += 4)
+            counts4 = _mm_sub_epi32(counts4, _mm_castps_si128(_mm_cmplt_ps(_mm_loadu_ps(data + i), key4)));
+        less += sumLanes(counts4);
+        for(; i < n; i++)
+            less += (data[i] < entry);
+        return less;
+    }
+};
+
+//64 bit doubles.
+template <typename T>
+struct CountLess<T, 8, true, true>
+{
+    static int count(const T data[], int n, const T& entry)
+    {
+        int less = 0;
+        int i = 0;
+#if defined(__AVX2__)
+        const __m256d key4 = _mm256_set1_pd(entry);
+        __m256i counts4 = _mm256_setzero_si256();
+        for(; i + 4 <= n; i += 4)
+            counts4 = _mm256_sub_epi64(counts4, _mm256_castpd_si256(_mm256_cmp_pd(_mm256_loadu_pd(data + i), key4, _CMP_LT_OQ)));
+        less += sumLanes64(_mm_add_epi64(_mm256_castsi256_si128(counts4), _mm256_extracti128_si256(counts4, 1)));
+#endif
+        const __m128d key2 = _mm_set1_pd(entry);
+        __m128i counts2 = _mm_setzero_si128();
+        for(; i + 2 <= n; i += 2)
+            counts2 = _mm_sub_epi64(counts2, _mm_castpd_si128(_mm_cmplt_pd(_mm_loadu_pd(data + i), key2)));
+        less += sumLanes64(counts2);
+        for(; i < n; i++)
+            less += (data[i] < entry);
+        return less;
+    }
+};
+#endif // __SSE2__
+
+#if defined(__SSE4_2__)
+//64 bit integers, _mm_cmpgt_epi64 needs SSE4.2.
+template <typename T, bool Signed>
+struct CountLess<T, 8, false, Signed>
+{
+    static int count(const T data[], int n, const T& entry)
+    {
+        const int64_t bias = Signed ? 0 : INT64_MIN;
+        int less = 0;
+        int i = 0;
+#if defined(__AVX2__)
+        const __m256i key4 = _mm256_set1_epi64x(int64_t(entry) ^ bias);
+        const __m256i bias4 = _mm256_set1_epi64x(bias);
+        __m256i counts4 = _mm256_setzero_si256();
+        for(; i + 4 <= n; i += 4)
+        {
+            __m256i items = _mm256_xor_si256(_mm256_loadu_si256((const __m256i*)(data + i)), bias4);
+            counts4 = _mm256_sub_epi64(counts4, _mm256_cmpgt_epi64(key4, items));
+        }
+        less += sumLanes64(_mm_add_epi64(_mm256_castsi256_si128(counts4), _mm256_extracti128_si256(counts4, 1)));
+#endif
+        const __m128i key2 = _mm_set1_epi64x(int64_t(entry) ^ bias);
+        const __m128i bias2 = _mm_set1_epi64x(bias);
+        __m128i counts2 = _mm_setzero_si128();
+        for(; i + 2 <= n; i += 2)
+        {
+            __m128i items = _mm_xor_si128(_mm_loadu_si128((const __m128i*)(data + i)), bias2);
+            counts2 = _mm_sub_epi64(counts2, _mm_cmpgt_epi64(key2, items));
+        }
+        less += sumLanes64(counts2);
+        for(; i < n; i++)
+            less += (data[i] < entry);
+        return less;
+    }
+};
+#endif // __SSE4_2__
+
+//for wide nodes, branchless binary search steps narrow data down to a window of
+// at most WINDOW items (one cache line), which is then compared and counted in one pass.
+// every item before the window is less than entry, and every item after it is not.
+template <typename T>
+struct NodeSearch<T, typename enable_if<is_arithmetic<T>::value>::type>
+{
+    static const int WINDOW = (64 / sizeof(T) > 4) ? int(64 / sizeof(T)) : 4;
+
+    static int firstGE(const T data[], int n, const T& entry)
+    {
+        const T* base = data;
+        int len = n;
+        while(len > WINDOW)
+        {
+            int half = len / 2;
+            base = (base[half] < entry) ? base + half : base;
+            len -= half;
+        }
+
+        return int(base - data) + CountLess<T>::count(base, len, entry);
+    }
+};
+
+//NodePrefixes<Key, Capacity> is kept by each inner node of a BPlusTree beside its routing keys, and
+// searches them: firstGE(data, n, key) returns the index NodeSearch<Key>::firstGE(data, n, key) does.
+// it holds nothing for most keys. refresh(data, n) is called whenever the routing keys change.
+template <typename Key, int Capacity>
+struct NodePrefixes
+{
+    void refresh(const Key data[], int n) {}
+    bool isFresh(const Key data[], int n) const {return true;}
+
+    int firstGE(const Key data[], int n, const Key& key) const
+    {
+        return NodeSearch<Key>::firstGE(data, n, key);
+    }
+};
+
+//for string keys, the node keeps the length of the prefix all of its routing keys share (skip), and
+// the HEAD_BYTES bytes after it of each key, as big endian integers padded with zeros (heads). the
+// heads order the keys the way their characters do, so a search compares integers held in the node
+// and reads the characters of a key only when its head ties with the key searched for. keys with a
+// long common prefix (paths, URLs) are told apart by the bytes that differ, not the ones they share.
+template <int Capacity>
+struct NodePrefixes<string, Capacity>
+{
+    static const size_t HEAD_BYTES = sizeof(uint64_t);
+
+    size_t skip;
+    uint64_t heads[Capacity];
+
+    NodePrefixes(): skip(0) {}
+
+    //preconditions: none
+    //postconditions: returns the HEAD_BYTES bytes of key from skip on, as a big endian integer padded with zeros.
+    static uint64_t headOf(const string& key, size_t skip)
+    {
+        uint64_t bytes = 0;
+        for(size_t i = skip; i < skip + HEAD_BYTES; i++)
+            bytes = (bytes << 8) | ((i < key.size()) ? uint8_t(key[i]) : 0);
+        return bytes;
+    }
+
+    //preconditions: data[0, n) is sorted.
+    //postconditions: skip is the length of the prefix data[0] and data[n-1] share (so every key between
+    // them shares it too), and heads[i] is the head of data[i] after it.
+    void refresh(const string data[], int n)
+    {
+        skip = 0;
+        if(n > 0)
+        {
+            const string& first = data[0];
+            const string& last = data[n-1];
+            size_t shorter = (first.size() < last.size()) ? first.size() : last.size();
+            while(skip < shorter && first[skip] == last[skip])
+                skip++;
+        }
+        for(int i = 0; i < n; i++)
+            heads[i] = headOf(data[i], skip);
+    }
+
+    //preconditions: none
+    //postconditions: returns true if skip and heads are what refresh(data, n) would make them.
+    bool isFresh(const string data[], int n) const
+    {
+        NodePrefixes fresh;
+        fresh.refresh(data, n);
+        bool same = (fresh.skip == skip);
+        for(int i = 0; i < n && same; i++)
+            same = (fresh.heads[i] == heads[i]);
+        return same;
+    }
+
+    //preconditions: refresh(data, n) was called since data last changed.
+    //postconditions: returns the index of the first key of data not less than key, (n if there is none).
+    // a key that does not start with the shared prefix comes before (or after) every key of data,
+    // otherwise a branchless binary search compares heads, then the whole keys on a tie.
+    int firstGE(const string data[], int n, const string& key) const
+    {
+        if(n == 0)
+            return 0;
+        if(skip > 0)
+        {
+            int order = key.compare(0, skip, data[0], 0, skip);
+            if(order != 0)
+                return (order < 0) ? 0 : n;
+        }
+
+        uint64_t head = headOf(key, skip);
+        int base = 0;
+        int len = n;
+        while(len > 1)
+        {
+            int half = len / 2;
+            base = less(data, base + half, head, key) ? base + half : base;
+            len -= half;
+        }
+        return base + less(data, base, head, key);
+    }
+
+private:
+    bool less(const string data[], int i, uint64_t head, const string& key) const
+    {
+        return (heads[i] != head) ? heads[i] < head : data[i] < key;
+    }
+};
+
+#endif // NODESEARCH_H
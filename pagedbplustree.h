@@ -0,0 +1,925 @@
+#ifndef PAGEDBPLUSTREE_H
+#define PAGEDBPLUSTREE_H
+
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include "bplustree.h"
+#include "bufferpool.h"
+using namespace std;
+
+//PagedBPlusTree is a B+Tree whose nodes are the pages of a file, read and written through a BufferPool
+// (bufferpool.h) of a fixed byte budget, so the tree can be much larger than the memory it uses.
+// Every node is pinned (with a PageGuard) only while it is being read or changed, and a changed node
+// is marked dirty, to be written back when its frame is reused, or on flush() and close().
+// The pages are laid out as in MappedBPlusTree (a node refers to another by page id), but each page
+// has room for one item (or key) more than its maximum, so that a node can overflow (or run short)
+// and be fixed from its parent, the way BPlusTree does it:
+//    page 0:  the FileHeader: what the file holds, the root page, the height, and the free pages.
+//    a leaf:  its items in order, and the page ids of the leaves on its right and left (0 for none).
+//    inner:   the page ids of its children, and keys[i]: a key not greater than any key in
+//             children[i+1], and greater than every key in children[i].
+// The separators follow the rule of a classic B+Tree, rather than BPlusTree's stricter one
+// (keys[i] is the smallest key in children[i+1]): removing the smallest item of a leaf changes
+// no inner page. Pages freed by merges are linked into a free list (by their next) and reused.
+// Keys are unique. T and Key must be trivially copyable. Not thread safe.
+template <typename T, int PageSize = 4096>
+class PagedBPlusTree
+{
+public:
+    typedef typename KeyOf<T>::type Key;
+
+private:
+    static_assert(is_trivially_copyable<T>::value, "PagedBPlusTree stores the bytes of its items: T must be trivially copyable");
+    static_assert(is_trivially_copyable<Key>::value, "PagedBPlusTree stores the bytes of its keys: Key must be trivially copyable");
+
+    static const uint64_t MAGIC = 0x3130474150545042ULL;    //"BPTPAG01", read as a little endian integer
+    static const uint32_t VERSION = 1;
+    static const uint32_t LEAF = 1;
+    static const uint32_t INNER = 2;
+    static const uint32_t FREE = 3;
+
+    struct FileHeader
+    {
+        uint64_t magic;
+        uint32_t version;
+        uint32_t pageSize;
+        uint32_t itemSize;
+        uint32_t keySize;
+        uint64_t rootPage;
+        uint64_t height;                           //the number of levels, 1 for a root that is a leaf
+        uint64_t itemCount;
+        uint64_t freePage;                         //the first free page, 0 if none
+    };
+
+    //the start of every leaf, inner and free page.
+    struct PageHeader
+    {
+        uint32_t kind;                             //LEAF, INNER or FREE
+        uint32_t count;                            //items in a leaf, keys in an inner page
+        uint64_t next;                             //the leaf on the right (or the next free page), 0 if none
+        uint64_t prev;                             //the leaf on the left, 0 if none
+    };
+
+    //the most items (keys) a leaf (inner page) holds between operations, (its page has room for one more).
+    static const int LEAF_MAXIMUM = int((PageSize - sizeof(PageHeader)) / sizeof(T)) - 1;
+    static const int LEAF_MINIMUM = LEAF_MAXIMUM / 2;
+    static const int INNER_MAXIMUM = int((PageSize - sizeof(PageHeader) - 2 * sizeof(uint64_t)) / (sizeof(Key) + sizeof(uint64_t))) - 1;
+    static const int INNER_MINIMUM = INNER_MAXIMUM / 2;
+
+    struct LeafPage
+    {
+        PageHeader header;
+        T items[LEAF_MAXIMUM + 1];
+    };
+
+    struct InnerPage
+    {
+        PageHeader header;
+        uint64_t children[INNER_MAXIMUM + 2];
+        Key keys[INNER_MAXIMUM + 1];
+    };
+
+    static_assert(LEAF_MAXIMUM >= 2 && INNER_MAXIMUM >= 2, "a page must hold at least three items and three keys");
+    static_assert(sizeof(FileHeader) <= PageSize && sizeof(LeafPage) <= PageSize && sizeof(InnerPage) <= PageSize,
+                  "every page must fit in PageSize bytes");
+
+public:
+    //a bidirectional iterator over the items, in order. it holds a copy of its item, (the page it
+    // came from may be evicted), and pins a leaf only while it moves. it is valid until the tree is
+    // changed. end() is a null iterator that still knows its tree, so that it can be decremented.
+    // (std::reverse_iterator cannot be used over it: it would return a reference into a temporary.)
+    class Iterator
+    {
+    public:
+        friend class PagedBPlusTree;
+
+        typedef bidirectional_iterator_tag iterator_category;
+        typedef T value_type;
+        typedef ptrdiff_t difference_type;
+        typedef const T* pointer;
+        typedef const T& reference;
+
+        friend bool operator ==(const Iterator& lhs, const Iterator& rhs){return (lhs.leaf == rhs.leaf && lhs.keyPtr == rhs.keyPtr);}
+        friend bool operator !=(const Iterator& lhs, const Iterator& rhs){return !(lhs == rhs);}
+
+        Iterator(const PagedBPlusTree* _owner = nullptr): owner(_owner), leaf(0), keyPtr(0), item() {}
+
+        bool is_null() const {return leaf == 0;}
+
+        //preconditions: leaf != 0
+        //postconditions: return the item (a copy of items[keyPtr] of leaf).
+        const T& operator *() const
+        {
+            assert(leaf != 0);
+            return item;
+        }
+
+        const T* operator ->() const
+        {
+            return &this->operator*();
+        }
+
+        Iterator operator++(int unUsed)
+        {
+            Iterator temp = *this;
+            this->operator++();
+            return temp;
+        }
+
+        //preconditions: leaf != 0
+        //postconditions: move to the next item of the leaf, or the first item of the next leaf (or end).
+        Iterator& operator++()
+        {
+            if(leaf != 0)
+                owner->moveTo(*this, leaf, keyPtr + 1);
+            return *this;
+        }
+
+        Iterator operator--(int unUsed)
+        {
+            Iterator temp = *this;
+            this->operator--();
+            return temp;
+        }
+
+        //preconditions: this is not the first item.
+        //postconditions: move to the item before this one, (from end(), to the last item).
+        Iterator& operator--()
+        {
+            owner->moveBack(*this);
+            return *this;
+        }
+
+    private:
+        const PagedBPlusTree* owner;
+        uint64_t leaf;                             //0 at end()
+        int keyPtr;
+        T item;
+    };
+
+    PagedBPlusTree(): root(0), levels(0), _size(0), freePage(0) {}
+    ~PagedBPlusTree() {close();}
+
+    //open (or create) the tree in the file at path, with a buffer pool of budgetBytes. returns false if
+    // the file cannot be opened, or holds something other than a tree of this T, Key and PageSize.
+    bool open(const string& path, size_t budgetBytes = 64 << 20);
+    bool close();                                  //write the tree back, and close the file
+    bool flush();                                  //write every dirty page (and the header) back
+    bool isOpen() const {return pool.isOpen();}
+
+    bool insert(const T& entry);                   //insert entry into the tree, false if its key is there
+    bool remove(const T& entry);                   //remove the item with the key of entry from the tree
+
+    bool contains(const T& entry) const;           //true if the key of entry is in the tree
+    bool find(const Key& key, T& item) const;      //copy the item with key to item, false if it is not there
+
+    int size() const {return int(_size);}
+    bool empty() const {return _size == 0;}
+    int height() const {return int(levels);}
+
+    Iterator lower_bound(const Key& key) const;    //return an iterator to the first item not less than key.
+    Iterator begin() const;
+    Iterator end() const {return Iterator(this);}
+
+    bool isValid() const;                          //verify that the pages satisfy all B+Tree rules.
+
+    const BufferStats& bufferStats() const {return pool.stats();}
+    void resetBufferStats() {pool.resetStats();}
+    size_t pageCount() const {return size_t(pool.pageCount());}
+    size_t bufferFrames() const {return pool.frameCount();}   //the frames of the buffer pool
+
+private:
+    mutable BufferPool pool;
+    uint64_t root;
+    uint64_t levels;
+    uint64_t _size;
+    uint64_t freePage;
+
+    static const Key& keyOf(const T& item) {return KeyOf<T>::key(item);}
+
+    static int leafIndex(const LeafPage* leaf, const Key& key);    //index of the first item not less than key
+    static int childIndex(const InnerPage* inner, const Key& key); //index of the child key is (or would be) in
+    static bool isShort(const PageHeader* page);   //fewer than its minimum items (keys)
+    static bool isOver(const PageHeader* page);    //more than its maximum items (keys)
+
+    uint64_t findLeaf(const Key& key) const;       //descend to the leaf where key is, or would be
+    uint64_t edgeLeaf(bool last) const;            //the first (or last) leaf
+    void moveTo(Iterator& it, uint64_t leaf, int index) const;  //point it at items[index] of leaf (or the next leaf)
+    void moveBack(Iterator& it) const;
+
+    uint64_t allocatePage();                       //the id of a free page, (or a new page at the end)
+    void releasePage(uint64_t id);                 //add page id to the free list
+    void writeHeader();
+
+    bool looseInsert(uint64_t id, const T& entry); //allows LEAF_MAXIMUM+1 (INNER_MAXIMUM+1) in page id
+    void fixExcess(PageGuard& parent, int i);      //split child i of parent if it is over its maximum
+    bool looseRemove(uint64_t id, const Key& key); //allows one fewer than the minimum in page id
+    void fixShortage(PageGuard& parent, int i);    //rotate or merge child i of parent if it is short
+
+    void rotateLeft(InnerPage* parent, int i, PageGuard& child, PageGuard& right);   //move one item from child i+1 to child i
+    void rotateRight(InnerPage* parent, int i, PageGuard& left, PageGuard& child);   //move one item from child i-1 to child i
+    void mergeChildren(InnerPage* parent, int i, PageGuard& left, PageGuard& right); //merge child i+1 into child i
+
+    bool verifyPage(uint64_t id, uint64_t depth, const Key* low, const Key* high, uint64_t& items) const;
+
+    PagedBPlusTree(const PagedBPlusTree&);
+    PagedBPlusTree& operator =(const PagedBPlusTree&);
+};
+
+//preconditions: the tree is not open.
+//postconditions: the file at path is opened behind a buffer pool of budgetBytes. a new (empty) file gets
+// a header and an empty root leaf, otherwise the header is read and checked.
+template <typename T, int PageSize>
+bool PagedBPlusTree<T, PageSize>::open(const string& path, size_t budgetBytes)
+{
+    assert(!isOpen());
+    if(!pool.open(path, budgetBytes, PageSize))
+        return false;
+
+    if(pool.pageCount() == 0)
+    {
+        PageGuard header(pool, 0, true);
+        root = allocatePage();
+        PageGuard leaf(pool, root, true);
+        leaf.as<PageHeader>()->kind = LEAF;
+        levels = 1;
+        _size = 0;
+        freePage = 0;
+    }
+    else
+    {
+        FileHeader header;
+        {
+            PageGuard guard(pool, 0);
+            header = *guard.as<FileHeader>();
+        }
+        bool ok = header.magic == MAGIC && header.version == VERSION && header.pageSize == uint32_t(PageSize)
+               && header.itemSize == sizeof(T) && header.keySize == sizeof(Key)
+               && header.rootPage != 0 && header.rootPage < pool.pageCount();
+        if(!ok)
+        {
+            pool.close();
+            return false;
+        }
+        root = header.rootPage;
+        levels = header.height;
+        _size = header.itemCount;
+        freePage = header.freePage;
+    }
+    writeHeader();
+    return true;
+}
+
+//preconditions: none
+//postconditions: the header is updated, and every dirty page written back and synced.
+template <typename T, int PageSize>
+bool PagedBPlusTree<T, PageSize>::flush()
+{
+    if(!isOpen())
+        return true;
+    writeHeader();
+    return pool.flush();
+}
+
+//preconditions: none
+//postconditions: flush, then close the file.
+template <typename T, int PageSize>
+bool PagedBPlusTree<T, PageSize>::close()
+{
+    if(!isOpen())
+        return true;
+    writeHeader();
+    return pool.close();
+}
+
+//preconditions: the tree is open.
+//postconditions: page 0 holds the root, height, size and free list of the tree.
+template <typename T, int PageSize>
+void PagedBPlusTree<T, PageSize>::writeHeader()
+{
+    PageGuard guard(pool, 0);
+    FileHeader* header = guard.as<FileHeader>();
+    header->magic = MAGIC;
+    header->version = VERSION;
+    header->pageSize = PageSize;
+    header->itemSize = sizeof(T);
+    header->keySize = sizeof(Key);
+    header->rootPage = root;
+    header->height = levels;
+    header->itemCount = _size;
+    header->freePage = freePage;
+    guard.markDirty();
+}
+
+//preconditions: the tree is open.
+//postconditions: returns the first page of the free list (taking it off the list), or if the list
+// is empty, the page after the last page of the file. the caller pins it as a new page.
+template <typename T, int PageSize>
+uint64_t PagedBPlusTree<T, PageSize>::allocatePage()
+{
+    if(freePage == 0)
+        return pool.pageCount();
+
+    uint64_t id = freePage;
+    PageGuard guard(pool, id);
+    freePage = guard.as<PageHeader>()->next;
+    return id;
+}
+
+//preconditions: page id is no longer part of the tree.
+//postconditions: page id is cleared, and put at the front of the free list.
+template <typename T, int PageSize>
+void PagedBPlusTree<T, PageSize>::releasePage(uint64_t id)
+{
+    PageGuard guard(pool, id, true);
+    PageHeader* page = guard.as<PageHeader>();
+    page->kind = FREE;
+    page->next = freePage;
+    freePage = id;
+}
+
+//preconditions: none
+//postconditions: returns the index of the first item in leaf whose key is not less than key,
+// if no such item exists, returns its count. (a branchless binary search, see firstGEBinary)
+template <typename T, int PageSize>
+int PagedBPlusTree<T, PageSize>::leafIndex(const LeafPage* leaf, const Key& key)
+{
+    int count = int(leaf->header.count);
+    if(count == 0)
+        return 0;
+
+    const T* items = leaf->items;
+    const T* cursor = items;
+    int len = count;
+    while(len > 1)
+    {
+        int half = len / 2;
+        cursor = (keyOf(cursor[half]) < key) ? cursor + half : cursor;
+        len -= half;
+    }
+
+    return int(cursor - items) + (keyOf(*cursor) < key);
+}
+
+//preconditions: none
+//postconditions: returns the index of the child of inner whose keys span key: the first key not less
+// than key, or the one after it if it equals key (keys[i] is not greater than any key in children[i+1]).
+template <typename T, int PageSize>
+int PagedBPlusTree<T, PageSize>::childIndex(const InnerPage* inner, const Key& key)
+{
+    int count = int(inner->header.count);
+    int i = NodeSearch<Key>::firstGE(inner->keys, count, key);
+    return (i < count && key == inner->keys[i]) ? i + 1 : i;
+}
+
+template <typename T, int PageSize>
+bool PagedBPlusTree<T, PageSize>::isShort(const PageHeader* page)
+{
+    return int(page->count) < (page->kind == LEAF ? LEAF_MINIMUM : INNER_MINIMUM);
+}
+
+template <typename T, int PageSize>
+bool PagedBPlusTree<T, PageSize>::isOver(const PageHeader* page)
+{
+    return int(page->count) > (page->kind == LEAF ? LEAF_MAXIMUM : INNER_MAXIMUM);
+}
+
+//preconditions: the tree is open.
+//postconditions: follows the keys from the root to the leaf where key is (or would be), pinning one
+// page at a time, and returns its page id.
+template <typename T, int PageSize>
+uint64_t PagedBPlusTree<T, PageSize>::findLeaf(const Key& key) const
+{
+    uint64_t id = root;
+    for(;;)
+    {
+        PageGuard guard(pool, id);
+        if(guard.as<PageHeader>()->kind == LEAF)
+            return id;
+        const InnerPage* inner = guard.as<InnerPage>();
+        id = inner->children[childIndex(inner, key)];
+    }
+}
+
+//preconditions: the tree is open.
+//postconditions: returns the first leaf (or the last), following the first (last) children from the root.
+template <typename T, int PageSize>
+uint64_t PagedBPlusTree<T, PageSize>::edgeLeaf(bool last) const
+{
+    uint64_t id = root;
+    for(;;)
+    {
+        PageGuard guard(pool, id);
+        if(guard.as<PageHeader>()->kind == LEAF)
+            return id;
+        const InnerPage* inner = guard.as<InnerPage>();
+        id = inner->children[last ? inner->header.count : 0];
+    }
+}
+
+//preconditions: leaf is a leaf of the tree, index <= its count.
+//postconditions: it is at items[index] of leaf with a copy of the item, or if index is past the last
+// item, at the first item of the next leaf, (or at end if there is none).
+template <typename T, int PageSize>
+void PagedBPlusTree<T, PageSize>::moveTo(Iterator& it, uint64_t leaf, int index) const
+{
+    while(leaf != 0)
+    {
+        PageGuard guard(pool, leaf);
+        const LeafPage* page = guard.as<LeafPage>();
+        if(index < int(page->header.count))
+        {
+            it.leaf = leaf;
+            it.keyPtr = index;
+            it.item = page->items[index];
+            return;
+        }
+        leaf = page->header.next;
+        index = 0;
+    }
+    it.leaf = 0;
+    it.keyPtr = 0;
+}
+
+//preconditions: it is not at the first item.
+//postconditions: it is at the item before, (from end, at the last item).
+template <typename T, int PageSize>
+void PagedBPlusTree<T, PageSize>::moveBack(Iterator& it) const
+{
+    uint64_t leaf = it.leaf;
+    int index = it.keyPtr - 1;
+    if(leaf == 0 || index < 0)
+    {
+        if(leaf == 0)
+            leaf = edgeLeaf(true);
+        else
+        {
+            PageGuard guard(pool, leaf);
+            leaf = guard.as<PageHeader>()->prev;
+        }
+        assert(leaf != 0);
+        PageGuard guard(pool, leaf);
+        index = int(guard.as<PageHeader>()->count) - 1;
+        assert(index >= 0);
+    }
+    moveTo(it, leaf, index);
+}
+
+//preconditions: none
+//postconditions: returns an iterator to the first item whose key is not less than key, or end().
+template <typename T, int PageSize>
+typename PagedBPlusTree<T, PageSize>::Iterator PagedBPlusTree<T, PageSize>::lower_bound(const Key& key) const
+{
+    Iterator it(this);
+    if(empty())
+        return it;
+
+    uint64_t leaf = findLeaf(key);
+    int index = 0;
+    {
+        PageGuard guard(pool, leaf);
+        index = leafIndex(guard.as<LeafPage>(), key);
+    }
+    moveTo(it, leaf, index);
+    return it;
+}
+
+//preconditions: none
+//postconditions: returns an iterator to the first item, or end() if the tree is empty.
+template <typename T, int PageSize>
+typename PagedBPlusTree<T, PageSize>::Iterator PagedBPlusTree<T, PageSize>::begin() const
+{
+    Iterator it(this);
+    if(!empty())
+        moveTo(it, edgeLeaf(false), 0);
+    return it;
+}
+
+//preconditions: none
+//postconditions: if the item with key is in the tree, it is copied to item and true is returned.
+template <typename T, int PageSize>
+bool PagedBPlusTree<T, PageSize>::find(const Key& key, T& item) const
+{
+    if(empty())
+        return false;
+
+    PageGuard guard(pool, findLeaf(key));
+    const LeafPage* leaf = guard.as<LeafPage>();
+    int i = leafIndex(leaf, key);
+    if(i == int(leaf->header.count) || !(keyOf(leaf->items[i]) == key))
+        return false;
+    item = leaf->items[i];
+    return true;
+}
+
+//preconditions: none
+//postconditions: returns true if the key of entry is in the tree.
+template <typename T, int PageSize>
+bool PagedBPlusTree<T, PageSize>::contains(const T& entry) const
+{
+    T item;
+    return find(keyOf(entry), item);
+}
+
+//preconditions: the tree is open.
+//postconditions: if the key of entry is not in the tree, entry is inserted and true is returned.
+// when the root overflows, it becomes the only child of a new root, which splits it.
+template <typename T, int PageSize>
+bool PagedBPlusTree<T, PageSize>::insert(const T& entry)
+{
+    assert(isOpen());
+    if(!looseInsert(root, entry))
+        return false;
+    _size++;
+
+    bool over = false;
+    {
+        PageGuard guard(pool, root);
+        over = isOver(guard.as<PageHeader>());
+    }
+    if(over)
+    {
+        uint64_t id = allocatePage();
+        PageGuard guard(pool, id, true);
+        InnerPage* inner = guard.as<InnerPage>();
+        inner->header.kind = INNER;
+        inner->children[0] = root;
+        root = id;
+        levels++;
+        fixExcess(guard, 0);
+    }
+    return true;
+}
+
+//preconditions: none
+//postconditions: entry is inserted into the subtree of page id unless its key is there, (the page may
+// be left one over its maximum). every child on the path that went over its maximum is split.
+template <typename T, int PageSize>
+bool PagedBPlusTree<T, PageSize>::looseInsert(uint64_t id, const T& entry)
+{
+    PageGuard guard(pool, id);
+    const Key& key = keyOf(entry);
+
+    if(guard.as<PageHeader>()->kind == LEAF)
+    {
+        LeafPage* leaf = guard.as<LeafPage>();
+        int count = int(leaf->header.count);
+        int i = leafIndex(leaf, key);
+        if(i < count && keyOf(leaf->items[i]) == key)
+            return false;
+
+        insertItem(leaf->items, i, count, entry);
+        leaf->header.count = uint32_t(count);
+        guard.markDirty();
+        return true;
+    }
+
+    InnerPage* inner = guard.as<InnerPage>();
+    int i = childIndex(inner, key);
+    if(!looseInsert(inner->children[i], entry))
+        return false;
+    fixExcess(guard, i);
+    return true;
+}
+
+//preconditions: parent is an inner page, with room for one more key.
+//postconditions: if child i is over its maximum, its upper half is moved to a new page that becomes
+// child i+1: a leaf is linked in after it, and its first key is copied up, an inner page moves its
+// middle key up.
+template <typename T, int PageSize>
+void PagedBPlusTree<T, PageSize>::fixExcess(PageGuard& parentGuard, int i)
+{
+    InnerPage* parent = parentGuard.as<InnerPage>();
+    uint64_t childId = parent->children[i];
+    PageGuard child(pool, childId);
+    if(!isOver(child.as<PageHeader>()))
+        return;
+
+    uint64_t siblingId = allocatePage();
+    PageGuard sibling(pool, siblingId, true);
+    Key separator;
+
+    if(child.as<PageHeader>()->kind == LEAF)
+    {
+        LeafPage* left = child.as<LeafPage>();
+        LeafPage* right = sibling.as<LeafPage>();
+        int leftCount = int(left->header.count), rightCount = 0;
+        split(left->items, leftCount, right->items, rightCount);
+        left->header.count = uint32_t(leftCount);
+        right->header.count = uint32_t(rightCount);
+        right->header.kind = LEAF;
+
+        right->header.next = left->header.next;
+        right->header.prev = childId;
+        if(left->header.next != 0)
+        {
+            PageGuard next(pool, left->header.next);
+            next.as<PageHeader>()->prev = siblingId;
+            next.markDirty();
+        }
+        left->header.next = siblingId;
+        separator = keyOf(right->items[0]);
+    }
+    else
+    {
+        InnerPage* left = child.as<InnerPage>();
+        InnerPage* right = sibling.as<InnerPage>();
+        int count = int(left->header.count);
+        int mid = count / 2;
+        separator = left->keys[mid];
+
+        int rightCount = count - mid - 1;
+        for(int k = 0; k < rightCount; k++)
+            right->keys[k] = left->keys[mid + 1 + k];
+        for(int k = 0; k <= rightCount; k++)
+            right->children[k] = left->children[mid + 1 + k];
+        right->header.kind = INNER;
+        right->header.count = uint32_t(rightCount);
+        left->header.count = uint32_t(mid);
+    }
+    child.markDirty();
+
+    int keys = int(parent->header.count);
+    int children = keys + 1;
+    insertItem(parent->keys, i, keys, separator);
+    insertItem(parent->children, i + 1, children, siblingId);
+    parent->header.count = uint32_t(keys);
+    parentGuard.markDirty();
+}
+
+//preconditions: the tree is open.
+//postconditions: if the key of entry is in the tree, its item is removed and true is returned.
+// when the root is an inner page left with no keys, its only child becomes the root.
+template <typename T, int PageSize>
+bool PagedBPlusTree<T, PageSize>::remove(const T& entry)
+{
+    assert(isOpen());
+    if(!looseRemove(root, keyOf(entry)))
+        return false;
+    _size--;
+
+    uint64_t oldRoot = root;
+    {
+        PageGuard guard(pool, root);
+        const InnerPage* inner = guard.as<InnerPage>();
+        if(inner->header.kind == INNER && inner->header.count == 0)
+            root = inner->children[0];
+    }
+    if(root != oldRoot)
+    {
+        releasePage(oldRoot);
+        levels--;
+    }
+    return true;
+}
+
+//preconditions: none
+//postconditions: the item with key is removed from the subtree of page id if it is there, (the page
+// may be left one short of its minimum). every child on the path that went short is fixed.
+template <typename T, int PageSize>
+bool PagedBPlusTree<T, PageSize>::looseRemove(uint64_t id, const Key& key)
+{
+    PageGuard guard(pool, id);
+
+    if(guard.as<PageHeader>()->kind == LEAF)
+    {
+        LeafPage* leaf = guard.as<LeafPage>();
+        int count = int(leaf->header.count);
+        int i = leafIndex(leaf, key);
+        if(i == count || !(keyOf(leaf->items[i]) == key))
+            return false;
+
+        deleteItem(leaf->items, i, count);
+        leaf->header.count = uint32_t(count);
+        guard.markDirty();
+        return true;
+    }
+
+    InnerPage* inner = guard.as<InnerPage>();
+    int i = childIndex(inner, key);
+    if(!looseRemove(inner->children[i], key))
+        return false;
+    fixShortage(guard, i);
+    return true;
+}
+
+//preconditions: parent is an inner page with at least one key.
+//postconditions: if child i is short, it takes an item from its left sibling (or, for the first child,
+// its right sibling) if that sibling has more than its minimum, otherwise the two are merged.
+template <typename T, int PageSize>
+void PagedBPlusTree<T, PageSize>::fixShortage(PageGuard& parentGuard, int i)
+{
+    InnerPage* parent = parentGuard.as<InnerPage>();
+    PageGuard child(pool, parent->children[i]);
+    const PageHeader* page = child.as<PageHeader>();
+    if(!isShort(page))
+        return;
+
+    int minimum = (page->kind == LEAF) ? LEAF_MINIMUM : INNER_MINIMUM;
+    if(i > 0)
+    {
+        PageGuard left(pool, parent->children[i-1]);
+        if(int(left.as<PageHeader>()->count) > minimum)
+            rotateRight(parent, i, left, child);
+        else
+            mergeChildren(parent, i - 1, left, child);
+    }
+    else
+    {
+        PageGuard right(pool, parent->children[i+1]);
+        if(int(right.as<PageHeader>()->count) > minimum)
+            rotateLeft(parent, i, child, right);
+        else
+            mergeChildren(parent, i, child, right);
+    }
+    parentGuard.markDirty();
+}
+
+//preconditions: child i+1 of parent has more than its minimum.
+//postconditions: the first item of child i+1 moves to the end of child i. for leaves, keys[i] becomes
+// the new first key of child i+1, for inner pages, keys[i] moves down and the first key of i+1 moves up.
+template <typename T, int PageSize>
+void PagedBPlusTree<T, PageSize>::rotateLeft(InnerPage* parent, int i, PageGuard& childGuard, PageGuard& rightGuard)
+{
+    if(childGuard.as<PageHeader>()->kind == LEAF)
+    {
+        LeafPage* child = childGuard.as<LeafPage>();
+        LeafPage* right = rightGuard.as<LeafPage>();
+        int childCount = int(child->header.count), rightCount = int(right->header.count);
+        attachItem(child->items, childCount, deleteItem(right->items, 0, rightCount));
+        child->header.count = uint32_t(childCount);
+        right->header.count = uint32_t(rightCount);
+        parent->keys[i] = keyOf(right->items[0]);
+    }
+    else
+    {
+        InnerPage* child = childGuard.as<InnerPage>();
+        InnerPage* right = rightGuard.as<InnerPage>();
+        int childKeys = int(child->header.count), childChildren = childKeys + 1;
+        int rightKeys = int(right->header.count), rightChildren = rightKeys + 1;
+        attachItem(child->keys, childKeys, parent->keys[i]);
+        attachItem(child->children, childChildren, deleteItem(right->children, 0, rightChildren));
+        parent->keys[i] = deleteItem(right->keys, 0, rightKeys);
+        child->header.count = uint32_t(childKeys);
+        right->header.count = uint32_t(rightKeys);
+    }
+    childGuard.markDirty();
+    rightGuard.markDirty();
+}
+
+//preconditions: child i-1 of parent has more than its minimum.
+//postconditions: the last item of child i-1 moves to the front of child i. for leaves, keys[i-1] becomes
+// its key, for inner pages, keys[i-1] moves down and the last key of child i-1 moves up.
+template <typename T, int PageSize>
+void PagedBPlusTree<T, PageSize>::rotateRight(InnerPage* parent, int i, PageGuard& leftGuard, PageGuard& childGuard)
+{
+    if(childGuard.as<PageHeader>()->kind == LEAF)
+    {
+        LeafPage* left = leftGuard.as<LeafPage>();
+        LeafPage* child = childGuard.as<LeafPage>();
+        int leftCount = int(left->header.count), childCount = int(child->header.count);
+        insertItem(child->items, 0, childCount, detachItem(left->items, leftCount));
+        left->header.count = uint32_t(leftCount);
+        child->header.count = uint32_t(childCount);
+        parent->keys[i-1] = keyOf(child->items[0]);
+    }
+    else
+    {
+        InnerPage* left = leftGuard.as<InnerPage>();
+        InnerPage* child = childGuard.as<InnerPage>();
+        int leftKeys = int(left->header.count), leftChildren = leftKeys + 1;
+        int childKeys = int(child->header.count), childChildren = childKeys + 1;
+        insertItem(child->keys, 0, childKeys, parent->keys[i-1]);
+        insertItem(child->children, 0, childChildren, detachItem(left->children, leftChildren));
+        parent->keys[i-1] = detachItem(left->keys, leftKeys);
+        left->header.count = uint32_t(leftKeys);
+        child->header.count = uint32_t(childKeys);
+    }
+    leftGuard.markDirty();
+    childGuard.markDirty();
+}
+
+//preconditions: children i and i+1 of parent fit in one page.
+//postconditions: child i+1 is appended to child i (with keys[i] between them, for inner pages),
+// unlinked from the leaves (for leaves), removed from parent with keys[i], and freed.
+template <typename T, int PageSize>
+void PagedBPlusTree<T, PageSize>::mergeChildren(InnerPage* parent, int i, PageGuard& leftGuard, PageGuard& rightGuard)
+{
+    if(leftGuard.as<PageHeader>()->kind == LEAF)
+    {
+        LeafPage* left = leftGuard.as<LeafPage>();
+        LeafPage* right = rightGuard.as<LeafPage>();
+        int leftCount = int(left->header.count), rightCount = int(right->header.count);
+        mergeArrays(left->items, leftCount, right->items, rightCount);
+        left->header.count = uint32_t(leftCount);
+
+        left->header.next = right->header.next;
+        if(right->header.next != 0)
+        {
+            PageGuard next(pool, right->header.next);
+            next.as<PageHeader>()->prev = leftGuard.id();
+            next.markDirty();
+        }
+    }
+    else
+    {
+        InnerPage* left = leftGuard.as<InnerPage>();
+        InnerPage* right = rightGuard.as<InnerPage>();
+        int leftKeys = int(left->header.count), leftChildren = leftKeys + 1;
+        int rightKeys = int(right->header.count), rightChildren = rightKeys + 1;
+        attachItem(left->keys, leftKeys, parent->keys[i]);
+        mergeArrays(left->keys, leftKeys, right->keys, rightKeys);
+        mergeArrays(left->children, leftChildren, right->children, rightChildren);
+        left->header.count = uint32_t(leftKeys);
+    }
+    leftGuard.markDirty();
+
+    int keys = int(parent->header.count);
+    int children = keys + 1;
+    deleteItem(parent->keys, i, keys);
+    deleteItem(parent->children, i + 1, children);
+    parent->header.count = uint32_t(keys);
+
+    releasePage(rightGuard.id());
+}
+
+//preconditions: none
+//postconditions: returns true if the tree is closed, or if, starting at the root: every page is a leaf
+// or inner page, holds keys in order between the keys its parent bounds it with, holds no more than its
+// maximum, and at least its minimum (but the root), every leaf is at depth height(), the leaf chain
+// runs both ways over every leaf, and the items add up to size().
+template <typename T, int PageSize>
+bool PagedBPlusTree<T, PageSize>::isValid() const
+{
+    if(!isOpen())
+        return true;
+
+    uint64_t items = 0;
+    if(!verifyPage(root, 1, nullptr, nullptr, items) || items != _size)
+        return false;
+
+    uint64_t chained = 0, previous = 0;
+    for(uint64_t id = edgeLeaf(false); id != 0; )
+    {
+        PageGuard guard(pool, id);
+        const PageHeader* page = guard.as<PageHeader>();
+        if(page->kind != LEAF || page->prev != previous)
+            return false;
+        chained += page->count;
+        previous = id;
+        id = page->next;
+    }
+    return chained == _size && previous == edgeLeaf(true);
+}
+
+//preconditions: low and high (when not null) bound the keys page id may hold: low <= key < high.
+//postconditions: returns true if the subtree of page id satisfies the rules described in isValid,
+// adding its items to items.
+template <typename T, int PageSize>
+bool PagedBPlusTree<T, PageSize>::verifyPage(uint64_t id, uint64_t depth, const Key* low, const Key* high, uint64_t& items) const
+{
+    if(id == 0 || id >= pool.pageCount())
+        return false;
+
+    PageGuard guard(pool, id);
+    const PageHeader* page = guard.as<PageHeader>();
+    if((page->kind != LEAF && page->kind != INNER) || isOver(page) || (id != root && isShort(page)))
+        return false;
+
+    if(page->kind == LEAF)
+    {
+        const LeafPage* leaf = guard.as<LeafPage>();
+        if(depth != levels)
+            return false;
+        for(int i = 0; i < int(leaf->header.count); i++)
+        {
+            const Key& key = keyOf(leaf->items[i]);
+            if((i > 0 && !(keyOf(leaf->items[i-1]) < key)) || (low && key < *low) || (high && !(key < *high)))
+                return false;
+        }
+        items += leaf->header.count;
+        return true;
+    }
+
+    const InnerPage* inner = guard.as<InnerPage>();
+    int count = int(inner->header.count);
+    if(count < 1)
+        return false;
+    for(int i = 0; i < count; i++)
+        if((i > 0 && !(inner->keys[i-1] < inner->keys[i])) || (low && inner->keys[i] < *low) || (high && !(inner->keys[i] < *high)))
+            return false;
+    for(int i = 0; i <= count; i++)
+    {
+        const Key* childLow = (i == 0) ? low : &inner->keys[i-1];
+        const Key* childHigh = (i == count) ? high : &inner->keys[i];
+        if(!verifyPage(inner->children[i], depth + 1, childLow, childHigh, items))
+            return false;
+    }
+    return true;
+}
+
+#endif // PAGEDBPLUSTREE_H
@@ -0,0 +1,938 @@
+#ifndef PERSISTENTBPLUSTREE_H
+#define PERSISTENTBPLUSTREE_H
+
+#include <iostream>
+#include <atomic>
+#include <iterator>
+#include <cstddef>
+#include "bplustree.h"
+using namespace std;
+
+//PersistentBPlusTree is a B+Tree whose copies share their nodes, so copying one (a snapshot)
+// takes O(1): the copy takes a reference to the root, and nothing else.
+// Every node counts the parents (and trees) that point at it. A write copies the nodes on
+// its root-to-leaf path that are shared (and the siblings it rotates or merges with), then
+// changes its own copies in place; every node it did not touch stays shared. So an old
+// snapshot never changes, stays readable and iterable, and costs only the nodes that were
+// written since it was taken.
+// The leaves are not linked (a link would make the sibling of every copied leaf shared
+// state), the iterator keeps the path from the root instead. The nodes are allocated with
+// new, not from a NodePool, since they outlive the tree that allocated them.
+// The reference counts are atomic: a snapshot may be handed to (and read and destroyed by)
+// another thread while this tree keeps changing, as long as each tree is used by one thread.
+template <typename T, int MinDegree = DefaultMinDegree<T>::value>
+class PersistentBPlusTree
+{
+private:
+    struct Node;
+    struct Inner;
+    struct Leaf;
+
+    static const int MAX_HEIGHT = 32;              //a tree of MinDegree 1 this tall holds more than an int can count
+
+public:
+    typedef typename KeyOf<T>::type Key;
+
+    //a bidirectional iterator over the items of one tree (or snapshot), in order. it holds
+    // the path from the root to its leaf, and stays valid until that tree is written or destroyed.
+    class Iterator
+    {
+    public:
+        friend class PersistentBPlusTree;
+
+        typedef bidirectional_iterator_tag iterator_category;
+        typedef T value_type;
+        typedef ptrdiff_t difference_type;
+        typedef const T* pointer;
+        typedef const T& reference;
+
+        friend bool operator ==(const Iterator& lhs, const Iterator& rhs){return (lhs.leaf == rhs.leaf && lhs.keyPtr == rhs.keyPtr);}
+        friend bool operator !=(const Iterator& lhs, const Iterator& rhs){return !(lhs == rhs);}
+
+        Iterator(const Node* _root = nullptr): root(_root), depth(0), leaf(nullptr), keyPtr(0) {}
+
+        bool is_null() const {return !leaf;}
+
+        //preconditions: leaf != nullptr, keyPtr < leaf->dataCount
+        //postconditions: return data[keyPtr] of leaf.
+        const T& operator *() const
+        {
+            assert(leaf && keyPtr < leaf->dataCount);
+            return leaf->data[keyPtr];
+        }
+
+        const T* operator ->() const
+        {
+            return &this->operator*();
+        }
+
+        Iterator operator++(int unUsed)
+        {
+            Iterator temp = *this;
+            this->operator++();
+            return temp;
+        }
+
+        //preconditions: leaf != nullptr
+        //postconditions: advance keyPtr if there are more items in the current leaf,
+        // otherwise, move to the first item of the next leaf (or to end).
+        Iterator& operator++()
+        {
+            if(leaf != nullptr)
+            {
+                if(keyPtr+1 < leaf->dataCount)
+                    keyPtr++;
+                else
+                    nextLeaf();
+            }
+            return *this;
+        }
+
+        Iterator operator--(int unUsed)
+        {
+            Iterator temp = *this;
+            this->operator--();
+            return temp;
+        }
+
+        //preconditions: this is not the first item.
+        //postconditions: move keyPtr back if it is not at the front of the current leaf,
+        // otherwise, move to the last item of the previous leaf (from end, of the last leaf).
+        Iterator& operator--()
+        {
+            if(leaf != nullptr && keyPtr > 0)
+                keyPtr--;
+            else if(leaf == nullptr)
+            {
+                assert(root);
+                depth = 0;
+                descend(root,false);
+            }
+            else
+                previousLeaf();
+            return *this;
+        }
+
+    private:
+        const Node* root;
+        const Inner* path[MAX_HEIGHT];             //the inner nodes above leaf, root first
+        int index[MAX_HEIGHT];                     //the subset taken in each of them
+        int depth;
+        const Leaf* leaf;                          //null at end
+        int keyPtr;
+
+        void descend(const Node* node, bool leftmost); //push the path down to the first (or last) item under node
+        void nextLeaf();
+        void previousLeaf();
+    };
+
+    friend ostream& operator<<(ostream& outs, const PersistentBPlusTree<T, MinDegree>& printMe)
+    {
+        printMe.printTree(printMe.root, 0, 0, outs);
+        return outs;
+    }
+
+    PersistentBPlusTree(bool dups = false);
+
+    //big three: a copy shares every node of other, and is O(1).
+    PersistentBPlusTree(const PersistentBPlusTree<T, MinDegree>& other);
+    ~PersistentBPlusTree();
+    PersistentBPlusTree<T, MinDegree>& operator =(const PersistentBPlusTree<T, MinDegree>& RHS);
+
+    PersistentBPlusTree<T, MinDegree> snapshot() const {return *this;} //an O(1) copy, that later writes leave as it is
+
+    bool areDupsOk() const {return dupsOk;}
+    bool insert(const T& entry);                //insert entry, copying the shared nodes on its path
+    bool remove(const T& entry);                //remove entry, copying the shared nodes on its path
+    void clearTree();                           //release every node of this tree, leaving it empty
+
+    bool contains(const T& entry) const;        //true if entry can be found in the tree
+    const T* find(const T& entry) const;        //return a pointer to this key. NULL if not there.
+    const T& get(const T& entry) const;         //return a reference to entry, which must be in the tree
+
+    int size() const;                           //count the number of elements in the tree
+    bool empty() const;                         //true if the tree is empty
+    size_t nodesCopied() const {return _copies;} //the number of shared nodes this tree has copied on write
+
+    bool isValid() const;                       //verify the B+Tree rules and the reference counts
+
+    Iterator lower_bound(const Key& key) const; //return an iterator to the first item not less than key.
+    Iterator begin() const;
+    Iterator end() const;
+
+private:
+    static_assert(MinDegree >= 1, "PersistentBPlusTree requires a MinDegree of at least 1");
+
+    static const int MINIMUM = MinDegree;
+    static const int MAXIMUM = 2 * MINIMUM;
+
+    struct Node
+    {
+        atomic<int> refs;                          //the number of parents and trees pointing at this node
+        bool leaf;                                 //true if this node is a Leaf
+        int dataCount;                             //number of data elements
+        int childCount;                            //number of children (always 0 in a leaf)
+
+        Node(bool isLeafNode): refs(1), leaf(isLeafNode), dataCount(0), childCount(0) {}
+        bool isLeaf() const {return leaf;}
+    };
+
+    struct Inner : Node
+    {
+        Key data[MAXIMUM + 1];                     //holds the routing keys
+        Node* subset[MAXIMUM + 2];                 //subtrees
+
+        Inner(): Node(false) {}
+    };
+
+    struct Leaf : Node
+    {
+        T data[MAXIMUM + 1];                       //holds the items
+
+        Leaf(): Node(true) {}
+    };
+
+    Node* root;                                    //never null, an empty tree is a single empty leaf
+    bool dupsOk;                                   //true if duplicate keys may be inserted
+    size_t _size;
+    size_t _copies;                                //see nodesCopied
+
+    static Inner* asInner(Node* node) {return static_cast<Inner*>(node);}
+    static const Inner* asInner(const Node* node) {return static_cast<const Inner*>(node);}
+    static Leaf* asLeaf(Node* node) {return static_cast<Leaf*>(node);}
+    static const Leaf* asLeaf(const Node* node) {return static_cast<const Leaf*>(node);}
+    static const Key& keyOf(const T& item) {return KeyOf<T>::key(item);}
+
+    static int innerIndex(const Inner* inner, const Key& key); //index of the first routing key in inner that is not less than key
+    static int leafIndex(const Leaf* leaf, const Key& key);    //index of the first item in leaf that is not less than key
+    static int leafIndex(const Leaf* leaf, const Key& key, true_type);
+    static int leafIndex(const Leaf* leaf, const Key& key, false_type);
+    static const Key& getSmallest(const Node* node);           //get the smallest key in this subtree.
+    const T* findKey(const Key& key) const;                    //the item with key, or null
+
+    //sharing
+    static Node* share(Node* node);                //take one more reference to node
+    static void release(Node* node);               //drop a reference, freeing node (and releasing its subsets) on the last one
+    static void deleteNode(Node* node);            //free a single node, leaving its subsets as they are
+    Node* own(Node*& slot);                        //make slot point at a node only this tree reaches, copying it if shared
+
+    //insert element functions
+    void looseInsert(Node* node, const T& entry);  //allows MAXIMUM+1 data elements in node
+    static void fixExcess(Inner* node, int i);     //fix excess of data elements in child i
+
+    //remove element functions:
+    void looseRemove(Node* node, const Key& key);  //allows MINIMUM-1 data elements in node
+    void fixShortage(Inner* node, int i);          //fix shortage of data elements in child i
+
+    static void rotateLeft(Inner* node, int i);    //transfer one element LEFT from child i+1
+    static void rotateRight(Inner* node, int i);   //transfer one element RIGHT from child i-1
+    static void mergeWithNextSubset(Inner* node, int i); //merge subset i with subset i+1
+    static void mergeWithPreviousSubset(Inner* node, int i);
+
+    void printTree(const Node* node, int level, int index, ostream& outs) const;
+    bool verifyNode(const Node* node, int depth, int& leafDepth,
+                    const Key* low, const Key* high, size_t& items) const; //used by isValid
+};
+
+//preconditions: none
+//postconditions: an empty tree, made of a single empty leaf, allowing duplicates if dups.
+template <typename T, int MinDegree>
+PersistentBPlusTree<T, MinDegree>::PersistentBPlusTree(bool dups): root(new Leaf), dupsOk(dups), _size(0), _copies(0)
+{
+}
+
+//preconditions: none
+//postconditions: this tree shares the root (and so every node) of other.
+template <typename T, int MinDegree>
+PersistentBPlusTree<T, MinDegree>::PersistentBPlusTree(const PersistentBPlusTree<T, MinDegree>& other):
+    root(share(other.root)), dupsOk(other.dupsOk), _size(other._size), _copies(0)
+{
+}
+
+//preconditions: none
+//postconditions: this tree drops its reference to its root, freeing the nodes no other tree shares.
+template <typename T, int MinDegree>
+PersistentBPlusTree<T, MinDegree>::~PersistentBPlusTree()
+{
+    release(root);
+}
+
+//preconditions: none
+//postconditions: this tree shares the root of RHS, and drops its reference to its old root.
+template <typename T, int MinDegree>
+PersistentBPlusTree<T, MinDegree>& PersistentBPlusTree<T, MinDegree>::operator =(const PersistentBPlusTree<T, MinDegree>& RHS)
+{
+    if(this != &RHS)
+    {
+        Node* oldRoot = root;
+        root = share(RHS.root);
+        release(oldRoot);
+        dupsOk = RHS.dupsOk;
+        _size = RHS._size;
+    }
+    return *this;
+}
+
+//preconditions: none
+//postconditions: this tree drops its nodes, and is a single empty leaf.
+template <typename T, int MinDegree>
+void PersistentBPlusTree<T, MinDegree>::clearTree()
+{
+    release(root);
+    root = new Leaf;
+    _size = 0;
+}
+
+//preconditions: node is reachable by the caller.
+//postconditions: returns node, with one more reference.
+template <typename T, int MinDegree>
+typename PersistentBPlusTree<T, MinDegree>::Node* PersistentBPlusTree<T, MinDegree>::share(Node* node)
+{
+    node->refs.fetch_add(1,memory_order_relaxed);
+    return node;
+}
+
+//preconditions: the caller holds one of the references to node.
+//postconditions: the reference is dropped. if it was the last one, the subsets of node
+// are released in turn, and node is freed.
+template <typename T, int MinDegree>
+void PersistentBPlusTree<T, MinDegree>::release(Node* node)
+{
+    if(node->refs.fetch_sub(1,memory_order_acq_rel) != 1)
+        return;
+
+    if(!node->isLeaf())
+    {
+        Inner* inner = asInner(node);
+        for(int i = 0; i < inner->childCount; i++)
+            release(inner->subset[i]);
+    }
+    deleteNode(node);
+}
+
+//preconditions: node was allocated as an Inner if it is not a leaf, otherwise as a Leaf.
+//postconditions: node is freed, its subsets (if any) are not released.
+template <typename T, int MinDegree>
+void PersistentBPlusTree<T, MinDegree>::deleteNode(Node* node)
+{
+    if(node->isLeaf())
+        delete asLeaf(node);
+    else
+        delete asInner(node);
+}
+
+//preconditions: slot is the root, or a subset of a node only this tree reaches.
+//postconditions: if the node at slot is shared, slot is pointed at a copy of it (which
+// shares its subsets), and the reference to the original is dropped. the node at slot,
+// which only this tree reaches now, is returned.
+template <typename T, int MinDegree>
+typename PersistentBPlusTree<T, MinDegree>::Node* PersistentBPlusTree<T, MinDegree>::own(Node*& slot)
+{
+    Node* node = slot;
+    if(node->refs.load(memory_order_acquire) == 1)
+        return node;
+
+    if(node->isLeaf())
+    {
+        Leaf* copy = new Leaf;
+        copyArray(copy->data,asLeaf(node)->data,copy->dataCount,node->dataCount);
+        slot = copy;
+    }
+    else
+    {
+        const Inner* source = asInner(node);
+        Inner* copy = new Inner;
+        copyArray(copy->data,source->data,copy->dataCount,source->dataCount);
+        for(int i = 0; i < source->childCount; i++)
+            copy->subset[i] = share(source->subset[i]);
+        copy->childCount = source->childCount;
+        slot = copy;
+    }
+
+    _copies++;
+    release(node);
+    return slot;
+}
+
+//preconditions: none
+//postconditions: the entry is inserted, unless its key is there and dups are not ok.
+// the tree is searched first, so an insert that changes nothing copies nothing. then
+// the root (if shared) is copied, and looseInsert copies the path below it. an excess
+// left in the root is fixed under a new root, as in BPlusTree::insertEntry.
+template <typename T, int MinDegree>
+bool PersistentBPlusTree<T, MinDegree>::insert(const T& entry)
+{
+    if(!dupsOk && findKey(keyOf(entry)))
+        return false;
+
+    looseInsert(own(root),entry);
+    _size++;
+
+    if(root->dataCount == MAXIMUM + 1)
+    {
+        Inner* newRoot = new Inner;
+        newRoot->subset[0] = root;
+        newRoot->childCount = 1;
+        fixExcess(newRoot,0);
+        root = newRoot;
+    }
+    return true;
+}
+
+//preconditions: none
+//postconditions: the item with the key of entry, if there is one, is removed, copying
+// the shared nodes it reaches first. a root left with a single subset is replaced by it.
+template <typename T, int MinDegree>
+bool PersistentBPlusTree<T, MinDegree>::remove(const T& entry)
+{
+    //copy the key, since entry may refer to an item that is about to be removed.
+    const Key key = keyOf(entry);
+    if(!findKey(key))
+        return false;
+
+    looseRemove(own(root),key);
+    _size--;
+
+    if(!root->isLeaf() && root->childCount == 1)
+    {
+        Node* shrinkPtr = root;
+        root = asInner(shrinkPtr)->subset[0];
+        deleteNode(shrinkPtr);
+    }
+    return true;
+}
+
+//preconditions: node is reached only by this tree.
+//postconditions: entry is inserted into the subtree at node, as in BPlusTree::looseInsert,
+// after the subset it goes down to is made this tree's own.
+template <typename T, int MinDegree>
+void PersistentBPlusTree<T, MinDegree>::looseInsert(Node* node, const T& entry)
+{
+    const Key& key = keyOf(entry);
+
+    if(node->isLeaf())
+    {
+        Leaf* leaf = asLeaf(node);
+        insertItem(leaf->data,leafIndex(leaf,key),leaf->dataCount,entry);
+    }
+    else
+    {
+        Inner* inner = asInner(node);
+        int i = innerIndex(inner,key);
+        if(i < inner->dataCount && key == inner->data[i])
+            i++;
+
+        looseInsert(own(inner->subset[i]),entry);
+        fixExcess(inner,i);
+    }
+}
+
+//preconditions: node and subset[i] are reached only by this tree, i < childCount, childCount <= maximum+1
+//postconditions: same as BPlusTree::fixExcess, with no leaves to link.
+template <typename T, int MinDegree>
+void PersistentBPlusTree<T, MinDegree>::fixExcess(Inner* node, int i)
+{
+    assert(i < node->childCount && node->childCount <= MAXIMUM+1);
+
+    if(node->subset[i]->dataCount > MAXIMUM)
+    {
+        if(node->subset[i]->isLeaf())
+        {
+            Leaf* left = asLeaf(node->subset[i]);
+            Leaf* right = new Leaf;
+            split(left->data,left->dataCount,right->data,right->dataCount,true);
+            insertItem(node->subset,i+1,node->childCount,static_cast<Node*>(right));
+            insertItem(node->data,i,node->dataCount,keyOf(right->data[0]));
+        }
+        else
+        {
+            Inner* left = asInner(node->subset[i]);
+            Inner* right = new Inner;
+            split(left->data,left->dataCount,right->data,right->dataCount);
+            split(left->subset,left->childCount,right->subset,right->childCount);
+            insertItem(node->subset,i+1,node->childCount,static_cast<Node*>(right));
+            insertItem(node->data,i,node->dataCount,detachItem(left->data,left->dataCount));
+        }
+    }
+}
+
+//preconditions: node is reached only by this tree, and key is in its subtree.
+//postconditions: key is removed from the subtree at node, as in BPlusTree::looseRemove,
+// after the subset it goes down to is made this tree's own.
+template <typename T, int MinDegree>
+void PersistentBPlusTree<T, MinDegree>::looseRemove(Node* node, const Key& key)
+{
+    if(!node->isLeaf())
+    {
+        Inner* inner = asInner(node);
+        int index = innerIndex(inner,key);
+        bool found = (index < inner->dataCount && inner->data[index] == key);
+        if(found)
+            index++;
+
+        Node* subset = own(inner->subset[index]);
+        looseRemove(subset,key);
+
+        //data[index-1] was the smallest key of subset[index], refresh it before
+        // a rotate or merge can move it. (an emptied leaf is resynced by fixShortage)
+        if(found && !(subset->isLeaf() && subset->dataCount == 0))
+            inner->data[index-1] = getSmallest(subset);
+
+        if(subset->dataCount < MINIMUM)
+            fixShortage(inner,index);
+    }
+    else
+    {
+        Leaf* leaf = asLeaf(node);
+        int index = leafIndex(leaf,key);
+        assert(index < leaf->dataCount && keyOf(leaf->data[index]) == key);
+        deleteItem(leaf->data,index,leaf->dataCount);
+    }
+}
+
+//preconditions: node and subset[i] are reached only by this tree, and subset[i] has a shortage.
+//postconditions: same as BPlusTree::fixShortage, after the sibling that gives or takes the
+// items is made this tree's own (a merge frees the emptied node, which only this tree reached).
+template <typename T, int MinDegree>
+void PersistentBPlusTree<T, MinDegree>::fixShortage(Inner* node, int i)
+{
+    if(i+1 < node->childCount && node->subset[i+1]->dataCount > MINIMUM)
+    {
+        own(node->subset[i+1]);
+        rotateLeft(node,i);
+    }
+    else if(i > 0 && node->subset[i-1]->dataCount > MINIMUM)
+    {
+        own(node->subset[i-1]);
+        rotateRight(node,i);
+    }
+    else if(i+1 < node->childCount)
+    {
+        own(node->subset[i+1]);
+        mergeWithNextSubset(node,i);
+    }
+    else
+    {
+        own(node->subset[i-1]);
+        mergeWithPreviousSubset(node,i);
+    }
+
+    //when the subsets are leaves, the items that moved (or the item that was removed)
+    // may have changed the smallest key of the subsets on either side of data[i-1] and data[i].
+    if(node->subset[0]->isLeaf())
+    {
+        for(int j = ((i == 0) ? 0 : i-1); j <= i && j < node->dataCount; j++)
+            if(!(node->data[j] == keyOf(asLeaf(node->subset[j+1])->data[0])))
+                node->data[j] = keyOf(asLeaf(node->subset[j+1])->data[0]);
+    }
+}
+
+//preconditions: (i + 1 < childCount), subset[i] and subset[i+1] are reached only by this tree.
+//postconditions: same as BPlusTree::mergeWithNextSubset, with no leaves to link.
+template <typename T, int MinDegree>
+void PersistentBPlusTree<T, MinDegree>::mergeWithNextSubset(Inner* node, int i)
+{
+    assert(node->childCount > i+1);
+
+    if(node->subset[i]->isLeaf())
+    {
+        Leaf* left = asLeaf(node->subset[i]);
+        Leaf* right = asLeaf(node->subset[i+1]);
+        mergeArrays(left->data,left->dataCount,right->data,right->dataCount);
+        deleteItem(node->data,i,node->dataCount);
+        deleteNode(deleteItem(node->subset,i+1,node->childCount));
+    }
+    else
+    {
+        Inner* left = asInner(node->subset[i]);
+        Inner* right = asInner(node->subset[i+1]);
+        insertItem(right->data,0,right->dataCount,deleteItem(node->data,i,node->dataCount));
+        mergeFront(right->data,right->dataCount,left->data,left->dataCount);
+        mergeFront(right->subset,right->childCount,left->subset,left->childCount);
+        deleteNode(deleteItem(node->subset,i,node->childCount));
+    }
+}
+
+//preconditions: (i > 0), subset[i-1] and subset[i] are reached only by this tree.
+//postconditions: same as BPlusTree::mergeWithPreviousSubset, with no leaves to link.
+template <typename T, int MinDegree>
+void PersistentBPlusTree<T, MinDegree>::mergeWithPreviousSubset(Inner* node, int i)
+{
+    assert(i > 0);
+
+    if(node->subset[i]->isLeaf())
+    {
+        Leaf* left = asLeaf(node->subset[i-1]);
+        Leaf* right = asLeaf(node->subset[i]);
+        mergeArrays(left->data,left->dataCount,right->data,right->dataCount);
+        deleteItem(node->data,i-1,node->dataCount);
+        deleteNode(deleteItem(node->subset,i,node->childCount));
+    }
+    else
+    {
+        Inner* left = asInner(node->subset[i-1]);
+        Inner* right = asInner(node->subset[i]);
+        attachItem(left->data,left->dataCount,deleteItem(node->data,i-1,node->dataCount));
+        mergeArrays(left->data,left->dataCount,right->data,right->dataCount);
+        mergeArrays(left->subset,left->childCount,right->subset,right->childCount);
+        deleteNode(deleteItem(node->subset,i,node->childCount));
+    }
+}
+
+//preconditions: (dataCount > i), subset[i] and subset[i+1] are reached only by this tree.
+//postconditions: same as BPlusTree::rotateLeft. (a subset that moves keeps its references)
+template <typename T, int MinDegree>
+void PersistentBPlusTree<T, MinDegree>::rotateLeft(Inner* node, int i)
+{
+    assert((node->dataCount > i) && (node->subset[i]->dataCount < MAXIMUM+1) && (node->subset[i+1]->dataCount > MINIMUM));
+
+    if(node->subset[i]->isLeaf())
+    {
+        Leaf* left = asLeaf(node->subset[i]);
+        Leaf* right = asLeaf(node->subset[i+1]);
+        attachItem(left->data,left->dataCount,deleteItem(right->data,0,right->dataCount));
+    }
+    else
+    {
+        Inner* left = asInner(node->subset[i]);
+        Inner* right = asInner(node->subset[i+1]);
+        attachItem(left->data,left->dataCount,deleteItem(node->data,i,node->dataCount));
+        insertItem(node->data,i,node->dataCount,deleteItem(right->data,0,right->dataCount));
+        attachItem(left->subset,left->childCount,deleteItem(right->subset,0,right->childCount));
+    }
+}
+
+//preconditions: (i > 0), subset[i-1] and subset[i] are reached only by this tree.
+//postconditions: same as BPlusTree::rotateRight.
+template <typename T, int MinDegree>
+void PersistentBPlusTree<T, MinDegree>::rotateRight(Inner* node, int i)
+{
+    assert((i > 0) && (node->subset[i]->dataCount < MAXIMUM+1) && (node->subset[i-1]->dataCount > MINIMUM));
+
+    if(node->subset[i]->isLeaf())
+    {
+        Leaf* left = asLeaf(node->subset[i-1]);
+        Leaf* right = asLeaf(node->subset[i]);
+        insertItem(right->data,0,right->dataCount,detachItem(left->data,left->dataCount));
+    }
+    else
+    {
+        Inner* left = asInner(node->subset[i-1]);
+        Inner* right = asInner(node->subset[i]);
+        insertItem(right->data,0,right->dataCount, deleteItem(node->data,i-1,node->dataCount));
+        insertItem(node->data,i-1,node->dataCount, detachItem(left->data,left->dataCount));
+        insertItem(right->subset,0,right->childCount,detachItem(left->subset,left->childCount));
+    }
+}
+
+//preconditions: none
+//postconditions: follows the routing keys from the root to the leaf where key is
+// (subset[i+1] when key equals data[i]), and returns its item with key, or null.
+template <typename T, int MinDegree>
+const T* PersistentBPlusTree<T, MinDegree>::findKey(const Key& key) const
+{
+    const Node* node = root;
+    while(!node->isLeaf())
+    {
+        const Inner* inner = asInner(node);
+        int i = innerIndex(inner,key);
+        if(i < inner->dataCount && key == inner->data[i])
+            i++;
+        node = inner->subset[i];
+    }
+
+    const Leaf* leaf = asLeaf(node);
+    int index = leafIndex(leaf,key);
+    if(index < leaf->dataCount && key == keyOf(leaf->data[index]))
+        return &leaf->data[index];
+    else
+        return nullptr;
+}
+
+//preconditions: none
+//postconditions: returns true if the entry exists in the tree, otherwise false.
+template <typename T, int MinDegree>
+bool PersistentBPlusTree<T, MinDegree>::contains(const T& entry) const
+{
+    return findKey(keyOf(entry)) != nullptr;
+}
+
+//preconditions: none
+//postconditions: returns a pointer to the entry in the tree if it exists, otherwise nullptr.
+// the pointer is valid until this tree is written or destroyed.
+template <typename T, int MinDegree>
+const T* PersistentBPlusTree<T, MinDegree>::find(const T& entry) const
+{
+    return findKey(keyOf(entry));
+}
+
+//preconditions: the entry is in the tree.
+//postconditions: returns a reference to the entry in the tree.
+template <typename T, int MinDegree>
+const T& PersistentBPlusTree<T, MinDegree>::get(const T& entry) const
+{
+    const T* item = findKey(keyOf(entry));
+    assert(item);
+    return *item;
+}
+
+//preconditions: none
+//postconditions: returns the total number of data items in the tree.
+template <typename T, int MinDegree>
+int PersistentBPlusTree<T, MinDegree>::size() const
+{
+    return _size;
+}
+
+//preconditions: none
+//postconditions: returns true if the root has no children or data items, otherwise false.
+template <typename T, int MinDegree>
+bool PersistentBPlusTree<T, MinDegree>::empty() const
+{
+    return root->isLeaf() && root->dataCount == 0;
+}
+
+//preconditions: none
+//postconditions: returns an iterator to the first item whose key is not less than key, or end().
+// the search goes left of a routing key equal to key, as in BPlusTree::findFirstLeaf, since
+// duplicates of key may sit at the end of subset[i] as well as in subset[i+1].
+template <typename T, int MinDegree>
+typename PersistentBPlusTree<T, MinDegree>::Iterator PersistentBPlusTree<T, MinDegree>::lower_bound(const Key& key) const
+{
+    Iterator it(root);
+    const Node* node = root;
+    while(!node->isLeaf())
+    {
+        const Inner* inner = asInner(node);
+        assert(it.depth < MAX_HEIGHT);
+        it.path[it.depth] = inner;
+        it.index[it.depth] = innerIndex(inner,key);
+        node = inner->subset[it.index[it.depth]];
+        it.depth++;
+    }
+
+    it.leaf = asLeaf(node);
+    it.keyPtr = leafIndex(it.leaf,key);
+    if(it.keyPtr == it.leaf->dataCount)
+        it.nextLeaf();
+    return it;
+}
+
+//preconditions: none
+//postconditions: returns an iterator to the first item, or end() if the tree is empty.
+template <typename T, int MinDegree>
+typename PersistentBPlusTree<T, MinDegree>::Iterator PersistentBPlusTree<T, MinDegree>::begin() const
+{
+    if(empty())
+        return end();
+
+    Iterator it(root);
+    it.descend(root,true);
+    return it;
+}
+
+//preconditions: none
+//postconditions: returns an iterator past the last item, that can be decremented to the last item.
+template <typename T, int MinDegree>
+typename PersistentBPlusTree<T, MinDegree>::Iterator PersistentBPlusTree<T, MinDegree>::end() const
+{
+    return Iterator(root);
+}
+
+//preconditions: the subtree at node is not empty.
+//postconditions: the inner nodes from node down to its first (or last) leaf are pushed on the
+// path, and the iterator is at the first (or last) item of that leaf.
+template <typename T, int MinDegree>
+void PersistentBPlusTree<T, MinDegree>::Iterator::descend(const Node* node, bool leftmost)
+{
+    while(!node->isLeaf())
+    {
+        const Inner* inner = asInner(node);
+        assert(depth < MAX_HEIGHT);
+        path[depth] = inner;
+        index[depth] = leftmost ? 0 : inner->childCount - 1;
+        node = inner->subset[index[depth]];
+        depth++;
+    }
+
+    leaf = asLeaf(node);
+    assert(leaf->dataCount > 0);
+    keyPtr = leftmost ? 0 : leaf->dataCount - 1;
+}
+
+//preconditions: leaf != nullptr
+//postconditions: the path is popped up to the lowest node with a subset to the right of the
+// one taken, then descends to the first item of that subset. at the last leaf, moves to end.
+template <typename T, int MinDegree>
+void PersistentBPlusTree<T, MinDegree>::Iterator::nextLeaf()
+{
+    while(depth > 0 && index[depth-1] + 1 >= path[depth-1]->childCount)
+        depth--;
+
+    if(depth == 0)
+    {
+        leaf = nullptr;
+        keyPtr = 0;
+        return;
+    }
+
+    index[depth-1]++;
+    descend(path[depth-1]->subset[index[depth-1]],true);
+}
+
+//preconditions: leaf is not the first leaf.
+//postconditions: the path is popped up to the lowest node with a subset to the left of the
+// one taken, then descends to the last item of that subset.
+template <typename T, int MinDegree>
+void PersistentBPlusTree<T, MinDegree>::Iterator::previousLeaf()
+{
+    while(depth > 0 && index[depth-1] == 0)
+        depth--;
+
+    assert(depth > 0);
+    index[depth-1]--;
+    descend(path[depth-1]->subset[index[depth-1]],false);
+}
+
+//preconditions: none
+//postconditions: returns the index of the first routing key in inner that is not less than key.
+template <typename T, int MinDegree>
+int PersistentBPlusTree<T, MinDegree>::innerIndex(const Inner* inner, const Key& key)
+{
+    return NodeSearch<Key>::firstGE(inner->data,inner->dataCount,key);
+}
+
+//preconditions: none
+//postconditions: returns the index of the first item in leaf whose key is not less than key,
+// if no such item exists, returns leaf->dataCount.
+template <typename T, int MinDegree>
+int PersistentBPlusTree<T, MinDegree>::leafIndex(const Leaf* leaf, const Key& key)
+{
+    return leafIndex(leaf,key,is_same<T, Key>());
+}
+
+//preconditions: T is the same type as Key
+//postconditions: the items are the keys, so search them with the NodeSearch for Key.
+template <typename T, int MinDegree>
+int PersistentBPlusTree<T, MinDegree>::leafIndex(const Leaf* leaf, const Key& key, true_type)
+{
+    return NodeSearch<Key>::firstGE(leaf->data,leaf->dataCount,key);
+}
+
+//preconditions: none
+//postconditions: a branchless binary search (see firstGEBinary) comparing keyOf(data[i]) with key.
+template <typename T, int MinDegree>
+int PersistentBPlusTree<T, MinDegree>::leafIndex(const Leaf* leaf, const Key& key, false_type)
+{
+    if(leaf->dataCount == 0)
+        return 0;
+
+    const T* base = leaf->data;
+    int len = leaf->dataCount;
+    while(len > 1)
+    {
+        int half = len / 2;
+        base = (keyOf(base[half]) < key) ? base + half : base;
+        len -= half;
+    }
+
+    return int(base - leaf->data) + (keyOf(*base) < key);
+}
+
+//preconditions: the subtree at node is not empty.
+//postconditions: returns the smallest key in this subtree.
+template <typename T, int MinDegree>
+const typename PersistentBPlusTree<T, MinDegree>::Key& PersistentBPlusTree<T, MinDegree>::getSmallest(const Node* node)
+{
+    while(!node->isLeaf())
+        node = asInner(node)->subset[0];
+
+    return keyOf(asLeaf(node)->data[0]);
+}
+
+//preconditions: none
+//postconditions: the subtree at node will be printed, last subset first.
+template <typename T, int MinDegree>
+void PersistentBPlusTree<T, MinDegree>::printTree(const Node* node, int level, int index, ostream& outs) const
+{
+    if(node->isLeaf())
+    {
+        outs << setw(level*10) << index << " : ";
+        printArray(asLeaf(node)->data,node->dataCount);
+    }
+    else
+    {
+        const Inner* inner = asInner(node);
+        for(int i = inner->childCount-1; i >= 0; i--)
+            printTree(inner->subset[i],level+1,i,outs);
+
+        outs << setw(level*10) << index << " : ";
+        printArray(inner->data,inner->dataCount);
+    }
+}
+
+//preconditions: no other tree that shares nodes with this one is being written.
+//postconditions: returns true if:
+// 1) every node is referenced, and holds at most MAXIMUM data items (at least MINIMUM, but for the root),
+// 2) an inner node with k routing keys has k+1 subsets, and every leaf is at the same depth,
+// 3) the keys are sorted (strictly, unless dups are ok) and inside the bounds of the routing keys above,
+// 4) data[i] of an inner node is the smallest key of subset[i+1],
+// 5) the items add up to size().
+template <typename T, int MinDegree>
+bool PersistentBPlusTree<T, MinDegree>::isValid() const
+{
+    int leafDepth = -1;
+    size_t items = 0;
+    return verifyNode(root,0,leafDepth,nullptr,nullptr,items) && items == _size;
+}
+
+//preconditions: low and high are null, or bound the keys of this subtree: low <= key <= high
+// (key < high, unless dups are ok, since duplicates of a routing key may sit on both sides of it).
+//postconditions: returns true if the subtree at node satisfies the rules listed in isValid.
+template <typename T, int MinDegree>
+bool PersistentBPlusTree<T, MinDegree>::verifyNode(const Node* node, int depth, int& leafDepth,
+                                                   const Key* low, const Key* high, size_t& items) const
+{
+    if(node->refs.load() < 1 || node->dataCount > MAXIMUM)
+        return false;
+    if(node != root && node->dataCount < MINIMUM)
+        return false;
+
+    if(node->isLeaf())
+    {
+        const Leaf* leaf = asLeaf(node);
+        if(leafDepth == -1)
+            leafDepth = depth;
+        if(depth != leafDepth)
+            return false;
+
+        for(int i = 0; i < leaf->dataCount; i++)
+        {
+            const Key& key = keyOf(leaf->data[i]);
+            if(i > 0 && (dupsOk ? key < keyOf(leaf->data[i-1]) : !(keyOf(leaf->data[i-1]) < key)))
+                return false;
+            if((low && key < *low) || (high && (dupsOk ? *high < key : !(key < *high))))
+                return false;
+        }
+
+        items += leaf->dataCount;
+        return true;
+    }
+
+    const Inner* inner = asInner(node);
+    if(inner->childCount != inner->dataCount + 1)
+        return false;
+
+    for(int i = 0; i < inner->childCount; i++)
+    {
+        const Key* subsetLow = (i == 0) ? low : &inner->data[i-1];
+        const Key* subsetHigh = (i == inner->dataCount) ? high : &inner->data[i];
+        if(!verifyNode(inner->subset[i],depth+1,leafDepth,subsetLow,subsetHigh,items))
+            return false;
+        if(i > 0 && !(getSmallest(inner->subset[i]) == inner->data[i-1]))
+            return false;
+    }
+    return true;
+}
+
+#endif // PERSISTENTBPLUSTREE_H
@@ -0,0 +1,201 @@
+/*************************************************************************************************************************
+ * B+Tree multi-threaded scaling benchmark
+ * ***********************************************************************************************************************
+ * Runs the same operation mixes with 1, 2, 4, 8, 16, 32 and 64 threads (or up to the thread count given as the
+ * second argument) on:
+ *    ConcurrentMap<int, int>     optimistic lock coupling: readers lock nothing, writers lock a leaf (or crab).
+ *    ConcurrentMap<string, int>  the same tree, with readers holding the nodes shared (string keys).
+ *    Map<int, int> + mutex       the single threaded Map, with every operation under one lock.
+ * The map is first loaded with N keys (the first argument, default 1000000): the even numbers 0, 2, ... 2(N-1),
+ * so that half of the keys drawn from [0, 2N) are there. The mixes are:
+ *    read only:   100% get.
+ *    read mostly: 90% get, 5% insert, 5% erase.
+ *    balanced:    50% get, 25% insert, 25% erase.
+ * Every run performs the same total number of operations (OPS_PER_RUN), split evenly between the threads,
+ * each thread drawing its keys from its own generator with a fixed seed. The throughput of the run
+ * (million operations per second, from the first thread starting to the last one finishing) is reported,
+ * with the speedup over the run with one thread. (the speedup is bounded by the number of cores.)
+ ************************************************************************************************************************/
+#include "map.h"
+#include "concurrentmap.h"
+#include <string>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <iomanip>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+using namespace std;
+
+typedef chrono::steady_clock Clock;
+
+static const size_t OPS_PER_RUN = 2000000;
+long long checksum = 0;
+
+//an operation mix: the percentage of gets and inserts, the rest are erases.
+struct Mix
+{
+    const char* name;
+    int getPercent;
+    int insertPercent;
+};
+
+//preconditions: none
+//postconditions: returns the key for the integer k. strings are zero padded, so they sort like k.
+template <typename Key> Key makeKey(int k);
+template <> int makeKey<int>(int k) {return k;}
+template <> string makeKey<string>(int k)
+{
+    char buffer[24];
+    snprintf(buffer, sizeof(buffer), "user:%012d", k);
+    return buffer;
+}
+
+//the ConcurrentMap, used as it is.
+template <typename Key>
+class Concurrent
+{
+public:
+    static const char* name() {return is_same<Key, int>::value ? "ConcurrentMap<int,int>" : "ConcurrentMap<string,int>";}
+    bool get(const Key& key, int& value) {return _map.get(key, value);}
+    bool insert(const Key& key, int value) {return _map.insert(key, value);}
+    bool erase(const Key& key) {return _map.erase(key);}
+
+private:
+    ConcurrentMap<Key, int> _map;
+};
+
+//the Map, with every operation under one mutex.
+class Locked
+{
+public:
+    static const char* name() {return "Map<int,int> + mutex";}
+
+    bool get(int key, int& value)
+    {
+        lock_guard<mutex> guard(_lock);
+        Map<int, int>::Iterator it = _map.lower_bound(key);
+        if(it == _map.end() || it.key() != key)
+            return false;
+        value = *it;
+        return true;
+    }
+    bool insert(int key, int value)
+    {
+        lock_guard<mutex> guard(_lock);
+        return _map.insert(key, value);
+    }
+    bool erase(int key)
+    {
+        lock_guard<mutex> guard(_lock);
+        return _map.erase(key);
+    }
+
+private:
+    mutex _lock;
+    Map<int, int> _map;
+};
+
+//preconditions: none
+//postconditions: ops operations of mix are performed on container, with keys drawn from [0, 2n)
+// by a generator seeded with seed. the number of hits is returned.
+template <typename Container, typename Key>
+long long runThread(Container& container, const Mix& mix, const vector<Key>& keys, size_t ops, unsigned seed)
+{
+    mt19937 rng(seed);
+    uniform_int_distribution<int> pickKey(0, int(keys.size()) - 1);
+    uniform_int_distribution<int> pickOp(0, 99);
+    long long hits = 0;
+
+    for(size_t i = 0; i < ops; i++)
+    {
+        const Key& key = keys[pickKey(rng)];
+        int op = pickOp(rng);
+        int value = 0;
+        if(op < mix.getPercent)
+            hits += container.get(key, value) ? 1 + value : 0;
+        else if(op < mix.getPercent + mix.insertPercent)
+            hits += container.insert(key, op);
+        else
+            hits += container.erase(key);
+    }
+    return hits;
+}
+
+//preconditions: keys holds the keys for 0, 1, ... 2n-1.
+//postconditions: for each mix, and each thread count up to maxThreads, a Container is loaded
+// with the n even keys, then OPS_PER_RUN operations are split between the threads. one line is
+// printed per run.
+template <typename Container, typename Key>
+void runScaling(const vector<Key>& keys, const vector<Mix>& mixes, int maxThreads)
+{
+    for(size_t m = 0; m < mixes.size(); m++)
+    {
+        double single = 0;
+        for(int threads = 1; threads <= maxThreads; threads *= 2)
+        {
+            Container* container = new Container();
+            for(size_t k = 0; k < keys.size(); k += 2)
+                container->insert(keys[k], int(k));
+
+            vector<thread> workers;
+            vector<long long> hits(threads, 0);
+            Clock::time_point start = Clock::now();
+            for(int t = 0; t < threads; t++)
+                workers.push_back(thread([&, t]()
+                {
+                    hits[t] = runThread(*container, mixes[m], keys, OPS_PER_RUN / threads, 1000u + t);
+                }));
+            for(int t = 0; t < threads; t++)
+                workers[t].join();
+            double seconds = chrono::duration<double>(Clock::now() - start).count();
+
+            for(int t = 0; t < threads; t++)
+                checksum += hits[t];
+            delete container;
+
+            double mops = (OPS_PER_RUN / threads) * threads / seconds / 1e6;
+            if(threads == 1)
+                single = mops;
+            cout << setw(28) << Container::name() << setw(13) << mixes[m].name << setw(9) << threads
+                 << setw(10) << fixed << setprecision(2) << mops << setw(10) << mops / single << "x" << endl;
+        }
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    int n = (argc > 1) ? atoi(argv[1]) : 1000000;
+    int maxThreads = (argc > 2) ? atoi(argv[2]) : 64;
+
+    vector<Mix> mixes;
+    Mix readOnly = {"read only", 100, 0};
+    Mix readMostly = {"read mostly", 90, 5};
+    Mix balanced = {"balanced", 50, 25};
+    mixes.push_back(readOnly);
+    mixes.push_back(readMostly);
+    mixes.push_back(balanced);
+
+    vector<int> intKeys;
+    vector<string> stringKeys;
+    for(int k = 0; k < 2 * n; k++)
+    {
+        intKeys.push_back(makeKey<int>(k));
+        stringKeys.push_back(makeKey<string>(k));
+    }
+
+    cout << "keys: " << n << ", operations per run: " << OPS_PER_RUN
+         << ", hardware threads: " << thread::hardware_concurrency() << endl << endl;
+    cout << setw(28) << "container" << setw(13) << "mix" << setw(9) << "threads"
+         << setw(10) << "Mops/s" << setw(11) << "speedup" << endl;
+
+    runScaling<Concurrent<int> >(intKeys, mixes, maxThreads);
+    runScaling<Locked>(intKeys, mixes, maxThreads);
+    runScaling<Concurrent<string> >(stringKeys, mixes, maxThreads);
+
+    cout << "(checksum " << checksum << ")" << endl;
+    return 0;
+}
@@ -0,0 +1,188 @@
+#ifndef SERIALIZE_H
+#define SERIALIZE_H
+
+#include <iostream>
+#include <iterator>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+using namespace std;
+
+//Encoder<T> writes a T to a binary stream, and reads one back:
+//    static void write(ostream& outs, const T& item);
+//    static bool read(istream& ins, T& item);      //false if the stream ran out or failed
+// The encoders below cover the trivially copyable types (their bytes, as they are in memory), strings
+// and vectors (a 64 bit length, then the characters or the items). Other types specialize Encoder
+// next to their definition, (Pair in map.h, MPair in multimap.h). A T without an Encoder cannot be saved.
+// Lengths and trivially copyable items are written in the byte order of the machine, so a stream is
+// read back by a build for the same kind of machine.
+// A length read from a stream is not trusted: the characters or items are read ENCODER_CHUNK_BYTES at a
+// time, so a corrupt length makes read return false when the stream runs out, not allocate that length.
+template <typename T, typename Enable = void>
+struct Encoder;
+
+static const size_t ENCODER_CHUNK_BYTES = 1 << 16;
+
+template <typename T>
+struct Encoder<T, typename enable_if<is_trivially_copyable<T>::value>::type>
+{
+    static void write(ostream& outs, const T& item)
+    {
+        outs.write(reinterpret_cast<const char*>(&item), sizeof(T));
+    }
+
+    static bool read(istream& ins, T& item)
+    {
+        return bool(ins.read(reinterpret_cast<char*>(&item), sizeof(T)));
+    }
+};
+
+template <>
+struct Encoder<string>
+{
+    static void write(ostream& outs, const string& item)
+    {
+        Encoder<uint64_t>::write(outs, uint64_t(item.size()));
+        outs.write(item.data(), item.size());
+    }
+
+    static bool read(istream& ins, string& item)
+    {
+        uint64_t length = 0;
+        if(!Encoder<uint64_t>::read(ins, length))
+            return false;
+        item.clear();
+        while(length > 0)
+        {
+            size_t chunk = size_t(min(length, uint64_t(ENCODER_CHUNK_BYTES)));
+            size_t done = item.size();
+            item.resize(done + chunk);
+            if(!ins.read(&item[done], chunk))
+                return false;
+            length -= chunk;
+        }
+        return true;
+    }
+};
+
+//a vector of trivially copyable items is written (and read) as one block.
+template <typename U>
+struct Encoder<vector<U> >
+{
+    static void write(ostream& outs, const vector<U>& items)
+    {
+        Encoder<uint64_t>::write(outs, uint64_t(items.size()));
+        writeItems(outs, items, is_trivially_copyable<U>());
+    }
+
+    static bool read(istream& ins, vector<U>& items)
+    {
+        uint64_t count = 0;
+        if(!Encoder<uint64_t>::read(ins, count))
+            return false;
+        items.clear();
+        return readItems(ins, items, count, is_trivially_copyable<U>());
+    }
+
+private:
+    static void writeItems(ostream& outs, const vector<U>& items, true_type)
+    {
+        if(!items.empty())
+            outs.write(reinterpret_cast<const char*>(items.data()), items.size() * sizeof(U));
+    }
+
+    static void writeItems(ostream& outs, const vector<U>& items, false_type)
+    {
+        for(size_t i = 0; i < items.size(); i++)
+            Encoder<U>::write(outs, items[i]);
+    }
+
+    //blocks of up to ENCODER_CHUNK_BYTES, so the vector only grows as far as the stream holds items.
+    static bool readItems(istream& ins, vector<U>& items, uint64_t count, true_type)
+    {
+        const uint64_t perChunk = (ENCODER_CHUNK_BYTES / sizeof(U) > 0) ? ENCODER_CHUNK_BYTES / sizeof(U) : 1;
+        while(count > 0)
+        {
+            size_t chunk = size_t(min(count, perChunk));
+            size_t done = items.size();
+            items.resize(done + chunk);
+            if(!ins.read(reinterpret_cast<char*>(items.data() + done), chunk * sizeof(U)))
+                return false;
+            count -= chunk;
+        }
+        return true;
+    }
+
+    static bool readItems(istream& ins, vector<U>& items, uint64_t count, false_type)
+    {
+        bool ok = true;
+        for(uint64_t i = 0; i < count && ok; i++)
+        {
+            items.emplace_back();
+            ok = Encoder<U>::read(ins, items.back());
+        }
+        return ok;
+    }
+};
+
+//DecodeIterator reads count items from a stream with Encoder<T>, one at a time, as an input
+// iterator. Like a move_iterator, dereferencing it gives the item as an rvalue, so a bulk load
+// moves each item into its leaf. If the stream fails, the iteration ends early and ok is set to false.
+template <typename T>
+class DecodeIterator
+{
+public:
+    typedef input_iterator_tag iterator_category;
+    typedef T value_type;
+    typedef ptrdiff_t difference_type;
+    typedef T* pointer;
+    typedef T&& reference;
+
+    //the end of every decoded range.
+    DecodeIterator(): ins(nullptr), remaining(0), ok(nullptr), item() {}
+
+    //preconditions: *_ok is true
+    //postconditions: the first of count items is read from _ins.
+    DecodeIterator(istream& _ins, uint64_t count, bool& _ok): ins(&_ins), remaining(count), ok(&_ok), item()
+    {
+        readItem();
+    }
+
+    friend bool operator ==(const DecodeIterator& lhs, const DecodeIterator& rhs){return lhs.remaining == rhs.remaining;}
+    friend bool operator !=(const DecodeIterator& lhs, const DecodeIterator& rhs){return lhs.remaining != rhs.remaining;}
+
+    T&& operator *() {return std::move(item);}
+    T* operator ->() {return &item;}
+
+    //preconditions: this is not the end.
+    //postconditions: the next item is read.
+    DecodeIterator& operator ++()
+    {
+        remaining--;
+        readItem();
+        return *this;
+    }
+
+private:
+    istream* ins;
+    uint64_t remaining;                            //the items left, counting the current one
+    bool* ok;
+    T item;
+
+    //preconditions: none
+    //postconditions: if any items remain, item is read from the stream. when that fails,
+    // no items remain and *ok is false.
+    void readItem()
+    {
+        if(remaining > 0 && !Encoder<T>::read(*ins, item))
+        {
+            remaining = 0;
+            *ok = false;
+        }
+    }
+};
+
+#endif // SERIALIZE_H
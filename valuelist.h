@@ -0,0 +1,334 @@
+#ifndef VALUELIST_H
+#define VALUELIST_H
+#include <iostream>
+#include <vector>
+#include <utility>
+#include <iterator>
+#include <new>
+#include <cstddef>
+#include <cstdint>
+#include <cassert>
+#include <type_traits>
+#include "serialize.h"
+using namespace std;
+
+//the number of values a ValueList<V> holds inside itself: as many as fit in 16 bytes (at least one),
+// so a ValueList of small values is no bigger than a vector, and needs no heap block for a short list.
+template <typename V>
+struct DefaultInlineValues
+{
+    static const int value = (16 / sizeof(V) > 1) ? int(16 / sizeof(V)) : 1;
+};
+
+//ValueList is the value list of a key of an MMap: a vector of V whose first InlineCount values are
+// stored inside the list itself, in the same bytes that hold the pointer to its heap block once it
+// outgrows them. A key with a short list costs no heap block (and no allocation to insert it), and
+// moving a list (as the leaves of the tree do when they shift, split, merge and rotate) moves at most
+// InlineCount values, or just the pointer, never copying them.
+// Like a vector's, its iterators are pointers, which a push_back past the capacity invalidates.
+template <typename V, int InlineCount = DefaultInlineValues<V>::value>
+class ValueList
+{
+public:
+    typedef V value_type;
+    typedef size_t size_type;
+    typedef V& reference;
+    typedef const V& const_reference;
+    typedef V* iterator;
+    typedef const V* const_iterator;
+
+    ValueList(): count(0), capacityCount(InlineCount), heap(nullptr) {}
+    ValueList(const ValueList& other);
+    ValueList(ValueList&& other) noexcept;
+    ~ValueList() {release();}
+
+    ValueList& operator =(const ValueList& other);
+    ValueList& operator =(ValueList&& other) noexcept;
+
+    //  Capacity
+    size_t size() const {return count;}
+    bool empty() const {return count == 0;}
+    size_t capacity() const {return capacityCount;}
+    bool isInline() const {return capacityCount == InlineCount;}   //the values are inside the list, not on the heap
+    void reserve(size_t n);
+
+    //  Element Access
+    V* data() {return isInline() ? slots() : heap;}
+    const V* data() const {return isInline() ? slots() : heap;}
+    V& operator [](size_t i) {assert(i < count); return data()[i];}
+    const V& operator [](size_t i) const {assert(i < count); return data()[i];}
+    V& front() {assert(count > 0); return data()[0];}
+    const V& front() const {assert(count > 0); return data()[0];}
+    V& back() {assert(count > 0); return data()[count - 1];}
+    const V& back() const {assert(count > 0); return data()[count - 1];}
+
+    iterator begin() {return data();}
+    iterator end() {return data() + count;}
+    const_iterator begin() const {return data();}
+    const_iterator end() const {return data() + count;}
+
+    //  Modifiers
+    void push_back(const V& value) {emplace_back(value);}
+    void push_back(V&& value) {emplace_back(std::move(value));}
+    template <typename... Args>
+    V& emplace_back(Args&&... args);
+    void pop_back();
+    void clear();
+
+    //replace the values with [first, last).
+    template <typename InputIt>
+    void assign(InputIt first, InputIt last);
+
+    friend bool operator ==(const ValueList& lhs, const ValueList& rhs) {return equal(lhs, rhs);}
+    friend bool operator !=(const ValueList& lhs, const ValueList& rhs) {return !equal(lhs, rhs);}
+    friend bool operator ==(const ValueList& lhs, const vector<V>& rhs) {return equal(lhs, rhs);}
+    friend bool operator !=(const ValueList& lhs, const vector<V>& rhs) {return !equal(lhs, rhs);}
+    friend bool operator ==(const vector<V>& lhs, const ValueList& rhs) {return equal(rhs, lhs);}
+    friend bool operator !=(const vector<V>& lhs, const ValueList& rhs) {return !equal(rhs, lhs);}
+
+    friend ValueList& operator +=(ValueList& list, const V& addme)  //list.push_back
+    {
+        list.push_back(addme);
+        return list;
+    }
+
+    friend ostream& operator <<(ostream& outs, const ValueList& list)
+    {
+        outs << "[";
+        for(size_t i = 0; i < list.count; i++)
+            outs << (i ? ", " : "") << list[i];
+        outs << "]";
+        return outs;
+    }
+
+private:
+    typedef typename aligned_storage<sizeof(V), alignof(V)>::type Slot;
+
+    uint32_t count;
+    uint32_t capacityCount;                        //InlineCount while the values are in slots, the heap block's after
+    union
+    {
+        Slot inlineSlots[InlineCount];
+        V* heap;
+    };
+
+    V* slots() {return reinterpret_cast<V*>(inlineSlots);}
+    const V* slots() const {return reinterpret_cast<const V*>(inlineSlots);}
+
+    void release();                                //destroy the values and free the heap block
+    void moveFrom(ValueList& other);               //take the values of other, leaving it empty
+    void reallocate(size_t n, V* block = nullptr); //move the values to a heap block of n values
+
+    template <typename List>
+    static bool equal(const ValueList& lhs, const List& rhs);
+};
+
+//preconditions: none
+//postconditions: the list holds copies of the values of other, inline if they fit.
+template <typename V, int InlineCount>
+ValueList<V, InlineCount>::ValueList(const ValueList& other): count(0), capacityCount(InlineCount), heap(nullptr)
+{
+    reserve(other.count);
+    for(size_t i = 0; i < other.count; i++)
+        ::new(static_cast<void*>(data() + i)) V(other[i]);
+    count = other.count;
+}
+
+//preconditions: none
+//postconditions: the list holds the values of other (its heap block, or its inline values moved), and other is empty.
+template <typename V, int InlineCount>
+ValueList<V, InlineCount>::ValueList(ValueList&& other) noexcept: count(0), capacityCount(InlineCount), heap(nullptr)
+{
+    moveFrom(other);
+}
+
+template <typename V, int InlineCount>
+ValueList<V, InlineCount>& ValueList<V, InlineCount>::operator =(const ValueList& other)
+{
+    if(this != &other)
+        assign(other.begin(), other.end());
+    return *this;
+}
+
+template <typename V, int InlineCount>
+ValueList<V, InlineCount>& ValueList<V, InlineCount>::operator =(ValueList&& other) noexcept
+{
+    if(this != &other)
+    {
+        release();
+        moveFrom(other);
+    }
+    return *this;
+}
+
+//preconditions: none
+//postconditions: the capacity is at least n, (the values are moved to a heap block if n is more than fit inline).
+template <typename V, int InlineCount>
+void ValueList<V, InlineCount>::reserve(size_t n)
+{
+    if(n > capacityCount)
+        reallocate(n);
+}
+
+//preconditions: none
+//postconditions: a value made from args is appended, (the values move to a heap block of twice the
+// capacity if the list is full). returns the new value.
+template <typename V, int InlineCount>
+template <typename... Args>
+V& ValueList<V, InlineCount>::emplace_back(Args&&... args)
+{
+    if(count < capacityCount)
+        ::new(static_cast<void*>(data() + count)) V(std::forward<Args>(args)...);
+    else
+    {
+        //the new value is made in the new block before the old values move, since args may refer to one of them.
+        size_t n = 2 * size_t(capacityCount);
+        V* block = static_cast<V*>(::operator new(n * sizeof(V)));
+        ::new(static_cast<void*>(block + count)) V(std::forward<Args>(args)...);
+        reallocate(n, block);
+    }
+    count++;
+    return back();
+}
+
+//preconditions: the list is not empty.
+//postconditions: the last value is destroyed.
+template <typename V, int InlineCount>
+void ValueList<V, InlineCount>::pop_back()
+{
+    assert(count > 0);
+    count--;
+    data()[count].~V();
+}
+
+//preconditions: none
+//postconditions: the values are destroyed, the capacity is kept.
+template <typename V, int InlineCount>
+void ValueList<V, InlineCount>::clear()
+{
+    V* values = data();
+    for(size_t i = 0; i < count; i++)
+        values[i].~V();
+    count = 0;
+}
+
+template <typename V, int InlineCount>
+template <typename InputIt>
+void ValueList<V, InlineCount>::assign(InputIt first, InputIt last)
+{
+    clear();
+    for(; first != last; ++first)
+        emplace_back(*first);
+}
+
+//preconditions: none
+//postconditions: the values are destroyed, the heap block (if any) is freed, and the list is empty and inline.
+template <typename V, int InlineCount>
+void ValueList<V, InlineCount>::release()
+{
+    clear();
+    if(!isInline())
+        ::operator delete(heap);
+    capacityCount = InlineCount;
+}
+
+//preconditions: this list is empty and inline.
+//postconditions: a heap block of other is taken over, or its inline values are moved into this list's slots.
+// other is left empty and inline.
+template <typename V, int InlineCount>
+void ValueList<V, InlineCount>::moveFrom(ValueList& other)
+{
+    assert(count == 0 && isInline());
+    if(other.isInline())
+    {
+        for(size_t i = 0; i < other.count; i++)
+        {
+            ::new(static_cast<void*>(slots() + i)) V(std::move(other.slots()[i]));
+            other.slots()[i].~V();
+        }
+    }
+    else
+    {
+        heap = other.heap;
+        capacityCount = other.capacityCount;
+        other.capacityCount = InlineCount;
+    }
+    count = other.count;
+    other.count = 0;
+}
+
+//preconditions: n > capacity(), n fits in 32 bits. block is nullptr, or a heap block of n values
+// (whose slot count may already hold the value being appended).
+//postconditions: the values are moved to block (a new heap block of n values, if nullptr),
+// and the old heap block is freed.
+template <typename V, int InlineCount>
+void ValueList<V, InlineCount>::reallocate(size_t n, V* block)
+{
+    assert(n > capacityCount && n <= UINT32_MAX);
+    if(!block)
+        block = static_cast<V*>(::operator new(n * sizeof(V)));
+
+    V* values = data();
+    for(size_t i = 0; i < count; i++)
+    {
+        ::new(static_cast<void*>(block + i)) V(std::move(values[i]));
+        values[i].~V();
+    }
+    if(!isInline())
+        ::operator delete(heap);
+    heap = block;
+    capacityCount = uint32_t(n);
+}
+
+template <typename V, int InlineCount>
+template <typename List>
+bool ValueList<V, InlineCount>::equal(const ValueList& lhs, const List& rhs)
+{
+    if(lhs.size() != rhs.size())
+        return false;
+    for(size_t i = 0; i < lhs.size(); i++)
+        if(!(lhs[i] == rhs[i]))
+            return false;
+    return true;
+}
+
+//a ValueList is saved like a vector (its length, then its values), so the two are read back interchangeably.
+template <typename V, int InlineCount>
+struct Encoder<ValueList<V, InlineCount> >
+{
+    static void write(ostream& outs, const ValueList<V, InlineCount>& items)
+    {
+        Encoder<uint64_t>::write(outs, uint64_t(items.size()));
+        writeItems(outs, items, is_trivially_copyable<V>());
+    }
+
+    static bool read(istream& ins, ValueList<V, InlineCount>& items)
+    {
+        uint64_t count = 0;
+        if(!Encoder<uint64_t>::read(ins, count) || count > UINT32_MAX)
+            return false;
+        items.clear();
+        bool ok = true;
+        for(uint64_t i = 0; i < count && ok; i++)
+        {
+            V& item = items.emplace_back();
+            ok = Encoder<V>::read(ins, item);
+        }
+        return ok;
+    }
+
+private:
+    static void writeItems(ostream& outs, const ValueList<V, InlineCount>& items, true_type)
+    {
+        if(!items.empty())
+            outs.write(reinterpret_cast<const char*>(items.data()), items.size() * sizeof(V));
+    }
+
+    static void writeItems(ostream& outs, const ValueList<V, InlineCount>& items, false_type)
+    {
+        for(size_t i = 0; i < items.size(); i++)
+            Encoder<V>::write(outs, items[i]);
+    }
+};
+
+#endif // VALUELIST_H
@@ -0,0 +1,160 @@
+#ifndef VERSIONLOCK_H
+#define VERSIONLOCK_H
+#include <atomic>
+#include <thread>
+#include <cstdint>
+using namespace std;
+
+//VersionLock guards one node of a ConcurrentBPlusTree.
+// The version word counts the changes made to the node: LOCKED is set while a writer
+// holds the node, and OBSOLETE once the node has been unlinked from the tree.
+// An optimistic reader takes no lock at all: it notes the version with readVersion(),
+// reads the node, and then checks with validate() that the version did not move.
+// A reader that must not look at a node while it changes (its items are not trivially
+// copyable) holds it shared instead, and a writer waits for the shared readers to leave.
+class VersionLock
+{
+public:
+    VersionLock(): version(0), readers(0) {}
+
+    bool readVersion(uint64_t& seen) const;    //note the version, false if the node is locked or obsolete
+    bool validate(uint64_t seen) const;        //true if nothing changed since readVersion gave seen
+    bool tryUpgrade(uint64_t seen);            //lock exclusively, if the version is still seen
+
+    void lock();                               //lock exclusively
+    void unlock();                             //unlock, moving the version on
+    void unlockUnchanged();                    //unlock a node that was not modified, keeping its version
+    void unlockObsolete();                     //unlock a node that was unlinked from the tree
+
+    void lockShared();                         //lock against writers only
+    void unlockShared();
+
+    //waits for a lock to be released: spins for a while, then gives up the cpu.
+    static void backoff(int& spins)
+    {
+        if(++spins > SPINS_BEFORE_YIELD)
+            this_thread::yield();
+    }
+
+private:
+    static const uint64_t OBSOLETE = 1;
+    static const uint64_t LOCKED = 2;
+    static const int SPINS_BEFORE_YIELD = 32;
+
+    atomic<uint64_t> version;
+    atomic<int> readers;
+
+    void waitForReaders() const;
+
+    //a lock belongs to its node, it cannot be copied.
+    VersionLock(const VersionLock&);
+    VersionLock& operator =(const VersionLock&);
+};
+
+//preconditions: none
+//postconditions: seen is set to the current version. returns false
+// (and the reader should restart) if a writer holds the node, or it is obsolete.
+inline bool VersionLock::readVersion(uint64_t& seen) const
+{
+    seen = version.load(memory_order_acquire);
+    return (seen & (LOCKED | OBSOLETE)) == 0;
+}
+
+//preconditions: seen came from readVersion
+//postconditions: returns true if no writer has locked the node since seen was read,
+// so everything read from it in between is consistent.
+inline bool VersionLock::validate(uint64_t seen) const
+{
+    //the reads of the node must not move past the second look at the version.
+    atomic_thread_fence(memory_order_acquire);
+    return version.load(memory_order_relaxed) == seen;
+}
+
+//preconditions: seen came from readVersion
+//postconditions: if the version is still seen, the node is locked exclusively
+// and true is returned, otherwise false is returned and nothing is locked.
+inline bool VersionLock::tryUpgrade(uint64_t seen)
+{
+    if(!version.compare_exchange_strong(seen, seen + LOCKED))
+        return false;
+
+    atomic_thread_fence(memory_order_release);
+    waitForReaders();
+    return true;
+}
+
+//preconditions: the node is not obsolete, and this thread does not hold it.
+//postconditions: the node is locked exclusively, and no shared reader holds it.
+inline void VersionLock::lock()
+{
+    int spins = 0;
+    for(;;)
+    {
+        uint64_t seen = version.load(memory_order_relaxed);
+        if(!(seen & LOCKED) && version.compare_exchange_weak(seen, seen + LOCKED))
+            break;
+        backoff(spins);
+    }
+
+    //the writes to the node must not be seen before LOCKED is.
+    atomic_thread_fence(memory_order_release);
+    waitForReaders();
+}
+
+//preconditions: this thread holds the node exclusively.
+//postconditions: LOCKED is cleared, and the version moves on (the add carries into the count).
+inline void VersionLock::unlock()
+{
+    version.fetch_add(LOCKED, memory_order_release);
+}
+
+//preconditions: this thread holds the node exclusively, and has not modified it.
+//postconditions: the version is what it was before lock(), so optimistic readers
+// that read the node before it was locked do not need to restart.
+inline void VersionLock::unlockUnchanged()
+{
+    version.fetch_sub(LOCKED, memory_order_release);
+}
+
+//preconditions: this thread holds the node exclusively, and has unlinked it from the tree.
+//postconditions: the node is unlocked and marked OBSOLETE, so every reader that finds it restarts.
+inline void VersionLock::unlockObsolete()
+{
+    version.fetch_add(LOCKED + OBSOLETE, memory_order_release);
+}
+
+//preconditions: this thread does not hold the node.
+//postconditions: the node is counted in readers, and no writer holds it.
+// a waiting writer goes first: a reader that finds LOCKED set steps back until it is cleared.
+inline void VersionLock::lockShared()
+{
+    int spins = 0;
+    for(;;)
+    {
+        readers.fetch_add(1);
+        if(!(version.load() & LOCKED))
+            break;
+
+        readers.fetch_sub(1);
+        while(version.load(memory_order_relaxed) & LOCKED)
+            backoff(spins);
+    }
+}
+
+//preconditions: this thread holds the node shared.
+//postconditions: this reader is no longer counted.
+inline void VersionLock::unlockShared()
+{
+    readers.fetch_sub(1, memory_order_release);
+}
+
+//preconditions: LOCKED is set by this thread.
+//postconditions: returns once every shared reader has left.
+inline void VersionLock::waitForReaders() const
+{
+    int spins = 0;
+    while(readers.load() != 0)
+        backoff(spins);
+}
+
+#endif // VERSIONLOCK_H
@@ -0,0 +1,367 @@
+#ifndef WAL_H
+#define WAL_H
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cerrno>
+#include <cassert>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "serialize.h"
+using namespace std;
+
+//WriteAheadLog makes the changes to an in-memory container durable. Every change is appended to a
+// log file as a record before it is applied, and the file is synced in groups: each sync
+// (fdatasync) commits every record appended since the last one, so the cost of a sync is shared by
+// the whole group. A crash loses at most the records appended after the last commit.
+// The container is checkpointed by saving all of it to a checkpoint file, which lets the log start
+// over empty. Opening replays the checkpoint, then the records of the log written after it.
+//    <path>.checkpoint: CHECKPOINT_MAGIC, the generation, then whatever the container saved.
+//    <path>.log:        LOG_MAGIC, the generation of the checkpoint it follows, then the records:
+//                       the length of op + payload, their checksum (FNV-1a), op, payload.
+// Each checkpoint has the next generation. A log whose generation is not the checkpoint's was
+// written before that checkpoint (a crash came between the two renames of checkpoint()), and is dropped.
+// A record cut short, or with a bad checksum, ends the log: it is where a crash stopped a write,
+// so the log is truncated there. The record payloads are written and read with Encoder.
+// Not thread safe: the container it logs for is used by one thread at a time.
+class WriteAheadLog
+{
+public:
+    //syncEvery: the number of records in a group, synced together (1 syncs every change before it
+    // returns, 0 syncs only on commit, checkpoint and close).
+    explicit WriteAheadLog(size_t syncEvery = 1);
+    ~WriteAheadLog();                              //commit and close
+
+    //open (or create) the log at path, recovering what it holds:
+    //    load(istream&) -> bool reads the checkpoint (called only if there is one),
+    //    apply(uint8_t op, istream& payload) -> bool applies one record.
+    // returns false if a file cannot be read or written, or load or apply fail.
+    template <typename Load, typename Apply>
+    bool open(const string& path, Load load, Apply apply);
+    void close();                                  //commit, and close the log file
+    bool isOpen() const {return fd >= 0;}
+
+    //append a record of op, whose payload writePayload(ostream&) writes. the group is committed
+    // when it holds syncEvery records. returns false, and drops the record, if it could not be
+    // written or committed. (the rest of the group stays pending, for the next commit.)
+    template <typename WritePayload>
+    bool append(uint8_t op, WritePayload writePayload);
+
+    bool commit();                                 //write the records appended so far and sync them, false if that fails
+
+    //save(ostream&) -> bool writes the whole container to a new checkpoint, then the log starts
+    // over empty. returns false if the checkpoint (or new log) could not be written.
+    template <typename Save>
+    bool checkpoint(Save save);
+
+    size_t pendingRecords() const {return pending;}   //records appended since the last commit
+    size_t logBytes() const {return logSize + buffer.size();}   //the length of the log, with the records not written yet
+    size_t commits() const {return syncs;}          //the number of syncs of the log so far
+
+private:
+    static const uint32_t CHECKPOINT_MAGIC = 0x4b504357;    //"WCPK"
+    static const uint32_t LOG_MAGIC = 0x474f4c57;           //"WLOG"
+    static const size_t HEADER_BYTES = 12;                  //magic and generation
+    static const size_t BUFFER_BYTES = 1 << 20;             //records are written (not synced) past this
+
+    size_t syncEvery;
+    string path;
+    int fd;                                        //the log file, -1 when closed
+    uint64_t generation;
+    string buffer;                                 //records appended but not written yet
+    size_t pending;
+    size_t logSize;                                //the bytes of the log file
+    size_t syncs;
+    ostringstream payload;                         //reused for the payload of each record
+
+    static uint32_t checksum(const char* bytes, size_t length);
+    static bool syncFile(const string& name);      //fsync the file (or directory) name
+    static string directoryOf(const string& name);
+    bool writeBuffer();                            //write buffer to the log file, without syncing
+    void discardFrom(size_t offset);               //drop the last record appended, which starts at offset
+    bool truncateLog(size_t length);               //cut the log file to length bytes
+    bool startLog();                               //replace the log with an empty one of this generation
+    template <typename Apply>
+    bool replay(Apply apply);                      //apply the records of the log, truncating it after the last whole one
+
+    WriteAheadLog(const WriteAheadLog&);
+    WriteAheadLog& operator =(const WriteAheadLog&);
+};
+
+inline WriteAheadLog::WriteAheadLog(size_t _syncEvery):
+    syncEvery(_syncEvery), fd(-1), generation(0), pending(0), logSize(0), syncs(0)
+{
+}
+
+inline WriteAheadLog::~WriteAheadLog()
+{
+    close();
+}
+
+//preconditions: the log is not open.
+//postconditions: if <path>.checkpoint exists, its generation is read and load is called on the rest
+// of it. then if <path>.log exists and follows that checkpoint, apply is called on each whole record,
+// and the log is left open for appending after the last one. otherwise a new, empty log is started.
+template <typename Load, typename Apply>
+bool WriteAheadLog::open(const string& _path, Load load, Apply apply)
+{
+    assert(!isOpen());
+    path = _path;
+    generation = 0;
+
+    ifstream checkpointFile((path + ".checkpoint").c_str(), ios::binary);
+    if(checkpointFile)
+    {
+        uint32_t magic = 0;
+        if(!Encoder<uint32_t>::read(checkpointFile, magic) || magic != CHECKPOINT_MAGIC
+           || !Encoder<uint64_t>::read(checkpointFile, generation) || !load(checkpointFile))
+            return false;
+    }
+
+    ifstream logFile((path + ".log").c_str(), ios::binary);
+    uint32_t magic = 0;
+    uint64_t logGeneration = 0;
+    bool follows = logFile && Encoder<uint32_t>::read(logFile, magic) && magic == LOG_MAGIC
+                && Encoder<uint64_t>::read(logFile, logGeneration) && logGeneration == generation;
+    logFile.close();
+
+    if(!follows)
+        return startLog();
+
+    fd = ::open((path + ".log").c_str(), O_WRONLY | O_APPEND);
+    return fd >= 0 && replay(apply);
+}
+
+//preconditions: the log file is open, and follows the checkpoint.
+//postconditions: apply is called on the op and payload of each record, in order, until the end of the
+// file or the first record that is cut short or fails its checksum. the file is truncated after the
+// last whole record. returns false if apply fails.
+template <typename Apply>
+bool WriteAheadLog::replay(Apply apply)
+{
+    ifstream logFile((path + ".log").c_str(), ios::binary | ios::ate);
+    size_t fileSize = size_t(logFile.tellg());
+    logFile.seekg(HEADER_BYTES);
+    size_t valid = HEADER_BYTES;
+    string record;
+
+    for(;;)
+    {
+        uint32_t length = 0, sum = 0;
+        if(!Encoder<uint32_t>::read(logFile, length) || !Encoder<uint32_t>::read(logFile, sum)
+           || length == 0 || length > fileSize - valid - 8)
+            break;
+        record.resize(length);
+        if(!logFile.read(&record[0], length) || checksum(record.data(), length) != sum)
+            break;
+
+        istringstream recordPayload(record.substr(1));
+        if(!apply(uint8_t(record[0]), recordPayload))
+            return false;
+        valid += 8 + length;
+    }
+
+    logSize = valid;
+    return ftruncate(fd, off_t(valid)) == 0;
+}
+
+//preconditions: none
+//postconditions: the records appended are committed, and the log file is closed.
+inline void WriteAheadLog::close()
+{
+    if(!isOpen())
+        return;
+    commit();
+    ::close(fd);
+    fd = -1;
+}
+
+//preconditions: the log is open, writePayload(ostream&) writes the payload of the record.
+//postconditions: the record (length, checksum, op, payload) is added to the group, and written
+// once the buffer is large. the group is committed once it holds syncEvery records. if that write
+// or commit fails, the record is taken out of the buffer (or the file) again and false is returned.
+template <typename WritePayload>
+bool WriteAheadLog::append(uint8_t op, WritePayload writePayload)
+{
+    assert(isOpen());
+    size_t start = logBytes();
+    payload.str("");
+    payload.put(char(op));
+    writePayload(payload);
+    const string& record = payload.str();
+
+    uint32_t length = uint32_t(record.size());
+    uint32_t sum = checksum(record.data(), record.size());
+    buffer.append(reinterpret_cast<const char*>(&length), sizeof(length));
+    buffer.append(reinterpret_cast<const char*>(&sum), sizeof(sum));
+    buffer.append(record);
+    pending++;
+
+    bool ok = true;
+    if(syncEvery > 0 && pending >= syncEvery)
+        ok = commit();
+    else if(buffer.size() >= BUFFER_BYTES)
+        ok = writeBuffer();
+    if(!ok)
+        discardFrom(start);
+    return ok;
+}
+
+//preconditions: none
+//postconditions: the buffered records are written to the log file, and the file is synced
+// (unless nothing was appended since the last commit). returns false if either fails, and the
+// records stay pending, so the next commit tries again.
+inline bool WriteAheadLog::commit()
+{
+    if(!isOpen() || (pending == 0 && buffer.empty()))
+        return true;
+
+    if(!writeBuffer() || fdatasync(fd) != 0)
+        return false;
+    pending = 0;
+    syncs++;
+    return true;
+}
+
+//preconditions: the log is open.
+//postconditions: the buffer is written to the end of the log file, and emptied. if the write fails,
+// the part of the buffer written is cut off the file again, and the buffer is kept.
+inline bool WriteAheadLog::writeBuffer()
+{
+    size_t written = 0;
+    while(written < buffer.size())
+    {
+        ssize_t n = ::write(fd, buffer.data() + written, buffer.size() - written);
+        if(n < 0 && errno == EINTR)
+            continue;
+        if(n <= 0)
+        {
+            if(written > 0)
+                truncateLog(logSize);
+            return false;
+        }
+        written += size_t(n);
+    }
+    logSize += buffer.size();
+    buffer.clear();
+    return true;
+}
+
+//preconditions: the last record appended starts at offset (of the log, with the buffer after it).
+//postconditions: the record is taken out of the buffer, or cut off the log file if it was written.
+inline void WriteAheadLog::discardFrom(size_t offset)
+{
+    if(offset >= logSize)
+        buffer.resize(offset - logSize);
+    else if(truncateLog(offset))
+        buffer.clear();
+    pending--;
+}
+
+//preconditions: the log is open, length <= the length of the log file.
+//postconditions: the log file is cut to length bytes. returns false if it cannot be, (then the
+// bytes after the last whole record are dropped on open instead, as a write cut short by a crash is).
+inline bool WriteAheadLog::truncateLog(size_t length)
+{
+    if(ftruncate(fd, off_t(length)) != 0)
+        return false;
+    logSize = length;
+    return true;
+}
+
+//preconditions: the log is open, save(ostream&) writes the whole container.
+//postconditions: the records appended are committed, then a checkpoint of the next generation is
+// written beside the old one, synced and renamed over it. then a new, empty log of that generation
+// replaces the old log the same way. a crash at any point leaves either the old checkpoint and its
+// log, or the new checkpoint (with the old log, which is dropped on open, or the new one).
+template <typename Save>
+bool WriteAheadLog::checkpoint(Save save)
+{
+    assert(isOpen());
+    if(!commit())
+        return false;
+
+    string name = path + ".checkpoint";
+    string temporary = name + ".tmp";
+    {
+        ofstream checkpointFile(temporary.c_str(), ios::binary | ios::trunc);
+        Encoder<uint32_t>::write(checkpointFile, uint32_t(CHECKPOINT_MAGIC));
+        Encoder<uint64_t>::write(checkpointFile, generation + 1);
+        if(!save(checkpointFile) || !checkpointFile.flush())
+            return false;
+    }
+    if(!syncFile(temporary) || rename(temporary.c_str(), name.c_str()) != 0 || !syncFile(directoryOf(name)))
+        return false;
+
+    generation++;
+    ::close(fd);
+    fd = -1;
+    return startLog();
+}
+
+//preconditions: the log file is closed.
+//postconditions: an empty log of this generation is written beside the log, synced, renamed over it,
+// and opened for appending.
+inline bool WriteAheadLog::startLog()
+{
+    string name = path + ".log";
+    string temporary = name + ".tmp";
+    {
+        ofstream logFile(temporary.c_str(), ios::binary | ios::trunc);
+        Encoder<uint32_t>::write(logFile, uint32_t(LOG_MAGIC));
+        Encoder<uint64_t>::write(logFile, generation);
+        if(!logFile.flush())
+            return false;
+    }
+    if(!syncFile(temporary) || rename(temporary.c_str(), name.c_str()) != 0 || !syncFile(directoryOf(name)))
+        return false;
+
+    buffer.clear();
+    pending = 0;
+    logSize = HEADER_BYTES;
+    fd = ::open(name.c_str(), O_WRONLY | O_APPEND);
+    return fd >= 0;
+}
+
+//preconditions: none
+//postconditions: the 32 bit FNV-1a hash of the bytes.
+inline uint32_t WriteAheadLog::checksum(const char* bytes, size_t length)
+{
+    uint32_t hash = 2166136261u;
+    for(size_t i = 0; i < length; i++)
+    {
+        hash ^= uint8_t(bytes[i]);
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+//preconditions: none
+//postconditions: the file (or directory) name is synced to the disk. returns false if it cannot be.
+inline bool WriteAheadLog::syncFile(const string& name)
+{
+    int file = ::open(name.c_str(), O_RDONLY);
+    if(file < 0)
+        return false;
+    bool ok = fsync(file) == 0;
+    ::close(file);
+    return ok;
+}
+
+//preconditions: none
+//postconditions: the directory that holds the file name, "." if name has none.
+inline string WriteAheadLog::directoryOf(const string& name)
+{
+    size_t slash = name.rfind('/');
+    if(slash == string::npos)
+        return ".";
+    return slash == 0 ? "/" : name.substr(0, slash);
+}
+
+#endif // WAL_H
@@ -0,0 +1,477 @@
+/*************************************************************************************************************************
+ * B+Tree workload benchmark
+ * ***********************************************************************************************************************
+ * Runs the same workloads on each container and on its standard library counterpart:
+ *    BPlusTree<int>      vs  std::set<int>
+ *    Map<string, int>    vs  std::map<string, int>
+ *    MMap<int, int>      vs  std::multimap<int, int>
+ * for every key count given on the command line (default: 1000 10000 100000 1000000), e.g.
+ *    bplustree_workloads 1000 1000000 100000000
+ *
+ * The n keys of a run are the even numbers 0, 2, ... 2(n-1) (as zero padded strings for Map), so that the odd
+ * numbers can be used as misses. The workloads are:
+ *    insert seq:     inserting the keys in ascending order, one at a time.
+ *    insert rand:    inserting the keys in shuffled order.
+ *    insert zipf:    inserting n keys drawn from a Zipfian distribution (theta 0.99) over the keys.
+ *    load sorted:    building the container from the sorted keys in one call (bulkLoad / the range constructor).
+ *    find hit:       looking up every key, in shuffled order.
+ *    find miss:      looking up n keys that are not there.
+ *    scan 100:       visiting the 100 items from lower_bound(key), for random keys.
+ *    mixed:          n operations on random keys: 80% find, 10% insert of a new key, 10% erase.
+ *    erase:          erasing every key, in shuffled order.
+ * The lookups, scans and the mixed and erase workloads run on the container built by insert rand.
+ * (For MMap and std::multimap every key has one value per insert, so insert zipf grows value lists.)
+ *
+ * For each workload, the throughput (million operations per second) is reported, with the 50th and 99th
+ * percentile latency per operation. Latencies are measured over chunks of CHUNK operations (the chunk time
+ * divided by CHUNK), to keep the clock out of the throughput, so the percentiles are of chunk averages.
+ * Bytes per key is the heap in use after insert rand (counted by the global operator new), divided by n.
+ * All random numbers come from generators with fixed seeds, so each run performs the same operations.
+ ************************************************************************************************************************/
+#include "bplustree.h"
+#include "map.h"
+#include "multimap.h"
+#include <set>
+#include <map>
+#include <string>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <iomanip>
+#include <new>
+#include <random>
+#include <vector>
+using namespace std;
+
+typedef chrono::steady_clock Clock;
+
+//----------------------------------------------------------------------------------------------------
+// heap accounting: every allocation is prefixed with its size, so live bytes can be tracked.
+//----------------------------------------------------------------------------------------------------
+static size_t liveBytes = 0;
+static const size_t HEADER = 16;                    //keeps the returned block 16 byte aligned
+
+//kept out of line, so the compiler does not take the header arithmetic for an out of bounds access.
+#if defined(__GNUC__)
+#define NOINLINE __attribute__((noinline))
+#else
+#define NOINLINE
+#endif
+
+NOINLINE void* operator new(size_t size)
+{
+    char* block = static_cast<char*>(malloc(size + HEADER));
+    if(!block)
+        throw bad_alloc();
+    *reinterpret_cast<size_t*>(block) = size;
+    liveBytes += size;
+    return block + HEADER;
+}
+
+NOINLINE void operator delete(void* p) noexcept
+{
+    if(p)
+    {
+        char* block = static_cast<char*>(p) - HEADER;
+        liveBytes -= *reinterpret_cast<size_t*>(block);
+        free(block);
+    }
+}
+
+void* operator new[](size_t size) {return operator new(size);}
+void operator delete[](void* p) noexcept {operator delete(p);}
+void operator delete(void* p, size_t) noexcept {operator delete(p);}
+void operator delete[](void* p, size_t) noexcept {operator delete(p);}
+
+//----------------------------------------------------------------------------------------------------
+// keys
+//----------------------------------------------------------------------------------------------------
+
+//makeKey<Key>(i) is the key numbered i. string keys are zero padded, so that they sort like the numbers.
+template <typename Key> Key makeKey(long long i);
+template <> int makeKey<int>(long long i) {return int(i);}
+template <> string makeKey<string>(long long i)
+{
+    char buffer[32];
+    snprintf(buffer, sizeof(buffer), "user:%012lld", i);
+    return buffer;
+}
+
+//draws ranks in [0, n) with P(rank r) proportional to 1 / (r+1)^theta,
+// by the method of Gray et al. (as in YCSB). rank 0 is the most popular.
+class Zipfian
+{
+public:
+    Zipfian(size_t n, double theta, unsigned seed): n(n), theta(theta), generator(seed), uniform(0.0, 1.0)
+    {
+        zetaN = 0;
+        for(size_t i = 1; i <= n; i++)
+            zetaN += 1.0 / pow(double(i), theta);
+        double zeta2 = 1.0 + 1.0 / pow(2.0, theta);
+        alpha = 1.0 / (1.0 - theta);
+        eta = (1.0 - pow(2.0 / n, 1.0 - theta)) / (1.0 - zeta2 / zetaN);
+    }
+
+    size_t next()
+    {
+        double u = uniform(generator);
+        double uz = u * zetaN;
+        if(uz < 1.0)
+            return 0;
+        if(uz < 1.0 + pow(0.5, theta))
+            return (n > 1) ? 1 : 0;
+        size_t rank = size_t(n * pow(eta * u - eta + 1.0, alpha));
+        return (rank < n) ? rank : n - 1;
+    }
+
+private:
+    size_t n;
+    double theta, zetaN, alpha, eta;
+    mt19937_64 generator;
+    uniform_real_distribution<double> uniform;
+};
+
+//the keys and operation orders of one run, shared by all the containers of a key type.
+template <typename Key>
+struct Workload
+{
+    vector<Key> sorted;                              //the n keys, in order
+    vector<Key> shuffled;                            //the n keys, shuffled
+    vector<Key> probes;                              //the n keys, in another shuffled order
+    vector<Key> misses;                              //n keys that are not in the container
+    vector<Key> zipf;                                //n keys drawn from a Zipfian distribution
+    vector<Key> scanStarts;                          //where each range scan starts
+    vector<char> mixedOps;                           //'f'ind, 'i'nsert or 'e'rase
+    vector<Key> mixedKeys;                           //the key of each mixed operation
+
+    explicit Workload(size_t n)
+    {
+        mt19937_64 generator(42);
+        for(size_t i = 0; i < n; i++)
+        {
+            sorted.push_back(makeKey<Key>(2 * (long long)i));
+            misses.push_back(makeKey<Key>(2 * (long long)i + 1));
+        }
+        shuffled = sorted;
+        shuffle(shuffled.begin(), shuffled.end(), generator);
+        probes = sorted;
+        shuffle(probes.begin(), probes.end(), generator);
+        shuffle(misses.begin(), misses.end(), generator);
+
+        //the popular ranks are spread over the key space by the shuffled order.
+        Zipfian zipfian(n, 0.99, 7);
+        for(size_t i = 0; i < n; i++)
+            zipf.push_back(shuffled[zipfian.next()]);
+
+        size_t scans = min(n, size_t(100000));
+        for(size_t i = 0; i < scans; i++)
+            scanStarts.push_back(sorted[generator() % n]);
+
+        for(size_t i = 0; i < n; i++)
+        {
+            int dice = int(generator() % 10);
+            mixedOps.push_back(dice == 0 ? 'i' : (dice == 1 ? 'e' : 'f'));
+            mixedKeys.push_back(dice == 0 ? misses[generator() % n] : sorted[generator() % n]);
+        }
+    }
+};
+
+//----------------------------------------------------------------------------------------------------
+// containers: each adapter gives the workloads the same four operations, and a constructor
+// that builds the container from the sorted Items (one per key) in one call.
+//----------------------------------------------------------------------------------------------------
+struct TreeSet
+{
+    static const char* name() {return "BPlusTree<int>";}
+    typedef int Item;
+    static Item item(int key) {return key;}
+    BPlusTree<int> tree;
+
+    TreeSet() {}
+    explicit TreeSet(const vector<Item>& sorted) {tree.bulkLoad(sorted.begin(), sorted.end());}
+
+    void insert(int key) {tree.insert(key);}
+    bool find(int key) {return tree.find(key) != nullptr;}
+    void erase(int key) {tree.remove(key);}
+    long long scan(int key, int length)
+    {
+        long long sum = 0;
+        BPlusTree<int>::Iterator it = tree.lower_bound(key);
+        for(int i = 0; i < length && it != tree.end(); i++, ++it)
+            sum += *it;
+        return sum;
+    }
+};
+
+struct StdSet
+{
+    static const char* name() {return "std::set<int>";}
+    typedef int Item;
+    static Item item(int key) {return key;}
+    set<int> tree;
+
+    StdSet() {}
+    explicit StdSet(const vector<Item>& sorted): tree(sorted.begin(), sorted.end()) {}
+
+    void insert(int key) {tree.insert(key);}
+    bool find(int key) {return tree.find(key) != tree.end();}
+    void erase(int key) {tree.erase(key);}
+    long long scan(int key, int length)
+    {
+        long long sum = 0;
+        set<int>::iterator it = tree.lower_bound(key);
+        for(int i = 0; i < length && it != tree.end(); i++, ++it)
+            sum += *it;
+        return sum;
+    }
+};
+
+struct TreeMap
+{
+    static const char* name() {return "Map<string,int>";}
+    typedef pair<string, int> Item;
+    static Item item(const string& key) {return make_pair(key, 1);}
+    Map<string, int> map;
+
+    TreeMap() {}
+    explicit TreeMap(const vector<Item>& sorted): map(sorted.begin(), sorted.end()) {}
+
+    void insert(const string& key) {map.insert(key, 1);}
+    bool find(const string& key) {return map.contains(key);}
+    void erase(const string& key) {map.erase(key);}
+    long long scan(const string& key, int length)
+    {
+        long long sum = 0;
+        Map<string, int>::Iterator it = map.lower_bound(key);
+        for(int i = 0; i < length && it != map.end(); i++, ++it)
+            sum += *it;
+        return sum;
+    }
+};
+
+struct StdMap
+{
+    static const char* name() {return "std::map<string,int>";}
+    typedef pair<string, int> Item;
+    static Item item(const string& key) {return make_pair(key, 1);}
+    map<string, int> tree;
+
+    StdMap() {}
+    explicit StdMap(const vector<Item>& sorted): tree(sorted.begin(), sorted.end()) {}
+
+    void insert(const string& key) {tree.insert(make_pair(key, 1));}
+    bool find(const string& key) {return tree.find(key) != tree.end();}
+    void erase(const string& key) {tree.erase(key);}
+    long long scan(const string& key, int length)
+    {
+        long long sum = 0;
+        map<string, int>::iterator it = tree.lower_bound(key);
+        for(int i = 0; i < length && it != tree.end(); i++, ++it)
+            sum += it->second;
+        return sum;
+    }
+};
+
+struct TreeMMap
+{
+    static const char* name() {return "MMap<int,int>";}
+    typedef pair<int, int> Item;
+    static Item item(int key) {return make_pair(key, key);}
+    MMap<int, int> map;
+
+    TreeMMap() {}
+    explicit TreeMMap(const vector<Item>& sorted): map(sorted.begin(), sorted.end()) {}
+
+    void insert(int key) {map.insert(key, key);}
+    bool find(int key) {return map.contains(key);}
+    void erase(int key) {map.erase(key);}
+    long long scan(int key, int length)
+    {
+        long long sum = 0;
+        MMap<int, int>::Iterator it = map.lower_bound(key);
+        for(int i = 0; i < length && it != map.end(); i++, ++it)
+            sum += *it;
+        return sum;
+    }
+};
+
+struct StdMultimap
+{
+    static const char* name() {return "std::multimap<int,int>";}
+    typedef pair<int, int> Item;
+    static Item item(int key) {return make_pair(key, key);}
+    multimap<int, int> tree;
+
+    StdMultimap() {}
+    explicit StdMultimap(const vector<Item>& sorted): tree(sorted.begin(), sorted.end()) {}
+
+    void insert(int key) {tree.insert(make_pair(key, key));}
+    bool find(int key) {return tree.find(key) != tree.end();}
+    void erase(int key) {tree.erase(key);}
+    long long scan(int key, int length)
+    {
+        long long sum = 0;
+        multimap<int, int>::iterator it = tree.lower_bound(key);
+        for(int i = 0; i < length && it != tree.end(); i++, ++it)
+            sum += it->second;
+        return sum;
+    }
+};
+
+//----------------------------------------------------------------------------------------------------
+// timing
+//----------------------------------------------------------------------------------------------------
+static const size_t CHUNK = 64;
+static long long checksum = 0;                      //results are added here, so no timed loop is optimized away
+
+//the result of timing one workload.
+struct Timing
+{
+    double mopsPerSecond;
+    double p50;                                      //ns per operation, -1 if not measured
+    double p99;
+};
+
+//preconditions: none
+//postconditions: runs op(i) for i in [0, ops), timing each chunk of CHUNK calls,
+// and returns the throughput and the latency percentiles of the chunks.
+template <typename Op>
+Timing timeOps(size_t ops, Op op)
+{
+    vector<double> latencies;
+    latencies.reserve(ops / CHUNK + 1);
+
+    Clock::time_point start = Clock::now();
+    Clock::time_point chunkStart = start;
+    for(size_t i = 0; i < ops; )
+    {
+        size_t end = min(ops, i + CHUNK);
+        for(; i < end; i++)
+            op(i);
+
+        Clock::time_point now = Clock::now();
+        latencies.push_back(chrono::duration<double, nano>(now - chunkStart).count() / CHUNK);
+        chunkStart = now;
+    }
+    double seconds = chrono::duration<double>(Clock::now() - start).count();
+
+    Timing timing;
+    timing.mopsPerSecond = ops / seconds / 1e6;
+    sort(latencies.begin(), latencies.end());
+    timing.p50 = latencies.empty() ? -1 : latencies[latencies.size() / 2];
+    timing.p99 = latencies.empty() ? -1 : latencies[latencies.size() * 99 / 100];
+    return timing;
+}
+
+//preconditions: none
+//postconditions: prints one row of results.
+void report(const char* container, const char* workload, size_t n, const Timing& timing)
+{
+    cout << setw(24) << container << setw(13) << workload << setw(11) << n
+         << fixed << setprecision(2) << setw(10) << timing.mopsPerSecond;
+    if(timing.p50 < 0)
+        cout << setw(10) << "-" << setw(10) << "-";
+    else
+        cout << setprecision(1) << setw(10) << timing.p50 << setw(10) << timing.p99;
+    cout << endl;
+}
+
+//----------------------------------------------------------------------------------------------------
+// workloads
+//----------------------------------------------------------------------------------------------------
+
+//preconditions: none
+//postconditions: runs every workload on a Container of Keys, printing one row for each,
+// and the bytes per key after insert rand.
+template <typename Container, typename Key>
+void runWorkloads(const Workload<Key>& w)
+{
+    const size_t n = w.sorted.size();
+    const char* name = Container::name();
+
+    {
+        Container c;
+        report(name, "insert seq", n, timeOps(n, [&](size_t i) {c.insert(w.sorted[i]);}));
+    }
+    {
+        Container c;
+        report(name, "insert zipf", n, timeOps(n, [&](size_t i) {c.insert(w.zipf[i]);}));
+    }
+    {
+        vector<typename Container::Item> items;
+        for(size_t i = 0; i < n; i++)
+            items.push_back(Container::item(w.sorted[i]));
+
+        Clock::time_point start = Clock::now();
+        Container c(items);
+        Timing timing = {n / chrono::duration<double>(Clock::now() - start).count() / 1e6, -1, -1};
+        report(name, "load sorted", n, timing);
+    }
+
+    size_t before = liveBytes;
+    Container* c = new Container;
+    report(name, "insert rand", n, timeOps(n, [&](size_t i) {c->insert(w.shuffled[i]);}));
+    double bytesPerKey = double(liveBytes - before) / n;
+
+    report(name, "find hit", n, timeOps(n, [&](size_t i) {checksum += c->find(w.probes[i]);}));
+    report(name, "find miss", n, timeOps(n, [&](size_t i) {checksum += c->find(w.misses[i]);}));
+    report(name, "scan 100", w.scanStarts.size(), timeOps(w.scanStarts.size(), [&](size_t i) {checksum += c->scan(w.scanStarts[i], 100);}));
+    report(name, "mixed", n, timeOps(n, [&](size_t i)
+    {
+        switch(w.mixedOps[i])
+        {
+        case 'i': c->insert(w.mixedKeys[i]); break;
+        case 'e': c->erase(w.mixedKeys[i]); break;
+        default: checksum += c->find(w.mixedKeys[i]); break;
+        }
+    }));
+    report(name, "erase", n, timeOps(n, [&](size_t i) {c->erase(w.probes[i]);}));
+    delete c;
+
+    cout << setw(24) << name << setw(13) << "bytes/key" << setw(11) << n
+         << fixed << setprecision(1) << setw(10) << bytesPerKey << endl;
+}
+
+int main(int argc, char* argv[])
+{
+    vector<size_t> sizes;
+    for(int i = 1; i < argc; i++)
+        sizes.push_back(size_t(atoll(argv[i])));
+    if(sizes.empty())
+    {
+        sizes.push_back(1000);
+        sizes.push_back(10000);
+        sizes.push_back(100000);
+        sizes.push_back(1000000);
+    }
+
+#if defined(__VERSION__)
+    cout << "compiler: " << __VERSION__ << endl;
+#endif
+    cout << "latencies are ns / op, over chunks of " << CHUNK << " ops" << endl << endl;
+    cout << setw(24) << "container" << setw(13) << "workload" << setw(11) << "keys"
+         << setw(10) << "Mops/s" << setw(10) << "p50" << setw(10) << "p99" << endl;
+
+    for(size_t s = 0; s < sizes.size(); s++)
+    {
+        {
+            Workload<int> w(sizes[s]);
+            runWorkloads<TreeSet>(w);
+            runWorkloads<StdSet>(w);
+            runWorkloads<TreeMMap>(w);
+            runWorkloads<StdMultimap>(w);
+        }
+        {
+            Workload<string> w(sizes[s]);
+            runWorkloads<TreeMap>(w);
+            runWorkloads<StdMap>(w);
+        }
+        cout << endl;
+    }
+
+    cout << "(checksum " << checksum << ")" << endl;
+    return 0;
+}